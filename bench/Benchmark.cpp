@@ -0,0 +1,398 @@
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <regex>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+#include <windows.h>
+#include <omp.h>
+
+#include <wx/init.h>
+#include <wx/log.h>
+#include <wx/image.h>
+#include <wx/filename.h>
+
+#include "json.hpp"
+#include "SyntheticDataset.h"
+
+namespace
+{
+	std::string dataDirectory;
+	// Size of the placeholder images, small so thousands of them are written quickly
+	const unsigned int imageWidth = 320;
+	const unsigned int imageHeight = 240;
+
+	std::vector<std::unique_ptr<Bench::Case>>& getCases()
+	{
+		static std::vector<std::unique_ptr<Bench::Case>> cases;
+		return cases;
+	}
+
+	double getRealTime()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// User and kernel time of every thread of the process, so the parallel cases show their speedup
+	double getCpuTime()
+	{
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		{
+			return 0;
+		}
+		auto toSeconds = [](const FILETIME& time)
+		{
+			return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1e-7;
+		};
+		return toSeconds(kernel) + toSeconds(user);
+	}
+
+	// Value of "--name=value", false if the argument is another one
+	bool getFlag(const std::string& argument, const std::string& name, std::string& value)
+	{
+		if (argument.compare(0, name.size() + 1, name + "=") != 0)
+		{
+			return 0;
+		}
+		value = argument.substr(name.size() + 1);
+		return 1;
+	}
+
+	std::string printTime(double seconds)
+	{
+		char text[32];
+		if (seconds < 1e-5)
+		{
+			snprintf(text, sizeof(text), "%.1f ns", seconds * 1e9);
+		}
+		else if (seconds < 1e-2)
+		{
+			snprintf(text, sizeof(text), "%.1f us", seconds * 1e6);
+		}
+		else
+		{
+			snprintf(text, sizeof(text), "%.1f ms", seconds * 1e3);
+		}
+		return text;
+	}
+
+	std::string printRate(double perSecond, const std::string& unit)
+	{
+		const char* prefixes[] = { "", "k", "M", "G", "T" };
+		int prefix = 0;
+		while (perSecond >= 1000 && prefix < 4)
+		{
+			perSecond /= 1000;
+			prefix++;
+		}
+		char text[48];
+		snprintf(text, sizeof(text), "%.2f%s%s/s", perSecond, prefixes[prefix], unit.c_str());
+		return text;
+	}
+
+	std::string getDate()
+	{
+		const std::time_t now = std::time(nullptr);
+		char text[32];
+		std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+		return text;
+	}
+}
+
+bool Bench::State::keepRunning()
+{
+	if (!started)
+	{
+		started = true;
+		if (hasError())
+		{
+			return 0;
+		}
+		resumeTiming();
+		return 1;
+	}
+	iterations++;
+	const double measured = realSeconds + (timing ? getRealTime() - realStart : 0);
+	if (hasError() || measured >= minSeconds || iterations >= 1000000000)
+	{
+		pauseTiming();
+		return 0;
+	}
+	return 1;
+}
+
+void Bench::State::pauseTiming()
+{
+	if (timing)
+	{
+		realSeconds += getRealTime() - realStart;
+		cpuSeconds += getCpuTime() - cpuStart;
+		timing = false;
+	}
+}
+
+void Bench::State::resumeTiming()
+{
+	if (!timing)
+	{
+		realStart = getRealTime();
+		cpuStart = getCpuTime();
+		timing = true;
+	}
+}
+
+void Bench::State::skipWithError(const std::string& message)
+{
+	error = message;
+}
+
+Bench::Case* Bench::Case::arg(int64_t argument)
+{
+	arguments.emplace_back(argument);
+	return this;
+}
+
+Bench::Case* Bench::add(const std::string& name, Function function)
+{
+	getCases().emplace_back(new Case(name, function));
+	return getCases().back().get();
+}
+
+std::string Bench::getDataset(size_t numImages, size_t sparsePointsPerImage, size_t densePoints, size_t meshFaces,
+	bool withImages)
+{
+	std::stringstream name;
+	name << "orbit_i" << numImages << "_s" << sparsePointsPerImage << "_d" << densePoints << "_m" << meshFaces <<
+		(withImages ? "_images" : "");
+	const std::string directory = dataDirectory + "/" + name.str();
+	//The ground truth is written last, so a dataset with it is complete
+	if (wxFileExists(directory + "/ground_truth.json"))
+	{
+		return directory;
+	}
+	Synthetic::Options options;
+	options.rig = Synthetic::Orbit;
+	options.numImages = static_cast<int>(numImages);
+	options.sparsePointsPerImage = static_cast<int>(sparsePointsPerImage);
+	options.densePoints = densePoints;
+	options.meshFaces = meshFaces;
+	if (withImages)
+	{
+		options.writeImages = true;
+		options.width = imageWidth;
+		options.height = imageHeight;
+	}
+	fprintf(stderr, "Generating the dataset %s\n", name.str().c_str());
+	if (!SyntheticDataset::generate(options, directory))
+	{
+		wxLog::FlushActive();
+		return "";
+	}
+	return directory;
+}
+
+std::string Bench::getScratchPath(const std::string& name)
+{
+	return dataDirectory + "/scratch/" + name;
+}
+
+int64_t Bench::getFileSize(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	return file.is_open() ? static_cast<int64_t>(file.tellg()) : 0;
+}
+
+int Bench::run(int argc, char** argv)
+{
+	std::string filter = ".", outputPath, value;
+	double minSeconds = 0.5;
+	bool listOnly = false;
+	nlohmann::json context;
+	dataDirectory = wxFileName::GetTempDir().ToStdString() + "/saescan3d_bench";
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		if (getFlag(argument, "--benchmark_filter", value))
+		{
+			filter = value;
+		}
+		else if (getFlag(argument, "--benchmark_min_time", value))
+		{
+			//Seconds, with or without the "s" of the newer versions
+			minSeconds = std::atof(value.c_str());
+		}
+		else if (getFlag(argument, "--benchmark_out", value))
+		{
+			outputPath = value;
+		}
+		else if (getFlag(argument, "--benchmark_context", value) && value.find('=') != std::string::npos)
+		{
+			//e.g. --benchmark_context=commit=<hash>, to follow the results along the history
+			context[value.substr(0, value.find('='))] = value.substr(value.find('=') + 1);
+		}
+		else if (getFlag(argument, "--benchmark_data", value))
+		{
+			dataDirectory = value;
+		}
+		else if (argument == "--benchmark_list_tests" || argument == "--benchmark_list_tests=true")
+		{
+			listOnly = true;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown argument %s\n"
+				"Use [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>] [--benchmark_out=<json file>]\n"
+				"    [--benchmark_context=<key>=<value>] [--benchmark_data=<folder of the datasets>] [--benchmark_list_tests]\n",
+				argument.c_str());
+			return 1;
+		}
+	}
+	std::regex filterExpression;
+	try
+	{
+		filterExpression = std::regex(filter);
+	}
+	catch (const std::regex_error&)
+	{
+		fprintf(stderr, "Invalid filter %s\n", filter.c_str());
+		return 1;
+	}
+	if (!listOnly && !wxFileName::Mkdir(dataDirectory + "/scratch", 0777, wxPATH_MKDIR_FULL))
+	{
+		fprintf(stderr, "Could not create the data folder %s\n", dataDirectory.c_str());
+		return 1;
+	}
+	context["date"] = getDate();
+	context["executable"] = argv[0];
+	context["num_cpus"] = std::thread::hardware_concurrency();
+	context["omp_max_threads"] = omp_get_max_threads();
+#ifdef NDEBUG
+	context["library_build_type"] = "release";
+#else
+	context["library_build_type"] = "debug";
+#endif
+	nlohmann::json results = nlohmann::json::array();
+	bool failed = false;
+	if (!listOnly)
+	{
+		printf("%-44s %14s %14s %12s  %s\n", "Benchmark", "Time", "CPU", "Iterations", "Rates");
+	}
+	for (size_t family = 0; family < getCases().size(); family++)
+	{
+		const Case& benchmarkCase = *getCases()[family];
+		//A case without arguments runs once
+		std::vector<std::pair<int64_t, bool>> runs;
+		for (const auto argument : benchmarkCase.getArguments())
+		{
+			runs.emplace_back(argument, true);
+		}
+		if (runs.empty())
+		{
+			runs.emplace_back(0, false);
+		}
+		for (size_t instance = 0; instance < runs.size(); instance++)
+		{
+			const std::string name = benchmarkCase.getName() + (runs[instance].second ? "/" + std::to_string(runs[instance].first) : "");
+			if (!std::regex_search(name, filterExpression))
+			{
+				continue;
+			}
+			if (listOnly)
+			{
+				printf("%s\n", name.c_str());
+				continue;
+			}
+			State state(runs[instance].first, runs[instance].second, minSeconds);
+			try
+			{
+				benchmarkCase.getFunction()(state);
+			}
+			catch (const std::exception& exception)
+			{
+				state.skipWithError(exception.what());
+			}
+			if (!state.hasError() && state.getIterations() == 0)
+			{
+				state.skipWithError("The case did not run its loop");
+			}
+			wxLog::FlushActive();
+			nlohmann::json result;
+			result["name"] = name;
+			result["family_index"] = family;
+			result["per_family_instance_index"] = instance;
+			result["run_name"] = name;
+			result["run_type"] = "iteration";
+			result["repetitions"] = 1;
+			result["repetition_index"] = 0;
+			result["threads"] = 1;
+			if (state.hasError())
+			{
+				failed = true;
+				result["error_occurred"] = true;
+				result["error_message"] = state.getError();
+				printf("%-44s ERROR: %s\n", name.c_str(), state.getError().c_str());
+				results.push_back(result);
+				continue;
+			}
+			const double iterations = static_cast<double>(state.getIterations());
+			const double realSeconds = state.getRealSeconds();
+			result["iterations"] = state.getIterations();
+			result["real_time"] = realSeconds / iterations * 1e9;
+			result["cpu_time"] = state.getCpuSeconds() / iterations * 1e9;
+			result["time_unit"] = "ns";
+			std::string rates;
+			if (state.getBytesProcessed() > 0 && realSeconds > 0)
+			{
+				result["bytes_per_second"] = state.getBytesProcessed() / realSeconds;
+				rates += printRate(state.getBytesProcessed() / realSeconds, "B") + " ";
+			}
+			if (state.getItemsProcessed() > 0 && realSeconds > 0)
+			{
+				result["items_per_second"] = state.getItemsProcessed() / realSeconds;
+				rates += printRate(state.getItemsProcessed() / realSeconds, "") + " items ";
+			}
+			if (!state.getLabel().empty())
+			{
+				result["label"] = state.getLabel();
+				rates += state.getLabel();
+			}
+			printf("%-44s %14s %14s %12lld  %s\n", name.c_str(), printTime(realSeconds / iterations).c_str(),
+				printTime(state.getCpuSeconds() / iterations).c_str(), static_cast<long long>(state.getIterations()), rates.c_str());
+			fflush(stdout);
+			results.push_back(result);
+		}
+	}
+	if (!outputPath.empty() && !listOnly)
+	{
+		std::ofstream output(outputPath);
+		if (!output.is_open())
+		{
+			fprintf(stderr, "Could not write %s\n", outputPath.c_str());
+			return 1;
+		}
+		nlohmann::json report;
+		report["context"] = context;
+		report["benchmarks"] = results;
+		output << report.dump(2);
+	}
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	wxInitializer initializer;
+	if (!initializer.IsOk())
+	{
+		fprintf(stderr, "Could not initialize wxWidgets\n");
+		return 1;
+	}
+	wxInitAllImageHandlers();
+	delete wxLog::SetActiveTarget(new wxLogStderr());
+	return Bench::run(argc, argv);
+}
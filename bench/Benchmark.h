@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Harness of the benchmarks in the style of Google Benchmark, without the dependency. A case is a function of a State
+// that times the loop of keepRunning(), registered with BENCHMARK(function) and optionally its arguments:
+//
+//	void PlyRead(Bench::State& state)
+//	{
+//		const auto path = ...setup of state.getArgument() points...;
+//		while (state.keepRunning())
+//		{
+//			...
+//		}
+//		state.setItemsProcessed(state.getIterations() * state.getArgument());
+//	}
+//	BENCHMARK(PlyRead)->arg(100000)->arg(1000000);
+//
+// The command line takes the flags of Google Benchmark (--benchmark_filter, --benchmark_min_time, --benchmark_out,
+// --benchmark_context, --benchmark_list_tests) and the results are written in its JSON format, so the tools that
+// compare its runs work with them.
+namespace Bench
+{
+	class State
+	{
+	public:
+		State(int64_t argument, bool hasArgument, double minSeconds) : argument(argument), argumentSet(hasArgument),
+			minSeconds(minSeconds) {};
+
+		// True while the measured time is below the minimum, the first call starts the timing
+		bool keepRunning();
+		// Excludes the setup of an iteration from the times
+		void pauseTiming();
+		void resumeTiming();
+		// Stops the loop and reports the case as failed
+		void skipWithError(const std::string& message);
+
+		int64_t getArgument() const { return argument; };
+		bool hasArgument() const { return argumentSet; };
+		int64_t getIterations() const { return iterations; };
+		// Totals of the run, the rates are per second of measured time
+		void setItemsProcessed(int64_t items) { itemsProcessed = items; };
+		void setBytesProcessed(int64_t bytes) { bytesProcessed = bytes; };
+		void setLabel(const std::string& label) { this->label = label; };
+
+		double getRealSeconds() const { return realSeconds; };
+		double getCpuSeconds() const { return cpuSeconds; };
+		int64_t getItemsProcessed() const { return itemsProcessed; };
+		int64_t getBytesProcessed() const { return bytesProcessed; };
+		const std::string& getLabel() const { return label; };
+		bool hasError() const { return !error.empty(); };
+		const std::string& getError() const { return error; };
+
+	private:
+		int64_t argument;
+		bool argumentSet;
+		double minSeconds;
+		bool started = false;
+		bool timing = false;
+		int64_t iterations = 0;
+		double realSeconds = 0;
+		double cpuSeconds = 0;
+		double realStart = 0;
+		double cpuStart = 0;
+		int64_t itemsProcessed = 0;
+		int64_t bytesProcessed = 0;
+		std::string label;
+		std::string error;
+	};
+
+	typedef void (*Function)(State&);
+
+	class Case
+	{
+	public:
+		Case(const std::string& name, Function function) : name(name), function(function) {};
+
+		// Runs the case once per argument, named "case/argument"
+		Case* arg(int64_t argument);
+		const std::string& getName() const { return name; };
+		Function getFunction() const { return function; };
+		const std::vector<int64_t>& getArguments() const { return arguments; };
+
+	private:
+		std::string name;
+		Function function;
+		std::vector<int64_t> arguments;
+	};
+
+	// Registers a case, see BENCHMARK
+	Case* add(const std::string& name, Function function);
+	// Runs the cases selected by the flags, 0 when they all succeeded
+	int run(int argc, char** argv);
+
+	// Folder of an orbit dataset (see SyntheticDataset) in the data folder of the run, generated once and kept for
+	// the next runs. Empty if it could not be generated. The readers of the camera files open their images, so
+	// withImages writes small placeholders of them
+	std::string getDataset(size_t numImages, size_t sparsePointsPerImage, size_t densePoints, size_t meshFaces,
+		bool withImages = false);
+	// Path of a file the cases can overwrite, in the data folder
+	std::string getScratchPath(const std::string& name);
+	int64_t getFileSize(const std::string& path);
+}
+
+#define BENCHMARK_CONCAT_NAME(name, line) name##line
+#define BENCHMARK_NAME(name, line) BENCHMARK_CONCAT_NAME(name, line)
+#define BENCHMARK(function) static Bench::Case* BENCHMARK_NAME(benchmarkCase, __LINE__) = Bench::add(#function, function)
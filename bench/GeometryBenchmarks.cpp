@@ -0,0 +1,226 @@
+#include <random>
+
+#include <omp.h>
+
+#include <Eigen/Dense>
+
+#include "Benchmark.h"
+#include "Camera.h"
+#include "ColmapModel.h"
+#include "SpatialIndex.h"
+#include "SyntheticDataset.h"
+
+namespace
+{
+	const size_t numQueries = 10000;
+	const size_t numNeighbors = 8;
+	const size_t numProjectionCameras = 100;
+
+	std::vector<Eigen::Vector3d> createPoints(size_t count, uint64_t stream)
+	{
+		Synthetic::Options options;
+		std::vector<float> positions, normals;
+		std::vector<unsigned char> colors;
+		SyntheticDataset::createPoints(options, count, stream, positions, normals, colors);
+		std::vector<Eigen::Vector3d> points(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			points[i] = Eigen::Vector3d(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+		}
+		return points;
+	}
+
+	// Similarity of the scale step from input to output, xyz interleaved, the normals are only rotated
+	void transformCloud(const Synthetic::Similarity& similarity, const std::vector<float>& positions, const std::vector<float>& normals,
+		std::vector<float>& outputPositions, std::vector<float>& outputNormals)
+	{
+		const Eigen::Matrix3f rotation = similarity.rotation.cast<float>();
+		const Eigen::Matrix3f scaledRotation = static_cast<float>(similarity.scale) * rotation;
+		const Eigen::Vector3f translation = similarity.translation.cast<float>();
+		const int count = static_cast<int>(positions.size() / 3);
+		const bool hasNormals = !normals.empty();
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < count; i++)
+		{
+			const size_t offset = 3 * static_cast<size_t>(i);
+			Eigen::Map<Eigen::Vector3f> outputPosition(&outputPositions[offset]);
+			outputPosition = scaledRotation * Eigen::Map<const Eigen::Vector3f>(&positions[offset]) + translation;
+			if (hasNormals)
+			{
+				Eigen::Map<Eigen::Vector3f> outputNormal(&outputNormals[offset]);
+				outputNormal = rotation * Eigen::Map<const Eigen::Vector3f>(&normals[offset]);
+			}
+		}
+	}
+
+	Synthetic::Similarity getSimilarity()
+	{
+		Synthetic::Options options;
+		return SyntheticDataset::createSimilarity(options);
+	}
+
+	// Argument: points with normals
+	void CloudTransform(Bench::State& state)
+	{
+		Synthetic::Options options;
+		std::vector<float> positions, normals;
+		std::vector<unsigned char> colors;
+		SyntheticDataset::createPoints(options, static_cast<size_t>(state.getArgument()), 0, positions, normals, colors);
+		std::vector<float> outputPositions(positions.size()), outputNormals(normals.size());
+		const auto similarity = getSimilarity();
+		while (state.keepRunning())
+		{
+			transformCloud(similarity, positions, normals, outputPositions, outputNormals);
+		}
+		state.setItemsProcessed(state.getIterations() * state.getArgument());
+		state.setBytesProcessed(state.getIterations() * static_cast<int64_t>((positions.size() + normals.size()) * sizeof(float)));
+	}
+
+	// Argument: faces, only the vertices move
+	void MeshTransform(Bench::State& state)
+	{
+		Synthetic::Options options;
+		options.meshFaces = static_cast<size_t>(state.getArgument());
+		std::vector<float> positions, outputNormals;
+		std::vector<uint32_t> triangles;
+		SyntheticDataset::createMesh(options, positions, triangles);
+		std::vector<float> outputPositions(positions.size());
+		const auto similarity = getSimilarity();
+		while (state.keepRunning())
+		{
+			transformCloud(similarity, positions, {}, outputPositions, outputNormals);
+		}
+		state.setItemsProcessed(state.getIterations() * static_cast<int64_t>(positions.size() / 3));
+		state.setBytesProcessed(state.getIterations() * static_cast<int64_t>(positions.size() * sizeof(float)));
+	}
+
+	// Argument: images, with 500 sparse points each
+	void ModelTransform(Bench::State& state)
+	{
+		Synthetic::Options options;
+		options.numImages = static_cast<int>(state.getArgument());
+		const ColmapModel model = SyntheticDataset::createModel(options);
+		const auto similarity = getSimilarity();
+		while (state.keepRunning())
+		{
+			state.pauseTiming();
+			ColmapModel transformed = model;
+			state.resumeTiming();
+			transformed.transform(similarity.scale, similarity.rotation, similarity.translation);
+		}
+		state.setItemsProcessed(state.getIterations() * static_cast<int64_t>(model.images.size() + model.points3D.size()));
+	}
+
+	// Argument: points, each one projected into 100 cameras of the orbit as the visibility tests of the pipeline
+	void CameraProjection(Bench::State& state)
+	{
+		Synthetic::Options options;
+		options.numImages = static_cast<int>(numProjectionCameras);
+		options.sparsePointsPerImage = 0;
+		const ColmapModel model = SyntheticDataset::createModel(options);
+		std::vector<Camera> cameras;
+		for (const auto& image : model.images)
+		{
+			const auto& intrinsics = model.cameras.at(image.second.cameraId);
+			double focal[2], principalPoint[2];
+			ColmapModel::getFocalAndPrincipalPoint(intrinsics, focal, principalPoint);
+			const float cameraFocal[2] = { static_cast<float>(focal[0]), static_cast<float>(focal[1]) };
+			const float cameraPrincipalPoint[2] = { static_cast<float>(principalPoint[0]), static_cast<float>(principalPoint[1]) };
+			cameras.emplace_back(image.second.name, cameraFocal, cameraPrincipalPoint, static_cast<unsigned int>(intrinsics.width),
+				static_cast<unsigned int>(intrinsics.height), ColmapModel::getMatrixRt(image.second));
+		}
+		std::vector<float> positions, normals;
+		std::vector<unsigned char> colors;
+		SyntheticDataset::createPoints(options, static_cast<size_t>(state.getArgument()), 0, positions, normals, colors);
+		const int numPoints = static_cast<int>(positions.size() / 3);
+		long long visible = 0;
+		while (state.keepRunning())
+		{
+			visible = 0;
+			for (const auto& camera : cameras)
+			{
+				const Eigen::Matrix4f matrixRt = camera.getMatrixRt().cast<float>();
+				const Eigen::Matrix3f rotation = matrixRt.block<3, 3>(0, 0);
+				const Eigen::Vector3f translation = matrixRt.block<3, 1>(0, 3);
+				const float fx = camera.getFocalX(), fy = camera.getFocalY();
+				const float cx = camera.getPrincipalPointX(), cy = camera.getPrincipalPointY();
+				const float width = static_cast<float>(camera.getWidth()), height = static_cast<float>(camera.getHeight());
+				long long cameraVisible = 0;
+#pragma omp parallel for schedule(static) reduction(+:cameraVisible)
+				for (int i = 0; i < numPoints; i++)
+				{
+					const Eigen::Vector3f point = rotation * Eigen::Map<const Eigen::Vector3f>(&positions[3 * static_cast<size_t>(i)]) + translation;
+					if (point.z() <= 0)
+					{
+						continue;
+					}
+					const float x = fx * point.x() / point.z() + cx;
+					const float y = fy * point.y() / point.z() + cy;
+					if (x >= 0 && y >= 0 && x < width && y < height)
+					{
+						cameraVisible++;
+					}
+				}
+				visible += cameraVisible;
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * state.getArgument() * static_cast<int64_t>(cameras.size()));
+		state.setLabel(std::to_string(visible) + " visible");
+	}
+
+	// Argument: points of the index
+	void SpatialIndexBuild(Bench::State& state)
+	{
+		const auto points = createPoints(static_cast<size_t>(state.getArgument()), 0);
+		while (state.keepRunning())
+		{
+			SpatialIndex index(points);
+		}
+		state.setItemsProcessed(state.getIterations() * state.getArgument());
+	}
+
+	// Argument: points of the index, queried by 10000 other points of the scene
+	void SpatialIndexKnn(Bench::State& state)
+	{
+		const SpatialIndex index(createPoints(static_cast<size_t>(state.getArgument()), 0));
+		const auto queries = createPoints(numQueries, 1);
+		size_t found = 0;
+		while (state.keepRunning())
+		{
+			for (const auto& query : queries)
+			{
+				found += index.knn(query, numNeighbors).size();
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * static_cast<int64_t>(queries.size()));
+		state.setLabel(std::to_string(state.getIterations() > 0 ? found / state.getIterations() / queries.size() : 0) + " found");
+	}
+
+	// Argument: points of the index, queried in the radius of about 8 neighbors
+	void SpatialIndexRadius(Bench::State& state)
+	{
+		const auto points = createPoints(static_cast<size_t>(state.getArgument()), 0);
+		const SpatialIndex index(points);
+		const auto queries = createPoints(numQueries, 1);
+		//The points cover the 4 pi 3^2 of the sphere of the scene
+		const double radius = std::sqrt(numNeighbors * 4 * 3 * 3 / static_cast<double>(points.size()));
+		size_t found = 0;
+		while (state.keepRunning())
+		{
+			for (const auto& query : queries)
+			{
+				found += index.radius(query, radius).size();
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * static_cast<int64_t>(queries.size()));
+		state.setLabel(std::to_string(state.getIterations() > 0 ? found / state.getIterations() / queries.size() : 0) + " found");
+	}
+}
+
+BENCHMARK(CloudTransform)->arg(100000)->arg(1000000)->arg(10000000);
+BENCHMARK(MeshTransform)->arg(100000)->arg(1000000)->arg(10000000);
+BENCHMARK(ModelTransform)->arg(100)->arg(1000);
+BENCHMARK(CameraProjection)->arg(100000)->arg(1000000);
+BENCHMARK(SpatialIndexBuild)->arg(10000)->arg(100000)->arg(1000000);
+BENCHMARK(SpatialIndexKnn)->arg(10000)->arg(100000)->arg(1000000);
+BENCHMARK(SpatialIndexRadius)->arg(10000)->arg(100000)->arg(1000000);
@@ -0,0 +1,290 @@
+#include <fstream>
+#include <memory>
+
+#include "Benchmark.h"
+#include "ImageIO.h"
+#include "Camera.h"
+#include "ColmapModel.h"
+#include "PlyIO.h"
+#include "SyntheticDataset.h"
+#include "tinyply.h"
+
+namespace
+{
+	// Few sparse points, the camera files don't have them
+	const size_t camerasSparsePoints = 10;
+	const size_t modelSparsePoints = 500;
+
+	void deleteCameras(std::vector<Camera*>& cameras)
+	{
+		for (auto camera : cameras)
+		{
+			delete camera;
+		}
+		cameras.clear();
+	}
+
+	void readCameras(Bench::State& state, const std::string& extension)
+	{
+		const auto dataset = Bench::getDataset(static_cast<size_t>(state.getArgument()), camerasSparsePoints, 0, 0, true);
+		if (dataset.empty())
+		{
+			state.skipWithError("Could not generate the dataset");
+		}
+		const std::string path = dataset + "/cameras." + extension;
+		std::vector<Camera*> cameras;
+		while (state.keepRunning())
+		{
+			if (!ImageIO::loadCameraParameters(path, cameras))
+			{
+				state.skipWithError("Could not read " + path);
+			}
+			state.pauseTiming();
+			deleteCameras(cameras);
+			state.resumeTiming();
+		}
+		state.setItemsProcessed(state.getIterations() * state.getArgument());
+		state.setBytesProcessed(state.getIterations() * Bench::getFileSize(path));
+	}
+
+	void writeCameras(Bench::State& state, const std::string& extension)
+	{
+		const auto dataset = Bench::getDataset(static_cast<size_t>(state.getArgument()), camerasSparsePoints, 0, 0, true);
+		std::vector<Camera*> cameras;
+		if (dataset.empty() || !ImageIO::loadCameraParameters(dataset + "/cameras." + extension, cameras))
+		{
+			state.skipWithError("Could not read the cameras of the dataset");
+		}
+		const std::string path = Bench::getScratchPath("cameras." + extension);
+		while (state.keepRunning())
+		{
+			if (!ImageIO::saveCameras(path, cameras))
+			{
+				state.skipWithError("Could not write " + path);
+			}
+		}
+		deleteCameras(cameras);
+		state.setItemsProcessed(state.getIterations() * state.getArgument());
+		state.setBytesProcessed(state.getIterations() * Bench::getFileSize(path));
+	}
+
+	void NvmRead(Bench::State& state)
+	{
+		readCameras(state, "nvm");
+	}
+
+	void NvmWrite(Bench::State& state)
+	{
+		writeCameras(state, "nvm");
+	}
+
+	void SfmRead(Bench::State& state)
+	{
+		readCameras(state, "sfm");
+	}
+
+	void SfmWrite(Bench::State& state)
+	{
+		writeCameras(state, "sfm");
+	}
+
+	// Argument: images, with 500 sparse points each
+	void ColmapModelRead(Bench::State& state)
+	{
+		const auto dataset = Bench::getDataset(static_cast<size_t>(state.getArgument()), modelSparsePoints, 0, 0);
+		if (dataset.empty())
+		{
+			state.skipWithError("Could not generate the dataset");
+		}
+		size_t numPoints = 0;
+		while (state.keepRunning())
+		{
+			ColmapModel model;
+			if (!model.read(dataset + "/sparse"))
+			{
+				state.skipWithError("Could not read the model of " + dataset);
+			}
+			numPoints = model.points3D.size();
+		}
+		state.setItemsProcessed(state.getIterations() * static_cast<int64_t>(numPoints));
+		state.setBytesProcessed(state.getIterations() * (Bench::getFileSize(dataset + "/sparse/cameras.bin") +
+			Bench::getFileSize(dataset + "/sparse/images.bin") + Bench::getFileSize(dataset + "/sparse/points3D.bin")));
+	}
+
+	// Argument: points, read by tinyply as every point cloud of the pipeline
+	void PlyReadTinyply(Bench::State& state)
+	{
+		const auto dataset = Bench::getDataset(2, 0, static_cast<size_t>(state.getArgument()), 0);
+		if (dataset.empty())
+		{
+			state.skipWithError("Could not generate the dataset");
+		}
+		const std::string path = dataset + "/dense.ply";
+		std::vector<float> positions, normals;
+		std::vector<unsigned char> colors;
+		while (state.keepRunning())
+		{
+			if (!PlyIO::readPoints(path, positions, normals, colors))
+			{
+				state.skipWithError("Could not read " + path);
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * state.getArgument());
+		state.setBytesProcessed(state.getIterations() * Bench::getFileSize(path));
+	}
+
+	// Argument: faces, read by tinyply as the meshes of SSDRecon
+	void MeshReadTinyply(Bench::State& state)
+	{
+		const auto dataset = Bench::getDataset(2, 0, 0, static_cast<size_t>(state.getArgument()));
+		if (dataset.empty())
+		{
+			state.skipWithError("Could not generate the dataset");
+		}
+		const std::string path = dataset + "/mesh.ply";
+		size_t numFaces = 0;
+		while (state.keepRunning())
+		{
+			std::ifstream file(path, std::ios::binary);
+			try
+			{
+				tinyply::PlyFile ply;
+				ply.parse_header(file);
+				auto vertices = ply.request_properties_from_element("vertex", { "x", "y", "z" });
+				auto faces = ply.request_properties_from_element("face", { "vertex_indices" }, 3);
+				ply.read(file);
+				numFaces = faces->count;
+			}
+			catch (const std::exception& exception)
+			{
+				state.skipWithError(exception.what());
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * static_cast<int64_t>(numFaces));
+		state.setBytesProcessed(state.getIterations() * Bench::getFileSize(path));
+	}
+
+	void createCloud(Bench::State& state, std::vector<float>& positions, std::vector<float>& normals, std::vector<unsigned char>& colors)
+	{
+		Synthetic::Options options;
+		SyntheticDataset::createPoints(options, static_cast<size_t>(state.getArgument()), 0, positions, normals, colors);
+	}
+
+	// Argument: points, written by the parallel writer of PlyIO
+	void PlyWriteNative(Bench::State& state)
+	{
+		std::vector<float> positions, normals;
+		std::vector<unsigned char> colors;
+		createCloud(state, positions, normals, colors);
+		const std::string path = Bench::getScratchPath("native.ply");
+		while (state.keepRunning())
+		{
+			if (!PlyIO::write(path, positions, normals, colors, {}))
+			{
+				state.skipWithError("Could not write " + path);
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * state.getArgument());
+		state.setBytesProcessed(state.getIterations() * Bench::getFileSize(path));
+	}
+
+	// Argument: points, with 16 bits positions
+	void PlyWriteNativeQuantized(Bench::State& state)
+	{
+		std::vector<float> positions, normals;
+		std::vector<unsigned char> colors;
+		createCloud(state, positions, normals, colors);
+		const std::string path = Bench::getScratchPath("quantized.ply");
+		PlyIO::WriteOptions writeOptions;
+		writeOptions.quantizePositions = true;
+		while (state.keepRunning())
+		{
+			if (!PlyIO::write(path, positions, normals, colors, {}, writeOptions))
+			{
+				state.skipWithError("Could not write " + path);
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * state.getArgument());
+		state.setBytesProcessed(state.getIterations() * Bench::getFileSize(path));
+	}
+
+	// Argument: points, appended in chunks as the point clouds created while they are written
+	void PlyWriteStream(Bench::State& state)
+	{
+		std::vector<float> positions, normals;
+		std::vector<unsigned char> colors;
+		createCloud(state, positions, normals, colors);
+		const std::string path = Bench::getScratchPath("stream.ply");
+		while (state.keepRunning())
+		{
+			PlyIO::StreamWriter writer;
+			if (!writer.open(path, true, true) || !writer.append(positions, normals, colors) || !writer.close())
+			{
+				state.skipWithError("Could not write " + path);
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * state.getArgument());
+		state.setBytesProcessed(state.getIterations() * Bench::getFileSize(path));
+	}
+
+	// Argument: points, written by tinyply
+	void PlyWriteTinyply(Bench::State& state)
+	{
+		std::vector<float> positions, normals;
+		std::vector<unsigned char> colors;
+		createCloud(state, positions, normals, colors);
+		const std::string path = Bench::getScratchPath("tinyply.ply");
+		const size_t count = positions.size() / 3;
+		while (state.keepRunning())
+		{
+			std::ofstream file(path, std::ios::binary);
+			tinyply::PlyFile ply;
+			ply.add_properties_to_element("vertex", { "x", "y", "z" }, tinyply::Type::FLOAT32, count,
+				reinterpret_cast<uint8_t*>(positions.data()), tinyply::Type::INVALID, 0);
+			ply.add_properties_to_element("vertex", { "nx", "ny", "nz" }, tinyply::Type::FLOAT32, count,
+				reinterpret_cast<uint8_t*>(normals.data()), tinyply::Type::INVALID, 0);
+			ply.add_properties_to_element("vertex", { "red", "green", "blue" }, tinyply::Type::UINT8, count,
+				colors.data(), tinyply::Type::INVALID, 0);
+			ply.write(file, true);
+			if (!file.good())
+			{
+				state.skipWithError("Could not write " + path);
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * state.getArgument());
+		state.setBytesProcessed(state.getIterations() * Bench::getFileSize(path));
+	}
+
+	// Argument: faces, written by the parallel writer of PlyIO
+	void MeshWriteNative(Bench::State& state)
+	{
+		Synthetic::Options options;
+		options.meshFaces = static_cast<size_t>(state.getArgument());
+		std::vector<float> positions;
+		std::vector<uint32_t> triangles;
+		SyntheticDataset::createMesh(options, positions, triangles);
+		const std::string path = Bench::getScratchPath("mesh.ply");
+		while (state.keepRunning())
+		{
+			if (!PlyIO::write(path, positions, {}, {}, triangles))
+			{
+				state.skipWithError("Could not write " + path);
+			}
+		}
+		state.setItemsProcessed(state.getIterations() * static_cast<int64_t>(triangles.size() / 3));
+		state.setBytesProcessed(state.getIterations() * Bench::getFileSize(path));
+	}
+}
+
+BENCHMARK(NvmRead)->arg(100)->arg(1000)->arg(10000);
+BENCHMARK(NvmWrite)->arg(100)->arg(1000)->arg(10000);
+BENCHMARK(SfmRead)->arg(100)->arg(1000)->arg(10000);
+BENCHMARK(SfmWrite)->arg(100)->arg(1000)->arg(10000);
+BENCHMARK(ColmapModelRead)->arg(100)->arg(1000);
+BENCHMARK(PlyReadTinyply)->arg(100000)->arg(1000000)->arg(10000000);
+BENCHMARK(MeshReadTinyply)->arg(100000)->arg(1000000);
+BENCHMARK(PlyWriteNative)->arg(100000)->arg(1000000)->arg(10000000);
+BENCHMARK(PlyWriteNativeQuantized)->arg(100000)->arg(1000000)->arg(10000000);
+BENCHMARK(PlyWriteStream)->arg(100000)->arg(1000000)->arg(10000000);
+BENCHMARK(PlyWriteTinyply)->arg(100000)->arg(1000000)->arg(10000000);
+BENCHMARK(MeshWriteNative)->arg(100000)->arg(1000000);
@@ -0,0 +1,158 @@
+#include "Check.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <regex>
+
+#include <wx/init.h>
+#include <wx/log.h>
+#include <wx/image.h>
+#include <wx/filename.h>
+
+namespace
+{
+	std::string dataDirectory;
+	// Failures printed per case, a broken reader fails once per camera or point
+	const size_t maxPrintedFailures = 20;
+
+	std::vector<std::pair<std::string, Check::Function>>& getCases()
+	{
+		static std::vector<std::pair<std::string, Check::Function>> cases;
+		return cases;
+	}
+
+	// Value of "--name=value", false if the argument is another one
+	bool getFlag(const std::string& argument, const std::string& name, std::string& value)
+	{
+		if (argument.compare(0, name.size() + 1, name + "=") != 0)
+		{
+			return 0;
+		}
+		value = argument.substr(name.size() + 1);
+		return 1;
+	}
+}
+
+bool Check::Result::fail(const std::string& message)
+{
+	failures.emplace_back(message);
+	return 0;
+}
+
+bool Check::Result::expect(bool condition, const std::string& expression, const char* file, int line)
+{
+	if (condition)
+	{
+		return 1;
+	}
+	return fail(wxFileName(file).GetFullName().ToStdString() + ":" + std::to_string(line) + ": " + expression);
+}
+
+int Check::add(const std::string& name, Function function)
+{
+	getCases().emplace_back(name, function);
+	return static_cast<int>(getCases().size());
+}
+
+std::string Check::getScratchDirectory(const std::string& name)
+{
+	const std::string directory = dataDirectory + "/" + name;
+	if (wxFileName::DirExists(directory))
+	{
+		wxFileName::Rmdir(directory, wxPATH_RMDIR_RECURSIVE);
+	}
+	if (!wxFileName::Mkdir(directory, 0777, wxPATH_MKDIR_FULL))
+	{
+		return "";
+	}
+	return directory;
+}
+
+bool Check::isNear(double a, double b, double tolerance)
+{
+	return std::abs(a - b) <= tolerance * std::max({ 1.0, std::abs(a), std::abs(b) });
+}
+
+int Check::run(int argc, char** argv)
+{
+	std::string filter = ".", value;
+	dataDirectory = wxFileName::GetTempDir().ToStdString() + "/saescan3d_check";
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		if (getFlag(argument, "--check_filter", value))
+		{
+			filter = value;
+		}
+		else if (getFlag(argument, "--check_data", value))
+		{
+			dataDirectory = value;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown argument %s\nUse [--check_filter=<regex>] [--check_data=<folder of the datasets>]\n",
+				argument.c_str());
+			return 1;
+		}
+	}
+	std::regex filterExpression;
+	try
+	{
+		filterExpression = std::regex(filter);
+	}
+	catch (const std::regex_error&)
+	{
+		fprintf(stderr, "Invalid filter %s\n", filter.c_str());
+		return 1;
+	}
+	size_t numRun = 0, numFailed = 0;
+	for (const auto& checkCase : getCases())
+	{
+		if (!std::regex_search(checkCase.first, filterExpression))
+		{
+			continue;
+		}
+		Result result;
+		try
+		{
+			checkCase.second(result);
+		}
+		catch (const std::exception& exception)
+		{
+			result.fail(std::string("Exception: ") + exception.what());
+		}
+		wxLog::FlushActive();
+		numRun++;
+		if (!result.hasFailed())
+		{
+			printf("%-44s OK\n", checkCase.first.c_str());
+			fflush(stdout);
+			continue;
+		}
+		numFailed++;
+		const auto& failures = result.getFailures();
+		printf("%-44s FAILED (%zu)\n", checkCase.first.c_str(), failures.size());
+		for (size_t i = 0; i < std::min(failures.size(), maxPrintedFailures); i++)
+		{
+			printf("    %s\n", failures[i].c_str());
+		}
+		fflush(stdout);
+	}
+	printf("%zu of %zu cases passed\n", numRun - numFailed, numRun);
+	return numFailed == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	wxInitializer initializer;
+	if (!initializer.IsOk())
+	{
+		fprintf(stderr, "Could not initialize wxWidgets\n");
+		return 1;
+	}
+	wxInitAllImageHandlers();
+	delete wxLog::SetActiveTarget(new wxLogStderr());
+	return Check::run(argc, argv);
+}
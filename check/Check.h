@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+// Correctness checks of the native components on small synthetic datasets (see SyntheticDataset), a console program
+// run by ctest. A case is a function of a Result that reports its failed expectations, registered with CHECK_CASE:
+//
+//	void PlyRoundTrip(Check::Result& result)
+//	{
+//		...write and read a point cloud...
+//		EXPECT(result, positions == readPositions);
+//	}
+//	CHECK_CASE(PlyRoundTrip);
+//
+// The command line takes --check_filter=<regex> of the cases and --check_data=<folder> of the datasets. The exit code
+// is 0 when every case passed.
+namespace Check
+{
+	class Result
+	{
+	public:
+		// Records the failure and returns false, so a case can stop when the rest depends on it
+		bool fail(const std::string& message);
+		bool expect(bool condition, const std::string& expression, const char* file, int line);
+
+		bool hasFailed() const { return !failures.empty(); };
+		const std::vector<std::string>& getFailures() const { return failures; };
+
+	private:
+		std::vector<std::string> failures;
+	};
+
+	typedef void (*Function)(Result&);
+
+	// Registers a case, see CHECK_CASE
+	int add(const std::string& name, Function function);
+	// Runs the cases selected by the flags, 0 when they all passed
+	int run(int argc, char** argv);
+
+	// Empty folder of a case in the data folder of the run, removed and created again on every call
+	std::string getScratchDirectory(const std::string& name);
+	// |a - b| <= tolerance * max(1, |a|, |b|)
+	bool isNear(double a, double b, double tolerance);
+
+	template<typename T>
+	std::string print(const T& value)
+	{
+		std::stringstream stream;
+		stream.precision(17);
+		stream << value;
+		return stream.str();
+	}
+}
+
+#define EXPECT(result, condition) (result).expect((condition), #condition, __FILE__, __LINE__)
+
+#define CHECK_CONCAT_NAME(name, line) name##line
+#define CHECK_NAME(name, line) CHECK_CONCAT_NAME(name, line)
+#define CHECK_CASE(function) static int CHECK_NAME(checkCase, __LINE__) = Check::add(#function, function)
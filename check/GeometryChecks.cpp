@@ -0,0 +1,465 @@
+#include <map>
+#include <fstream>
+#include <random>
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+#include "Check.h"
+#include "ColmapModel.h"
+#include "ColmapModelMerger.h"
+#include "SpatialIndex.h"
+#include "SyntheticDataset.h"
+#include "json.hpp"
+
+namespace
+{
+	// The synthetic models have no noise, so the transforms and the alignments are exact up to the rounding
+	const double transformTolerance = 1e-9;
+	const double alignmentTolerance = 1e-7;
+	const size_t numQueries = 300;
+	const size_t numNeighbors = 8;
+
+	Synthetic::Options getOptions(Synthetic::Rig rig)
+	{
+		Synthetic::Options options;
+		options.rig = rig;
+		options.numImages = 30;
+		options.width = 320;
+		options.height = 240;
+		options.sparsePointsPerImage = 50;
+		options.densePoints = 5000;
+		options.meshFaces = 500;
+		return options;
+	}
+
+	std::string getRigName(Synthetic::Rig rig)
+	{
+		return rig == Synthetic::Orbit ? "orbit" : (rig == Synthetic::NadirGrid ? "nadir" : "corridor");
+	}
+
+	bool expectNear(Check::Result& result, const Eigen::Vector3d& expected, const Eigen::Vector3d& actual, double tolerance,
+		const std::string& label)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (!Check::isNear(expected[i], actual[i], tolerance))
+			{
+				return result.fail(label + ": (" + Check::print(actual.transpose()) + ") instead of (" +
+					Check::print(expected.transpose()) + ")");
+			}
+		}
+		return 1;
+	}
+
+	bool expectNear(Check::Result& result, const Eigen::Matrix3d& expected, const Eigen::Matrix3d& actual, double tolerance,
+		const std::string& label)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (!expectNear(result, Eigen::Vector3d(expected.row(i).transpose()), Eigen::Vector3d(actual.row(i).transpose()),
+				tolerance, label + " row " + Check::print(i)))
+			{
+				return 0;
+			}
+		}
+		return 1;
+	}
+
+	Synthetic::Similarity invert(const Synthetic::Similarity& similarity)
+	{
+		Synthetic::Similarity inverse;
+		inverse.scale = 1 / similarity.scale;
+		inverse.rotation = similarity.rotation.transpose();
+		inverse.translation = -inverse.scale * (inverse.rotation * similarity.translation);
+		return inverse;
+	}
+
+	// Camera centers and points of two models of the same scene, matched by image and point id
+	void compareModels(Check::Result& result, const ColmapModel& expected, const ColmapModel& actual, double tolerance,
+		const std::string& label)
+	{
+		if (!EXPECT(result, actual.images.size() == expected.images.size() && actual.points3D.size() == expected.points3D.size()))
+		{
+			return;
+		}
+		for (const auto& image : expected.images)
+		{
+			const auto actualImage = actual.images.find(image.first);
+			if (actualImage == actual.images.end() || actualImage->second.name != image.second.name)
+			{
+				result.fail(label + ": image " + image.second.name + " is missing");
+				return;
+			}
+			const Eigen::Matrix4d expectedRt = ColmapModel::getMatrixRt(image.second);
+			const Eigen::Matrix4d actualRt = ColmapModel::getMatrixRt(actualImage->second);
+			if (!expectNear(result, ColmapModel::getCameraCenter(image.second), ColmapModel::getCameraCenter(actualImage->second),
+				tolerance, label + " center of " + image.second.name) ||
+				!expectNear(result, Eigen::Matrix3d(expectedRt.block<3, 3>(0, 0)), Eigen::Matrix3d(actualRt.block<3, 3>(0, 0)),
+				tolerance, label + " rotation of " + image.second.name))
+			{
+				return;
+			}
+		}
+		for (const auto& point : expected.points3D)
+		{
+			const auto actualPoint = actual.points3D.find(point.first);
+			if (actualPoint == actual.points3D.end())
+			{
+				result.fail(label + ": point " + Check::print(point.first) + " is missing");
+				return;
+			}
+			const Eigen::Vector3d expectedPosition = Eigen::Vector3d::Map(point.second.xyz);
+			if (!expectNear(result, expectedPosition, Eigen::Vector3d::Map(actualPoint->second.xyz), tolerance,
+				label + " point " + Check::print(point.first)))
+			{
+				return;
+			}
+		}
+	}
+
+	// The similarity and the camera centers of ground_truth.json against the model written and the one of the scene
+	void checkGroundTruth(Check::Result& result, Synthetic::Rig rig)
+	{
+		const std::string rigName = getRigName(rig);
+		const auto directory = Check::getScratchDirectory("ground_truth_" + rigName);
+		const auto options = getOptions(rig);
+		if (directory.empty() || !SyntheticDataset::generate(options, directory))
+		{
+			result.fail("Could not generate the " + rigName + " dataset");
+			return;
+		}
+		std::ifstream groundTruthFile(directory + "/ground_truth.json");
+		nlohmann::json groundTruth;
+		try
+		{
+			groundTruthFile >> groundTruth;
+		}
+		catch (const nlohmann::json::exception& exception)
+		{
+			result.fail("Could not read ground_truth.json of the " + rigName + " dataset: " + exception.what());
+			return;
+		}
+		Synthetic::Similarity similarity;
+		similarity.scale = groundTruth["transform"]["scale"].get<double>();
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				similarity.rotation(i, j) = groundTruth["transform"]["rotation"][3 * i + j].get<double>();
+			}
+			similarity.translation[i] = groundTruth["transform"]["translation"][i].get<double>();
+		}
+		const auto expectedSimilarity = SyntheticDataset::createSimilarity(options);
+		EXPECT(result, Check::isNear(similarity.scale, expectedSimilarity.scale, transformTolerance));
+		expectNear(result, expectedSimilarity.rotation, similarity.rotation, transformTolerance, rigName + " ground truth rotation");
+		expectNear(result, expectedSimilarity.translation, similarity.translation, transformTolerance, rigName + " ground truth translation");
+		EXPECT(result, (similarity.rotation.transpose() * similarity.rotation - Eigen::Matrix3d::Identity()).norm() < transformTolerance);
+		ColmapModel model;
+		if (!EXPECT(result, model.read(directory + "/sparse")))
+		{
+			return;
+		}
+		const ColmapModel sceneModel = SyntheticDataset::createModel(options);
+		//The centers of the ground truth are in the scene, the model is moved by the similarity
+		std::map<std::string, Eigen::Vector3d> centers;
+		for (const auto& image : model.images)
+		{
+			centers[image.second.name] = ColmapModel::getCameraCenter(image.second);
+		}
+		EXPECT(result, groundTruth["images"].size() == model.images.size());
+		EXPECT(result, groundTruth["sparsePoints"].get<size_t>() == model.points3D.size());
+		for (const auto& image : groundTruth["images"])
+		{
+			const std::string name = image["name"].get<std::string>();
+			const Eigen::Vector3d center(image["center"][0].get<double>(), image["center"][1].get<double>(), image["center"][2].get<double>());
+			if (centers.find(name) == centers.end())
+			{
+				result.fail(rigName + ": image " + name + " of the ground truth is not in the model");
+				break;
+			}
+			if (!expectNear(result, similarity.apply(center), centers[name], transformTolerance, rigName + " moved center of " + name))
+			{
+				break;
+			}
+		}
+		//The inverse brings the model back to the scene
+		const auto inverse = invert(similarity);
+		model.transform(inverse.scale, inverse.rotation, inverse.translation);
+		compareModels(result, sceneModel, model, transformTolerance, rigName + " model back in the scene");
+	}
+
+	void TransformMatchesGroundTruth(Check::Result& result)
+	{
+		checkGroundTruth(result, Synthetic::Orbit);
+		checkGroundTruth(result, Synthetic::NadirGrid);
+		checkGroundTruth(result, Synthetic::Corridor);
+	}
+	CHECK_CASE(TransformMatchesGroundTruth);
+
+	// Two overlapping sub-models of a scene, one moved by the similarity of the dataset, are aligned and merged back
+	void checkMerger(Check::Result& result, Synthetic::Rig rig)
+	{
+		const std::string rigName = getRigName(rig);
+		const auto options = getOptions(rig);
+		const ColmapModel model = SyntheticDataset::createModel(options);
+		std::vector<uint32_t> imageIds;
+		for (const auto& image : model.images)
+		{
+			imageIds.emplace_back(image.first);
+		}
+		//The first two thirds are the reference, the last half shares a sixth of the images with it
+		const size_t numImages = imageIds.size();
+		const std::vector<uint32_t> referenceIds(imageIds.begin(), imageIds.begin() + 2 * numImages / 3);
+		const std::vector<uint32_t> movedIds(imageIds.begin() + numImages / 2, imageIds.end());
+		const ColmapModel reference = model.getSubModel(referenceIds);
+		ColmapModel moved = model.getSubModel(movedIds);
+		const auto similarity = SyntheticDataset::createSimilarity(options);
+		moved.transform(similarity.scale, similarity.rotation, similarity.translation);
+		double scale, rmsError;
+		Eigen::Matrix3d rotation;
+		Eigen::Vector3d translation;
+		size_t numShared;
+		std::string failure;
+		if (!EXPECT(result, ColmapModelMerger::align(moved, reference, scale, rotation, translation, numShared, rmsError, failure)))
+		{
+			return;
+		}
+		const auto inverse = invert(similarity);
+		EXPECT(result, numShared == referenceIds.size() + movedIds.size() - numImages);
+		EXPECT(result, Check::isNear(scale, inverse.scale, alignmentTolerance));
+		expectNear(result, inverse.rotation, rotation, alignmentTolerance, rigName + " aligned rotation");
+		expectNear(result, inverse.translation, translation, alignmentTolerance, rigName + " aligned translation");
+		EXPECT(result, rmsError < alignmentTolerance);
+		ColmapModel merged;
+		std::string report;
+		if (!EXPECT(result, ColmapModelMerger::merge({ moved, reference }, merged, report)))
+		{
+			return;
+		}
+		EXPECT(result, report.find("not merged") == std::string::npos);
+		//The merged model is in the frame of the reference, the scene
+		if (!EXPECT(result, merged.images.size() == numImages))
+		{
+			return;
+		}
+		for (const auto& image : model.images)
+		{
+			const auto mergedImage = merged.images.find(image.first);
+			if (mergedImage == merged.images.end())
+			{
+				result.fail(rigName + ": image " + image.second.name + " is not in the merged model");
+				return;
+			}
+			if (!expectNear(result, ColmapModel::getCameraCenter(image.second), ColmapModel::getCameraCenter(mergedImage->second),
+				alignmentTolerance, rigName + " merged center of " + image.second.name))
+			{
+				return;
+			}
+		}
+		//Every merged point is a point of the scene, whatever id the merge gave it
+		std::vector<Eigen::Vector3d> scenePoints;
+		for (const auto& point : model.points3D)
+		{
+			scenePoints.emplace_back(Eigen::Vector3d::Map(point.second.xyz));
+		}
+		const SpatialIndex index(scenePoints);
+		EXPECT(result, !merged.points3D.empty());
+		for (const auto& point : merged.points3D)
+		{
+			const Eigen::Vector3d position = Eigen::Vector3d::Map(point.second.xyz);
+			const auto nearest = index.knn(position, 1);
+			if (nearest.empty() || !expectNear(result, scenePoints[nearest[0]], position, alignmentTolerance,
+				rigName + " merged point " + Check::print(point.first)))
+			{
+				if (nearest.empty())
+				{
+					result.fail(rigName + ": no scene point near the merged point " + Check::print(point.first));
+				}
+				return;
+			}
+		}
+	}
+
+	// A sub-model that can't be aligned, tried first as it shares the most images, leaves the others merged
+	void checkMergerFailure(Check::Result& result, Synthetic::Rig rig)
+	{
+		const std::string rigName = getRigName(rig);
+		const ColmapModel model = SyntheticDataset::createModel(getOptions(rig));
+		std::vector<uint32_t> imageIds;
+		for (const auto& image : model.images)
+		{
+			imageIds.emplace_back(image.first);
+		}
+		const size_t numImages = imageIds.size();
+		const std::vector<uint32_t> referenceIds(imageIds.begin(), imageIds.begin() + 2 * numImages / 3);
+		const std::vector<uint32_t> otherIds(imageIds.begin() + numImages / 2, imageIds.end());
+		const size_t numShared = referenceIds.size() + otherIds.size() - numImages;
+		//Cameras of the reference moved to the same place, they give no scale
+		ColmapModel collapsed = model.getSubModel(std::vector<uint32_t>(referenceIds.begin(), referenceIds.begin() + numShared + 1));
+		const Eigen::Vector3d center = ColmapModel::getCameraCenter(collapsed.images.begin()->second);
+		for (auto& image : collapsed.images)
+		{
+			Eigen::Matrix4d matrixRt = ColmapModel::getMatrixRt(image.second);
+			matrixRt.block<3, 1>(0, 3) = -matrixRt.block<3, 3>(0, 0) * center;
+			ColmapModel::setMatrixRt(image.second, matrixRt);
+		}
+		ColmapModel merged;
+		std::string report;
+		if (!EXPECT(result, ColmapModelMerger::merge({ model.getSubModel(otherIds), model.getSubModel(referenceIds), collapsed },
+			merged, report)))
+		{
+			return;
+		}
+		if (merged.images.size() != numImages || report.find("Sub-model 2") == std::string::npos ||
+			report.find("same place") == std::string::npos)
+		{
+			result.fail(rigName + ": " + Check::print(merged.images.size()) + " of " + Check::print(numImages) +
+				" images merged around a sub-model that can't be aligned, report:\n" + report);
+		}
+	}
+
+	void ModelMergerRecoversSimilarity(Check::Result& result)
+	{
+		checkMerger(result, Synthetic::Orbit);
+		checkMerger(result, Synthetic::NadirGrid);
+		checkMerger(result, Synthetic::Corridor);
+		checkMergerFailure(result, Synthetic::Orbit);
+		checkMergerFailure(result, Synthetic::Corridor);
+	}
+	CHECK_CASE(ModelMergerRecoversSimilarity);
+
+	std::vector<size_t> bruteForceKnn(const std::vector<Eigen::Vector3d>& points, const Eigen::Vector3d& query, size_t k,
+		long long excludeIndex)
+	{
+		std::vector<std::pair<double, size_t>> distances;
+		distances.reserve(points.size());
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			if (static_cast<long long>(i) != excludeIndex)
+			{
+				distances.emplace_back((points[i] - query).squaredNorm(), i);
+			}
+		}
+		k = std::min(k, distances.size());
+		std::partial_sort(distances.begin(), distances.begin() + k, distances.end());
+		std::vector<size_t> indices(k);
+		for (size_t i = 0; i < k; i++)
+		{
+			indices[i] = distances[i].second;
+		}
+		return indices;
+	}
+
+	// knn and radius of the index against a search of every point, for queries on the points and around them.
+	// The distances are compared instead of the indices, equidistant points can be returned in any order
+	void checkIndex(Check::Result& result, const std::vector<Eigen::Vector3d>& points, const std::string& label)
+	{
+		const SpatialIndex index(points);
+		Eigen::Vector3d minimum = points[0], maximum = points[0];
+		for (const auto& point : points)
+		{
+			minimum = minimum.cwiseMin(point);
+			maximum = maximum.cwiseMax(point);
+		}
+		//Queries on the points, excluding themselves, and anywhere in a box twice as large
+		std::mt19937 random(7);
+		std::uniform_int_distribution<size_t> pointIndex(0, points.size() - 1);
+		std::uniform_real_distribution<double> unit(-0.5, 1.5);
+		for (size_t q = 0; q < numQueries; q++)
+		{
+			Eigen::Vector3d query;
+			long long excludeIndex = -1;
+			if (q % 2 == 0)
+			{
+				excludeIndex = static_cast<long long>(pointIndex(random));
+				query = points[static_cast<size_t>(excludeIndex)];
+			}
+			else
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					query[i] = minimum[i] + unit(random) * (maximum[i] - minimum[i]);
+				}
+			}
+			const auto expected = bruteForceKnn(points, query, numNeighbors + 1, excludeIndex);
+			const auto actual = index.knn(query, numNeighbors, excludeIndex);
+			if (!EXPECT(result, actual.size() == std::min(numNeighbors, expected.size())))
+			{
+				return;
+			}
+			for (size_t i = 0; i < actual.size(); i++)
+			{
+				const double expectedDistance = (points[expected[i]] - query).norm();
+				const double actualDistance = (points[actual[i]] - query).norm();
+				if (static_cast<long long>(actual[i]) == excludeIndex || !Check::isNear(expectedDistance, actualDistance, 1e-12))
+				{
+					result.fail(label + ": neighbor " + Check::print(i) + " of query " + Check::print(q) + " at " +
+						Check::print(actualDistance) + " instead of " + Check::print(expectedDistance));
+					return;
+				}
+			}
+			//A radius between the last neighbor and the next one has exactly the neighbors (and the query point) inside
+			if (expected.size() <= numNeighbors)
+			{
+				continue;
+			}
+			const double inner = (points[expected[numNeighbors - 1]] - query).norm();
+			const double outer = (points[expected[numNeighbors]] - query).norm();
+			if (outer - inner <= 1e-9 * std::max(1.0, outer))
+			{
+				continue;
+			}
+			auto inside = index.radius(query, (inner + outer) / 2);
+			std::vector<size_t> expectedInside(expected.begin(), expected.begin() + numNeighbors);
+			if (excludeIndex >= 0)
+			{
+				expectedInside.emplace_back(static_cast<size_t>(excludeIndex));
+			}
+			std::sort(inside.begin(), inside.end());
+			std::sort(expectedInside.begin(), expectedInside.end());
+			if (inside != expectedInside)
+			{
+				result.fail(label + ": " + Check::print(inside.size()) + " points inside the radius of query " + Check::print(q) +
+					" instead of " + Check::print(expectedInside.size()));
+				return;
+			}
+		}
+	}
+
+	void SpatialIndexMatchesBruteForce(Check::Result& result)
+	{
+		for (const auto rig : { Synthetic::Orbit, Synthetic::NadirGrid, Synthetic::Corridor })
+		{
+			const std::string rigName = getRigName(rig);
+			auto options = getOptions(rig);
+			options.outlierRatio = 0.05;
+			std::vector<float> positions, normals;
+			std::vector<unsigned char> colors;
+			SyntheticDataset::createPoints(options, 20000, 0, positions, normals, colors);
+			std::vector<Eigen::Vector3d> points(positions.size() / 3);
+			for (size_t i = 0; i < points.size(); i++)
+			{
+				points[i] = Eigen::Vector3d(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+			}
+			checkIndex(result, points, rigName + " points");
+			//Far from the origin like projected coordinates, the cells are relative to the points
+			std::vector<Eigen::Vector3d> projectedPoints(points);
+			for (auto& point : projectedPoints)
+			{
+				point += Eigen::Vector3d(500000, 7500000, 800);
+			}
+			checkIndex(result, projectedPoints, rigName + " projected points");
+			//The cameras of a grid are coplanar and the ones of a corridor collinear
+			std::vector<Eigen::Vector3d> centers;
+			for (const auto& image : SyntheticDataset::createModel(options).images)
+			{
+				centers.emplace_back(ColmapModel::getCameraCenter(image.second));
+			}
+			checkIndex(result, centers, rigName + " camera centers");
+		}
+		//Repeated points, every cell size is degenerate
+		checkIndex(result, std::vector<Eigen::Vector3d>(100, Eigen::Vector3d(1, 2, 3)), "repeated points");
+	}
+	CHECK_CASE(SpatialIndexMatchesBruteForce);
+}
@@ -0,0 +1,314 @@
+#include <map>
+
+#include <Eigen/Dense>
+
+#include <wx/filename.h>
+
+#include "Check.h"
+#include "Utils.h"
+#include "ImageIO.h"
+#include "Camera.h"
+#include "ColmapModel.h"
+#include "PlyIO.h"
+#include "SyntheticDataset.h"
+
+namespace
+{
+	// Relative error of the values written as text with 17 digits or as doubles, after the conversions of the readers
+	const double poseTolerance = 1e-9;
+
+	Synthetic::Options getOptions(Synthetic::Rig rig)
+	{
+		Synthetic::Options options;
+		options.rig = rig;
+		options.numImages = 12;
+		options.width = 320;
+		options.height = 240;
+		options.sparsePointsPerImage = 30;
+		options.densePoints = 5000;
+		options.meshFaces = 500;
+		//The readers of the camera files open the images for their size
+		options.writeImages = true;
+		return options;
+	}
+
+	void deleteCameras(std::vector<Camera*>& cameras)
+	{
+		for (auto camera : cameras)
+		{
+			delete camera;
+		}
+		cameras.clear();
+	}
+
+	// First different element of two arrays, so a broken reader fails once instead of once per value
+	template<typename T>
+	bool expectEqual(Check::Result& result, const std::vector<T>& expected, const std::vector<T>& actual, const std::string& label)
+	{
+		if (expected.size() != actual.size())
+		{
+			return result.fail(label + ": " + Check::print(actual.size()) + " values instead of " + Check::print(expected.size()));
+		}
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			if (expected[i] != actual[i])
+			{
+				return result.fail(label + ": value " + Check::print(i) + " is " + Check::print(+actual[i]) + " instead of " +
+					Check::print(+expected[i]));
+			}
+		}
+		return 1;
+	}
+
+	bool expectNear(Check::Result& result, double expected, double actual, double tolerance, const std::string& label)
+	{
+		if (Check::isNear(expected, actual, tolerance))
+		{
+			return 1;
+		}
+		return result.fail(label + ": " + Check::print(actual) + " instead of " + Check::print(expected));
+	}
+
+	// Intrinsics and pose of the cameras read from a file against the images of the model they were written from
+	void compareCameras(Check::Result& result, const ColmapModel& model, const std::vector<Camera*>& cameras, const std::string& label)
+	{
+		if (!EXPECT(result, cameras.size() == model.images.size()))
+		{
+			return;
+		}
+		std::map<std::string, const ColmapModel::Image*> images;
+		for (const auto& image : model.images)
+		{
+			images[image.second.name] = &image.second;
+		}
+		for (const auto camera : cameras)
+		{
+			const std::string name = wxFileName(camera->filePath).GetFullName().ToStdString();
+			const auto image = images.find(name);
+			if (image == images.end())
+			{
+				result.fail(label + ": unknown image " + camera->filePath);
+				return;
+			}
+			const auto& intrinsics = model.cameras.at(image->second->cameraId);
+			double focal[2], principalPoint[2];
+			ColmapModel::getFocalAndPrincipalPoint(intrinsics, focal, principalPoint);
+			//The cameras keep the intrinsics as floats
+			bool passed = expectNear(result, focal[0], camera->getFocalX(), 1e-6, label + " " + name + " focal x") &&
+				expectNear(result, focal[1], camera->getFocalY(), 1e-6, label + " " + name + " focal y") &&
+				expectNear(result, principalPoint[0], camera->getPrincipalPointX(), 1e-6, label + " " + name + " principal point x") &&
+				expectNear(result, principalPoint[1], camera->getPrincipalPointY(), 1e-6, label + " " + name + " principal point y") &&
+				EXPECT(result, camera->getWidth() == intrinsics.width && camera->getHeight() == intrinsics.height);
+			const Eigen::Matrix4d expectedRt = ColmapModel::getMatrixRt(*image->second);
+			const Eigen::Matrix4d matrixRt = camera->getMatrixRt();
+			for (int i = 0; i < 3 && passed; i++)
+			{
+				for (int j = 0; j < 4 && passed; j++)
+				{
+					passed = expectNear(result, expectedRt(i, j), matrixRt(i, j), poseTolerance,
+						label + " " + name + " [R|t](" + Check::print(i) + "," + Check::print(j) + ")");
+				}
+			}
+			if (!passed)
+			{
+				return;
+			}
+		}
+	}
+
+	bool saveCameras(const std::string& path, const std::vector<Camera*>& cameras)
+	{
+		if (Utils::getFileExtension(path) == "scb")
+		{
+			return ImageIO::saveCameraBundle(path, cameras);
+		}
+		return ImageIO::saveCameras(path, cameras);
+	}
+
+	// The camera files of a dataset against its COLMAP model, then written and read again
+	void checkCameraFiles(Check::Result& result, Synthetic::Rig rig, const std::string& rigName)
+	{
+		const auto directory = Check::getScratchDirectory("cameras_" + rigName);
+		const auto options = getOptions(rig);
+		if (directory.empty() || !SyntheticDataset::generate(options, directory))
+		{
+			result.fail("Could not generate the " + rigName + " dataset");
+			return;
+		}
+		ColmapModel model;
+		if (!EXPECT(result, model.read(directory + "/sparse")))
+		{
+			return;
+		}
+		for (const std::string extension : { "nvm", "sfm", "scb" })
+		{
+			std::vector<Camera*> cameras, readCameras;
+			const std::string path = directory + "/cameras." + extension;
+			const std::string roundTripPath = directory + "/round_trip." + extension;
+			if (!ImageIO::loadCameraParameters(path, cameras))
+			{
+				result.fail("Could not read " + path);
+				continue;
+			}
+			compareCameras(result, model, cameras, rigName + " " + extension);
+			if (saveCameras(roundTripPath, cameras) && ImageIO::loadCameraParameters(roundTripPath, readCameras))
+			{
+				compareCameras(result, model, readCameras, rigName + " " + extension + " round trip");
+			}
+			else
+			{
+				result.fail("Could not write and read " + roundTripPath);
+			}
+			deleteCameras(cameras);
+			deleteCameras(readCameras);
+		}
+	}
+
+	void CameraFilesRoundTrip(Check::Result& result)
+	{
+		checkCameraFiles(result, Synthetic::Orbit, "orbit");
+		checkCameraFiles(result, Synthetic::NadirGrid, "nadir");
+		checkCameraFiles(result, Synthetic::Corridor, "corridor");
+	}
+	CHECK_CASE(CameraFilesRoundTrip);
+
+	// The binary model keeps every value, so the model read is the one written
+	void ColmapModelRoundTrip(Check::Result& result)
+	{
+		const auto directory = Check::getScratchDirectory("colmap_model");
+		auto options = getOptions(Synthetic::Corridor);
+		options.sparsePointsPerImage = 200;
+		const ColmapModel model = SyntheticDataset::createModel(options);
+		ColmapModel readModel;
+		if (directory.empty() || !EXPECT(result, model.write(directory)) || !EXPECT(result, readModel.read(directory)))
+		{
+			return;
+		}
+		EXPECT(result, !model.points3D.empty());
+		if (!EXPECT(result, readModel.cameras.size() == model.cameras.size() && readModel.images.size() == model.images.size() &&
+			readModel.points3D.size() == model.points3D.size()))
+		{
+			return;
+		}
+		for (const auto& camera : model.cameras)
+		{
+			const auto& readCamera = readModel.cameras[camera.first];
+			EXPECT(result, readCamera.cameraId == camera.second.cameraId && readCamera.modelId == camera.second.modelId &&
+				readCamera.width == camera.second.width && readCamera.height == camera.second.height);
+			expectEqual(result, camera.second.params, readCamera.params, "camera " + Check::print(camera.first));
+		}
+		for (const auto& image : model.images)
+		{
+			const auto& readImage = readModel.images[image.first];
+			const std::string label = "image " + image.second.name;
+			EXPECT(result, readImage.imageId == image.second.imageId && readImage.cameraId == image.second.cameraId &&
+				readImage.name == image.second.name);
+			expectEqual(result, std::vector<double>(image.second.qvec, image.second.qvec + 4),
+				std::vector<double>(readImage.qvec, readImage.qvec + 4), label + " qvec");
+			expectEqual(result, std::vector<double>(image.second.tvec, image.second.tvec + 3),
+				std::vector<double>(readImage.tvec, readImage.tvec + 3), label + " tvec");
+			if (!EXPECT(result, readImage.points2D.size() == image.second.points2D.size()))
+			{
+				continue;
+			}
+			for (size_t i = 0; i < image.second.points2D.size(); i++)
+			{
+				const auto& point = image.second.points2D[i];
+				const auto& readPoint = readImage.points2D[i];
+				if (point.x != readPoint.x || point.y != readPoint.y || point.point3DId != readPoint.point3DId)
+				{
+					result.fail(label + ": observation " + Check::print(i) + " differs");
+					break;
+				}
+			}
+		}
+		for (const auto& point : model.points3D)
+		{
+			const auto readPoint = readModel.points3D.find(point.first);
+			if (readPoint == readModel.points3D.end())
+			{
+				result.fail("Point " + Check::print(point.first) + " was not read");
+				break;
+			}
+			bool equal = point.second.error == readPoint->second.error && point.second.track.size() == readPoint->second.track.size();
+			for (int i = 0; i < 3; i++)
+			{
+				equal = equal && point.second.xyz[i] == readPoint->second.xyz[i] && point.second.rgb[i] == readPoint->second.rgb[i];
+			}
+			for (size_t i = 0; equal && i < point.second.track.size(); i++)
+			{
+				equal = point.second.track[i].imageId == readPoint->second.track[i].imageId &&
+					point.second.track[i].point2DIdx == readPoint->second.track[i].point2DIdx;
+			}
+			if (!equal)
+			{
+				result.fail("Point " + Check::print(point.first) + " differs");
+				break;
+			}
+		}
+	}
+	CHECK_CASE(ColmapModelRoundTrip);
+
+	// Point clouds written in one piece and streamed in chunks, with and without the optional properties
+	void PlyRoundTrip(Check::Result& result)
+	{
+		const auto directory = Check::getScratchDirectory("ply");
+		if (directory.empty())
+		{
+			result.fail("Could not create the scratch folder");
+			return;
+		}
+		auto options = getOptions(Synthetic::NadirGrid);
+		options.outlierRatio = 0.01;
+		//More than a chunk of the parallel writer
+		const size_t count = 300000;
+		std::vector<float> positions, normals, readPositions, readNormals;
+		std::vector<unsigned char> colors, readColors;
+		SyntheticDataset::createPoints(options, count, 0, positions, normals, colors);
+		const std::string path = directory + "/points.ply";
+		if (EXPECT(result, PlyIO::write(path, positions, normals, colors, {})) &&
+			EXPECT(result, PlyIO::readPoints(path, readPositions, readNormals, readColors)))
+		{
+			expectEqual(result, positions, readPositions, "positions");
+			expectEqual(result, normals, readNormals, "normals");
+			expectEqual(result, colors, readColors, "colors");
+		}
+		size_t numVertices = 0;
+		bool hasNormals = false, hasColors = false;
+		if (EXPECT(result, PlyIO::readPointsHeader(path, numVertices, hasNormals, hasColors)))
+		{
+			EXPECT(result, numVertices == count && hasNormals && hasColors);
+		}
+		//Without normals and colors
+		const std::string positionsPath = directory + "/positions.ply";
+		if (EXPECT(result, PlyIO::write(positionsPath, positions, {}, {}, {})) &&
+			EXPECT(result, PlyIO::readPoints(positionsPath, readPositions, readNormals, readColors)))
+		{
+			expectEqual(result, positions, readPositions, "positions only");
+			EXPECT(result, readNormals.empty() && readColors.empty());
+		}
+		//Streamed in chunks of uneven sizes, the count is written on close
+		const std::string streamPath = directory + "/stream.ply";
+		PlyIO::StreamWriter writer;
+		if (!EXPECT(result, writer.open(streamPath, true, true)))
+		{
+			return;
+		}
+		const size_t chunkSizes[] = { 1, 99999, 200000 };
+		size_t first = 0;
+		for (const size_t chunkSize : chunkSizes)
+		{
+			writer.append(std::vector<float>(positions.begin() + 3 * first, positions.begin() + 3 * (first + chunkSize)),
+				std::vector<float>(normals.begin() + 3 * first, normals.begin() + 3 * (first + chunkSize)),
+				std::vector<unsigned char>(colors.begin() + 3 * first, colors.begin() + 3 * (first + chunkSize)));
+			first += chunkSize;
+		}
+		if (EXPECT(result, writer.close()) && EXPECT(result, PlyIO::readPoints(streamPath, readPositions, readNormals, readColors)))
+		{
+			expectEqual(result, positions, readPositions, "streamed positions");
+			expectEqual(result, normals, readNormals, "streamed normals");
+			expectEqual(result, colors, readColors, "streamed colors");
+		}
+	}
+	CHECK_CASE(PlyRoundTrip);
+}
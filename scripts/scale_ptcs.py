@@ -1,4 +1,5 @@
 import argparse
+import csv
 import os
 import numpy as np
 import open3d as o3d
@@ -100,6 +101,30 @@ def process_images(folder_path: str) -> list:
     return results
 
 
+def read_gps_csv(csv_path: str) -> list:
+    """Reads the GPS data of the images from the CSV written by the application, so the images are not opened again.
+
+    Args:
+        csv_path (str): CSV with the filename, latitude, longitude and altitude of the images with GPS.
+
+    Returns:
+        list: list of dictionaries containing image filename, UTM easting, northing, and altitude.
+    """
+    results = []
+    with open(csv_path, 'r', newline='') as file:
+        for row in csv.DictReader(file):
+            utm_e, utm_n, _, _ = utm.from_latlon(
+                float(row["latitude"]), float(row["longitude"]))
+            results.append({
+                "filename": row["filename"],
+                "utm_e": float(utm_e),
+                "utm_n": float(utm_n),
+                "altitude": float(row["altitude"])
+            })
+
+    return results
+
+
 def read_nvm_file(nvm_path: str) -> list:
     """Reads camera poses from an NVM file generated by COLMAP.
 
@@ -253,6 +278,8 @@ def main():
                         default="/home/grin/Downloads/small_clouds/3DData/PointCloud.ply", required=False)
     parser.add_argument('--obj', help='Path to the OBJ file to transform',
                         default="/home/grin/Downloads/small_clouds/3DData/TexturedSurface/TexturedSurface.obj", required=False)
+    parser.add_argument("--gps-csv", type=str, help="CSV with the GPS data of the images, instead of reading their EXIF.",
+                        default="", required=False)
     args = parser.parse_args()
 
     # Describe the parameters
@@ -262,12 +289,17 @@ def main():
     print(f"Point cloud: {args.cloud}", flush=True)
     if args.obj and args.obj != "":
         print(f"OBJ: {args.obj}", flush=True)
+    if args.gps_csv != "":
+        print(f"GPS CSV: {args.gps_csv}", flush=True)
     sys.stdout.flush()
 
     # Obtain GPS data from images and camera poses from NVM file
     print("Processing input images EXIF information ...", flush=True)
     sys.stdout.flush()
-    utm_data = process_images(args.folder)
+    if args.gps_csv != "":
+        utm_data = read_gps_csv(args.gps_csv)
+    else:
+        utm_data = process_images(args.folder)
     print("Reading camera poses from NVM file ...", flush=True)
     sys.stdout.flush()
     camera_poses = read_nvm_file(args.nvm)
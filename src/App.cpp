@@ -1,13 +1,72 @@
 #include "App.h"
 
+#include <cstdio>
+#include <future>
+#include <chrono>
+#include <atomic>
+
+#include <windows.h>
+
 #include <wx/wx.h>
 #include "ProjectPanel.h"
+#include "ConfigurationDialog.h"
+#include "Reconstruction.h"
+#include "ProgressModel.h"
+#include "JobQueue.h"
+#include "StageBudget.h"
+#include "Cancellation.h"
+#include "SyntheticDataset.h"
 
 IMPLEMENT_APP(App)
 
+namespace
+{
+	std::atomic<bool> interrupted(false);
+
+	//Ctrl+C or closing the console cancels the reconstruction, or the queue runner and its jobs
+	BOOL WINAPI onConsoleControl(DWORD controlType)
+	{
+		if (controlType == CTRL_C_EVENT || controlType == CTRL_BREAK_EVENT || controlType == CTRL_CLOSE_EVENT)
+		{
+			interrupted = true;
+			Cancellation::cancel();
+			return TRUE;
+		}
+		return FALSE;
+	}
+}
+
 bool App::OnInit()
 {
 	wxInitAllImageHandlers();
+	const std::string mode = argc >= 2 ? argv[1].ToStdString() : "";
+	if (mode == "--reconstruct" || mode == "--enqueue" || mode == "--run-queue" || mode == "--synthetic")
+	{
+		commandLine = mode;
+		if (mode != "--run-queue" && argc >= 3)
+		{
+			projectFolder = argv[2].ToStdString();
+		}
+		for (int i = 2; i < argc; i++)
+		{
+			generateTexture = generateTexture || argv[i] == "--texture";
+			budget = budget || argv[i] == "--budget";
+		}
+		for (int i = 3; i < argc && mode == "--synthetic"; i++)
+		{
+			syntheticArguments.emplace_back(argv[i].ToStdString());
+		}
+		//The GUI subsystem has no console, write to the one of the caller or, for the queue runner, to its own
+		if (AttachConsole(ATTACH_PARENT_PROCESS) || (mode == "--run-queue" && AllocConsole()))
+		{
+			freopen("CONOUT$", "w", stdout);
+			freopen("CONOUT$", "w", stderr);
+		}
+		delete wxLog::SetActiveTarget(new wxLogStderr());
+		SetConsoleCtrlHandler(onConsoleControl, TRUE);
+		ConfigurationDialog::loadDefaultConfig();
+		return true;
+	}
 	mainFrame = new wxFrame(nullptr, wxID_ANY, "SAEScan 3D", wxDefaultPosition,
 		wxSize(980, 570), wxMINIMIZE_BOX | wxSYSTEM_MENU | wxCAPTION | wxCLOSE_BOX | wxCLIP_CHILDREN);
 
@@ -21,4 +80,73 @@ bool App::OnInit()
 	mainFrame->Show(true);
 	this->SetTopWindow(mainFrame);
 	return true;
+}
+
+int App::OnRun()
+{
+	if (commandLine.empty())
+	{
+		return wxApp::OnRun();
+	}
+	if (commandLine == "--run-queue")
+	{
+		return JobQueue::run(ConfigurationDialog::getQueueOptions()) ? 0 : 1;
+	}
+	if (commandLine == "--synthetic")
+	{
+		Synthetic::Options options;
+		if (projectFolder.empty() || !SyntheticDataset::parseArguments(syntheticArguments, options))
+		{
+			wxLogError("Use --synthetic <folder> [--rig orbit|nadir|corridor] [--images N] [--size WxH] [--sparse-points N] "
+				"[--dense-points N] [--noise m] [--outliers ratio] [--mesh-faces N] [--write-images] [--no-transform] [--seed N]");
+			return 1;
+		}
+		printf("%s", options.print().c_str());
+		const bool generated = SyntheticDataset::generate(options, projectFolder);
+		wxLog::FlushActive();
+		return generated ? 0 : 1;
+	}
+	if (!wxDirExists(projectFolder + "\\images"))
+	{
+		wxLogError(wxString("O diretorio " + projectFolder + " nao tem as imagens de um projeto"));
+		return 1;
+	}
+	if (commandLine == "--enqueue")
+	{
+		return JobQueue::submit(ConfigurationDialog::getQueueOptions(), projectFolder, generateTexture) ? 0 : 1;
+	}
+	return runCommandLine();
+}
+
+int App::runCommandLine()
+{
+	//Started by the queue runner, the stages share the machine with the other jobs
+	if (budget && !StageBudget::enable(ConfigurationDialog::getQueueOptions(), projectFolder + "\\budget.json"))
+	{
+		return 1;
+	}
+	auto reconstruction = std::async(std::launch::async, [this]() { return Reconstruction::Reconstruct(projectFolder, generateTexture); });
+	std::string lastStatus;
+	while (reconstruction.wait_for(std::chrono::seconds(5)) != std::future_status::ready)
+	{
+		//Again, the reconstruction may not have started when interrupted
+		if (interrupted)
+		{
+			Cancellation::cancel();
+		}
+		//The messages of the worker thread are only written when flushed by this one
+		wxLog::FlushActive();
+		const auto status = ProgressModel::getStatus();
+		const auto line = status.print();
+		if (status.running && line != lastStatus)
+		{
+			printf("%s\n", line.c_str());
+			fflush(stdout);
+			lastStatus = line;
+		}
+	}
+	const bool succeeded = reconstruction.get();
+	wxLog::FlushActive();
+	printf(succeeded ? "Reconstrucao concluida\n" : "Erro na reconstrucao\n");
+	return succeeded ? 0 : 1;
 }
\ No newline at end of file
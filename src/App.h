@@ -5,13 +5,30 @@
 #endif
 
 #include <wx\app.h>
+#include <string>
+#include <vector>
 
 class App : public wxApp 
 {
 public:
 	virtual bool OnInit();
+	// Without the main window when started with --reconstruct <project folder> [--texture] [--budget],
+	// --enqueue <project folder> [--texture], --run-queue or --synthetic <folder> [options of SyntheticDataset],
+	// the exit code is 0 on success
+	virtual int OnRun();
 private:
+	// Reconstruction from the command line, printing the progress to the console
+	int runCommandLine();
+
 	wxFrame* mainFrame;
+	// Mode of the command line, empty for the GUI
+	std::string commandLine;
+	std::string projectFolder;
+	bool generateTexture = false;
+	// Share the machine with the other jobs of the queue
+	bool budget = false;
+	// Options of the synthetic dataset
+	std::vector<std::string> syntheticArguments;
 };
 
 DECLARE_APP(App)
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "ArtifactTracker.h"
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+
+ArtifactTracker::~ArtifactTracker()
+{
+	removeAll();
+}
+
+void ArtifactTracker::add(const std::string& path, const std::string& lastConsumer)
+{
+	artifacts.push_back({ path, lastConsumer });
+}
+
+uint64_t ArtifactTracker::stageCompleted(const std::string& stage)
+{
+	uint64_t freedBytes = 0;
+	for (auto it = artifacts.begin(); it != artifacts.end();)
+	{
+		if (it->lastConsumer == stage)
+		{
+			freedBytes += remove(it->path);
+			it = artifacts.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	return freedBytes;
+}
+
+uint64_t ArtifactTracker::removeAll()
+{
+	uint64_t freedBytes = 0;
+	for (const auto& artifact : artifacts)
+	{
+		freedBytes += remove(artifact.path);
+	}
+	artifacts.clear();
+	return freedBytes;
+}
+
+void ArtifactTracker::keepAll()
+{
+	artifacts.clear();
+}
+
+uint64_t ArtifactTracker::remove(const std::string& path)
+{
+	if (wxDirExists(path))
+	{
+		const uint64_t size = wxDir::GetTotalSize(path).GetValue();
+		if (!wxFileName::Rmdir(path, wxPATH_RMDIR_RECURSIVE))
+		{
+			wxLogWarning("Could not remove %s", path);
+			return 0;
+		}
+		return size;
+	}
+	if (wxFileExists(path))
+	{
+		const uint64_t size = wxFileName::GetSize(path).GetValue();
+		if (!wxRemoveFile(path))
+		{
+			wxLogWarning("Could not remove %s", path);
+			return 0;
+		}
+		return size;
+	}
+	return 0;
+}
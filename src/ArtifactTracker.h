@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Intermediate files and directories of a reconstruction, each one removed as soon as the last stage that reads it
+// completes, so the temp disk holds only what the remaining stages need. What is left when the tracker is destroyed
+// (e.g. a stage failed) is removed too.
+class ArtifactTracker
+{
+public:
+	ArtifactTracker() {};
+	~ArtifactTracker();
+
+	// The file or directory is removed when the stage lastConsumer completes
+	void add(const std::string& path, const std::string& lastConsumer);
+	// Removes the artifacts of the stage, returns the bytes freed
+	uint64_t stageCompleted(const std::string& stage);
+	// Removes every artifact still tracked, returns the bytes freed
+	uint64_t removeAll();
+	// Stops tracking without removing, the artifacts of a cancelled run are kept for the next one
+	void keepAll();
+
+private:
+	struct Artifact
+	{
+		std::string path;
+		std::string lastConsumer;
+	};
+	std::vector<Artifact> artifacts;
+
+	static uint64_t remove(const std::string& path);
+};
@@ -0,0 +1,165 @@
+#include "CameraBundle.h"
+
+#include <fstream>
+#include <cstring>
+
+#include <windows.h>
+
+#include "Utils.h"
+
+namespace
+{
+	uint64_t align8(uint64_t value)
+	{
+		return (value + 7) & ~static_cast<uint64_t>(7);
+	}
+}
+
+CameraBundle::~CameraBundle()
+{
+	close();
+}
+
+bool CameraBundle::open(const std::string& filePath)
+{
+	close();
+	HANDLE fileHandle = CreateFileW(Utils::s2ws(filePath).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return 0;
+	}
+	file = fileHandle;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(CameraBundleFormat::Header)))
+	{
+		close();
+		return 0;
+	}
+	size = static_cast<uint64_t>(fileSize.QuadPart);
+	mapping = CreateFileMappingW(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+	{
+		close();
+		return 0;
+	}
+	data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!data)
+	{
+		close();
+		return 0;
+	}
+	header = reinterpret_cast<const CameraBundleFormat::Header*>(data);
+	//Validate the blocks before anyone touches them
+	const bool valid = std::memcmp(header->magic, CameraBundleFormat::magic, 4) == 0 &&
+		header->version == CameraBundleFormat::version &&
+		header->recordSize == sizeof(CameraBundleFormat::CameraRecord) &&
+		header->camerasOffset + static_cast<uint64_t>(header->numCameras) * header->recordSize <= size &&
+		header->stringsOffset + header->stringsSize <= size &&
+		header->pointsOffset + header->numPoints * sizeof(CameraBundleFormat::SparsePoint) <= size;
+	if (!valid)
+	{
+		close();
+		return 0;
+	}
+	for (uint32_t i = 0; i < header->numCameras; i++)
+	{
+		const auto& record = getCamera(i);
+		if (record.pathOffset + record.pathLength > header->stringsSize)
+		{
+			close();
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void CameraBundle::close()
+{
+	if (data)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mapping)
+	{
+		CloseHandle(mapping);
+	}
+	if (file)
+	{
+		CloseHandle(file);
+	}
+	file = nullptr;
+	mapping = nullptr;
+	data = nullptr;
+	header = nullptr;
+	size = 0;
+}
+
+const CameraBundleFormat::CameraRecord& CameraBundle::getCamera(uint32_t index) const
+{
+	return reinterpret_cast<const CameraBundleFormat::CameraRecord*>(data + header->camerasOffset)[index];
+}
+
+std::string CameraBundle::getImagePath(uint32_t index) const
+{
+	const auto& record = getCamera(index);
+	return std::string(data + header->stringsOffset + record.pathOffset, record.pathLength);
+}
+
+const CameraBundleFormat::SparsePoint* CameraBundle::getPoints() const
+{
+	if (!header || header->numPoints == 0)
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<const CameraBundleFormat::SparsePoint*>(data + header->pointsOffset);
+}
+
+bool CameraBundle::write(const std::string& filePath, const std::vector<CameraBundleFormat::CameraRecord>& records,
+	const std::vector<std::string>& imagePaths, const std::vector<CameraBundleFormat::SparsePoint>& points)
+{
+	if (records.size() != imagePaths.size())
+	{
+		return 0;
+	}
+	//String table
+	std::string strings;
+	std::vector<CameraBundleFormat::CameraRecord> outRecords = records;
+	for (size_t i = 0; i < outRecords.size(); i++)
+	{
+		outRecords[i].pathOffset = strings.size();
+		outRecords[i].pathLength = static_cast<uint32_t>(imagePaths[i].size());
+		outRecords[i].reserved = 0;
+		strings += imagePaths[i];
+	}
+	CameraBundleFormat::Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, CameraBundleFormat::magic, 4);
+	header.version = CameraBundleFormat::version;
+	header.numCameras = static_cast<uint32_t>(outRecords.size());
+	header.recordSize = sizeof(CameraBundleFormat::CameraRecord);
+	header.camerasOffset = align8(sizeof(header));
+	header.stringsOffset = align8(header.camerasOffset + outRecords.size() * sizeof(CameraBundleFormat::CameraRecord));
+	header.stringsSize = strings.size();
+	header.numPoints = points.size();
+	header.pointsOffset = align8(header.stringsOffset + header.stringsSize);
+
+	std::ofstream out(filePath, std::ios::binary);
+	if (!out.good())
+	{
+		return 0;
+	}
+	const char padding[8] = { 0 };
+	auto pad = [&](uint64_t offset)
+	{
+		out.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(out.tellp())));
+	};
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	pad(header.camerasOffset);
+	out.write(reinterpret_cast<const char*>(outRecords.data()), outRecords.size() * sizeof(CameraBundleFormat::CameraRecord));
+	pad(header.stringsOffset);
+	out.write(strings.data(), strings.size());
+	pad(header.pointsOffset);
+	out.write(reinterpret_cast<const char*>(points.data()), points.size() * sizeof(CameraBundleFormat::SparsePoint));
+	return out.good();
+}
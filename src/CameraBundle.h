@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Binary camera bundle (.scb)
+// [header][camera records][path string table][sparse points]
+// All the blocks are 8 bytes aligned, so the file can be used directly from a memory map.
+namespace CameraBundleFormat
+{
+	const char magic[4] = { 'S', 'C', 'B', 'F' };
+	const uint32_t version = 1;
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t numCameras;
+		// sizeof(CameraRecord) of the writer
+		uint32_t recordSize;
+		uint64_t camerasOffset;
+		uint64_t stringsOffset;
+		uint64_t stringsSize;
+		uint64_t numPoints;
+		uint64_t pointsOffset;
+		uint64_t reserved;
+	};
+
+	struct CameraRecord
+	{
+		// [R|t] world to camera, row major 3x4
+		double matrixRt[12];
+		float focalDistance[2];
+		float principalPoint[2];
+		uint32_t width;
+		uint32_t height;
+		// Image path inside the string table, not null terminated
+		uint64_t pathOffset;
+		uint32_t pathLength;
+		uint32_t reserved;
+	};
+
+	struct SparsePoint
+	{
+		float position[3];
+		unsigned char color[3];
+		unsigned char reserved;
+	};
+}
+
+// Read only memory mapped view of a camera bundle
+class CameraBundle
+{
+public:
+	CameraBundle() {};
+	~CameraBundle();
+
+	bool open(const std::string& filePath);
+	void close();
+
+	uint32_t getNumberOfCameras() const { return header ? header->numCameras : 0; };
+	const CameraBundleFormat::CameraRecord& getCamera(uint32_t index) const;
+	std::string getImagePath(uint32_t index) const;
+
+	uint64_t getNumberOfPoints() const { return header ? header->numPoints : 0; };
+	const CameraBundleFormat::SparsePoint* getPoints() const;
+
+	static bool write(const std::string& filePath, const std::vector<CameraBundleFormat::CameraRecord>& records,
+		const std::vector<std::string>& imagePaths, const std::vector<CameraBundleFormat::SparsePoint>& points);
+
+private:
+	void* file = nullptr;
+	void* mapping = nullptr;
+	const char* data = nullptr;
+	uint64_t size = 0;
+	const CameraBundleFormat::Header* header = nullptr;
+
+	CameraBundle(const CameraBundle&) = delete;
+	CameraBundle& operator=(const CameraBundle&) = delete;
+};
@@ -0,0 +1,102 @@
+#include "Cancellation.h"
+
+#include <sstream>
+#include <mutex>
+#include <chrono>
+
+#include <windows.h>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	std::mutex cancellationMutex;
+	bool cancelled = false;
+	std::string reason;
+	bool hasDeadline = false;
+	std::string deadlineStage;
+	double deadlineSeconds = 0;
+	Clock::time_point deadline;
+
+	// Interval of the checks while a tool runs
+	const DWORD waitInterval = 200;
+}
+
+std::string Timeouts::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Enabled " << enabled << "\n" <<
+		"Factor " << factor << "\n" <<
+		"Min seconds " << minSeconds << "\n";
+	return parameters.str();
+}
+
+void Cancellation::reset()
+{
+	std::lock_guard<std::mutex> lock(cancellationMutex);
+	cancelled = false;
+	reason.clear();
+	hasDeadline = false;
+}
+
+void Cancellation::cancel()
+{
+	std::lock_guard<std::mutex> lock(cancellationMutex);
+	if (!cancelled)
+	{
+		cancelled = true;
+		reason = "Cancelled by the user";
+	}
+}
+
+bool Cancellation::isCancelled()
+{
+	std::lock_guard<std::mutex> lock(cancellationMutex);
+	if (!cancelled && hasDeadline && Clock::now() > deadline)
+	{
+		cancelled = true;
+		std::stringstream text;
+		text << deadlineStage << " timed out after " << static_cast<long long>(deadlineSeconds) << " s";
+		reason = text.str();
+	}
+	return cancelled;
+}
+
+std::string Cancellation::getReason()
+{
+	std::lock_guard<std::mutex> lock(cancellationMutex);
+	return reason;
+}
+
+void Cancellation::setDeadline(const std::string& stage, double seconds)
+{
+	std::lock_guard<std::mutex> lock(cancellationMutex);
+	hasDeadline = true;
+	deadlineStage = stage;
+	deadlineSeconds = seconds;
+	deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+void Cancellation::clearDeadline()
+{
+	std::lock_guard<std::mutex> lock(cancellationMutex);
+	hasDeadline = false;
+}
+
+bool Cancellation::wait(void* process, void* job)
+{
+	while (WaitForSingleObject(process, waitInterval) == WAIT_TIMEOUT)
+	{
+		if (isCancelled())
+		{
+			//The .bat wrappers start the real tool, the whole job goes
+			if (job == NULL || !TerminateJobObject(job, 1))
+			{
+				TerminateProcess(process, 1);
+			}
+			WaitForSingleObject(process, INFINITE);
+			return 0;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+namespace Timeouts
+{
+	struct Options
+	{
+		Options() {};
+		Options(bool enabled, double factor, int minSeconds) : enabled(enabled), factor(factor), minSeconds(minSeconds) {};
+		bool enabled = true;
+		// Timeout of a stage as a multiple of its time predicted from the images and the previous runs
+		double factor = 5;
+		// Timeouts are never below this, the predictions of the first runs are rough
+		int minSeconds = 1800;
+
+		std::string print() const;
+	};
+}
+
+// Cancellation of the running reconstruction, by the user or when the running stage passes its deadline. The
+// native steps check it between images, the external tools are terminated with every process they started and
+// no new one starts, so the stage fails and the files already written are kept for the next run.
+class Cancellation
+{
+public:
+	static void reset();
+	static void cancel();
+	static bool isCancelled();
+	// Why it was cancelled, empty if it wasn't
+	static std::string getReason();
+
+	// The stage is cancelled once it runs longer than seconds
+	static void setDeadline(const std::string& stage, double seconds);
+	static void clearDeadline();
+
+	// Waits for a process, terminating its job object (or the process alone, without one) when cancelled.
+	// False if it was cancelled
+	static bool wait(void* process, void* job);
+};
@@ -0,0 +1,416 @@
+#include "ColmapModel.h"
+
+#include <fstream>
+#include <algorithm>
+
+#include "Tracer.h"
+
+namespace
+{
+	template <typename T>
+	bool readValue(std::istream& stream, T& value)
+	{
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	template <typename T>
+	void writeValue(std::ostream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+}
+
+bool ColmapModel::read(const std::string& modelDir, bool readPoints)
+{
+	Tracer::Span span("Model read", "io", modelDir);
+	cameras.clear();
+	images.clear();
+	points3D.clear();
+	if (!readCameras(modelDir + "/cameras.bin") || !readImages(modelDir + "/images.bin"))
+	{
+		return 0;
+	}
+	if (readPoints && !readPoints3D(modelDir + "/points3D.bin"))
+	{
+		return 0;
+	}
+	return 1;
+}
+
+bool ColmapModel::write(const std::string& modelDir) const
+{
+	Tracer::Span span("Model write", "io", modelDir);
+	return writeCameras(modelDir + "/cameras.bin") &&
+		writeImages(modelDir + "/images.bin") &&
+		writePoints3D(modelDir + "/points3D.bin");
+}
+
+int ColmapModel::getNumParams(int modelId)
+{
+	switch (modelId)
+	{
+	case 0: // SIMPLE_PINHOLE
+		return 3;
+	case 1: // PINHOLE
+	case 2: // SIMPLE_RADIAL
+	case 8: // SIMPLE_RADIAL_FISHEYE
+		return 4;
+	case 3: // RADIAL
+	case 7: // FOV
+	case 9: // RADIAL_FISHEYE
+		return 5;
+	case 4: // OPENCV
+	case 5: // OPENCV_FISHEYE
+		return 8;
+	case 6: // FULL_OPENCV
+	case 10: // THIN_PRISM_FISHEYE
+		return 12;
+	default:
+		return -1;
+	}
+}
+
+void ColmapModel::getFocalAndPrincipalPoint(const Intrinsics& intrinsics, double focal[2], double principalPoint[2])
+{
+	const auto& params = intrinsics.params;
+	// Models with a single focal length: f, cx, cy, ...
+	if (intrinsics.modelId == 0 || intrinsics.modelId == 2 || intrinsics.modelId == 3 ||
+		intrinsics.modelId == 8 || intrinsics.modelId == 9)
+	{
+		focal[0] = focal[1] = params[0];
+		principalPoint[0] = params[1];
+		principalPoint[1] = params[2];
+	}
+	// fx, fy, cx, cy, ...
+	else
+	{
+		focal[0] = params[0];
+		focal[1] = params[1];
+		principalPoint[0] = params[2];
+		principalPoint[1] = params[3];
+	}
+}
+
+void ColmapModel::transform(double scale, const Eigen::Matrix3d& rotation, const Eigen::Vector3d& translation)
+{
+	Tracer::Span span("Model transform", "native");
+	for (auto& image : images)
+	{
+		//The camera keeps its orientation relative to the scene, so R' = R * rotation^T and t' = -R' * c'
+		Eigen::Matrix4d matrixRt = getMatrixRt(image.second);
+		const Eigen::Vector3d center = scale * rotation * getCameraCenter(image.second) + translation;
+		const Eigen::Matrix3d cameraRotation = matrixRt.block<3, 3>(0, 0) * rotation.transpose();
+		matrixRt.block<3, 3>(0, 0) = cameraRotation;
+		matrixRt.block<3, 1>(0, 3) = -cameraRotation * center;
+		setMatrixRt(image.second, matrixRt);
+	}
+	for (auto& point : points3D)
+	{
+		Eigen::Map<Eigen::Vector3d> xyz(point.second.xyz);
+		xyz = scale * rotation * xyz + translation;
+	}
+}
+
+ColmapModel ColmapModel::getSubModel(const std::vector<uint32_t>& imageIds) const
+{
+	ColmapModel subModel;
+	for (const auto imageId : imageIds)
+	{
+		const auto image = images.find(imageId);
+		if (image == images.end())
+		{
+			continue;
+		}
+		Image subImage = image->second;
+		for (auto& point2D : subImage.points2D)
+		{
+			point2D.point3DId = -1;
+		}
+		subModel.images.emplace(imageId, subImage);
+		subModel.cameras.emplace(image->second.cameraId, cameras.at(image->second.cameraId));
+	}
+	for (const auto& point : points3D)
+	{
+		std::vector<TrackElement> track;
+		for (const auto& element : point.second.track)
+		{
+			if (subModel.images.count(element.imageId))
+			{
+				track.emplace_back(element);
+			}
+		}
+		if (track.size() < 2)
+		{
+			continue;
+		}
+		for (const auto& element : track)
+		{
+			auto& points2D = subModel.images[element.imageId].points2D;
+			if (element.point2DIdx < points2D.size())
+			{
+				points2D[element.point2DIdx].point3DId = static_cast<int64_t>(point.first);
+			}
+		}
+		Point3D subPoint = point.second;
+		subPoint.track = track;
+		subModel.points3D.emplace(point.first, subPoint);
+	}
+	return subModel;
+}
+
+std::map<uint32_t, std::vector<uint32_t>> ColmapModel::getCovisibleImages(size_t maxImages) const
+{
+	std::map<uint32_t, std::map<uint32_t, size_t>> sharedPoints;
+	for (const auto& point : points3D)
+	{
+		std::vector<uint32_t> trackImages;
+		for (const auto& element : point.second.track)
+		{
+			trackImages.emplace_back(element.imageId);
+		}
+		std::sort(trackImages.begin(), trackImages.end());
+		trackImages.erase(std::unique(trackImages.begin(), trackImages.end()), trackImages.end());
+		for (size_t i = 0; i < trackImages.size(); i++)
+		{
+			for (size_t j = i + 1; j < trackImages.size(); j++)
+			{
+				sharedPoints[trackImages[i]][trackImages[j]]++;
+				sharedPoints[trackImages[j]][trackImages[i]]++;
+			}
+		}
+	}
+	std::map<uint32_t, std::vector<uint32_t>> covisibleImages;
+	for (const auto& image : images)
+	{
+		std::vector<std::pair<uint32_t, size_t>> imageShared(sharedPoints[image.first].begin(), sharedPoints[image.first].end());
+		std::stable_sort(imageShared.begin(), imageShared.end(), [](const std::pair<uint32_t, size_t>& a, const std::pair<uint32_t, size_t>& b)
+			{ return a.second > b.second; });
+		auto& imageCovisible = covisibleImages[image.first];
+		for (size_t i = 0; i < imageShared.size() && i < maxImages; i++)
+		{
+			imageCovisible.emplace_back(imageShared[i].first);
+		}
+	}
+	return covisibleImages;
+}
+
+Eigen::Matrix4d ColmapModel::getMatrixRt(const Image& image)
+{
+	Eigen::Quaterniond quaternion(image.qvec[0], image.qvec[1], image.qvec[2], image.qvec[3]);
+	Eigen::Matrix4d matrixRt = Eigen::Matrix4d::Identity();
+	matrixRt.block<3, 3>(0, 0) = quaternion.normalized().toRotationMatrix();
+	matrixRt.block<3, 1>(0, 3) = Eigen::Vector3d(image.tvec[0], image.tvec[1], image.tvec[2]);
+	return matrixRt;
+}
+
+void ColmapModel::setMatrixRt(Image& image, const Eigen::Matrix4d& matrixRt)
+{
+	Eigen::Matrix3d rotation = matrixRt.block<3, 3>(0, 0);
+	Eigen::Quaterniond quaternion(rotation);
+	image.qvec[0] = quaternion.w();
+	image.qvec[1] = quaternion.x();
+	image.qvec[2] = quaternion.y();
+	image.qvec[3] = quaternion.z();
+	for (int i = 0; i < 3; i++)
+	{
+		image.tvec[i] = matrixRt(i, 3);
+	}
+}
+
+Eigen::Vector3d ColmapModel::getCameraCenter(const Image& image)
+{
+	const Eigen::Matrix4d matrixRt = getMatrixRt(image);
+	return -matrixRt.block<3, 3>(0, 0).transpose() * matrixRt.block<3, 1>(0, 3);
+}
+
+bool ColmapModel::readCameras(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in.good())
+	{
+		return 0;
+	}
+	uint64_t numCameras = 0;
+	if (!readValue(in, numCameras))
+	{
+		return 0;
+	}
+	for (uint64_t i = 0; i < numCameras; i++)
+	{
+		Intrinsics intrinsics;
+		int32_t cameraId, modelId;
+		if (!readValue(in, cameraId) || !readValue(in, modelId) ||
+			!readValue(in, intrinsics.width) || !readValue(in, intrinsics.height))
+		{
+			return 0;
+		}
+		const int numParams = getNumParams(modelId);
+		if (numParams < 0)
+		{
+			return 0;
+		}
+		intrinsics.cameraId = cameraId;
+		intrinsics.modelId = modelId;
+		intrinsics.params.resize(numParams);
+		if (!in.read(reinterpret_cast<char*>(intrinsics.params.data()), numParams * sizeof(double)))
+		{
+			return 0;
+		}
+		cameras[intrinsics.cameraId] = intrinsics;
+	}
+	return 1;
+}
+
+bool ColmapModel::readImages(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in.good())
+	{
+		return 0;
+	}
+	uint64_t numImages = 0;
+	if (!readValue(in, numImages))
+	{
+		return 0;
+	}
+	for (uint64_t i = 0; i < numImages; i++)
+	{
+		Image image;
+		if (!readValue(in, image.imageId) ||
+			!in.read(reinterpret_cast<char*>(image.qvec), sizeof(image.qvec)) ||
+			!in.read(reinterpret_cast<char*>(image.tvec), sizeof(image.tvec)) ||
+			!readValue(in, image.cameraId))
+		{
+			return 0;
+		}
+		//Null terminated name
+		if (!std::getline(in, image.name, '\0'))
+		{
+			return 0;
+		}
+		uint64_t numPoints2D = 0;
+		if (!readValue(in, numPoints2D))
+		{
+			return 0;
+		}
+		image.points2D.resize(numPoints2D);
+		for (auto& point2D : image.points2D)
+		{
+			if (!readValue(in, point2D.x) || !readValue(in, point2D.y) || !readValue(in, point2D.point3DId))
+			{
+				return 0;
+			}
+		}
+		images[image.imageId] = std::move(image);
+	}
+	return 1;
+}
+
+bool ColmapModel::readPoints3D(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in.good())
+	{
+		return 0;
+	}
+	uint64_t numPoints = 0;
+	if (!readValue(in, numPoints))
+	{
+		return 0;
+	}
+	for (uint64_t i = 0; i < numPoints; i++)
+	{
+		uint64_t pointId;
+		Point3D point;
+		uint64_t trackLength = 0;
+		if (!readValue(in, pointId) ||
+			!in.read(reinterpret_cast<char*>(point.xyz), sizeof(point.xyz)) ||
+			!in.read(reinterpret_cast<char*>(point.rgb), sizeof(point.rgb)) ||
+			!readValue(in, point.error) || !readValue(in, trackLength))
+		{
+			return 0;
+		}
+		point.track.resize(trackLength);
+		for (auto& element : point.track)
+		{
+			if (!readValue(in, element.imageId) || !readValue(in, element.point2DIdx))
+			{
+				return 0;
+			}
+		}
+		points3D[pointId] = std::move(point);
+	}
+	return 1;
+}
+
+bool ColmapModel::writeCameras(const std::string& path) const
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out.good())
+	{
+		return 0;
+	}
+	writeValue(out, static_cast<uint64_t>(cameras.size()));
+	for (const auto& camera : cameras)
+	{
+		const auto& intrinsics = camera.second;
+		writeValue(out, static_cast<int32_t>(intrinsics.cameraId));
+		writeValue(out, static_cast<int32_t>(intrinsics.modelId));
+		writeValue(out, intrinsics.width);
+		writeValue(out, intrinsics.height);
+		out.write(reinterpret_cast<const char*>(intrinsics.params.data()), intrinsics.params.size() * sizeof(double));
+	}
+	return out.good();
+}
+
+bool ColmapModel::writeImages(const std::string& path) const
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out.good())
+	{
+		return 0;
+	}
+	writeValue(out, static_cast<uint64_t>(images.size()));
+	for (const auto& imageEntry : images)
+	{
+		const auto& image = imageEntry.second;
+		writeValue(out, image.imageId);
+		out.write(reinterpret_cast<const char*>(image.qvec), sizeof(image.qvec));
+		out.write(reinterpret_cast<const char*>(image.tvec), sizeof(image.tvec));
+		writeValue(out, image.cameraId);
+		out.write(image.name.c_str(), image.name.size() + 1);
+		writeValue(out, static_cast<uint64_t>(image.points2D.size()));
+		for (const auto& point2D : image.points2D)
+		{
+			writeValue(out, point2D.x);
+			writeValue(out, point2D.y);
+			writeValue(out, point2D.point3DId);
+		}
+	}
+	return out.good();
+}
+
+bool ColmapModel::writePoints3D(const std::string& path) const
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out.good())
+	{
+		return 0;
+	}
+	writeValue(out, static_cast<uint64_t>(points3D.size()));
+	for (const auto& pointEntry : points3D)
+	{
+		const auto& point = pointEntry.second;
+		writeValue(out, pointEntry.first);
+		out.write(reinterpret_cast<const char*>(point.xyz), sizeof(point.xyz));
+		out.write(reinterpret_cast<const char*>(point.rgb), sizeof(point.rgb));
+		writeValue(out, point.error);
+		writeValue(out, static_cast<uint64_t>(point.track.size()));
+		for (const auto& element : point.track)
+		{
+			writeValue(out, element.imageId);
+			writeValue(out, element.point2DIdx);
+		}
+	}
+	return out.good();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+// COLMAP sparse model stored in the binary format (cameras.bin, images.bin and points3D.bin)
+class ColmapModel
+{
+public:
+	struct Intrinsics
+	{
+		uint32_t cameraId = 0;
+		int modelId = 1;
+		uint64_t width = 0;
+		uint64_t height = 0;
+		std::vector<double> params;
+	};
+
+	struct Point2D
+	{
+		double x = 0;
+		double y = 0;
+		// -1 if the observation is not part of a 3D point
+		int64_t point3DId = -1;
+	};
+
+	struct Image
+	{
+		uint32_t imageId = 0;
+		// w, x, y, z of the world to camera rotation
+		double qvec[4] = { 1, 0, 0, 0 };
+		// World to camera translation
+		double tvec[3] = { 0, 0, 0 };
+		uint32_t cameraId = 0;
+		// Relative to the image path
+		std::string name;
+		std::vector<Point2D> points2D;
+	};
+
+	struct TrackElement
+	{
+		uint32_t imageId;
+		uint32_t point2DIdx;
+	};
+
+	struct Point3D
+	{
+		double xyz[3] = { 0, 0, 0 };
+		unsigned char rgb[3] = { 0, 0, 0 };
+		double error = 0;
+		std::vector<TrackElement> track;
+	};
+
+	std::map<uint32_t, Intrinsics> cameras;
+	std::map<uint32_t, Image> images;
+	std::map<uint64_t, Point3D> points3D;
+
+	// Read the model from a directory, points3D.bin is optional when readPoints is false
+	bool read(const std::string& modelDir, bool readPoints = true);
+	// Write the model to an existing directory
+	bool write(const std::string& modelDir) const;
+
+	// Apply the similarity x' = scale * rotation * x + translation to the cameras and points
+	void transform(double scale, const Eigen::Matrix3d& rotation, const Eigen::Vector3d& translation);
+
+	// The images, their cameras and the points seen by at least 2 of them, with the tracks restricted to the images
+	ColmapModel getSubModel(const std::vector<uint32_t>& imageIds) const;
+	// Up to maxImages images of each image, sorted by the number of shared points
+	std::map<uint32_t, std::vector<uint32_t>> getCovisibleImages(size_t maxImages) const;
+
+	// Number of parameters of a COLMAP camera model, -1 if unknown
+	static int getNumParams(int modelId);
+	// {fx, fy} and {cx, cy} of any COLMAP camera model
+	static void getFocalAndPrincipalPoint(const Intrinsics& intrinsics, double focal[2], double principalPoint[2]);
+
+	// [R|t] world to camera
+	static Eigen::Matrix4d getMatrixRt(const Image& image);
+	static void setMatrixRt(Image& image, const Eigen::Matrix4d& matrixRt);
+	static Eigen::Vector3d getCameraCenter(const Image& image);
+
+private:
+	bool readCameras(const std::string& path);
+	bool readImages(const std::string& path);
+	bool readPoints3D(const std::string& path);
+	bool writeCameras(const std::string& path) const;
+	bool writeImages(const std::string& path) const;
+	bool writePoints3D(const std::string& path) const;
+};
@@ -0,0 +1,257 @@
+#include "ColmapModelMerger.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/Geometry>
+
+#include "Tracer.h"
+
+bool ColmapModelMerger::merge(const std::vector<ColmapModel>& models, ColmapModel& merged, std::string& report)
+{
+	Tracer::Span span("Model merge", "native", std::to_string(models.size()) + " models");
+	std::stringstream reportStream;
+	if (models.empty())
+	{
+		report = "No sub-model to merge\n";
+		return 0;
+	}
+	size_t reference = 0;
+	for (size_t i = 1; i < models.size(); i++)
+	{
+		if (models[i].images.size() > models[reference].images.size())
+		{
+			reference = i;
+		}
+	}
+	merged = models[reference];
+	reportStream << "Reference sub-model " << reference << ": " << merged.images.size() << " images\n";
+	std::vector<size_t> remaining;
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		if (i != reference)
+		{
+			remaining.emplace_back(i);
+		}
+	}
+	//Sub-models that could not be aligned and why, tried again while the merged model grows
+	std::vector<std::pair<size_t, std::string>> failed;
+	bool grown = false;
+	while (!remaining.empty())
+	{
+		//The most connected sub-model gives the most reliable alignment
+		auto next = remaining.begin();
+		size_t nextShared = 0;
+		for (auto it = remaining.begin(); it != remaining.end(); ++it)
+		{
+			const size_t shared = countSharedImages(models[*it], merged);
+			if (shared > nextShared)
+			{
+				nextShared = shared;
+				next = it;
+			}
+		}
+		const size_t index = *next;
+		remaining.erase(next);
+		double scale, rmsError;
+		Eigen::Matrix3d rotation;
+		Eigen::Vector3d translation;
+		size_t numShared;
+		std::string failure;
+		if (align(models[index], merged, scale, rotation, translation, numShared, rmsError, failure))
+		{
+			ColmapModel aligned = models[index];
+			aligned.transform(scale, rotation, translation);
+			append(aligned, merged);
+			reportStream << "Sub-model " << index << ": " << aligned.images.size() << " images, " << numShared <<
+				" shared, scale " << scale << ", RMS error " << rmsError << "\n";
+			grown = true;
+		}
+		else
+		{
+			failed.emplace_back(index, failure);
+		}
+		if (remaining.empty() && grown && !failed.empty())
+		{
+			for (const auto& failedModel : failed)
+			{
+				remaining.emplace_back(failedModel.first);
+			}
+			failed.clear();
+			grown = false;
+		}
+	}
+	for (const auto& failedModel : failed)
+	{
+		reportStream << "Sub-model " << failedModel.first << ": " << models[failedModel.first].images.size() <<
+			" images, not merged (" << failedModel.second << ")\n";
+	}
+	reportStream << "Merged model: " << merged.images.size() << " images, " << merged.points3D.size() << " points\n";
+	report = reportStream.str();
+	return !merged.images.empty();
+}
+
+bool ColmapModelMerger::align(const ColmapModel& source, const ColmapModel& target,
+	double& scale, Eigen::Matrix3d& rotation, Eigen::Vector3d& translation, size_t& numShared, double& rmsError, std::string& failure)
+{
+	std::vector<Eigen::Vector3d> sourceCenters, targetCenters;
+	//Rotation of the source to the target seen by each shared image, Rt_target^T * Rt_source
+	std::vector<Eigen::Matrix3d> imageRotations;
+	for (const auto& image : source.images)
+	{
+		const auto targetImage = target.images.find(image.first);
+		if (targetImage != target.images.end())
+		{
+			sourceCenters.emplace_back(ColmapModel::getCameraCenter(image.second));
+			targetCenters.emplace_back(ColmapModel::getCameraCenter(targetImage->second));
+			imageRotations.emplace_back(ColmapModel::getMatrixRt(targetImage->second).block<3, 3>(0, 0).transpose() *
+				ColmapModel::getMatrixRt(image.second).block<3, 3>(0, 0));
+		}
+	}
+	numShared = sourceCenters.size();
+	if (numShared < 3)
+	{
+		failure = std::to_string(numShared) + " shared images, less than 3";
+		return 0;
+	}
+	std::vector<size_t> inliers(numShared);
+	for (size_t i = 0; i < numShared; i++)
+	{
+		inliers[i] = i;
+	}
+	std::vector<double> residuals(numShared);
+	for (int iteration = 0; iteration < 2; iteration++)
+	{
+		//The rotation comes from the orientations of the cameras, the centers of a strip (a corridor, a row of a grid)
+		//are collinear and leave the rotation around them free
+		Eigen::Matrix3d rotationSum = Eigen::Matrix3d::Zero();
+		Eigen::Vector3d sourceMean = Eigen::Vector3d::Zero(), targetMean = Eigen::Vector3d::Zero();
+		for (const auto index : inliers)
+		{
+			rotationSum += imageRotations[index];
+			sourceMean += sourceCenters[index];
+			targetMean += targetCenters[index];
+		}
+		sourceMean /= static_cast<double>(inliers.size());
+		targetMean /= static_cast<double>(inliers.size());
+		const Eigen::JacobiSVD<Eigen::Matrix3d> svd(rotationSum, Eigen::ComputeFullU | Eigen::ComputeFullV);
+		Eigen::Matrix3d reflection = Eigen::Matrix3d::Identity();
+		reflection(2, 2) = (svd.matrixU() * svd.matrixV().transpose()).determinant() < 0 ? -1 : 1;
+		rotation = svd.matrixU() * reflection * svd.matrixV().transpose();
+		//Scale and translation of the centers with that rotation, in the least squares sense
+		double correlation = 0, sourceVariance = 0, targetVariance = 0, sourceNorm = 0, targetNorm = 0;
+		for (const auto index : inliers)
+		{
+			const Eigen::Vector3d rotated = rotation * (sourceCenters[index] - sourceMean);
+			correlation += rotated.dot(targetCenters[index] - targetMean);
+			sourceVariance += rotated.squaredNorm();
+			targetVariance += (targetCenters[index] - targetMean).squaredNorm();
+			sourceNorm += sourceCenters[index].squaredNorm();
+			targetNorm += targetCenters[index].squaredNorm();
+		}
+		//The shared cameras at the same place (up to the rounding of their coordinates) give no scale
+		if (!(sourceVariance > 1e-20 * sourceNorm) || !(targetVariance > 1e-20 * targetNorm))
+		{
+			failure = "the " + std::to_string(inliers.size()) + " shared cameras are at the same place";
+			return 0;
+		}
+		if (!(correlation > 0))
+		{
+			failure = "the centers of the " + std::to_string(inliers.size()) + " shared cameras don't follow their orientations";
+			return 0;
+		}
+		scale = correlation / sourceVariance;
+		translation = targetMean - scale * rotation * sourceMean;
+		for (size_t i = 0; i < numShared; i++)
+		{
+			residuals[i] = (scale * rotation * sourceCenters[i] + translation - targetCenters[i]).norm();
+		}
+		if (iteration == 1)
+		{
+			break;
+		}
+		std::vector<double> sortedResiduals(residuals);
+		std::nth_element(sortedResiduals.begin(), sortedResiduals.begin() + numShared / 2, sortedResiduals.end());
+		const double threshold = 3 * sortedResiduals[numShared / 2];
+		std::vector<size_t> newInliers;
+		for (size_t i = 0; i < numShared; i++)
+		{
+			if (residuals[i] <= threshold)
+			{
+				newInliers.emplace_back(i);
+			}
+		}
+		if (newInliers.size() < 3 || newInliers.size() == inliers.size())
+		{
+			break;
+		}
+		inliers = newInliers;
+	}
+	double squaredSum = 0;
+	for (const auto index : inliers)
+	{
+		squaredSum += residuals[index] * residuals[index];
+	}
+	rmsError = std::sqrt(squaredSum / inliers.size());
+	return 1;
+}
+
+void ColmapModelMerger::append(const ColmapModel& source, ColmapModel& target)
+{
+	for (const auto& camera : source.cameras)
+	{
+		target.cameras.insert(camera);
+	}
+	for (const auto& image : source.images)
+	{
+		//Shared images keep the pose and observations of the target
+		if (target.images.count(image.first))
+		{
+			continue;
+		}
+		ColmapModel::Image newImage = image.second;
+		for (auto& point2D : newImage.points2D)
+		{
+			point2D.point3DId = -1;
+		}
+		target.images.emplace(image.first, newImage);
+	}
+	uint64_t nextPointId = target.points3D.empty() ? 1 : target.points3D.rbegin()->first + 1;
+	for (const auto& point : source.points3D)
+	{
+		//Observations already used by a target point stay with it
+		std::vector<ColmapModel::TrackElement> track;
+		for (const auto& element : point.second.track)
+		{
+			const auto image = target.images.find(element.imageId);
+			if (image != target.images.end() && element.point2DIdx < image->second.points2D.size() &&
+				image->second.points2D[element.point2DIdx].point3DId == -1)
+			{
+				track.emplace_back(element);
+			}
+		}
+		if (track.size() < 2)
+		{
+			continue;
+		}
+		for (const auto& element : track)
+		{
+			target.images[element.imageId].points2D[element.point2DIdx].point3DId = static_cast<int64_t>(nextPointId);
+		}
+		ColmapModel::Point3D newPoint = point.second;
+		newPoint.track = track;
+		target.points3D.emplace(nextPointId, newPoint);
+		nextPointId++;
+	}
+}
+
+size_t ColmapModelMerger::countSharedImages(const ColmapModel& source, const ColmapModel& target)
+{
+	size_t shared = 0;
+	for (const auto& image : source.images)
+	{
+		shared += target.images.count(image.first);
+	}
+	return shared;
+}
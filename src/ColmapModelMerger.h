@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "ColmapModel.h"
+
+// Merges COLMAP sub-models reconstructed from the same database, so an image has the same id in every sub-model
+class ColmapModelMerger
+{
+public:
+	// The sub-model with most images is the reference, the others are aligned to the merged model
+	// in the order of most shared images. Sub-models that can't be aligned are tried again once the merged model has
+	// grown, the ones left out are reported with the reason.
+	static bool merge(const std::vector<ColmapModel>& models, ColmapModel& merged, std::string& report);
+
+	// Similarity from the images registered in both models, false with less than 3 of them or all at the same place.
+	// The rotation is the mean of the ones of their orientations, so collinear centers also align, and the scale and
+	// translation fit their centers. Outliers (e.g. badly registered images in the overlap) are removed once before the
+	// final estimate. failure tells why the models could not be aligned.
+	static bool align(const ColmapModel& source, const ColmapModel& target, double& scale, Eigen::Matrix3d& rotation,
+		Eigen::Vector3d& translation, size_t& numShared, double& rmsError, std::string& failure);
+
+private:
+	// Add the images, cameras and points of source that are not in target, the tracks are joined by image id
+	static void append(const ColmapModel& source, ColmapModel& target);
+
+	static size_t countSharedImages(const ColmapModel& source, const ColmapModel& target);
+};
@@ -14,6 +14,19 @@
 #include <wx/stdpaths.h>
 
 #include "HelperTexRecon.h"
+#include "ImagePreScreen.h"
+#include "MatchingPlanner.h"
+#include "SpatialPartition.h"
+#include "DepthMapFusion.h"
+#include "PlaneSweepStereo.h"
+#include "DenseResourcePlanner.h"
+#include "QualityPresets.h"
+#include "Tracer.h"
+#include "JobQueue.h"
+#include "ProcessLimits.h"
+#include "Cancellation.h"
+#include "StageRunner.h"
+
 #include "Utils.h"
 #include "json.hpp"
 
@@ -27,6 +40,66 @@ bool ConfigurationDialog::isFirstInstance = true;
 int ConfigurationDialog::sparseQuality = 2;
 int ConfigurationDialog::denseQuality = 2;
 bool ConfigurationDialog::useGPU = false;
+bool ConfigurationDialog::retainWorkspace = false;
+//Sparse matching
+int ConfigurationDialog::matchNeighbors = 20;
+int ConfigurationDialog::matchTimeNeighbors = 5;
+int ConfigurationDialog::sequentialOverlap = 10;
+int ConfigurationDialog::vocabTreeNeighbors = 50;
+double ConfigurationDialog::matchTimeBudget = 1800;
+double ConfigurationDialog::matchPairsPerSecond = 100;
+//Sparse partitioning
+int ConfigurationDialog::partitionMaxImages = 500;
+double ConfigurationDialog::partitionOverlap = 0.2;
+int ConfigurationDialog::partitionMaxWorkers = 2;
+double ConfigurationDialog::partitionMaxDroppedFraction = 0.1;
+int ConfigurationDialog::partitionDenseMaxImages = 150;
+int ConfigurationDialog::partitionDenseMaxWorkers = 2;
+//Dense resources
+double ConfigurationDialog::resourceMemoryBudget = 0;
+int ConfigurationDialog::resourceNumSourceImages = 20;
+//Dense stereo
+int ConfigurationDialog::stereoMode = 0;
+int ConfigurationDialog::stereoMaxImageSize = 1000;
+int ConfigurationDialog::stereoNumSourceImages = 4;
+int ConfigurationDialog::stereoNumDepths = 96;
+int ConfigurationDialog::stereoWindowRadius = 3;
+double ConfigurationDialog::stereoMinNCC = 0.5;
+int ConfigurationDialog::stereoNumThreads = 0;
+int ConfigurationDialog::stereoTileRows = 32;
+//Dense fusion
+bool ConfigurationDialog::fusionNative = true;
+int ConfigurationDialog::fusionMinNumPixels = 5;
+double ConfigurationDialog::fusionMaxReprojError = 2;
+double ConfigurationDialog::fusionMaxDepthError = 0.01;
+double ConfigurationDialog::fusionMaxNormalError = 10;
+double ConfigurationDialog::fusionCacheSize = 4;
+//Timeline trace
+bool ConfigurationDialog::traceEnabled = true;
+int ConfigurationDialog::traceCounterInterval = 500;
+//Job queue
+std::string ConfigurationDialog::queueDirectory = "";
+int ConfigurationDialog::queueMaxJobs = 2;
+int ConfigurationDialog::queueCpuThreads = 0;
+double ConfigurationDialog::queueMemoryBudget = 0;
+int ConfigurationDialog::queueGpus = 1;
+//Limits of the external tools
+int ConfigurationDialog::limitsPriority = 1;
+double ConfigurationDialog::limitsMemoryFactor = 1.5;
+bool ConfigurationDialog::limitsCpuHardCap = false;
+//Stage timeouts
+bool ConfigurationDialog::timeoutsEnabled = true;
+double ConfigurationDialog::timeoutsFactor = 5;
+int ConfigurationDialog::timeoutsMinSeconds = 1800;
+//Stand-ins of the external tools
+bool ConfigurationDialog::runnerMock = false;
+int ConfigurationDialog::runnerDelayMs = 0;
+int ConfigurationDialog::runnerDelayPerImageMs = 0;
+int ConfigurationDialog::runnerSparsePointsPerImage = 300;
+int ConfigurationDialog::runnerDensePointsPerImage = 5000;
+int ConfigurationDialog::runnerMeshFaces = 200000;
+int ConfigurationDialog::runnerTextureSize = 1024;
+unsigned int ConfigurationDialog::runnerSeed = 1;
 //TexRecon
 int ConfigurationDialog::dataTerm = 1;
 int ConfigurationDialog::outlierRemoval = 0;
@@ -36,6 +109,13 @@ bool ConfigurationDialog::globalSeamLeveling = false;
 bool ConfigurationDialog::localSeamLeveling = true;
 bool ConfigurationDialog::holeFilling = true;
 bool ConfigurationDialog::keepUnseenFaces = false;
+//Image pre-screen
+double ConfigurationDialog::minRelativeSharpness = 0.3;
+double ConfigurationDialog::maxClippedFraction = 0.5;
+unsigned int ConfigurationDialog::maxDuplicateDistance = 4;
+int ConfigurationDialog::analysisWidth = 512;
+//Scale of the reconstruction
+bool ConfigurationDialog::scaleGPSFile = false;
 
 ConfigurationDialog::ConfigurationDialog(wxWindow * parent, wxWindowID id, const wxString & title, const wxPoint & pos, const wxSize & size, long style) : wxDialog(parent, id, title, pos, size, style)
 {
@@ -80,6 +160,13 @@ ConfigurationDialog::ConfigurationDialog(wxWindow * parent, wxWindowID id, const
 	fgSizerCOLMAP->Add(ckBUseGPU, 0, wxALL, 5);
 	//------
 
+	//Retain workspace
+	fgSizerCOLMAP->Add(new wxStaticText(sbSizerCOLMAP->GetStaticBox(), wxID_ANY, "Retain workspace"), 0, wxALL, 5);
+	ckBRetainWorkspace = new wxCheckBox(sbSizerCOLMAP->GetStaticBox(), wxID_ANY, wxEmptyString);
+	ckBRetainWorkspace->SetValue(retainWorkspace);
+	fgSizerCOLMAP->Add(ckBRetainWorkspace, 0, wxALL, 5);
+	//------
+
 	sbSizerCOLMAP->Add(fgSizerCOLMAP, 1, wxEXPAND, 5);
 
 	bSizerMesh->Add(sbSizerCOLMAP, 0, wxEXPAND, 5);
@@ -189,6 +276,66 @@ void ConfigurationDialog::loadDefaultConfig()
 	sparseQuality = jsonFile["COLMAP"]["sparseQuality"];
 	denseQuality =	jsonFile["COLMAP"]["denseQuality"];
 	useGPU =		jsonFile["COLMAP"]["useGPU"];
+	retainWorkspace =	jsonFile["COLMAP"]["retainWorkspace"];
+
+	matchNeighbors =		jsonFile["Matching"]["neighbors"];
+	matchTimeNeighbors =	jsonFile["Matching"]["timeNeighbors"];
+	sequentialOverlap =		jsonFile["Matching"]["sequentialOverlap"];
+	vocabTreeNeighbors =	jsonFile["Matching"]["vocabTreeNeighbors"];
+	matchTimeBudget =		jsonFile["Matching"]["timeBudget"];
+	matchPairsPerSecond =	jsonFile["Matching"]["pairsPerSecond"];
+
+	partitionMaxImages =	jsonFile["Partition"]["maxImages"];
+	partitionOverlap =		jsonFile["Partition"]["overlap"];
+	partitionMaxWorkers =	jsonFile["Partition"]["maxWorkers"];
+	partitionMaxDroppedFraction =	jsonFile["Partition"]["maxDroppedFraction"];
+	partitionDenseMaxImages =	jsonFile["Partition"]["denseMaxImages"];
+	partitionDenseMaxWorkers =	jsonFile["Partition"]["denseMaxWorkers"];
+
+	resourceMemoryBudget =		jsonFile["Resources"]["memoryBudget"];
+	resourceNumSourceImages =	jsonFile["Resources"]["numSourceImages"];
+
+	stereoMode =			jsonFile["Stereo"]["mode"];
+	stereoMaxImageSize =	jsonFile["Stereo"]["maxImageSize"];
+	stereoNumSourceImages =	jsonFile["Stereo"]["numSourceImages"];
+	stereoNumDepths =		jsonFile["Stereo"]["numDepths"];
+	stereoWindowRadius =	jsonFile["Stereo"]["windowRadius"];
+	stereoMinNCC =			jsonFile["Stereo"]["minNCC"];
+	stereoNumThreads =		jsonFile["Stereo"]["numThreads"];
+	stereoTileRows =		jsonFile["Stereo"]["tileRows"];
+
+	fusionNative =			jsonFile["Fusion"]["native"];
+	fusionMinNumPixels =	jsonFile["Fusion"]["minNumPixels"];
+	fusionMaxReprojError =	jsonFile["Fusion"]["maxReprojError"];
+	fusionMaxDepthError =	jsonFile["Fusion"]["maxDepthError"];
+	fusionMaxNormalError =	jsonFile["Fusion"]["maxNormalError"];
+	fusionCacheSize =		jsonFile["Fusion"]["cacheSize"];
+
+	traceEnabled =			jsonFile["Trace"]["enabled"];
+	traceCounterInterval =	jsonFile["Trace"]["counterInterval"];
+
+	queueDirectory =		jsonFile["Queue"]["directory"].get<std::string>();
+	queueMaxJobs =			jsonFile["Queue"]["maxJobs"];
+	queueCpuThreads =		jsonFile["Queue"]["cpuThreads"];
+	queueMemoryBudget =		jsonFile["Queue"]["memoryBudget"];
+	queueGpus =				jsonFile["Queue"]["gpus"];
+
+	limitsPriority =		jsonFile["Limits"]["priority"];
+	limitsMemoryFactor =	jsonFile["Limits"]["memoryFactor"];
+	limitsCpuHardCap =		jsonFile["Limits"]["cpuHardCap"];
+
+	timeoutsEnabled =		jsonFile["Timeouts"]["enabled"];
+	timeoutsFactor =		jsonFile["Timeouts"]["factor"];
+	timeoutsMinSeconds =	jsonFile["Timeouts"]["minSeconds"];
+
+	runnerMock =					jsonFile["Runner"]["mock"];
+	runnerDelayMs =					jsonFile["Runner"]["delayMs"];
+	runnerDelayPerImageMs =			jsonFile["Runner"]["delayPerImageMs"];
+	runnerSparsePointsPerImage =	jsonFile["Runner"]["sparsePointsPerImage"];
+	runnerDensePointsPerImage =		jsonFile["Runner"]["densePointsPerImage"];
+	runnerMeshFaces =				jsonFile["Runner"]["meshFaces"];
+	runnerTextureSize =				jsonFile["Runner"]["textureSize"];
+	runnerSeed =					jsonFile["Runner"]["seed"];
 
 	dataTerm =					jsonFile["TexRecon"]["dataTerm"];
 	outlierRemoval =			jsonFile["TexRecon"]["outlierRemoval"];
@@ -198,6 +345,13 @@ void ConfigurationDialog::loadDefaultConfig()
 	localSeamLeveling =			jsonFile["TexRecon"]["localSeamLeveling"];
 	holeFilling =				jsonFile["TexRecon"]["holeFilling"];
 	keepUnseenFaces =			jsonFile["TexRecon"]["keepUnseenFaces"];
+
+	minRelativeSharpness =	jsonFile["PreScreen"]["minRelativeSharpness"];
+	maxClippedFraction =	jsonFile["PreScreen"]["maxClippedFraction"];
+	maxDuplicateDistance =	jsonFile["PreScreen"]["maxDuplicateDistance"];
+	analysisWidth =			jsonFile["PreScreen"]["analysisWidth"];
+
+	scaleGPSFile =	jsonFile["ScalePtcs"]["gpsFile"];
 }
 
 std::string ConfigurationDialog::getParameters()
@@ -208,9 +362,49 @@ std::string ConfigurationDialog::getParameters()
 		"Sparse quality " << getSparseQuality() << "\n" <<
 		"Dense quality " << getDenseQuality() << "\n" <<
 		"Use GPU " << getUseGPU() << "\n" <<
+		"Retain workspace " << getRetainWorkspace() << "\n" <<
+		"------------------------------------------------------\n" <<
+		"Quality preset" << (QualityPresets::hasProjectOverrides() ? " (project overrides)" : "") << "\n" <<
+		getQualityPreset().print() <<
+		"------------------------------------------------------\n" <<
+		"Matching\n" <<
+		getMatchingOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Partition\n" <<
+		getPartitionOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Resources\n" <<
+		getResourceOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Stereo\n" <<
+		getStereoOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Fusion\n" <<
+		getFusionOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Trace\n" <<
+		getTraceOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Queue\n" <<
+		getQueueOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Limits\n" <<
+		getLimitsOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Timeouts\n" <<
+		getTimeoutsOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Runner\n" <<
+		getRunnerOptions().print() <<
 		"------------------------------------------------------\n" <<
 		"TexRecon\n" <<
 		getTexReconOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"Pre-screen\n" <<
+		getPreScreenOptions().print() <<
+		"------------------------------------------------------\n" <<
+		"ScalePtcs\n" <<
+		"GPS file " << getScaleGPSFile() << "\n" <<
 		"------------------------------------------------------\n";
 	return parameters.str();
 }
@@ -258,12 +452,87 @@ std::string ConfigurationDialog::getUseGPU()
 	return "0";
 }
 
+bool ConfigurationDialog::getRetainWorkspace()
+{
+	return retainWorkspace;
+}
+
+Quality::Preset ConfigurationDialog::getQualityPreset()
+{
+	auto preset = QualityPresets::get(static_cast<Quality::Level>(denseQuality));
+	preset.sparse = QualityPresets::get(static_cast<Quality::Level>(sparseQuality)).sparse;
+	return preset;
+}
+
+Matching::Options ConfigurationDialog::getMatchingOptions()
+{
+	return Matching::Options(matchNeighbors, matchTimeNeighbors, sequentialOverlap, vocabTreeNeighbors, matchTimeBudget, matchPairsPerSecond);
+}
+
+Partition::Options ConfigurationDialog::getPartitionOptions()
+{
+	return Partition::Options(partitionMaxImages, partitionOverlap, partitionMaxWorkers, partitionMaxDroppedFraction,
+		partitionDenseMaxImages, partitionDenseMaxWorkers);
+}
+
+Resources::Options ConfigurationDialog::getResourceOptions()
+{
+	return Resources::Options(resourceMemoryBudget, resourceNumSourceImages);
+}
+
+Stereo::Options ConfigurationDialog::getStereoOptions()
+{
+	return Stereo::Options(stereoMode, stereoMaxImageSize, stereoNumSourceImages, stereoNumDepths, stereoWindowRadius, stereoMinNCC,
+		stereoNumThreads, stereoTileRows);
+}
+
+Fusion::Options ConfigurationDialog::getFusionOptions()
+{
+	return Fusion::Options(fusionNative, fusionMinNumPixels, fusionMaxReprojError, fusionMaxDepthError, fusionMaxNormalError, fusionCacheSize);
+}
+
+Trace::Options ConfigurationDialog::getTraceOptions()
+{
+	return Trace::Options(traceEnabled, traceCounterInterval);
+}
+
+Queue::Options ConfigurationDialog::getQueueOptions()
+{
+	return Queue::Options(queueDirectory, queueMaxJobs, queueCpuThreads, queueMemoryBudget, queueGpus);
+}
+
+Limits::Options ConfigurationDialog::getLimitsOptions()
+{
+	return Limits::Options(limitsPriority, limitsMemoryFactor, limitsCpuHardCap);
+}
+
+Timeouts::Options ConfigurationDialog::getTimeoutsOptions()
+{
+	return Timeouts::Options(timeoutsEnabled, timeoutsFactor, timeoutsMinSeconds);
+}
+
+Runner::Options ConfigurationDialog::getRunnerOptions()
+{
+	return Runner::Options(runnerMock, runnerDelayMs, runnerDelayPerImageMs, runnerSparsePointsPerImage, runnerDensePointsPerImage,
+		runnerMeshFaces, runnerTextureSize, runnerSeed);
+}
+
 
 TexRecon::Options ConfigurationDialog::getTexReconOptions()
 {
 	return TexRecon::Options(dataTerm, outlierRemoval, toneMapping, geometricVisibilityTest, globalSeamLeveling, localSeamLeveling, holeFilling, keepUnseenFaces);
 }
 
+PreScreen::Options ConfigurationDialog::getPreScreenOptions()
+{
+	return PreScreen::Options(minRelativeSharpness, maxClippedFraction, maxDuplicateDistance, analysisWidth);
+}
+
+bool ConfigurationDialog::getScaleGPSFile()
+{
+	return scaleGPSFile;
+}
+
 void ConfigurationDialog::SetQuality(int quality)
 {
 	sparseQuality = quality;
@@ -276,6 +545,7 @@ void ConfigurationDialog::OnOK(wxCommandEvent & WXUNUSED)
 	sparseQuality = choiceSparseQuality->GetSelection();
 	denseQuality = choiceDenseQuality->GetSelection();
 	useGPU = ckBUseGPU->IsChecked();
+	retainWorkspace = ckBRetainWorkspace->IsChecked();
 	//TexRecon
 	dataTerm = choiceDataTerm->GetSelection();
 	outlierRemoval = choiceOutlierRemoval->GetSelection();
@@ -294,6 +564,7 @@ void ConfigurationDialog::OnBtDefault(wxCommandEvent & WXUNUSED)
 	choiceSparseQuality->SetSelection(sparseQuality);
 	choiceDenseQuality->SetSelection(denseQuality);
 	ckBUseGPU->SetValue(useGPU);
+	ckBRetainWorkspace->SetValue(retainWorkspace);
 	//TexRecon
 	choiceDataTerm->SetSelection(dataTerm);
 	choiceOutlierRemoval->SetSelection(outlierRemoval);
@@ -10,6 +10,66 @@ namespace TexRecon
 	struct Options;
 }
 
+namespace PreScreen
+{
+	struct Options;
+}
+
+namespace Matching
+{
+	struct Options;
+}
+
+namespace Partition
+{
+	struct Options;
+}
+
+namespace Fusion
+{
+	struct Options;
+}
+
+namespace Stereo
+{
+	struct Options;
+}
+
+namespace Resources
+{
+	struct Options;
+}
+
+namespace Quality
+{
+	struct Preset;
+}
+
+namespace Trace
+{
+	struct Options;
+}
+
+namespace Queue
+{
+	struct Options;
+}
+
+namespace Limits
+{
+	struct Options;
+}
+
+namespace Timeouts
+{
+	struct Options;
+}
+
+namespace Runner
+{
+	struct Options;
+}
+
 class ConfigurationDialog : public wxDialog
 {
 public:
@@ -26,10 +86,42 @@ public:
 	//0 - Low 1 - Medium 2 - High 3 - Extreme
 	static std::string getDenseQuality();
 	static std::string getUseGPU();
+	//Keep the COLMAP workspace in the project folder, so reruns reuse the sparse model, undistorted images and depth maps
+	static bool getRetainWorkspace();
+	//Parameters of the sparse quality for the sparse stage and of the dense quality for the later stages
+	static Quality::Preset getQualityPreset();
+
+	//Sparse matching
+	static Matching::Options getMatchingOptions();
+	//Sparse partitioning of large captures
+	static Partition::Options getPartitionOptions();
+	//Memory budget of the dense stage
+	static Resources::Options getResourceOptions();
+	//Dense stereo, COLMAP patch match or CPU plane sweep
+	static Stereo::Options getStereoOptions();
+	//Dense fusion
+	static Fusion::Options getFusionOptions();
+	//Timeline of the reconstruction for chrome://tracing
+	static Trace::Options getTraceOptions();
+	//Job queue and the budget its stages share
+	static Queue::Options getQueueOptions();
+	//Priority, processors and memory of the external tools
+	static Limits::Options getLimitsOptions();
+	//Stage timeouts
+	static Timeouts::Options getTimeoutsOptions();
+	//Stand-ins of the external tools for benchmarks
+	static Runner::Options getRunnerOptions();
 
 	//TexRecon
 	static TexRecon::Options getTexReconOptions();
 
+	//Image pre-screen
+	static PreScreen::Options getPreScreenOptions();
+
+	//Scale of the reconstruction
+	//Pass the GPS of the images metadata to scale_ptcs.exe as a CSV, the versions before --gps-csv reject it
+	static bool getScaleGPSFile();
+
 	static void SetQuality(int quality);
 
 private:
@@ -42,6 +134,7 @@ private:
 	wxChoice* choiceSparseQuality;
 	wxChoice* choiceDenseQuality;
 	wxCheckBox* ckBUseGPU;
+	wxCheckBox* ckBRetainWorkspace;
 
 	//TexRecon
 	wxChoice* choiceDataTerm;
@@ -60,6 +153,66 @@ private:
 	static int sparseQuality;
 	static int denseQuality;
 	static bool useGPU;
+	static bool retainWorkspace;
+	//Sparse matching
+	static int matchNeighbors;
+	static int matchTimeNeighbors;
+	static int sequentialOverlap;
+	static int vocabTreeNeighbors;
+	static double matchTimeBudget;
+	static double matchPairsPerSecond;
+	//Sparse partitioning
+	static int partitionMaxImages;
+	static double partitionOverlap;
+	static int partitionMaxWorkers;
+	static double partitionMaxDroppedFraction;
+	static int partitionDenseMaxImages;
+	static int partitionDenseMaxWorkers;
+	//Dense resources
+	static double resourceMemoryBudget;
+	static int resourceNumSourceImages;
+	//Dense stereo
+	static int stereoMode;
+	static int stereoMaxImageSize;
+	static int stereoNumSourceImages;
+	static int stereoNumDepths;
+	static int stereoWindowRadius;
+	static double stereoMinNCC;
+	static int stereoNumThreads;
+	static int stereoTileRows;
+	//Dense fusion
+	static bool fusionNative;
+	static int fusionMinNumPixels;
+	static double fusionMaxReprojError;
+	static double fusionMaxDepthError;
+	static double fusionMaxNormalError;
+	static double fusionCacheSize;
+	//Timeline trace
+	static bool traceEnabled;
+	static int traceCounterInterval;
+	//Job queue
+	static std::string queueDirectory;
+	static int queueMaxJobs;
+	static int queueCpuThreads;
+	static double queueMemoryBudget;
+	static int queueGpus;
+	//Limits of the external tools
+	static int limitsPriority;
+	static double limitsMemoryFactor;
+	static bool limitsCpuHardCap;
+	//Stage timeouts
+	static bool timeoutsEnabled;
+	static double timeoutsFactor;
+	static int timeoutsMinSeconds;
+	//Stand-ins of the external tools
+	static bool runnerMock;
+	static int runnerDelayMs;
+	static int runnerDelayPerImageMs;
+	static int runnerSparsePointsPerImage;
+	static int runnerDensePointsPerImage;
+	static int runnerMeshFaces;
+	static int runnerTextureSize;
+	static unsigned int runnerSeed;
 	//TexRecon
 	static int dataTerm;
 	static int outlierRemoval;
@@ -69,6 +222,13 @@ private:
 	static bool localSeamLeveling;
 	static bool holeFilling;
 	static bool keepUnseenFaces;
+	//Image pre-screen
+	static double minRelativeSharpness;
+	static double maxClippedFraction;
+	static unsigned int maxDuplicateDistance;
+	static int analysisWidth;
+	//Scale of the reconstruction
+	static bool scaleGPSFile;
 
 };
 enum EnumConfigDialog
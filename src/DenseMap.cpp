@@ -0,0 +1,34 @@
+#include "DenseMap.h"
+
+#include <fstream>
+
+bool DenseMap::read(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		return 0;
+	}
+	char separator;
+	file >> width >> separator >> height >> separator >> channels >> separator;
+	if (!file.good() || width <= 0 || height <= 0 || channels <= 0)
+	{
+		return 0;
+	}
+	data.resize(static_cast<size_t>(width) * height * channels);
+	const std::streamsize size = static_cast<std::streamsize>(data.size() * sizeof(float));
+	file.read(reinterpret_cast<char*>(data.data()), size);
+	return file.gcount() == size;
+}
+
+bool DenseMap::write(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		return 0;
+	}
+	file << width << "&" << height << "&" << channels << "&";
+	file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(float)));
+	return file.good();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Depth (1 channel) or normal (3 channels) map of a COLMAP dense workspace, stored in the .bin format:
+// text header "width&height&channels&" followed by the floats, the channels one after the other
+class DenseMap
+{
+public:
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<float> data;
+
+	DenseMap() {};
+	DenseMap(int width, int height, int channels) :
+		width(width), height(height), channels(channels), data(static_cast<size_t>(width) * height * channels, 0.f) {};
+
+	float at(int row, int col, int channel = 0) const
+	{
+		return data[(static_cast<size_t>(channel) * height + row) * width + col];
+	}
+	float& at(int row, int col, int channel = 0)
+	{
+		return data[(static_cast<size_t>(channel) * height + row) * width + col];
+	}
+
+	bool read(const std::string& path);
+	bool write(const std::string& path) const;
+};
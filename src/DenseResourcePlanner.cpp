@@ -0,0 +1,109 @@
+#include "DenseResourcePlanner.h"
+
+#include <sstream>
+#include <algorithm>
+
+#include <windows.h>
+
+#include "ColmapModel.h"
+
+namespace
+{
+	// Gray image (float), depth (float) and normal (3 floats) per pixel, the same in patch match and fusion
+	const uint64_t bytesPerPixel = 20;
+	// Smallest size chosen by the planner, below it the depth maps are too coarse to be useful
+	const int minImageSize = 500;
+	const double bytesPerGB = 1024.0 * 1024.0 * 1024.0;
+}
+
+std::string Resources::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Memory budget " << memoryBudget << "\n" <<
+		"Num source images " << numSourceImages << "\n";
+	return parameters.str();
+}
+
+std::string Resources::Plan::print() const
+{
+	std::stringstream plan;
+	plan << "Image size " << imageSize << ", " << numWorkers << " workers, " << cacheSize << " GB cache per worker\n" <<
+		"Estimated " << workerBytes / (1024 * 1024) << " MB per worker of a budget of " << budgetBytes / (1024 * 1024) << " MB\n" <<
+		reason;
+	return plan.str();
+}
+
+Resources::Plan DenseResourcePlanner::plan(const ColmapModel& model, int qualityImageSize, int maxWorkers, const Resources::Options& options)
+{
+	Resources::Plan plan;
+	//The largest camera bounds the memory of any worker
+	uint64_t width = 0, height = 0;
+	for (const auto& camera : model.cameras)
+	{
+		if (camera.second.width * camera.second.height > width * height)
+		{
+			width = camera.second.width;
+			height = camera.second.height;
+		}
+	}
+	const int largestSide = static_cast<int>(std::max(width, height));
+	plan.imageSize = qualityImageSize > 0 ? std::min(qualityImageSize, largestSide) : largestSide;
+	plan.numWorkers = std::max(maxWorkers, 1);
+	if (options.memoryBudget > 0)
+	{
+		plan.budgetBytes = static_cast<uint64_t>(options.memoryBudget * bytesPerGB);
+	}
+	else
+	{
+		plan.budgetBytes = getAvailableMemory() / 4 * 3;
+	}
+	if (plan.budgetBytes == 0 || largestSide == 0)
+	{
+		plan.imageSize = qualityImageSize;
+		plan.reason = "Unknown memory or image size, the quality size is used\n";
+		return plan;
+	}
+	plan.workerBytes = estimateWorkerBytes(width, height, plan.imageSize, options.numSourceImages);
+	while (plan.numWorkers > 1 && plan.numWorkers * plan.workerBytes > plan.budgetBytes)
+	{
+		plan.numWorkers--;
+	}
+	const int initialImageSize = plan.imageSize;
+	while (plan.workerBytes > plan.budgetBytes && plan.imageSize > minImageSize)
+	{
+		plan.imageSize = std::max(minImageSize, plan.imageSize * 9 / 10);
+		plan.workerBytes = estimateWorkerBytes(width, height, plan.imageSize, options.numSourceImages);
+	}
+	plan.cacheSize = plan.budgetBytes / bytesPerGB / plan.numWorkers;
+	if (plan.imageSize < initialImageSize)
+	{
+		plan.reason = "Downscaled from " + std::to_string(initialImageSize) + " to fit one worker in the budget\n";
+	}
+	if (plan.workerBytes > plan.budgetBytes)
+	{
+		plan.reason += "One worker doesn't fit in the budget even with the smallest size\n";
+	}
+	if (plan.numWorkers < maxWorkers)
+	{
+		plan.reason += "Workers reduced from " + std::to_string(maxWorkers) + " to fit in the budget\n";
+	}
+	return plan;
+}
+
+uint64_t DenseResourcePlanner::estimateWorkerBytes(uint64_t width, uint64_t height, int imageSize, int numSourceImages)
+{
+	const double scale = imageSize > 0 ? std::min(1.0, static_cast<double>(imageSize) / std::max(width, height)) : 1.0;
+	const uint64_t pixels = static_cast<uint64_t>(width * scale) * static_cast<uint64_t>(height * scale);
+	return (1 + static_cast<uint64_t>(std::max(numSourceImages, 0))) * pixels * bytesPerPixel;
+}
+
+uint64_t DenseResourcePlanner::getAvailableMemory()
+{
+	MEMORYSTATUSEX memoryStatus;
+	memoryStatus.dwLength = sizeof(memoryStatus);
+	if (!GlobalMemoryStatusEx(&memoryStatus))
+	{
+		return 0;
+	}
+	return memoryStatus.ullAvailPhys;
+}
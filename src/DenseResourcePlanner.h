@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+class ColmapModel;
+
+namespace Resources
+{
+	struct Options
+	{
+		Options() {};
+		Options(double memoryBudget, int numSourceImages) : memoryBudget(memoryBudget), numSourceImages(numSourceImages) {};
+		// GB of RAM for the dense stage, 0 uses 75% of the free physical memory when it starts
+		double memoryBudget = 0;
+		// Images loaded with each reference image by patch match and fusion
+		int numSourceImages = 20;
+
+		std::string print() const;
+	};
+
+	struct Plan
+	{
+		// max_image_size of the undistortion, patch match and fusion, -1 keeps the images size
+		int imageSize = -1;
+		// Dense clusters processed at the same time
+		int numWorkers = 1;
+		// GB each worker may use, passed as the cache_size of patch match and fusion
+		double cacheSize = 0;
+		// Estimated bytes of one worker with imageSize
+		uint64_t workerBytes = 0;
+		uint64_t budgetBytes = 0;
+		std::string reason;
+
+		std::string print() const;
+	};
+}
+
+// Chooses the image size and the number of dense workers that fit the memory budget. The quality size is kept
+// while possible: the workers are reduced first and the images are only downscaled when one worker doesn't fit.
+class DenseResourcePlanner
+{
+public:
+	// qualityImageSize is the max_image_size of the dense quality (-1 for none), maxWorkers the configured workers
+	static Resources::Plan plan(const ColmapModel& model, int qualityImageSize, int maxWorkers, const Resources::Options& options);
+
+	// Bytes of the images, depth and normal maps of a reference image and its sources
+	static uint64_t estimateWorkerBytes(uint64_t width, uint64_t height, int imageSize, int numSourceImages);
+
+	// Free physical memory in bytes, 0 if unknown
+	static uint64_t getAvailableMemory();
+};
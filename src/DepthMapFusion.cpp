@@ -0,0 +1,402 @@
+#include "DepthMapFusion.h"
+
+#include <sstream>
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/Dense>
+
+#include <wx/image.h>
+#include <wx/log.h>
+
+#include "ColmapModel.h"
+#include "DenseMap.h"
+#include "PlyIO.h"
+#include "Tracer.h"
+#include "ProgressModel.h"
+#include "Cancellation.h"
+
+namespace
+{
+	struct ViewMaps
+	{
+		DenseMap depth;
+		DenseMap normal;
+	};
+
+	// Least recently used maps, only accessed by the thread that drives the fusion
+	class MapCache
+	{
+	public:
+		MapCache(const std::string& stereoPath, const std::string& inputType, size_t maxBytes) :
+			stereoPath(stereoPath), inputType(inputType), maxBytes(maxBytes) {};
+
+		// nullptr if the maps of the image are missing or don't match
+		std::shared_ptr<const ViewMaps> get(const std::string& imageName)
+		{
+			const auto cached = entries.find(imageName);
+			if (cached != entries.end())
+			{
+				order.splice(order.begin(), order, cached->second);
+				return cached->second->second;
+			}
+			auto maps = std::make_shared<ViewMaps>();
+			const std::string fileName = imageName + "." + inputType + ".bin";
+			if (!maps->depth.read(stereoPath + "/depth_maps/" + fileName) || !maps->normal.read(stereoPath + "/normal_maps/" + fileName) ||
+				maps->depth.channels != 1 || maps->normal.channels != 3 ||
+				maps->depth.width != maps->normal.width || maps->depth.height != maps->normal.height)
+			{
+				maps = nullptr;
+			}
+			order.emplace_front(imageName, maps);
+			entries[imageName] = order.begin();
+			bytes += getBytes(maps);
+			//The maps in use are kept alive by their shared_ptr
+			while (bytes > maxBytes && order.size() > 1)
+			{
+				bytes -= getBytes(order.back().second);
+				entries.erase(order.back().first);
+				order.pop_back();
+			}
+			return maps;
+		}
+
+	private:
+		std::string stereoPath;
+		std::string inputType;
+		size_t maxBytes;
+		size_t bytes = 0;
+		std::list<std::pair<std::string, std::shared_ptr<const ViewMaps>>> order;
+		std::unordered_map<std::string, std::list<std::pair<std::string, std::shared_ptr<const ViewMaps>>>::iterator> entries;
+
+		static size_t getBytes(const std::shared_ptr<const ViewMaps>& maps)
+		{
+			return maps ? (maps->depth.data.size() + maps->normal.data.size()) * sizeof(float) : 0;
+		}
+	};
+
+	// Pose and intrinsics of an undistorted (pinhole) image, scaled to the size of its maps when used
+	struct View
+	{
+		std::string name;
+		Eigen::Matrix3f rotation;
+		Eigen::Vector3f translation;
+		float focal[2];
+		float principalPoint[2];
+		int width;
+		int height;
+		std::vector<int> neighbors;
+	};
+
+	struct Projection
+	{
+		float fx, fy, cx, cy;
+
+		Projection(const View& view, const DenseMap& map)
+		{
+			const float scaleX = static_cast<float>(map.width) / view.width;
+			const float scaleY = static_cast<float>(map.height) / view.height;
+			fx = view.focal[0] * scaleX;
+			fy = view.focal[1] * scaleY;
+			cx = view.principalPoint[0] * scaleX;
+			cy = view.principalPoint[1] * scaleY;
+		}
+	};
+
+	// Consistent views of a pixel of the reference image
+	struct Accumulator
+	{
+		Eigen::Vector3f position;
+		Eigen::Vector3f normal;
+		Eigen::Vector3f positionSum;
+		Eigen::Vector3f normalSum;
+		int count = 0;
+		// Consistent with a pixel an image fused before already made a point of
+		bool fused = false;
+	};
+
+	// One bit per pixel of the maps of an image
+	bool getBit(const std::vector<uint64_t>& mask, size_t index)
+	{
+		return !mask.empty() && ((mask[index >> 6] >> (index & 63)) & 1) != 0;
+	}
+
+	bool readViews(const std::string& sparsePath, int checkNumImages, std::vector<View>& views)
+	{
+		ColmapModel model;
+		if (!model.read(sparsePath))
+		{
+			return 0;
+		}
+		std::unordered_map<uint32_t, int> viewIndices;
+		for (const auto& image : model.images)
+		{
+			const auto camera = model.cameras.find(image.second.cameraId);
+			if (camera == model.cameras.end())
+			{
+				continue;
+			}
+			View view;
+			view.name = image.second.name;
+			const Eigen::Matrix4d matrixRt = ColmapModel::getMatrixRt(image.second);
+			view.rotation = matrixRt.block<3, 3>(0, 0).cast<float>();
+			view.translation = matrixRt.block<3, 1>(0, 3).cast<float>();
+			double focal[2], principalPoint[2];
+			ColmapModel::getFocalAndPrincipalPoint(camera->second, focal, principalPoint);
+			for (int i = 0; i < 2; i++)
+			{
+				view.focal[i] = static_cast<float>(focal[i]);
+				view.principalPoint[i] = static_cast<float>(principalPoint[i]);
+			}
+			view.width = static_cast<int>(camera->second.width);
+			view.height = static_cast<int>(camera->second.height);
+			viewIndices[image.first] = static_cast<int>(views.size());
+			views.emplace_back(view);
+		}
+		//Neighbors by the number of shared sparse points
+		const auto covisibleImages = model.getCovisibleImages(static_cast<size_t>(std::max(checkNumImages, 0)));
+		for (const auto& image : covisibleImages)
+		{
+			const auto viewIndex = viewIndices.find(image.first);
+			if (viewIndex == viewIndices.end())
+			{
+				continue;
+			}
+			for (const auto imageId : image.second)
+			{
+				const auto neighborIndex = viewIndices.find(imageId);
+				if (neighborIndex != viewIndices.end())
+				{
+					views[viewIndex->second].neighbors.emplace_back(neighborIndex->second);
+				}
+			}
+		}
+		return 1;
+	}
+}
+
+std::string Fusion::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Native " << native << "\n" <<
+		"Min num pixels " << minNumPixels << "\n" <<
+		"Max reprojection error " << maxReprojError << "\n" <<
+		"Max depth error " << maxDepthError << "\n" <<
+		"Max normal error " << maxNormalError << "\n" <<
+		"Cache size " << cacheSize << "\n" <<
+		"Check num images " << checkNumImages << "\n";
+	return parameters.str();
+}
+
+bool DepthMapFusion::fuse(const std::string& workspacePath, const std::string& inputType, const std::string& outputPath,
+	const Fusion::Options& options)
+{
+	Tracer::Span span("Fusion", "native", workspacePath);
+	std::vector<View> views;
+	if (!readViews(workspacePath + "/sparse", options.checkNumImages, views))
+	{
+		wxLogError("Error reading the sparse model of the dense workspace");
+		return 0;
+	}
+	PlyIO::StreamWriter writer;
+	if (!writer.open(outputPath, true, true))
+	{
+		return 0;
+	}
+	MapCache cache(workspacePath + "/stereo", inputType, static_cast<size_t>(std::max(options.cacheSize, 0.0) * 1024 * 1024 * 1024));
+	const float minNormalCos = static_cast<float>(std::cos(options.maxNormalError * 3.14159265358979323846 / 180));
+	const float maxDepthError = static_cast<float>(options.maxDepthError);
+	const float maxSquaredReprojError = static_cast<float>(options.maxReprojError * options.maxReprojError);
+	const int rowsPerTile = 64;
+	std::vector<Accumulator> accumulators;
+	//Pixels of each image fused in a point, a bit each (250 MB for 1000 maps of 2 Mpx)
+	std::vector<std::vector<uint64_t>> fusedPixels(views.size());
+	int numFusedViews = 0;
+	for (int r = 0; r < static_cast<int>(views.size()); r++)
+	{
+		if (Cancellation::isCancelled())
+		{
+			wxLogError("Fusion stopped: %s", Cancellation::getReason());
+			return 0;
+		}
+		const View& reference = views[r];
+		Tracer::Span imageSpan("Fuse image", "native", reference.name);
+		ProgressModel::reportStep("fusion", r, views.size());
+		const auto referenceMaps = cache.get(reference.name);
+		if (!referenceMaps)
+		{
+			continue;
+		}
+		const DenseMap& depth = referenceMaps->depth;
+		const DenseMap& normal = referenceMaps->normal;
+		const int width = depth.width, height = depth.height;
+		const Projection projection(reference, depth);
+		const Eigen::Matrix3f referenceRotationT = reference.rotation.transpose();
+		accumulators.assign(static_cast<size_t>(width) * height, Accumulator());
+		//Points of the reference pixels
+#pragma omp parallel for schedule(static)
+		for (int row = 0; row < height; row++)
+		{
+			for (int col = 0; col < width; col++)
+			{
+				const float d = depth.at(row, col);
+				if (d <= 0)
+				{
+					continue;
+				}
+				Accumulator& accumulator = accumulators[static_cast<size_t>(row) * width + col];
+				const Eigen::Vector3f cameraPoint((col - projection.cx) / projection.fx * d, (row - projection.cy) / projection.fy * d, d);
+				accumulator.position = referenceRotationT * (cameraPoint - reference.translation);
+				accumulator.normal = referenceRotationT * Eigen::Vector3f(normal.at(row, col, 0), normal.at(row, col, 1), normal.at(row, col, 2));
+				accumulator.positionSum = accumulator.position;
+				accumulator.normalSum = accumulator.normal;
+				accumulator.count = 1;
+			}
+		}
+		//One neighbor at a time, so only its maps are needed besides the reference ones
+		for (const int n : reference.neighbors)
+		{
+			const View& neighbor = views[n];
+			const auto neighborMaps = cache.get(neighbor.name);
+			if (!neighborMaps)
+			{
+				continue;
+			}
+			const DenseMap& neighborDepth = neighborMaps->depth;
+			const DenseMap& neighborNormal = neighborMaps->normal;
+			const Projection neighborProjection(neighbor, neighborDepth);
+			const Eigen::Matrix3f neighborRotationT = neighbor.rotation.transpose();
+			const std::vector<uint64_t>& neighborFused = fusedPixels[n];
+#pragma omp parallel for schedule(static)
+			for (int row = 0; row < height; row++)
+			{
+				for (int col = 0; col < width; col++)
+				{
+					Accumulator& accumulator = accumulators[static_cast<size_t>(row) * width + col];
+					if (accumulator.count == 0 || accumulator.fused)
+					{
+						continue;
+					}
+					//Depth of the reference point in the neighbor
+					const Eigen::Vector3f neighborPoint = neighbor.rotation * accumulator.position + neighbor.translation;
+					if (neighborPoint.z() <= 0)
+					{
+						continue;
+					}
+					const int neighborCol = static_cast<int>(std::round(neighborProjection.fx * neighborPoint.x() / neighborPoint.z() + neighborProjection.cx));
+					const int neighborRow = static_cast<int>(std::round(neighborProjection.fy * neighborPoint.y() / neighborPoint.z() + neighborProjection.cy));
+					if (neighborCol < 0 || neighborRow < 0 || neighborCol >= neighborDepth.width || neighborRow >= neighborDepth.height)
+					{
+						continue;
+					}
+					const float neighborD = neighborDepth.at(neighborRow, neighborCol);
+					if (neighborD <= 0 || std::abs(neighborPoint.z() - neighborD) > maxDepthError * neighborD)
+					{
+						continue;
+					}
+					//Point of the neighbor pixel back in the reference
+					const Eigen::Vector3f neighborPixelPoint((neighborCol - neighborProjection.cx) / neighborProjection.fx * neighborD,
+						(neighborRow - neighborProjection.cy) / neighborProjection.fy * neighborD, neighborD);
+					const Eigen::Vector3f worldPoint = neighborRotationT * (neighborPixelPoint - neighbor.translation);
+					const Eigen::Vector3f referencePoint = reference.rotation * worldPoint + reference.translation;
+					if (referencePoint.z() <= 0)
+					{
+						continue;
+					}
+					const float errorX = projection.fx * referencePoint.x() / referencePoint.z() + projection.cx - col;
+					const float errorY = projection.fy * referencePoint.y() / referencePoint.z() + projection.cy - row;
+					if (errorX * errorX + errorY * errorY > maxSquaredReprojError)
+					{
+						continue;
+					}
+					const Eigen::Vector3f worldNormal = neighborRotationT * Eigen::Vector3f(neighborNormal.at(neighborRow, neighborCol, 0),
+						neighborNormal.at(neighborRow, neighborCol, 1), neighborNormal.at(neighborRow, neighborCol, 2));
+					if (accumulator.normal.dot(worldNormal) < minNormalCos)
+					{
+						continue;
+					}
+					//The surface was already written by the neighbor
+					if (getBit(neighborFused, static_cast<size_t>(neighborRow) * neighborDepth.width + neighborCol))
+					{
+						accumulator.fused = true;
+						continue;
+					}
+					accumulator.positionSum += worldPoint;
+					accumulator.normalSum += worldNormal;
+					accumulator.count++;
+				}
+			}
+		}
+		//Colors of the undistorted image, sampled at the map resolution
+		wxImage image;
+		const bool hasImage = image.LoadFile(workspacePath + "/images/" + reference.name) && image.IsOk();
+		const unsigned char* rgb = hasImage ? image.GetData() : nullptr;
+		const int imageWidth = hasImage ? image.GetWidth() : 0, imageHeight = hasImage ? image.GetHeight() : 0;
+		//Points of the tiles, appended in order so the output doesn't depend on the threads
+		const int numTiles = (height + rowsPerTile - 1) / rowsPerTile;
+		std::vector<std::vector<float>> tilePositions(numTiles), tileNormals(numTiles);
+		std::vector<std::vector<unsigned char>> tileColors(numTiles);
+#pragma omp parallel for schedule(dynamic)
+		for (int t = 0; t < numTiles; t++)
+		{
+			for (int row = t * rowsPerTile; row < std::min(height, (t + 1) * rowsPerTile); row++)
+			{
+				for (int col = 0; col < width; col++)
+				{
+					const Accumulator& accumulator = accumulators[static_cast<size_t>(row) * width + col];
+					if (accumulator.count < options.minNumPixels || accumulator.fused)
+					{
+						continue;
+					}
+					const Eigen::Vector3f position = accumulator.positionSum / static_cast<float>(accumulator.count);
+					const Eigen::Vector3f pointNormal = accumulator.normalSum.normalized();
+					for (int i = 0; i < 3; i++)
+					{
+						tilePositions[t].emplace_back(position[i]);
+						tileNormals[t].emplace_back(pointNormal[i]);
+					}
+					if (rgb)
+					{
+						const int x = std::min(imageWidth - 1, col * imageWidth / width);
+						const int y = std::min(imageHeight - 1, row * imageHeight / height);
+						const unsigned char* pixel = rgb + (static_cast<size_t>(y) * imageWidth + x) * 3;
+						tileColors[t].insert(tileColors[t].end(), pixel, pixel + 3);
+					}
+					else
+					{
+						tileColors[t].insert(tileColors[t].end(), 3, 0);
+					}
+				}
+			}
+		}
+		for (int t = 0; t < numTiles; t++)
+		{
+			if (!writer.append(tilePositions[t], tileNormals[t], tileColors[t]))
+			{
+				return 0;
+			}
+		}
+		//The images fused after this one skip the points consistent with these pixels
+		auto& fused = fusedPixels[r];
+		fused.assign((static_cast<size_t>(width) * height + 63) / 64, 0);
+		for (size_t i = 0; i < accumulators.size(); i++)
+		{
+			if (accumulators[i].count >= options.minNumPixels && !accumulators[i].fused)
+			{
+				fused[i >> 6] |= uint64_t(1) << (i & 63);
+			}
+		}
+		numFusedViews++;
+	}
+	const size_t numPoints = writer.getNumVertices();
+	if (!writer.close())
+	{
+		return 0;
+	}
+	wxLogInfo(wxString("Fused " + std::to_string(numPoints) + " points from " + std::to_string(numFusedViews) + " of " +
+		std::to_string(views.size()) + " images"));
+	return numFusedViews > 0;
+}
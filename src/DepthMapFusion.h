@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+namespace Fusion
+{
+	struct Options
+	{
+		Options() {};
+		Options(bool native, int minNumPixels, double maxReprojError, double maxDepthError, double maxNormalError, double cacheSize) :
+			native(native), minNumPixels(minNumPixels), maxReprojError(maxReprojError), maxDepthError(maxDepthError),
+			maxNormalError(maxNormalError), cacheSize(cacheSize) {};
+		// Fuse with DepthMapFusion instead of COLMAP stereo_fusion
+		bool native = true;
+		// Consistent views, the reference included, needed to create a point
+		int minNumPixels = 5;
+		// Pixels
+		double maxReprojError = 2;
+		// Relative to the depth
+		double maxDepthError = 0.01;
+		// Degrees
+		double maxNormalError = 10;
+		// GB of depth and normal maps kept in memory
+		double cacheSize = 4;
+		// Most covisible images checked against each reference image, set from the dense quality
+		int checkNumImages = 50;
+
+		std::string print() const;
+	};
+}
+
+// Fusion of the depth and normal maps of a COLMAP dense workspace in a point cloud.
+// The reference images are fused one at a time with their rows in parallel, the maps of the neighbor images are
+// read when needed through a cache of Options::cacheSize and the points are streamed to the PLY.
+// The pixels of each image that made a point are marked, and a later image skips the points consistent with a marked
+// pixel of its neighbors, so the surface seen by several images isn't repeated. A point is only skipped when it was
+// written, whatever the neighbors list or the views the other image found.
+class DepthMapFusion
+{
+public:
+	// inputType is "geometric" or "photometric", as in COLMAP
+	static bool fuse(const std::string& workspacePath, const std::string& inputType, const std::string& outputPath,
+		const Fusion::Options& options);
+};
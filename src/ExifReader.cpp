@@ -0,0 +1,212 @@
+#include "ExifReader.h"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+
+namespace
+{
+	const double earthRadius = 6378137.0;
+	const double pi = 3.14159265358979323846;
+
+	class TIFFReader
+	{
+	public:
+		TIFFReader(const unsigned char* data, size_t size, bool littleEndian) :
+			data(data), size(size), littleEndian(littleEndian) {};
+
+		bool valid(size_t offset, size_t length) const
+		{
+			return offset <= size && length <= size - offset;
+		}
+		uint16_t get16(size_t offset) const
+		{
+			return littleEndian ? static_cast<uint16_t>(data[offset] | (data[offset + 1] << 8)) :
+				static_cast<uint16_t>((data[offset] << 8) | data[offset + 1]);
+		}
+		uint32_t get32(size_t offset) const
+		{
+			return littleEndian ?
+				static_cast<uint32_t>(data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | (static_cast<uint32_t>(data[offset + 3]) << 24)) :
+				static_cast<uint32_t>((static_cast<uint32_t>(data[offset]) << 24) | (data[offset + 1] << 16) | (data[offset + 2] << 8) | data[offset + 3]);
+		}
+		// Offset of the value of an IFD entry, 0 if not found or invalid
+		size_t findEntry(size_t ifdOffset, uint16_t tag, uint32_t& count) const
+		{
+			if (!valid(ifdOffset, 2))
+			{
+				return 0;
+			}
+			const uint16_t numEntries = get16(ifdOffset);
+			for (uint16_t i = 0; i < numEntries; i++)
+			{
+				const size_t entry = ifdOffset + 2 + i * 12;
+				if (!valid(entry, 12))
+				{
+					return 0;
+				}
+				if (get16(entry) != tag)
+				{
+					continue;
+				}
+				const uint16_t type = get16(entry + 2);
+				count = get32(entry + 4);
+				// BYTE, ASCII, SHORT, LONG, RATIONAL
+				const size_t typeSize = (type == 1 || type == 2 || type == 7) ? 1 : (type == 3 ? 2 : (type == 4 ? 4 : 8));
+				const size_t valueSize = typeSize * count;
+				const size_t valueOffset = valueSize <= 4 ? entry + 8 : get32(entry + 8);
+				return valid(valueOffset, valueSize) ? valueOffset : 0;
+			}
+			return 0;
+		}
+		double getRational(size_t offset) const
+		{
+			const uint32_t denominator = get32(offset + 4);
+			return denominator == 0 ? 0 : static_cast<double>(get32(offset)) / denominator;
+		}
+		const unsigned char* at(size_t offset) const
+		{
+			return data + offset;
+		}
+
+	private:
+		const unsigned char* data;
+		size_t size;
+		bool littleEndian;
+	};
+
+	// Days from 1970-01-01 of a civil date
+	long long daysFromCivil(int year, int month, int day)
+	{
+		year -= month <= 2;
+		const long long era = (year >= 0 ? year : year - 399) / 400;
+		const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+		const unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+		const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+		return era * 146097 + static_cast<long long>(dayOfEra) - 719468;
+	}
+}
+
+bool ExifReader::read(const std::string& imagePath, ExifData& exif)
+{
+	std::ifstream file(imagePath, std::ios::binary);
+	if (!file.good())
+	{
+		return 0;
+	}
+	unsigned char marker[4];
+	if (!file.read(reinterpret_cast<char*>(marker), 2) || marker[0] != 0xFF || marker[1] != 0xD8)
+	{
+		return 0;
+	}
+	//Walk the segments until the APP1 Exif one, it comes before the image data
+	while (file.read(reinterpret_cast<char*>(marker), 4))
+	{
+		if (marker[0] != 0xFF)
+		{
+			return 0;
+		}
+		const size_t segmentSize = (marker[2] << 8) | marker[3];
+		if (segmentSize < 2 || marker[1] == 0xDA)
+		{
+			return 0;
+		}
+		if (marker[1] == 0xE1)
+		{
+			std::vector<unsigned char> segment(segmentSize - 2);
+			if (!file.read(reinterpret_cast<char*>(segment.data()), segment.size()))
+			{
+				return 0;
+			}
+			if (segment.size() > 6 && std::memcmp(segment.data(), "Exif\0\0", 6) == 0)
+			{
+				return parseTIFF(segment.data() + 6, segment.size() - 6, exif);
+			}
+		}
+		else
+		{
+			file.seekg(segmentSize - 2, std::ios::cur);
+		}
+	}
+	return 0;
+}
+
+bool ExifReader::parseTIFF(const unsigned char* data, size_t size, ExifData& exif)
+{
+	if (size < 8 || !((data[0] == 'I' && data[1] == 'I') || (data[0] == 'M' && data[1] == 'M')))
+	{
+		return 0;
+	}
+	const TIFFReader tiff(data, size, data[0] == 'I');
+	if (tiff.get16(2) != 42)
+	{
+		return 0;
+	}
+	const size_t ifd0 = tiff.get32(4);
+	uint32_t count = 0;
+	//Capture time
+	const size_t exifIFDEntry = tiff.findEntry(ifd0, 0x8769, count);
+	if (exifIFDEntry)
+	{
+		const size_t dateTime = tiff.findEntry(tiff.get32(exifIFDEntry), 0x9003, count);
+		if (dateTime && count >= 19)
+		{
+			//YYYY:MM:DD HH:MM:SS
+			const std::string text(reinterpret_cast<const char*>(tiff.at(dateTime)), 19);
+			int year, month, day, hour, minute, second;
+			if (sscanf(text.c_str(), "%d:%d:%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second) == 6 && month >= 1 && month <= 12)
+			{
+				exif.captureTime = daysFromCivil(year, month, day) * 86400.0 + hour * 3600.0 + minute * 60.0 + second;
+				exif.hasCaptureTime = true;
+			}
+		}
+	}
+	//GPS
+	const size_t gpsIFDEntry = tiff.findEntry(ifd0, 0x8825, count);
+	if (gpsIFDEntry)
+	{
+		const size_t gpsIFD = tiff.get32(gpsIFDEntry);
+		uint32_t latitudeCount = 0, longitudeCount = 0, refCount = 0;
+		const size_t latitudeRef = tiff.findEntry(gpsIFD, 0x0001, refCount);
+		const size_t latitude = tiff.findEntry(gpsIFD, 0x0002, latitudeCount);
+		const size_t longitudeRef = tiff.findEntry(gpsIFD, 0x0003, refCount);
+		const size_t longitude = tiff.findEntry(gpsIFD, 0x0004, longitudeCount);
+		if (latitude && longitude && latitudeCount == 3 && longitudeCount == 3)
+		{
+			exif.latitude = tiff.getRational(latitude) + tiff.getRational(latitude + 8) / 60.0 + tiff.getRational(latitude + 16) / 3600.0;
+			exif.longitude = tiff.getRational(longitude) + tiff.getRational(longitude + 8) / 60.0 + tiff.getRational(longitude + 16) / 3600.0;
+			if (latitudeRef && *tiff.at(latitudeRef) == 'S')
+			{
+				exif.latitude = -exif.latitude;
+			}
+			if (longitudeRef && *tiff.at(longitudeRef) == 'W')
+			{
+				exif.longitude = -exif.longitude;
+			}
+			exif.hasGPS = true;
+			const size_t altitudeRef = tiff.findEntry(gpsIFD, 0x0005, count);
+			const size_t altitude = tiff.findEntry(gpsIFD, 0x0006, count);
+			if (altitude)
+			{
+				exif.altitude = tiff.getRational(altitude);
+				if (altitudeRef && *tiff.at(altitudeRef) == 1)
+				{
+					exif.altitude = -exif.altitude;
+				}
+			}
+		}
+	}
+	return exif.hasGPS || exif.hasCaptureTime;
+}
+
+void ExifReader::toLocalMeters(const ExifData& exif, double referenceLatitude, double referenceLongitude, double xyz[3])
+{
+	//Equirectangular projection, good enough for the extent of a capture
+	const double toRadians = pi / 180.0;
+	xyz[0] = (exif.longitude - referenceLongitude) * toRadians * earthRadius * std::cos(referenceLatitude * toRadians);
+	xyz[1] = (exif.latitude - referenceLatitude) * toRadians * earthRadius;
+	xyz[2] = exif.altitude;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+struct ExifData
+{
+	bool hasGPS = false;
+	// Degrees, negative for south and west
+	double latitude = 0;
+	double longitude = 0;
+	// Meters above the sea level
+	double altitude = 0;
+	bool hasCaptureTime = false;
+	// Seconds of DateTimeOriginal counted from 1970-01-01, without time zone
+	double captureTime = 0;
+};
+
+// Minimal EXIF reader for the GPS and capture time tags of JPEG files
+class ExifReader
+{
+public:
+	static bool read(const std::string& imagePath, ExifData& exif);
+
+	// Parse the APP1 segment content, starting at the TIFF header
+	static bool parseTIFF(const unsigned char* data, size_t size, ExifData& exif);
+
+	// Local metric frame (x east, y north, z up) around a reference latitude/longitude
+	static void toLocalMeters(const ExifData& exif, double referenceLatitude, double referenceLongitude, double xyz[3]);
+};
@@ -1,22 +1,51 @@
 #include "HelperCOLMAP.h"
 
 #include <fstream>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
 
 #include <wx/log.h>
 #include <wx/dir.h>
+#include <wx/filename.h>
 
 #include "ConfigurationDialog.h"
+#include "ColmapModel.h"
+#include "ColmapModelMerger.h"
 #include "ImageIO.h"
+#include "DepthMapFusion.h"
+#include "DenseResourcePlanner.h"
+#include "MatchingPlanner.h"
+#include "PlaneSweepStereo.h"
+#include "PlyIO.h"
+#include "QualityPresets.h"
+#include "StageBudget.h"
+#include "StageRunner.h"
+#include "WorkspaceIndex.h"
+#include "SpatialPartition.h"
 #include "Utils.h"
+#include "Tracer.h"
+
+namespace
+{
+	const char* colmapTool = "COLMAP/COLMAP.bat";
+
+	//Optional, the vocabulary tree matching is skipped without it
+	std::string getVocabTreePath()
+	{
+		return Utils::getExecutionPath() + "/COLMAP/vocab_tree.bin";
+	}
+}
 
 bool HelperCOLMAP::modelConverter(std::string inputPath, std::string outputPath, std::string outputType)
 {
-	std::string colmapParameters(Utils::preparePath(Utils::getExecutionPath() + "/COLMAP/COLMAP.bat") +
-		" model_converter --input_path=" + Utils::preparePath(inputPath) +
+	std::string colmapParameters(" model_converter --input_path=" + Utils::preparePath(inputPath) +
 		" --output_path=" + Utils::preparePath(outputPath) +
 		" --output_type=" + Utils::preparePath(outputType)
 	);
-	if (!Utils::startProcess(colmapParameters))
+	if (!StageRunner::get()->run(colmapTool, colmapParameters))
 	{
 		wxLogError("Error with COLMAP model converter");
 		return 0;
@@ -29,18 +58,52 @@ bool HelperCOLMAP::modelConverter(std::string inputPath, std::string outputPath,
 	return 1;
 }
 
-bool HelperCOLMAP::executeSparse(std::string imagesPath, std::string nvmPath)
+bool HelperCOLMAP::executeSparse(std::string imagesPath, std::string nvmPath, Matching::Plan& matchingPlan)
 {
-	std::string colmapParameters(Utils::preparePath(Utils::getExecutionPath() + "/COLMAP/COLMAP.bat") +
-		" automatic_reconstructor --image_path=" + Utils::preparePath(imagesPath) +
-		" --workspace_path=" + Utils::preparePath(Utils::getPath(nvmPath, false)) +
-		" --quality=" + ConfigurationDialog::getSparseQuality() +
-		" --use_gpu=" + ConfigurationDialog::getUseGPU() +
-		" --dense=0"
-	);
-	if (!Utils::startProcess(colmapParameters))
+	const std::string workspacePath = Utils::getPath(nvmPath, false);
+	const auto bundlePath = nvmPath.substr(0, nvmPath.find_last_of('.')) + ".scb";
+	//A retained workspace keeps the model of the same images and parameters
+	WorkspaceIndex index(workspacePath + "/workspace_index.json");
+	const auto sparseQuality = ConfigurationDialog::getQualityPreset().sparse;
+	const std::string sparseKey = WorkspaceIndex::fingerprintDirectory(imagesPath) + "\n" + std::to_string(sparseQuality.maxImageSize) + " " +
+		std::to_string(sparseQuality.maxNumFeatures) + "\n" +
+		ConfigurationDialog::getMatchingOptions().print() + std::to_string(ConfigurationDialog::getPartitionOptions().maxImages) + " " +
+		std::to_string(ConfigurationDialog::getPartitionOptions().overlap);
+	if (index.isValid("sparse", sparseKey) && Utils::exists(nvmPath) && Utils::exists(bundlePath) &&
+		Utils::exists(workspacePath + "/sparse/0/cameras.bin"))
+	{
+		wxLogInfo("Reusing the sparse model of %s", workspacePath);
+		return 1;
+	}
+	index.invalidate("sparse");
+	const std::string databasePath = workspacePath + "/database.db";
+	if (Utils::exists(databasePath))
+	{
+		Utils::RemoveFile(databasePath);
+	}
+	if (!executeFeatureExtractor(imagesPath, databasePath))
+	{
+		return 0;
+	}
+	const auto images = MatchPairGenerator::readImages(imagesPath);
+	matchingPlan = MatchingPlanner::plan(images, ConfigurationDialog::getMatchingOptions(), getVocabTreePath());
+	const std::string pairsPath = workspacePath + "/match_pairs.txt";
+	if (!matchingPlan.pairs.empty() && !MatchPairGenerator::writePairs(pairsPath, images, matchingPlan.pairs))
+	{
+		wxLogError("Error writing the match pairs");
+		return 0;
+	}
+	const auto matchingStart = std::chrono::steady_clock::now();
+	if (!executeMatcher(databasePath, matchingPlan, pairsPath))
+	{
+		return 0;
+	}
+	matchingPlan.measuredSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - matchingStart).count();
+	//Models of a previous run would be mixed with the new ones
+	wxFileName::Rmdir(workspacePath + "/sparse", wxPATH_RMDIR_RECURSIVE);
+	wxFileName::Rmdir(workspacePath + "/sparse_parts", wxPATH_RMDIR_RECURSIVE);
+	if (!executePartitionedMapper(imagesPath, databasePath, workspacePath, images))
 	{
-		wxLogError("Error with COLMAP sparse");
 		return 0;
 	}
 	std::string camerasBinPath = Utils::getPath(nvmPath, false);
@@ -56,55 +119,503 @@ bool HelperCOLMAP::executeSparse(std::string imagesPath, std::string nvmPath)
 		return 0;
 	}
 	ImageIO::replaceCamerasFileImageDir(nvmPath, imagesPath);
+	//Binary camera bundle, read by the next stages without parsing text
+	if (!ImageIO::convertCOLMAPModel(Utils::getPath(nvmPath, false) + "/sparse/0", imagesPath, bundlePath))
+	{
+		wxLogError("Error creating the camera bundle");
+		return 0;
+	}
+	index.setValid("sparse", sparseKey);
 	return 1;
 }
 
-bool HelperCOLMAP::executeDense(std::string imagesPath, std::string tempDir, std::string pointCloudOutputPath)
+bool HelperCOLMAP::executeDense(std::string imagesPath, std::string sparsePath, std::string workspacePath, std::string pointCloudOutputPath,
+	bool keepWorkspace)
 {
-	if (!executeImageUndistorter(imagesPath, tempDir + "/sparse/0", tempDir + "/dense", "COLMAP"))
+	const auto options = ConfigurationDialog::getPartitionOptions();
+	ColmapModel model;
+	if (!model.read(sparsePath))
 	{
+		wxLogError("Error reading the sparse model");
 		return 0;
 	}
-	if (!executePatchMachStereo(tempDir + "/dense", "COLMAP"))
+	//Image size and workers that fit the memory budget
+	const bool clustered = model.images.size() > static_cast<size_t>(std::max(options.denseMaxImages, 1));
+	//A queued job plans with the memory its stage holds instead of the free memory
+	auto resourceOptions = ConfigurationDialog::getResourceOptions();
+	if (resourceOptions.memoryBudget <= 0 && StageBudget::getHeld().memory > 0)
+	{
+		resourceOptions.memoryBudget = StageBudget::getHeld().memory;
+	}
+	const auto resourcePlan = DenseResourcePlanner::plan(model, ConfigurationDialog::getQualityPreset().dense.maxImageSize,
+		clustered ? options.denseMaxWorkers : 1, resourceOptions);
+	wxLogInfo(wxString("Dense resources: " + resourcePlan.print()));
+	if (!clustered)
+	{
+		return executeDenseWorkspace(imagesPath, sparsePath, workspacePath, pointCloudOutputPath, resourcePlan);
+	}
+	//Clusters of the registered cameras
+	std::vector<uint32_t> imageIds;
+	std::vector<Eigen::Vector3d> centers;
+	for (const auto& image : model.images)
+	{
+		imageIds.emplace_back(image.first);
+		centers.emplace_back(ColmapModel::getCameraCenter(image.second));
+	}
+	const auto clusters = SpatialPartition::partition(centers, std::max(options.denseMaxImages, 1), options.overlap);
+	const std::string partsPath = workspacePath + "/clusters";
+	if (!wxDirExists(partsPath))
+	{
+		wxMkdir(partsPath);
+	}
+	std::vector<std::string> pointCloudPaths(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const std::string clusterPath = partsPath + "/" + std::to_string(c);
+		std::vector<uint32_t> clusterImageIds;
+		for (const auto index : clusters[c].indices)
+		{
+			clusterImageIds.emplace_back(imageIds[index]);
+		}
+		if ((!wxDirExists(clusterPath) && !wxMkdir(clusterPath)) || (!wxDirExists(clusterPath + "/sparse") && !wxMkdir(clusterPath + "/sparse")) ||
+			(!wxDirExists(clusterPath + "/dense") && !wxMkdir(clusterPath + "/dense")) ||
+			!model.getSubModel(clusterImageIds).write(clusterPath + "/sparse"))
+		{
+			wxLogError("Error creating the dense cluster %zu", c);
+			return 0;
+		}
+		pointCloudPaths[c] = clusterPath + "/fused.ply";
+	}
+	//Without keepWorkspace each cluster keeps its own workspace only while it is processed
+	const int numWorkers = std::max(1, std::min(resourcePlan.numWorkers, static_cast<int>(clusters.size())));
+	std::vector<char> succeeded(clusters.size(), 0);
+	std::atomic<size_t> nextCluster(0);
+	auto worker = [&]()
+	{
+		for (size_t c = nextCluster++; c < clusters.size(); c = nextCluster++)
+		{
+			const std::string clusterPath = partsPath + "/" + std::to_string(c);
+			succeeded[c] = executeDenseWorkspace(imagesPath, clusterPath + "/sparse", clusterPath + "/dense", pointCloudPaths[c], resourcePlan);
+			if (!keepWorkspace)
+			{
+				wxFileName::Rmdir(clusterPath + "/dense", wxPATH_RMDIR_RECURSIVE);
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for (int i = 0; i < numWorkers; i++)
+	{
+		workers.emplace_back(worker);
+	}
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		if (!succeeded[c])
+		{
+			wxLogError("Error in the dense reconstruction of the cluster %zu", c);
+			return 0;
+		}
+	}
+	if (!mergeClusterPointClouds(pointCloudPaths, clusters, pointCloudOutputPath))
 	{
+		wxLogError("Error merging the dense point clouds");
 		return 0;
 	}
-	if (!executeStereoFusion(tempDir + "/dense", "COLMAP", pointCloudOutputPath))
+	if (!keepWorkspace)
+	{
+		wxFileName::Rmdir(partsPath, wxPATH_RMDIR_RECURSIVE);
+	}
+	return 1;
+}
+
+bool HelperCOLMAP::executeDenseWorkspace(const std::string& imagesPath, const std::string& sparsePath, const std::string& workspacePath,
+	const std::string& pointCloudOutputPath, const Resources::Plan& resourcePlan)
+{
+	Tracer::Span span("Dense workspace", "native", workspacePath);
+	//Undistorted images and depth maps are reused while the model and their parameters don't change,
+	//so a rerun that only changes the fusion goes straight to it
+	WorkspaceIndex index(workspacePath + "/workspace_index.json");
+	const std::string undistortionKey = WorkspaceIndex::fingerprintFiles({ sparsePath + "/cameras.bin", sparsePath + "/images.bin",
+		sparsePath + "/points3D.bin" }) + getImageUndistorterParameters(resourcePlan.imageSize);
+	//COLMAP patch match needs CUDA, machines without it use the CPU plane sweep
+	const auto stereoOptions = ConfigurationDialog::getStereoOptions();
+	const bool planeSweep = stereoOptions.mode == Stereo::PlaneSweep || (stereoOptions.mode == Stereo::Auto && ConfigurationDialog::getUseGPU() == "0");
+	const std::string stereoKey = undistortionKey + (planeSweep ? stereoOptions.printOutputParameters() : getPatchMatchStereoParameters(resourcePlan.imageSize));
+	if (!index.isValid("undistortion", undistortionKey))
+	{
+		index.invalidate("stereo");
+		index.invalidate("undistortion");
+		if (!executeImageUndistorter(imagesPath, sparsePath, workspacePath, "COLMAP", resourcePlan.imageSize))
+		{
+			return 0;
+		}
+		index.setValid("undistortion", undistortionKey);
+	}
+	if (!index.isValid("stereo", stereoKey))
+	{
+		index.invalidate("stereo");
+		if (planeSweep ? !PlaneSweepStereo::run(workspacePath, stereoOptions) : !executePatchMachStereo(workspacePath, "COLMAP", resourcePlan))
+		{
+			return 0;
+		}
+		index.setValid("stereo", stereoKey);
+	}
+	//The plane sweep and the lower qualities don't make the geometric consistency pass, their maps are photometric
+	const bool geometric = !planeSweep && ConfigurationDialog::getQualityPreset().dense.geomConsistency;
+	if (!executeStereoFusion(workspacePath, "COLMAP", pointCloudOutputPath, resourcePlan, geometric ? "geometric" : "photometric"))
 	{
 		return 0;
 	}
 	return 1;
 }
 
-bool HelperCOLMAP::executeImageUndistorter(const std::string imagesPath, const std::string inputPath,
-	const std::string outputPath, const std::string outputType)
+bool HelperCOLMAP::mergeClusterPointClouds(const std::vector<std::string>& pointCloudPaths, const std::vector<SpatialPartition::Cluster>& clusters,
+	const std::string& pointCloudOutputPath)
 {
-	// Quality
-	auto quality = ConfigurationDialog::getDenseQuality();
+	Tracer::Span span("Merge clusters", "native", std::to_string(clusters.size()) + " clusters");
+	//Normals and colors are only written when every cluster has them
+	bool hasNormals = true, hasColors = true;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		size_t numVertices = 0;
+		bool clusterNormals = false, clusterColors = false;
+		if (!PlyIO::readPointsHeader(pointCloudPaths[c], numVertices, clusterNormals, clusterColors))
+		{
+			wxLogError("Error reading the point cloud %s", pointCloudPaths[c]);
+			return 0;
+		}
+		hasNormals = hasNormals && clusterNormals;
+		hasColors = hasColors && clusterColors;
+	}
+	//One cluster in memory at a time
+	PlyIO::StreamWriter writer;
+	if (!writer.open(pointCloudOutputPath, hasNormals, hasColors))
+	{
+		return 0;
+	}
+	size_t numRead = 0;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		std::vector<float> clusterPositions, clusterNormals;
+		std::vector<unsigned char> clusterColors;
+		if (!PlyIO::readPoints(pointCloudPaths[c], clusterPositions, clusterNormals, clusterColors))
+		{
+			wxLogError("Error reading the point cloud %s", pointCloudPaths[c]);
+			return 0;
+		}
+		const size_t numPoints = clusterPositions.size() / 3;
+		//Kept points compacted in place
+		size_t numKept = 0;
+		for (size_t i = 0; i < numPoints; i++)
+		{
+			//The cells of the camera clusters split the scene below them too
+			const Eigen::Vector3d point(clusterPositions[3 * i], clusterPositions[3 * i + 1], clusterPositions[3 * i + 2]);
+			if (!clusters[c].contains(point))
+			{
+				continue;
+			}
+			std::copy_n(&clusterPositions[3 * i], 3, &clusterPositions[3 * numKept]);
+			if (hasNormals)
+			{
+				std::copy_n(&clusterNormals[3 * i], 3, &clusterNormals[3 * numKept]);
+			}
+			if (hasColors)
+			{
+				std::copy_n(&clusterColors[3 * i], 3, &clusterColors[3 * numKept]);
+			}
+			numKept++;
+		}
+		clusterPositions.resize(3 * numKept);
+		clusterNormals.resize(hasNormals ? 3 * numKept : 0);
+		clusterColors.resize(hasColors ? 3 * numKept : 0);
+		if (!writer.append(clusterPositions, clusterNormals, clusterColors))
+		{
+			wxLogError("Error writing the point cloud %s", pointCloudOutputPath);
+			return 0;
+		}
+		numRead += numPoints;
+	}
+	wxLogInfo("Dense clusters: %zu, %zu points merged from %zu", clusters.size(), writer.getNumVertices(), numRead);
+	return writer.close();
+}
+
+bool HelperCOLMAP::executeFeatureExtractor(const std::string& imagesPath, const std::string& databasePath)
+{
+	const auto quality = ConfigurationDialog::getQualityPreset().sparse;
+
+	std::string colmapParameters(" feature_extractor --database_path=" + Utils::preparePath(databasePath) +
+		" --image_path=" + Utils::preparePath(imagesPath) +
+		" --SiftExtraction.use_gpu=" + ConfigurationDialog::getUseGPU() +
+		" --SiftExtraction.max_num_features=" + std::to_string(quality.maxNumFeatures)
+	);
+	if (quality.maxImageSize > 0)
+	{
+		colmapParameters += " --SiftExtraction.max_image_size=" + std::to_string(quality.maxImageSize);
+	}
+	if (!StageRunner::get()->run(colmapTool, colmapParameters))
+	{
+		wxLogError("Error with COLMAP feature extractor");
+		return 0;
+	}
+	if (!Utils::exists(databasePath))
+	{
+		wxLogError("No database was created with COLMAP feature extractor");
+		return 0;
+	}
+	return 1;
+}
+
+bool HelperCOLMAP::executeMatcher(const std::string& databasePath, const Matching::Plan& matchingPlan, const std::string& pairsPath)
+{
+	std::string colmapParameters;
+	switch (matchingPlan.strategy)
+	{
+	case Matching::Sequential:
+	case Matching::Spatial:
+		//The pairs come ordered by capture time or position, not only by filename like sequential_matcher
+		colmapParameters += " matches_importer --database_path=" + Utils::preparePath(databasePath) +
+			" --match_list_path=" + Utils::preparePath(pairsPath) +
+			" --match_type=pairs";
+		break;
+	case Matching::VocabTree:
+		colmapParameters += " vocab_tree_matcher --database_path=" + Utils::preparePath(databasePath) +
+			" --VocabTreeMatching.vocab_tree_path=" + Utils::preparePath(getVocabTreePath()) +
+			" --VocabTreeMatching.num_images=" + std::to_string(ConfigurationDialog::getMatchingOptions().vocabTreeNeighbors + 1);
+		break;
+	default:
+		colmapParameters += " exhaustive_matcher --database_path=" + Utils::preparePath(databasePath);
+		break;
+	}
+
+	colmapParameters += " --SiftMatching.use_gpu=" + ConfigurationDialog::getUseGPU();
+	if (!StageRunner::get()->run(colmapTool, colmapParameters))
+	{
+		wxLogError("Error with COLMAP matcher");
+		return 0;
+	}
+	return 1;
+}
 
-	int max_image_size = -1;
+bool HelperCOLMAP::executeMapper(const std::string& imagesPath, const std::string& databasePath, const std::string& outputPath,
+	const std::string& imageListPath, int numThreads)
+{
+	std::string colmapParameters(" mapper --database_path=" + Utils::preparePath(databasePath) +
+		" --image_path=" + Utils::preparePath(imagesPath) +
+		" --output_path=" + Utils::preparePath(outputPath) +
+		" --Mapper.num_threads=" + std::to_string(numThreads)
+	);
+	if (!imageListPath.empty())
+	{
+		colmapParameters += " --image_list_path=" + Utils::preparePath(imageListPath);
+	}
+	if (!StageRunner::get()->run(colmapTool, colmapParameters))
+	{
+		wxLogError("Error with COLMAP mapper");
+		return 0;
+	}
+	return 1;
+}
 
-	if (quality == "low")
+bool HelperCOLMAP::executePartitionedMapper(const std::string& imagesPath, const std::string& databasePath, const std::string& workspacePath,
+	const std::vector<MatchPairGenerator::ImageInfo>& images)
+{
+	const auto options = ConfigurationDialog::getPartitionOptions();
+	const size_t maxImages = std::max(options.maxImages, 1);
+	if (!wxDirExists(workspacePath + "/sparse"))
+	{
+		wxMkdir(workspacePath + "/sparse");
+	}
+	if (images.size() <= maxImages || MatchPairGenerator::getGPSFraction(images) < 0.5)
+	{
+		return executeMapper(imagesPath, databasePath, workspacePath + "/sparse");
+	}
+	//Clusters of the geotagged images
+	std::vector<size_t> gpsImages;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		if (images[i].exif.hasGPS)
+		{
+			gpsImages.emplace_back(i);
+		}
+	}
+	std::vector<Eigen::Vector3d> positions(gpsImages.size());
+	for (size_t i = 0; i < gpsImages.size(); i++)
+	{
+		ExifReader::toLocalMeters(images[gpsImages[i]].exif, images[gpsImages[0]].exif.latitude, images[gpsImages[0]].exif.longitude, positions[i].data());
+	}
+	const auto clusters = SpatialPartition::partition(positions, maxImages, options.overlap);
+	std::vector<std::vector<size_t>> clusterImages(clusters.size());
+	std::vector<size_t> gpsImageCluster(images.size(), clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		for (const auto index : clusters[c].indices)
+		{
+			clusterImages[c].emplace_back(gpsImages[index]);
+		}
+		for (const auto index : clusters[c].core)
+		{
+			gpsImageCluster[gpsImages[index]] = c;
+		}
+	}
+	//Images without GPS go with the closest geotagged image in the name order
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		if (images[i].exif.hasGPS)
+		{
+			continue;
+		}
+		for (size_t distance = 1; distance < images.size(); distance++)
+		{
+			if (i >= distance && images[i - distance].exif.hasGPS)
+			{
+				clusterImages[gpsImageCluster[i - distance]].emplace_back(i);
+				break;
+			}
+			if (i + distance < images.size() && images[i + distance].exif.hasGPS)
+			{
+				clusterImages[gpsImageCluster[i + distance]].emplace_back(i);
+				break;
+			}
+		}
+	}
+	const std::string partsPath = workspacePath + "/sparse_parts";
+	if (!wxDirExists(partsPath))
+	{
+		wxMkdir(partsPath);
+	}
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const std::string clusterPath = partsPath + "/" + std::to_string(c);
+		if (!wxDirExists(clusterPath))
+		{
+			wxMkdir(clusterPath);
+		}
+		std::ofstream imageList(clusterPath + "/image_list.txt");
+		for (const auto index : clusterImages[c])
+		{
+			imageList << images[index].name << "\n";
+		}
+	}
+	//Each mapper gets a share of the cores
+	const int numWorkers = std::max(1, std::min(options.maxWorkers, static_cast<int>(clusters.size())));
+	const int threadsPerMapper = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / numWorkers);
+	std::vector<ColmapModel> models(clusters.size());
+	std::vector<char> succeeded(clusters.size(), 0);
+	std::atomic<size_t> nextCluster(0);
+	auto worker = [&]()
+	{
+		for (size_t c = nextCluster++; c < clusters.size(); c = nextCluster++)
+		{
+			const std::string clusterPath = partsPath + "/" + std::to_string(c);
+			succeeded[c] = executeMapper(imagesPath, databasePath, clusterPath, clusterPath + "/image_list.txt", threadsPerMapper) &&
+				readLargestModel(clusterPath, models[c]);
+		}
+	};
+	std::vector<std::thread> workers;
+	for (int i = 0; i < numWorkers; i++)
+	{
+		workers.emplace_back(worker);
+	}
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+	std::vector<ColmapModel> reconstructedModels;
+	for (size_t c = 0; c < clusters.size(); c++)
 	{
-		max_image_size = 1000;
+		if (succeeded[c])
+		{
+			reconstructedModels.emplace_back(std::move(models[c]));
+		}
+		else
+		{
+			wxLogWarning("Cluster %zu of the sparse reconstruction failed", c);
+		}
 	}
-	else if (quality == "medium")
+	ColmapModel merged;
+	std::string report;
+	if (!ColmapModelMerger::merge(reconstructedModels, merged, report))
 	{
-		max_image_size = 1600;
+		wxLogError("Error merging the sparse models");
+		return 0;
 	}
-	else if (quality == "high")
+	wxLogInfo(wxString("Sparse clusters: " + std::to_string(clusters.size()) + "\n" + report));
+	//Images registered by a cluster that could not be aligned to the others
+	std::map<uint32_t, std::string> registeredImages;
+	for (const auto& model : reconstructedModels)
 	{
-		max_image_size = 2400;
+		for (const auto& image : model.images)
+		{
+			registeredImages[image.first] = image.second.name;
+		}
 	}
+	std::string droppedImages;
+	size_t numDropped = 0;
+	for (const auto& image : registeredImages)
+	{
+		if (!merged.images.count(image.first))
+		{
+			droppedImages += (numDropped == 0 ? "" : ", ") + image.second;
+			numDropped++;
+		}
+	}
+	if (numDropped > 0)
+	{
+		wxLogWarning(wxString(std::to_string(numDropped) + " of " + std::to_string(registeredImages.size()) +
+			" registered images left out of the merged sparse model: " + droppedImages));
+		if (numDropped > options.maxDroppedFraction * registeredImages.size())
+		{
+			wxLogError(wxString("The merged sparse model is missing more than " +
+				std::to_string(static_cast<int>(100 * options.maxDroppedFraction)) + "% of the registered images"));
+			return 0;
+		}
+	}
+	const std::string modelPath = workspacePath + "/sparse/0";
+	if (!wxDirExists(modelPath))
+	{
+		wxMkdir(modelPath);
+	}
+	if (!merged.write(modelPath))
+	{
+		wxLogError("Error writing the merged sparse model");
+		return 0;
+	}
+	return 1;
+}
+
+bool HelperCOLMAP::readLargestModel(const std::string& mapperOutputPath, ColmapModel& model)
+{
+	size_t largest = 0;
+	for (int i = 0; wxDirExists(mapperOutputPath + "/" + std::to_string(i)); i++)
+	{
+		ColmapModel candidate;
+		if (candidate.read(mapperOutputPath + "/" + std::to_string(i)) && candidate.images.size() > largest)
+		{
+			largest = candidate.images.size();
+			model = std::move(candidate);
+		}
+	}
+	return largest > 0;
+}
+
+std::string HelperCOLMAP::getImageUndistorterParameters(int maxImageSize)
+{
+	return " --max_image_size=" + std::to_string(maxImageSize);
+}
 
-	std::string colmapParameters(Utils::preparePath(Utils::getExecutionPath() + "/COLMAP/COLMAP.bat") +
-		" image_undistorter --image_path=" + Utils::preparePath(imagesPath) +
+bool HelperCOLMAP::executeImageUndistorter(const std::string imagesPath, const std::string inputPath,
+	const std::string outputPath, const std::string outputType, int maxImageSize)
+{
+	std::string colmapParameters(" image_undistorter --image_path=" + Utils::preparePath(imagesPath) +
 		" --input_path=" + Utils::preparePath(inputPath) +
 		" --output_path=" + Utils::preparePath(outputPath) +
 		" --output_type=" + outputType +
-		" --max_image_size=" + std::to_string(max_image_size)
+		getImageUndistorterParameters(maxImageSize)
 	);
-	if (!Utils::startProcess(colmapParameters))
+	if (!StageRunner::get()->run(colmapTool, colmapParameters))
 	{
 		wxLogError("Error with COLMAP image undistorter");
 		return 0;
@@ -123,49 +634,29 @@ bool HelperCOLMAP::executeImageUndistorter(const std::string imagesPath, const s
 	return 1;
 }
 
-bool HelperCOLMAP::executePatchMachStereo(const std::string workspacePath, const std::string workspaceFormat)
+std::string HelperCOLMAP::getPatchMatchStereoParameters(int maxImageSize)
 {
-	// Quality
-	auto quality = ConfigurationDialog::getDenseQuality();
+	const auto quality = ConfigurationDialog::getQualityPreset().dense;
 
-	int max_image_size = -1;
-	int window_radius = 5;
-	int window_step = 1;
-	int num_samples = 15;
-	int num_iterations = 5;
-	const int geom_consistency = 1; // BUG: always 1!
-
-	if (quality == "low")
-	{
-		max_image_size = 1000;
-		window_radius = 4;
-		window_step = 2;
-		num_samples /= 2;
-		num_iterations = 3;
-	}
-	else if (quality == "medium")
-	{
-		max_image_size = 1600;
-		window_radius = 4;
-		window_step = 2;
-		num_samples /= 1.5;
-	}
-	else if (quality == "high")
-	{
-		max_image_size = 2400;
-	}
+	return " --PatchMatchStereo.max_image_size=" + std::to_string(maxImageSize) +
+		" --PatchMatchStereo.window_radius=" + std::to_string(quality.windowRadius) +
+		" --PatchMatchStereo.window_step=" + std::to_string(quality.windowStep) +
+		" --PatchMatchStereo.num_samples=" + std::to_string(quality.numSamples) +
+		" --PatchMatchStereo.num_iterations=" + std::to_string(quality.numIterations) +
+		" --PatchMatchStereo.geom_consistency=" + std::to_string(quality.geomConsistency ? 1 : 0);
+}
 
-	std::string colmapParameters(Utils::preparePath(Utils::getExecutionPath() + "/COLMAP/COLMAP.bat") +
-		" patch_match_stereo --workspace_path=" + Utils::preparePath(workspacePath) +
+bool HelperCOLMAP::executePatchMachStereo(const std::string workspacePath, const std::string workspaceFormat, const Resources::Plan& resourcePlan)
+{
+	std::string colmapParameters(" patch_match_stereo --workspace_path=" + Utils::preparePath(workspacePath) +
 		" --workspace_format=" + workspaceFormat +
-		" --PatchMatchStereo.max_image_size=" + std::to_string(max_image_size) +
-		" --PatchMatchStereo.window_radius=" + std::to_string(window_radius) +
-		" --PatchMatchStereo.window_step=" + std::to_string(window_step) +
-		" --PatchMatchStereo.num_samples=" + std::to_string(num_samples) +
-		" --PatchMatchStereo.num_iterations=" + std::to_string(num_iterations) +
-		" --PatchMatchStereo.geom_consistency=" + std::to_string(geom_consistency)
+		getPatchMatchStereoParameters(resourcePlan.imageSize)
 	);
-	if (!Utils::startProcess(colmapParameters))
+	if (resourcePlan.cacheSize > 0)
+	{
+		colmapParameters += " --PatchMatchStereo.cache_size=" + std::to_string(resourcePlan.cacheSize);
+	}
+	if (!StageRunner::get()->run(colmapTool, colmapParameters))
 	{
 		wxLogError("Error with COLMAP patch match stereo");
 		return 0;
@@ -184,41 +675,44 @@ bool HelperCOLMAP::executePatchMachStereo(const std::string workspacePath, const
 	return 1;
 }
 
-bool HelperCOLMAP::executeStereoFusion(const std::string workspacePath, const std::string workspaceFormat, const std::string outputPath, const std::string inputType)
+bool HelperCOLMAP::executeStereoFusion(const std::string workspacePath, const std::string workspaceFormat, const std::string outputPath,
+	const Resources::Plan& resourcePlan, const std::string inputType)
 {
-	// Quality
-	auto quality = ConfigurationDialog::getDenseQuality();
-
-	int check_num_images = 50;
-	int max_image_size = -1;
+	const int check_num_images = ConfigurationDialog::getQualityPreset().dense.checkNumImages;
 
-	if (quality == "low")
+	//The native fusion streams the points to the PLY and doesn't write the .vis file
+	auto fusionOptions = ConfigurationDialog::getFusionOptions();
+	if (fusionOptions.native && workspaceFormat == "COLMAP")
 	{
-		check_num_images /= 2;
-		max_image_size = 1000;
+		fusionOptions.checkNumImages = check_num_images;
+		if (resourcePlan.cacheSize > 0)
+		{
+			fusionOptions.cacheSize = std::min(fusionOptions.cacheSize, resourcePlan.cacheSize);
+		}
+		if (!DepthMapFusion::fuse(workspacePath, inputType, outputPath, fusionOptions))
+		{
+			wxLogError("Error with the stereo fusion");
+			return 0;
+		}
 	}
-	else if (quality == "medium")
+	else
 	{
-		check_num_images /= 1.5;
-		max_image_size = 1600;
-	}
-	else if (quality == "high")
-	{
-		max_image_size = 2400;
-	}
-
-	std::string colmapParameters(Utils::preparePath(Utils::getExecutionPath() + "/COLMAP/COLMAP.bat") +
-		" stereo_fusion --workspace_path=" + Utils::preparePath(workspacePath) +
-		" --workspace_format=" + workspaceFormat +
-		" --input_type=" + inputType +
-		" --output_path=" + Utils::preparePath(outputPath) +
-		" --StereoFusion.check_num_images=" + std::to_string(check_num_images) +
-		" --StereoFusion.max_image_size=" + std::to_string(max_image_size)
-	);
-	if (!Utils::startProcess(colmapParameters))
-	{
-		wxLogError("Error with COLMAP stereo fusion");
-		return 0;
+		std::string colmapParameters(" stereo_fusion --workspace_path=" + Utils::preparePath(workspacePath) +
+			" --workspace_format=" + workspaceFormat +
+			" --input_type=" + inputType +
+			" --output_path=" + Utils::preparePath(outputPath) +
+			" --StereoFusion.check_num_images=" + std::to_string(check_num_images) +
+			" --StereoFusion.max_image_size=" + std::to_string(resourcePlan.imageSize)
+		);
+		if (resourcePlan.cacheSize > 0)
+		{
+			colmapParameters += " --StereoFusion.cache_size=" + std::to_string(resourcePlan.cacheSize);
+		}
+		if (!StageRunner::get()->run(colmapTool, colmapParameters))
+		{
+			wxLogError("Error with COLMAP stereo fusion");
+			return 0;
+		}
 	}
 	if (!Utils::exists(outputPath))
 	{
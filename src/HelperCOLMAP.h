@@ -1,5 +1,21 @@
 #pragma once
 #include <string>
+#include <vector>
+
+#include "MatchPairGenerator.h"
+#include "SpatialPartition.h"
+
+namespace Matching
+{
+	struct Plan;
+}
+
+namespace Resources
+{
+	struct Plan;
+}
+
+class ColmapModel;
 
 class HelperCOLMAP
 {
@@ -9,16 +25,50 @@ public:
 
 	static bool modelConverter(std::string inputPath, std::string outputPath, std::string outputType = "nvm");
 
-	static bool executeSparse(std::string imagesPath, std::string nvmPath);
+	//The matching plan is returned with its measured time.
+	//The model of a previous run in the same workspace is reused while the images and the sparse parameters don't change.
+	static bool executeSparse(std::string imagesPath, std::string nvmPath, Matching::Plan& matchingPlan);
 
-	static bool executeDense(std::string imagesPath, std::string tempDir, std::string pointCloudOutputPath);
+	//Scenes with more images than Partition.denseMaxImages are processed in overlapping clusters merged at the end.
+	//keepWorkspace retains the undistorted images and depth maps of the clusters for reruns.
+	static bool executeDense(std::string imagesPath, std::string sparsePath, std::string workspacePath, std::string pointCloudOutputPath,
+		bool keepWorkspace);
 
 private:
+	static bool executeFeatureExtractor(const std::string& imagesPath, const std::string& databasePath);
+
+	//pairsPath is used by the sequential and spatial strategies
+	static bool executeMatcher(const std::string& databasePath, const Matching::Plan& matchingPlan, const std::string& pairsPath);
+
+	//imageListPath restricts the mapping to the listed images, numThreads <= 0 uses every core
+	static bool executeMapper(const std::string& imagesPath, const std::string& databasePath, const std::string& outputPath,
+		const std::string& imageListPath = "", int numThreads = -1);
+
+	//Large geotagged captures are split in overlapping clusters mapped concurrently and merged into sparse/0
+	static bool executePartitionedMapper(const std::string& imagesPath, const std::string& databasePath, const std::string& workspacePath,
+		const std::vector<MatchPairGenerator::ImageInfo>& images);
+
+	//The mapper writes one model per connected component, the largest is kept
+	static bool readLargestModel(const std::string& mapperOutputPath, ColmapModel& model);
+
+	//Undistortion, patch match and fusion of one sparse model
+	static bool executeDenseWorkspace(const std::string& imagesPath, const std::string& sparsePath, const std::string& workspacePath,
+		const std::string& pointCloudOutputPath, const Resources::Plan& resourcePlan);
+
+	//Fused clouds of the clusters, each one keeps only the points inside its cell so the overlaps are not duplicated
+	static bool mergeClusterPointClouds(const std::vector<std::string>& pointCloudPaths, const std::vector<SpatialPartition::Cluster>& clusters,
+		const std::string& pointCloudOutputPath);
+
+	//Options that change the undistorted images and depth maps, part of the workspace keys
+	static std::string getImageUndistorterParameters(int maxImageSize);
+	static std::string getPatchMatchStereoParameters(int maxImageSize);
+
 	static bool executeImageUndistorter(const std::string imagesPath, const std::string inputPath,
-		const std::string outputPath, const std::string outputType);
+		const std::string outputPath, const std::string outputType, int maxImageSize);
 
-	static bool executePatchMachStereo(const std::string workspacePath, const std::string workspaceFormat);
+	//The cache_size of patch match and fusion is the memory of a worker in the resource plan
+	static bool executePatchMachStereo(const std::string workspacePath, const std::string workspaceFormat, const Resources::Plan& resourcePlan);
 
 	static bool executeStereoFusion(const std::string workspacePath, const std::string workspaceFormat, const std::string outputPath,
-		const std::string inputType = "geometric");
+		const Resources::Plan& resourcePlan, const std::string inputType = "geometric");
 };
\ No newline at end of file
@@ -5,32 +5,38 @@
 #include <wx/log.h>
 
 #include "Utils.h"
+#include "PlyIO.h"
+#include "QualityPresets.h"
 #include "tinyply.h"
+#include "Tracer.h"
+#include "StageRunner.h"
 
-bool HelperSSDRecon::executeMeshing(std::string inputPath, std::string outputPath)
+bool HelperSSDRecon::executeMeshing(std::string inputPath, std::string outputPath, const Quality::Meshing& quality)
 {
-	if (!executeSSD(inputPath, outputPath))
+	if (!executeSSD(inputPath, outputPath, quality.depth, quality.samplesPerNode))
 	{
 		return 0;
 	}
-	if (!executeSurfaceTrimmer(outputPath))
+	if (!executeSurfaceTrimmer(outputPath, quality.trim))
+	{
+		return 0;
+	}
+	if (!fixBadPLY(outputPath))
 	{
 		return 0;
 	}
-	fixBadPLY(outputPath);
 	return 1;
 }
 
-bool HelperSSDRecon::executeSSD(std::string inputPath, std::string outputPath)
+bool HelperSSDRecon::executeSSD(std::string inputPath, std::string outputPath, int depth, int samplesPerNode)
 {
-	std::string ssdParameters(Utils::preparePath(Utils::getExecutionPath() + "/SSDRecon/SSDRecon.exe") +
-		" --in " + Utils::preparePath(inputPath) +
+	std::string ssdParameters(" --in " + Utils::preparePath(inputPath) +
 		" --out " + Utils::preparePath(outputPath) +
-		" --depth 12" +
-		" --samplesPerNode 12" +
+		" --depth " + std::to_string(depth) +
+		" --samplesPerNode " + std::to_string(samplesPerNode) +
 		" --density"
 	);
-	if (!Utils::startProcess(ssdParameters))
+	if (!StageRunner::get()->run("SSDRecon/SSDRecon.exe", ssdParameters))
 	{
 		wxLogError("Error with SSDRecon");
 		return 0;
@@ -43,14 +49,13 @@ bool HelperSSDRecon::executeSSD(std::string inputPath, std::string outputPath)
 	return 1;
 }
 
-bool HelperSSDRecon::executeSurfaceTrimmer(std::string inputPath)
+bool HelperSSDRecon::executeSurfaceTrimmer(std::string inputPath, int trim)
 {
-	std::string surfaceParameters(Utils::preparePath(Utils::getExecutionPath() + "/SSDRecon/SurfaceTrimmer.exe") +
-		" --in " + Utils::preparePath(inputPath) +
+	std::string surfaceParameters(" --in " + Utils::preparePath(inputPath) +
 		" --out " + Utils::preparePath(inputPath) +
-		" --trim 5"
+		" --trim " + std::to_string(trim)
 	);
-	if (!Utils::startProcess(surfaceParameters))
+	if (!StageRunner::get()->run("SSDRecon/SurfaceTrimmer.exe", surfaceParameters))
 	{
 		wxLogError("Error with SurfaceTrimmer");
 		return 0;
@@ -106,17 +111,15 @@ struct memory_stream : virtual memory_buffer, public std::istream
 		: memory_buffer(first_elem, size), std::istream(static_cast<std::streambuf*>(this)) {}
 };
 
-struct float3 { float x, y, z; };
-struct uint3 { uint32_t x, y, z; };
-
-void HelperSSDRecon::fixBadPLY(std::string inputPath)
+bool HelperSSDRecon::fixBadPLY(std::string inputPath)
 {
+	Tracer::Span span("PLY fix", "io", inputPath);
 	//Read
 	std::unique_ptr<std::istream> file_stream;
 	std::vector<uint8_t> byte_buffer;
 
-	std::vector<float3> verts;
-	std::vector<uint3> triangles;
+	std::vector<float> verts;
+	std::vector<uint32_t> triangles;
 
 	try
 	{
@@ -150,34 +153,24 @@ void HelperSSDRecon::fixBadPLY(std::string inputPath)
 		catch (const std::exception & e) { wxLogError("tinyply exception"); }
 
 		file.read(*file_stream);
+		if (!vertices || !faces)
+		{
+			return 0;
+		}
 
-		verts.resize(vertices->count);
+		verts.resize(vertices->count * 3);
 		std::memcpy(verts.data(), vertices->buffer.get(), vertices->buffer.size_bytes());
 
-		triangles.resize(faces->count);
+		triangles.resize(faces->count * 3);
 		std::memcpy(triangles.data(), faces->buffer.get(), faces->buffer.size_bytes());
 
 	}
 	catch (const std::exception & e)
 	{
 		wxLogError("Caught tinyply exception");
+		return 0;
 	}
 
-	//Write
-	std::filebuf fb_binary;
-	fb_binary.open(inputPath, std::ios::out | std::ios::binary);
-	std::ostream outstream_binary(&fb_binary);
-	if (outstream_binary.fail()) throw std::runtime_error("failed to open " + inputPath);
-
-	tinyply::PlyFile plyFile;
-
-	plyFile.add_properties_to_element("vertex", { "x", "y", "z" },
-		tinyply::Type::FLOAT32, verts.size(), reinterpret_cast<uint8_t*>(verts.data()), tinyply::Type::INVALID, 0);
-
-	plyFile.add_properties_to_element("face", { "vertex_indices" },
-		tinyply::Type::UINT32, triangles.size(), reinterpret_cast<uint8_t*>(triangles.data()), tinyply::Type::UINT8, 3);
-
-
-	// Write a binary file
-	plyFile.write(outstream_binary, true);
+	// Write a binary file, vertices and faces are serialized in parallel
+	return PlyIO::write(inputPath, verts, {}, {}, triangles);
 }
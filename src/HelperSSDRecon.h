@@ -1,20 +1,26 @@
 #pragma once
 #include <string>
 
+namespace Quality
+{
+	struct Meshing;
+}
+
 class HelperSSDRecon
 {
 public:
 	HelperSSDRecon() {};
 	~HelperSSDRecon() {};
 
-	static bool executeMeshing(std::string inputPath, std::string outputPath);
+	//Octree depth, samples per node and trim of the dense quality
+	static bool executeMeshing(std::string inputPath, std::string outputPath, const Quality::Meshing& quality);
 
 private:
-	static bool executeSSD(std::string inputPath, std::string outputPath);
+	static bool executeSSD(std::string inputPath, std::string outputPath, int depth, int samplesPerNode);
 
-	static bool executeSurfaceTrimmer(std::string inputPath);
+	static bool executeSurfaceTrimmer(std::string inputPath, int trim);
 
 	// We need to open and save the ply because TexRecon does not read the SSDRecon ply
-	static void fixBadPLY(std::string inputPath);
+	static bool fixBadPLY(std::string inputPath);
 
 };
\ No newline at end of file
@@ -1,17 +1,56 @@
 #include "HelperScalePtcs.h"
 #include "Utils.h"
+#include "StageRunner.h"
+#include "ImageMetadataCache.h"
+#include "ConfigurationDialog.h"
 #include <fstream>
 #include <wx/log.h>
+#include <wx/dir.h>
+
+namespace
+{
+	// GPS of the images from the metadata cache, so the script doesn't open every image again for its EXIF
+	bool writeGPSFile(const std::string& imagesFolder, const std::string& gpsPath)
+	{
+		wxArrayString files;
+		wxDir::GetAllFiles(imagesFolder, &files, wxEmptyString, wxDIR_FILES);
+		std::ofstream gpsFile(gpsPath);
+		if (!gpsFile.is_open())
+		{
+			return 0;
+		}
+		gpsFile.precision(12);
+		gpsFile << "filename,latitude,longitude,altitude\n";
+		for (const auto& file : files)
+		{
+			const auto path = file.ToStdString();
+			const auto extension = Utils::toUpper(Utils::getFileExtension(path));
+			ImageMetadata metadata;
+			if ((extension == "JPG" || extension == "JPEG") && ImageMetadataCache::get(path, metadata) && metadata.exif.hasGPS)
+			{
+				gpsFile << "\"" << Utils::getFileName(path) << "\"," << metadata.exif.latitude << "," <<
+					metadata.exif.longitude << "," << metadata.exif.altitude << "\n";
+			}
+		}
+		gpsFile.close();
+		return !gpsFile.fail();
+	}
+}
 
 bool HelperScalePtcs::executeScalePtcs(const std::string &inputCamerasFile, const std::string &inputImagesFolder,
 									   const std::string &inputPtc, const std::string &texturePath)
 {
-	std::string scalePtcsCommand(Utils::preparePath(Utils::getExecutionPath() + "/ScalePtcs/scale_ptcs.exe") +
-								 " --folder " + Utils::preparePath(inputImagesFolder) +
-								 " --nvm " + Utils::preparePath(inputCamerasFile) +
-								 " --cloud " + Utils::preparePath(inputPtc) +
-								 " --obj " + Utils::preparePath(texturePath));
-	if (!Utils::startProcess(scalePtcsCommand))
+	std::string scalePtcsParameters(" --folder " + Utils::preparePath(inputImagesFolder) +
+		" --nvm " + Utils::preparePath(inputCamerasFile) +
+		" --cloud " + Utils::preparePath(inputPtc) +
+		" --obj " + Utils::preparePath(texturePath));
+	//Without the file the script reads the EXIF of the images
+	const auto gpsPath = Utils::getPath(inputCamerasFile) + "gps.csv";
+	if (ConfigurationDialog::getScaleGPSFile() && writeGPSFile(inputImagesFolder, gpsPath))
+	{
+		scalePtcsParameters += " --gps-csv " + Utils::preparePath(gpsPath);
+	}
+	if (!StageRunner::get()->run("ScalePtcs/scale_ptcs.exe", scalePtcsParameters))
 	{
 		wxLogError("Error with Scale Reconstruction Process");
 		return 0;
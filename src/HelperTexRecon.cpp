@@ -9,6 +9,8 @@
 #include "Camera.h"
 #include "Utils.h"
 #include "ImageIO.h"
+#include "Tracer.h"
+#include "StageRunner.h"
 
 bool HelperTexRecon::executeTexRecon(const std::string & inputCamerasFile, const std::string & inputMesh, const std::string & outputMesh, const TexRecon::Options & options)
 {
@@ -20,8 +22,7 @@ bool HelperTexRecon::executeTexRecon(const std::string & inputCamerasFile, const
 		return 0;
 	}
 	std::stringstream texReconParameters;
-	texReconParameters << Utils::preparePath(Utils::getExecutionPath() + "/TexRecon/texrecon.exe") <<
-		" --data_term=" + options.getDataTerm() <<
+	texReconParameters << " --data_term=" + options.getDataTerm() <<
 		" --outlier_removal=" + options.getOutlierRemoval() <<
 		" --tone_mapping=" + options.getToneMapping() << " --no_intermediate_results ";
 	if (!options.geometricVisibilityTest)
@@ -47,7 +48,7 @@ bool HelperTexRecon::executeTexRecon(const std::string & inputCamerasFile, const
 	texReconParameters << Utils::preparePath(outputPath + ".cameras") << " " <<
 		Utils::preparePath(inputMesh) << " " <<
 		Utils::preparePath(outputPath);
-	if (!Utils::startProcess(texReconParameters.str()))
+	if (!StageRunner::get()->run("TexRecon/texrecon.exe", texReconParameters.str()))
 	{
 		wxLogError("Error with TexRecon");
 		return 0;
@@ -62,6 +63,7 @@ bool HelperTexRecon::executeTexRecon(const std::string & inputCamerasFile, const
 
 bool HelperTexRecon::createCamerasFile(const std::string & inputCamerasFile, const std::string & outputCamerasFile)
 {
+	Tracer::Span span("Cameras file", "native", outputCamerasFile);
 	if (!Utils::exists(inputCamerasFile))
 	{
 		return 0;
@@ -27,14 +27,24 @@
 
 #include "Utils.h"
 #include "Camera.h"
+#include "ColmapModel.h"
+#include "ImageMetadataCache.h"
 
 
 bool ImageIO::getImageSize(const std::string& imagePath, unsigned int& width, unsigned int& height)
 {
-	if (!Utils::exists(imagePath))
+	ImageMetadata metadata;
+	if (!ImageMetadataCache::get(imagePath, metadata))
 	{
 		return 0;
 	}
+	width = metadata.width;
+	height = metadata.height;
+	return 1;
+}
+
+bool ImageIO::readImageSize(const std::string& imagePath, unsigned int& width, unsigned int& height)
+{
 	Gdiplus::GdiplusStartupInput gdiplusStartupInput;
 	ULONG_PTR gdiplusToken;
 	GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, NULL);
@@ -75,7 +85,7 @@ bool ImageIO::getImagePathsExist(std::vector<std::string>& imagePaths, const std
 				imagePath = newImageDir + "\\" + imageName;
 			}
 		}
-		if (!Utils::exists(imagePath))
+		if (!ImageMetadataCache::exists(imagePath))
 		{
 			return 0;
 		}
@@ -85,6 +95,11 @@ bool ImageIO::getImagePathsExist(std::vector<std::string>& imagePaths, const std
 
 bool ImageIO::loadCameraParameters(const std::string& filePath, std::vector<Camera*>& cameras)
 {
+	const std::string extension = Utils::getFileExtension(filePath);
+	if (extension == "scb")
+	{
+		return loadCameraBundle(filePath, cameras);
+	}
 	std::ifstream parametersFile(filePath);
 	if (!parametersFile.good())
 	{
@@ -92,7 +107,6 @@ bool ImageIO::loadCameraParameters(const std::string& filePath, std::vector<Came
 	}
 	std::string line;
 	unsigned int qtdCameras = 0;
-	const std::string extension = Utils::getFileExtension(filePath);
 	//SFM
 	if (extension == "sfm")
 	{
@@ -156,6 +170,10 @@ bool ImageIO::getCamerasFileImagePaths(const std::string& camerasFilePath, std::
 	{
 		return ImageIO::getNVMImagePaths(camerasFilePath, imagePaths);
 	}
+	else if (Utils::getFileExtension(camerasFilePath) == "scb")
+	{
+		return ImageIO::getCameraBundleImagePaths(camerasFilePath, imagePaths);
+	}
 	return 0;
 }
 
@@ -169,6 +187,10 @@ bool ImageIO::replaceCamerasFileImageDir(const std::string& camerasFilePath, con
 	{
 		return ImageIO::replaceNVMImageDir(camerasFilePath, newImgDir);
 	}
+	else if (Utils::getFileExtension(camerasFilePath) == "scb")
+	{
+		return ImageIO::replaceCameraBundleImageDir(camerasFilePath, newImgDir);
+	}
 	return 0;
 }
 
@@ -186,6 +208,14 @@ unsigned int ImageIO::GetNumberOfCameras(const std::string & camerasFilePath)
 	{
 		return ImageIO::GetNumberOfCamerasNVM(camerasFilePath);
 	}
+	else if (Utils::getFileExtension(camerasFilePath) == "scb")
+	{
+		CameraBundle bundle;
+		if (bundle.open(camerasFilePath))
+		{
+			return bundle.getNumberOfCameras();
+		}
+	}
 	return 0;
 }
 
@@ -199,9 +229,257 @@ bool ImageIO::saveCameras(const std::string & camerasFilePath, const std::vector
 	{
 		return saveNVMFile(camerasFilePath, cameras);
 	}
+	else if (Utils::getFileExtension(camerasFilePath) == "scb")
+	{
+		return saveCameraBundle(camerasFilePath, cameras);
+	}
 	return 0;
 }
 
+bool ImageIO::saveCameraBundle(const std::string& bundlePath, const std::vector<Camera*>& cameras,
+	const std::vector<CameraBundleFormat::SparsePoint>& points)
+{
+	std::vector<CameraBundleFormat::CameraRecord> records(cameras.size());
+	std::vector<std::string> imagePaths(cameras.size());
+	for (size_t i = 0; i < cameras.size(); i++)
+	{
+		const auto& camera = *cameras[i];
+		auto& record = records[i];
+		const auto matrixRt = camera.getMatrixRt();
+		for (int j = 0; j < 3; j++)
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				record.matrixRt[j * 4 + k] = matrixRt(j, k);
+			}
+		}
+		record.focalDistance[0] = camera.getFocalX();
+		record.focalDistance[1] = camera.getFocalY();
+		record.principalPoint[0] = camera.getPrincipalPointX();
+		record.principalPoint[1] = camera.getPrincipalPointY();
+		record.width = camera.getWidth();
+		record.height = camera.getHeight();
+		imagePaths[i] = camera.filePath;
+	}
+	return CameraBundle::write(bundlePath, records, imagePaths, points);
+}
+
+bool ImageIO::loadCameraBundlePoints(const std::string& bundlePath, std::vector<CameraBundleFormat::SparsePoint>& points)
+{
+	CameraBundle bundle;
+	if (!bundle.open(bundlePath))
+	{
+		return 0;
+	}
+	const auto begin = bundle.getPoints();
+	points.assign(begin, begin + bundle.getNumberOfPoints());
+	return 1;
+}
+
+bool ImageIO::loadCOLMAPModel(const std::string& modelDir, const std::string& imagesDir, std::vector<Camera*>& cameras)
+{
+	ColmapModel model;
+	if (!model.read(modelDir, false))
+	{
+		return 0;
+	}
+	cameras.reserve(cameras.size() + model.images.size());
+	for (const auto& imageEntry : model.images)
+	{
+		const auto& image = imageEntry.second;
+		const auto intrinsics = model.cameras.find(image.cameraId);
+		if (intrinsics == model.cameras.end())
+		{
+			for (auto cam : cameras)
+			{
+				delete cam;
+			}
+			cameras.clear();
+			return 0;
+		}
+		double focal[2], principal[2];
+		ColmapModel::getFocalAndPrincipalPoint(intrinsics->second, focal, principal);
+		const float focalDistance[2] = { static_cast<float>(focal[0]), static_cast<float>(focal[1]) };
+		const float principalPoint[2] = { static_cast<float>(principal[0]), static_cast<float>(principal[1]) };
+		cameras.emplace_back(new Camera(imagesDir + "/" + image.name, focalDistance, principalPoint,
+			static_cast<unsigned int>(intrinsics->second.width), static_cast<unsigned int>(intrinsics->second.height),
+			ColmapModel::getMatrixRt(image)));
+	}
+	sortCamerasByName(cameras);
+	return 1;
+}
+
+bool ImageIO::saveCOLMAPModel(const std::string& modelDir, const std::vector<Camera*>& cameras)
+{
+	ColmapModel model;
+	uint32_t id = 1;
+	for (const auto& camera : cameras)
+	{
+		//One PINHOLE camera per image
+		ColmapModel::Intrinsics intrinsics;
+		intrinsics.cameraId = id;
+		intrinsics.modelId = 1;
+		intrinsics.width = camera->getWidth();
+		intrinsics.height = camera->getHeight();
+		intrinsics.params = { camera->getFocalX(), camera->getFocalY(), camera->getPrincipalPointX(), camera->getPrincipalPointY() };
+		model.cameras[id] = intrinsics;
+		ColmapModel::Image image;
+		image.imageId = id;
+		image.cameraId = id;
+		image.name = Utils::getFileName(camera->filePath, true);
+		ColmapModel::setMatrixRt(image, camera->getMatrixRt());
+		model.images[id] = image;
+		id++;
+	}
+	return model.write(modelDir);
+}
+
+bool ImageIO::convertCOLMAPModel(const std::string& modelDir, const std::string& imagesDir, const std::string& camerasFilePath)
+{
+	std::vector<Camera*> cameras;
+	if (!loadCOLMAPModel(modelDir, imagesDir, cameras))
+	{
+		return 0;
+	}
+	bool result = 0;
+	if (Utils::getFileExtension(camerasFilePath) == "scb")
+	{
+		//Keep the sparse points
+		ColmapModel model;
+		std::vector<CameraBundleFormat::SparsePoint> points;
+		if (model.read(modelDir))
+		{
+			points.reserve(model.points3D.size());
+			for (const auto& pointEntry : model.points3D)
+			{
+				CameraBundleFormat::SparsePoint point;
+				for (int i = 0; i < 3; i++)
+				{
+					point.position[i] = static_cast<float>(pointEntry.second.xyz[i]);
+					point.color[i] = pointEntry.second.rgb[i];
+				}
+				point.reserved = 0;
+				points.emplace_back(point);
+			}
+		}
+		result = saveCameraBundle(camerasFilePath, cameras, points);
+	}
+	else
+	{
+		result = saveCameras(camerasFilePath, cameras);
+	}
+	for (auto camera : cameras)
+	{
+		delete camera;
+	}
+	return result;
+}
+
+bool ImageIO::streamReplaceImageDir(const std::string& camerasFilePath, const std::string& newImgDir, bool isNVM)
+{
+	//Large buffers, the points after the cameras are copied as they are. They are set after the open and before the
+	//first read or write, MSVC ignores the buffer of a stream without a file
+	const size_t bufferSize = 1 << 20;
+	std::vector<char> inBuffer(bufferSize), outBuffer(bufferSize);
+	std::ifstream in(camerasFilePath, std::ios::binary);
+	if (!in.good())
+	{
+		return 0;
+	}
+	in.rdbuf()->pubsetbuf(inBuffer.data(), bufferSize);
+	const std::string tempPath = camerasFilePath + ".tmp";
+	std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+	if (!out.good())
+	{
+		return 0;
+	}
+	out.rdbuf()->pubsetbuf(outBuffer.data(), bufferSize);
+	auto isEmptyLine = [](const std::string& line)
+	{
+		return line.find_first_not_of(" \t\r") == std::string::npos;
+	};
+	std::string line;
+	//NVM_V3 line
+	if (isNVM)
+	{
+		if (!std::getline(in, line))
+		{
+			out.close();
+			Utils::RemoveFile(tempPath);
+			return 0;
+		}
+		out << line << "\n";
+	}
+	//Number of views, NVM has an empty line before it
+	int num_views = -1;
+	while (std::getline(in, line))
+	{
+		out << line << "\n";
+		if (!isEmptyLine(line))
+		{
+			num_views = std::atoi(line.c_str());
+			break;
+		}
+	}
+	if (num_views < 0 || num_views > 10000)
+	{
+		out.close();
+		Utils::RemoveFile(tempPath);
+		return 0;
+	}
+	//Only the first token of the camera lines is changed, the rest is copied as it is
+	int views = 0;
+	while (views < num_views && std::getline(in, line))
+	{
+		const auto tokenBegin = line.find_first_not_of(" \t");
+		if (tokenBegin == std::string::npos)
+		{
+			//SFM has an empty line after the number of views
+			out << line << "\n";
+			continue;
+		}
+		auto tokenEnd = line.find_first_of(" \t", tokenBegin);
+		if (tokenEnd == std::string::npos)
+		{
+			tokenEnd = line.size();
+		}
+		const auto imgName = Utils::getFileName(line.substr(tokenBegin, tokenEnd - tokenBegin), true);
+		out << line.substr(0, tokenBegin) << newImgDir << "/" << imgName;
+		out.write(line.data() + tokenEnd, line.size() - tokenEnd);
+		if (!in.eof())
+		{
+			out << "\n";
+		}
+		views++;
+	}
+	if (views != num_views)
+	{
+		out.close();
+		Utils::RemoveFile(tempPath);
+		return 0;
+	}
+	//Everything after the cameras
+	if (in.peek() != std::char_traits<char>::eof())
+	{
+		out << in.rdbuf();
+	}
+	in.close();
+	out.close();
+	if (out.fail())
+	{
+		Utils::RemoveFile(tempPath);
+		return 0;
+	}
+	//Atomic replace of the original file
+	if (!MoveFileExW(Utils::s2ws(tempPath).c_str(), Utils::s2ws(camerasFilePath).c_str(),
+		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		Utils::RemoveFile(tempPath);
+		return 0;
+	}
+	return 1;
+}
+
 //NVM
 bool ImageIO::getNVMImagePaths(const std::string& nvmPath, std::vector<std::string>& imagePaths)
 {
@@ -243,66 +521,7 @@ bool ImageIO::getNVMImagePaths(const std::string& nvmPath, std::vector<std::stri
 
 bool ImageIO::replaceNVMImageDir(const std::string& nvmPath, const std::string& newImgDir)
 {
-	std::ifstream in(nvmPath.c_str());
-	std::stringstream out;
-	if (!in.good())
-	{
-		return 0;
-	}
-	//NVM_V3 line
-	std::string line;
-	std::getline(in, line, '\n');
-	out << line << "\n\n";
-	/* Read number of views. */
-	int num_views = 0;
-	in >> num_views;
-	out << num_views << "\n";
-	if (num_views < 0 || num_views > 10000)
-	{
-		return 0;
-	}
-	std::string imagePath;
-	std::string imgName;
-	for (int i = 0; i < num_views; ++i)
-	{
-		/* Filename*/
-		in >> imagePath;
-		imgName = Utils::getFileName(imagePath, true);
-		out << newImgDir << "/" << imgName << " ";
-		double temp;
-		for (int j = 0; j < 10; j++)
-		{
-			in >> temp;
-			if (j != 9)
-			{
-				out << temp << " ";
-			}
-			else
-			{
-				out << temp;
-			}
-		}
-		//Avoid double space when we finish the cameras
-		if (i < num_views - 1)
-		{
-			out << "\n";
-		}
-		in.eof();
-	}
-	while (getline(in, line, '\n'))
-	{
-		out << line << "\n";
-	}
-	in.close();
-	//Overwrite the file
-	std::ofstream outFile(nvmPath.c_str());
-	if (!outFile.good())
-	{
-		return 0;
-	}
-	outFile << out.rdbuf();
-	outFile.close();
-	return 1;
+	return streamReplaceImageDir(nvmPath, newImgDir, true);
 }
 
 unsigned int ImageIO::GetNumberOfCamerasNVM(const std::string & camerasFilePath)
@@ -335,10 +554,7 @@ Camera* ImageIO::getCameraFromNVMLine(const std::string & nvmLine)
 		return nullptr;
 	}
 	std::string filePath = tokens[0];
-	if (!Utils::exists(filePath))
-	{
-		return nullptr;
-	}
+	//False as well when the image doesn't exist
 	unsigned int width, height;
 	if (!getImageSize(filePath, width, height))
 	{
@@ -386,6 +602,8 @@ Camera* ImageIO::getCameraFromNVMLine(const std::string & nvmLine)
 std::string ImageIO::getNVMLineFromCamera(const Camera & camera)
 {
 	std::stringstream ss;
+	//Enough digits to read back the same values
+	ss.precision(17);
 	ss << camera.filePath << " " << camera.getFocalX() << " ";
 	//MatrixR to quaternion
 	Eigen::Matrix3d matrixR;
@@ -468,66 +686,7 @@ bool ImageIO::getSFMImagePaths(const std::string& sfmPath, std::vector<std::stri
 
 bool ImageIO::replaceSFMImageDir(const std::string& sfmPath, const std::string& newImgDir)
 {
-	std::ifstream in(sfmPath.c_str());
-	std::stringstream out;
-	if (!in.good())
-	{
-		return 0;
-	}
-	// Read number of views.
-	int num_views = 0;
-	in >> num_views;
-	out << num_views << "\n";
-	//Empty line
-	std::string line;
-	std::getline(in, line, '\n');
-	out << line << "\n";
-	if (num_views < 0 || num_views > 10000)
-	{
-		return 0;
-	}
-	std::string imagePath;
-	std::string imgName;
-	for (int i = 0; i < num_views; ++i)
-	{
-		/* Filename*/
-		in >> imagePath;
-		imgName = Utils::getFileName(imagePath, true);
-		out << newImgDir << "/" << imgName << " ";
-		double temp;
-		for (int j = 0; j < 16; j++)
-		{
-			in >> temp;
-			if (j != 15)
-			{
-				out << temp << " ";
-			}
-			else
-			{
-				out << temp;
-			}
-		}
-		//Avoid double space when we finish the cameras
-		if (i < num_views - 1)
-		{
-			out << "\n";
-		}
-		in.eof();
-	}
-	while (getline(in, line, '\n'))
-	{
-		out << line << "\n";
-	}
-	in.close();
-	//Overwrite the file
-	std::ofstream outFile(sfmPath.c_str());
-	if (!outFile.good())
-	{
-		return 0;
-	}
-	outFile << out.rdbuf();
-	outFile.close();
-	return 1;
+	return streamReplaceImageDir(sfmPath, newImgDir, false);
 }
 
 unsigned int ImageIO::GetNumberOfCamerasSFM(const std::string & camerasFilePath)
@@ -558,10 +717,7 @@ Camera * ImageIO::getCameraFromSFMLine(const std::string & sfmLine)
 		return nullptr;
 	}
 	std::string filePath = tokens[0];
-	if (!Utils::exists(filePath))
-	{
-		return nullptr;
-	}
+	//False as well when the image doesn't exist
 	unsigned int width, height;
 	if (!getImageSize(filePath, width, height))
 	{
@@ -588,6 +744,8 @@ Camera * ImageIO::getCameraFromSFMLine(const std::string & sfmLine)
 std::string ImageIO::getSFMLineFromCamera(const Camera & camera)
 {
 	std::stringstream ss;
+	//Enough digits to read back the same values
+	ss.precision(17);
 	ss << camera.filePath << " ";
 	auto matrixRt = camera.getMatrixRt();
 	//Rotation
@@ -625,4 +783,81 @@ bool ImageIO::saveSFMFile(const std::string & filename, const std::vector<Camera
 	}
 	sfmFile.close();
 	return 1;
-}
\ No newline at end of file
+}
+
+//SCB
+bool ImageIO::loadCameraBundle(const std::string& bundlePath, std::vector<Camera*>& cameras)
+{
+	CameraBundle bundle;
+	if (!bundle.open(bundlePath))
+	{
+		return 0;
+	}
+	cameras.reserve(bundle.getNumberOfCameras());
+	for (uint32_t i = 0; i < bundle.getNumberOfCameras(); i++)
+	{
+		const auto& record = bundle.getCamera(i);
+		const std::string filePath = bundle.getImagePath(i);
+		if (!ImageMetadataCache::exists(filePath))
+		{
+			for (auto cam : cameras)
+			{
+				delete cam;
+			}
+			cameras.clear();
+			return 0;
+		}
+		Eigen::Matrix4d matrixRT = Eigen::Matrix4d::Identity();
+		for (int j = 0; j < 3; j++)
+		{
+			for (int k = 0; k < 4; k++)
+			{
+				matrixRT(j, k) = record.matrixRt[j * 4 + k];
+			}
+		}
+		cameras.emplace_back(new Camera(filePath, record.focalDistance, record.principalPoint, record.width, record.height, matrixRT));
+	}
+	sortCamerasByName(cameras);
+	return 1;
+}
+
+bool ImageIO::getCameraBundleImagePaths(const std::string& bundlePath, std::vector<std::string>& imagePaths)
+{
+	CameraBundle bundle;
+	if (!bundle.open(bundlePath))
+	{
+		return 0;
+	}
+	imagePaths.reserve(bundle.getNumberOfCameras());
+	for (uint32_t i = 0; i < bundle.getNumberOfCameras(); i++)
+	{
+		imagePaths.emplace_back(bundle.getImagePath(i));
+	}
+	return 1;
+}
+
+bool ImageIO::replaceCameraBundleImageDir(const std::string& bundlePath, const std::string& newImgDir)
+{
+	std::vector<CameraBundleFormat::CameraRecord> records;
+	std::vector<std::string> imagePaths;
+	std::vector<CameraBundleFormat::SparsePoint> points;
+	{
+		CameraBundle bundle;
+		if (!bundle.open(bundlePath))
+		{
+			return 0;
+		}
+		records.reserve(bundle.getNumberOfCameras());
+		imagePaths.reserve(bundle.getNumberOfCameras());
+		for (uint32_t i = 0; i < bundle.getNumberOfCameras(); i++)
+		{
+			records.emplace_back(bundle.getCamera(i));
+			imagePaths.emplace_back(newImgDir + "/" + Utils::getFileName(bundle.getImagePath(i), true));
+		}
+		if (bundle.getNumberOfPoints() > 0)
+		{
+			points.assign(bundle.getPoints(), bundle.getPoints() + bundle.getNumberOfPoints());
+		}
+	}
+	return CameraBundle::write(bundlePath, records, imagePaths, points);
+}
@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 
+#include "CameraBundle.h"
+
 class Camera;
 namespace easyexif
 {
@@ -12,7 +14,10 @@ namespace easyexif
 class ImageIO
 {
 public:
+	//Size from the metadata cache (see ImageMetadataCache), the image is opened only the first time
 	static bool getImageSize(const std::string& imagePath, unsigned int& width, unsigned int& height);
+	//Size read from the image
+	static bool readImageSize(const std::string& imagePath, unsigned int& width, unsigned int& height);
 
 	//Test if image paths exist
 	static bool getImagePathsExist(std::vector<std::string> &imagePaths, const std::string& newImageDir = "");
@@ -32,9 +37,24 @@ public:
 	//Output
 	static bool saveCameras(const std::string& camerasFilePath, const std::vector<Camera*> &cameras);
 
+	//Camera bundle (.scb)
+	static bool saveCameraBundle(const std::string& bundlePath, const std::vector<Camera*> &cameras,
+		const std::vector<CameraBundleFormat::SparsePoint> &points = {});
+	static bool loadCameraBundlePoints(const std::string& bundlePath, std::vector<CameraBundleFormat::SparsePoint> &points);
+
+	//COLMAP binary model (cameras.bin, images.bin, points3D.bin)
+	//Image names of the model are relative to imagesDir
+	static bool loadCOLMAPModel(const std::string& modelDir, const std::string& imagesDir, std::vector<Camera*> &cameras);
+	static bool saveCOLMAPModel(const std::string& modelDir, const std::vector<Camera*> &cameras);
+	//Convert a COLMAP model to a nvm/sfm/scb file, the sparse points are kept in the .scb
+	static bool convertCOLMAPModel(const std::string& modelDir, const std::string& imagesDir, const std::string& camerasFilePath);
+
 
 private:
 
+	//Rewrite only the image paths of a nvm/sfm file, streaming to a temp file that replaces the original
+	static bool streamReplaceImageDir(const std::string& camerasFilePath, const std::string& newImgDir, bool isNVM);
+
 	//NVM
 	//Get the image paths from a NVM file
 	static bool getNVMImagePaths(const std::string& nvmPath, std::vector<std::string> &imagePaths);
@@ -59,4 +79,9 @@ private:
 	static std::string getSFMLineFromCamera(const Camera& camera);
 	static bool saveSFMFile(const std::string& filename, const std::vector<Camera*> &cameras);
 
+	//SCB
+	static bool loadCameraBundle(const std::string& bundlePath, std::vector<Camera*> &cameras);
+	static bool getCameraBundleImagePaths(const std::string& bundlePath, std::vector<std::string> &imagePaths);
+	static bool replaceCameraBundleImageDir(const std::string& bundlePath, const std::string& newImgDir);
+
 };
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "ImageIngestion.h"
+
+#include <atomic>
+#include <thread>
+#include <map>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+
+#include <windows.h>
+
+#include "Utils.h"
+
+namespace
+{
+	// Files bigger than this skip the system cache when copied
+	const unsigned long long unbufferedCopySize = 8 * 1024 * 1024;
+
+	enum class IngestionMethod
+	{
+		Renamed,
+		Linked,
+		Copied,
+		Failed
+	};
+}
+
+std::string ImageIngestion::Statistics::print() const
+{
+	const double megabytes = bytes / (1024.0 * 1024.0);
+	std::stringstream result;
+	result.precision(3);
+	result << std::fixed << (renamed + linked + copied) << " images, " << megabytes << " MB in " << seconds << " s";
+	if (seconds > 0)
+	{
+		result << " (" << megabytes / seconds << " MB/s)";
+	}
+	result << " - renamed " << renamed << ", linked " << linked << ", copied " << copied << ", failed " << failed;
+	if (!keptSourcePaths.empty())
+	{
+		result << ", sources not removed " << keptSourcePaths.size();
+	}
+	return result.str();
+}
+
+bool ImageIngestion::ingest(const std::vector<std::string>& imagePaths, const std::string& destinationDir, bool moveImages,
+	unsigned int maxWorkers, const ProgressCallback& progress, Statistics& statistics)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const std::string destinationVolume = getVolume(destinationDir);
+	//Same volume test for each source directory
+	std::map<std::string, bool> sameVolume;
+	for (const auto& path : imagePaths)
+	{
+		const auto dir = Utils::getPath(path, false);
+		if (sameVolume.find(dir) == sameVolume.end())
+		{
+			sameVolume[dir] = !destinationVolume.empty() && getVolume(dir) == destinationVolume;
+		}
+	}
+
+	std::vector<IngestionMethod> methods(imagePaths.size(), IngestionMethod::Failed);
+	std::vector<unsigned long long> sizes(imagePaths.size(), 0);
+	std::vector<char> sourcesKept(imagePaths.size(), 0);
+	std::atomic<size_t> nextImage(0);
+	std::atomic<unsigned int> processedImages(0);
+	auto worker = [&]()
+	{
+		for (size_t i = nextImage++; i < imagePaths.size(); i = nextImage++)
+		{
+			const auto& source = imagePaths[i];
+			const auto destination = destinationDir + "\\" + Utils::getFileName(source);
+			const std::wstring wideSource = Utils::s2ws(source);
+			const std::wstring wideDestination = Utils::s2ws(destination);
+			const unsigned long long sourceSize = getFileSize(source);
+			IngestionMethod method = IngestionMethod::Failed;
+			if (sameVolume.at(Utils::getPath(source, false)))
+			{
+				if (moveImages && MoveFileExW(wideSource.c_str(), wideDestination.c_str(), 0))
+				{
+					method = IngestionMethod::Renamed;
+				}
+				else if (!moveImages && CreateHardLinkW(wideDestination.c_str(), wideSource.c_str(), NULL))
+				{
+					method = IngestionMethod::Linked;
+				}
+			}
+			if (method == IngestionMethod::Failed)
+			{
+				const DWORD flags = sourceSize > unbufferedCopySize ? COPY_FILE_NO_BUFFERING : 0;
+				if (CopyFileExW(wideSource.c_str(), wideDestination.c_str(), NULL, NULL, NULL, flags))
+				{
+					method = IngestionMethod::Copied;
+				}
+			}
+			//Verify the new file
+			if (method != IngestionMethod::Failed && getFileSize(destination) != sourceSize)
+			{
+				if (method == IngestionMethod::Renamed)
+				{
+					//The destination is the only copy of the image, it goes back or stays where it is
+					MoveFileExW(wideDestination.c_str(), wideSource.c_str(), 0);
+				}
+				else
+				{
+					DeleteFileW(wideDestination.c_str());
+				}
+				method = IngestionMethod::Failed;
+			}
+			//Different volumes, the move is a copy followed by the removal of the source
+			if (method == IngestionMethod::Copied && moveImages && !DeleteFileW(wideSource.c_str()))
+			{
+				sourcesKept[i] = 1;
+			}
+			methods[i] = method;
+			sizes[i] = sourceSize;
+			processedImages++;
+		}
+	};
+	const unsigned int numWorkers = std::max(1u, std::min<unsigned int>(maxWorkers, static_cast<unsigned int>(imagePaths.size())));
+	std::vector<std::thread> workers;
+	for (unsigned int i = 0; i < numWorkers; i++)
+	{
+		workers.emplace_back(worker);
+	}
+	//Progress is reported from the calling thread, so it can update the UI
+	while (processedImages < imagePaths.size())
+	{
+		if (progress)
+		{
+			progress(processedImages);
+		}
+		Sleep(100);
+	}
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+	if (progress)
+	{
+		progress(processedImages);
+	}
+	for (size_t i = 0; i < imagePaths.size(); i++)
+	{
+		switch (methods[i])
+		{
+		case IngestionMethod::Renamed:
+			statistics.renamed++;
+			break;
+		case IngestionMethod::Linked:
+			statistics.linked++;
+			break;
+		case IngestionMethod::Copied:
+			statistics.copied++;
+			break;
+		default:
+			statistics.failed++;
+			statistics.failedPaths.emplace_back(imagePaths[i]);
+			continue;
+		}
+		statistics.bytes += sizes[i];
+		if (sourcesKept[i])
+		{
+			statistics.keptSourcePaths.emplace_back(imagePaths[i]);
+		}
+	}
+	statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return statistics.failed == 0;
+}
+
+std::string ImageIngestion::getVolume(const std::string& path)
+{
+	wchar_t volume[MAX_PATH];
+	if (!GetVolumePathNameW(Utils::s2ws(path).c_str(), volume, MAX_PATH))
+	{
+		return "";
+	}
+	const std::wstring wideVolume(volume);
+	return std::string(wideVolume.begin(), wideVolume.end());
+}
+
+unsigned long long ImageIngestion::getFileSize(const std::string& path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExW(Utils::s2ws(path).c_str(), GetFileExInfoStandard, &attributes))
+	{
+		return 0;
+	}
+	return (static_cast<unsigned long long>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+}
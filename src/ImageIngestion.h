@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+class ImageIngestion
+{
+public:
+	struct Statistics
+	{
+		unsigned int renamed = 0;
+		unsigned int linked = 0;
+		unsigned int copied = 0;
+		unsigned int failed = 0;
+		unsigned long long bytes = 0;
+		double seconds = 0;
+		std::vector<std::string> failedPaths;
+		// Moved across volumes, copied but the source could not be removed
+		std::vector<std::string> keptSourcePaths;
+
+		std::string print() const;
+	};
+
+	// Called from the thread that called ingest, with the number of processed images
+	typedef std::function<void(unsigned int)> ProgressCallback;
+
+	// Bring the images to destinationDir.
+	// When the source and the destination are in the same volume the images are renamed (move) or hard linked (copy),
+	// otherwise they are copied by a pool of maxWorkers threads. The size of every new file is verified, a renamed image
+	// that fails it is moved back to its source.
+	static bool ingest(const std::vector<std::string>& imagePaths, const std::string& destinationDir, bool moveImages,
+		unsigned int maxWorkers, const ProgressCallback& progress, Statistics& statistics);
+
+private:
+	static std::string getVolume(const std::string& path);
+	static unsigned long long getFileSize(const std::string& path);
+};
@@ -0,0 +1,455 @@
+#include "ImageMetadataCache.h"
+
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <cctype>
+
+#include <windows.h>
+#include <omp.h>
+
+#include <wx/log.h>
+
+#include "ImageIO.h"
+#include "Tracer.h"
+#include "Utils.h"
+
+namespace
+{
+	// Time a listing of a folder is trusted, about a burst of lookups such as the load of a camera file
+	const double listingSeconds = 10;
+	const uint32_t tableMagic = 0x434D4953;
+	const uint32_t tableVersion = 1;
+
+	struct FileStamp
+	{
+		uint64_t size = 0;
+		int64_t modificationTime = 0;
+	};
+
+	struct Folder
+	{
+		// Empty when the folder is cached only for the session
+		std::string tablePath;
+		bool changed = false;
+		// By lower case file name
+		std::unordered_map<std::string, ImageMetadata> entries;
+		std::unordered_map<std::string, FileStamp> listing;
+		// 0 without a listing
+		double listingTime = 0;
+	};
+
+	std::mutex mutex;
+	// By lower case path with '/' separators, never erased so the references stay valid
+	std::unordered_map<std::string, Folder> folders;
+
+	template <typename T>
+	bool readValue(std::istream& stream, T& value)
+	{
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	template <typename T>
+	void writeValue(std::ostream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	double getTime()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Windows paths are case insensitive
+	std::string getKey(const std::string& path)
+	{
+		std::string key = path;
+		std::replace(key.begin(), key.end(), '\\', '/');
+		std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		while (key.size() > 1 && key.back() == '/')
+		{
+			key.pop_back();
+		}
+		return key;
+	}
+
+	void splitPath(const std::string& path, std::string& folder, std::string& name)
+	{
+		const auto key = getKey(path);
+		const auto separator = key.find_last_of('/');
+		if (separator == std::string::npos)
+		{
+			folder = ".";
+			name = key;
+			return;
+		}
+		folder = key.substr(0, separator);
+		name = key.substr(separator + 1);
+	}
+
+	FileStamp getStamp(DWORD sizeHigh, DWORD sizeLow, const FILETIME& time)
+	{
+		FileStamp stamp;
+		stamp.size = (static_cast<uint64_t>(sizeHigh) << 32) | sizeLow;
+		stamp.modificationTime = static_cast<int64_t>((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime);
+		return stamp;
+	}
+
+	bool statFile(const std::string& path, FileStamp& stamp)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (!GetFileAttributesExW(Utils::s2ws(path).c_str(), GetFileExInfoStandard, &attributes) ||
+			(attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		{
+			return 0;
+		}
+		stamp = getStamp(attributes.nFileSizeHigh, attributes.nFileSizeLow, attributes.ftLastWriteTime);
+		return 1;
+	}
+
+	// Files of a folder in one enumeration, over the network it costs about as much as one request per file
+	std::unordered_map<std::string, FileStamp> listFolder(const std::string& folder)
+	{
+		std::unordered_map<std::string, FileStamp> listing;
+		WIN32_FIND_DATAW data;
+		const HANDLE find = FindFirstFileExW(Utils::s2ws(folder + "/*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+			NULL, FIND_FIRST_EX_LARGE_FETCH);
+		if (find == INVALID_HANDLE_VALUE)
+		{
+			return listing;
+		}
+		do
+		{
+			if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			{
+				listing[getKey(wxString(data.cFileName).ToStdString())] = getStamp(data.nFileSizeHigh, data.nFileSizeLow, data.ftLastWriteTime);
+			}
+		} while (FindNextFileW(find, &data));
+		FindClose(find);
+		return listing;
+	}
+
+	// Size and time of the file now, from the listing of its folder when there is one
+	bool getFileStamp(const std::string& path, FileStamp& stamp)
+	{
+		std::string folderKey, name;
+		splitPath(path, folderKey, name);
+		bool expired = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			const auto folder = folders.find(folderKey);
+			if (folder != folders.end() && folder->second.listingTime > 0)
+			{
+				expired = getTime() - folder->second.listingTime >= listingSeconds;
+				if (expired)
+				{
+					//Taken again by this lookup, the others keep using the old one meanwhile
+					folder->second.listingTime = getTime();
+				}
+				else
+				{
+					const auto file = folder->second.listing.find(name);
+					if (file != folder->second.listing.end())
+					{
+						stamp = file->second;
+						return 1;
+					}
+				}
+			}
+		}
+		if (expired)
+		{
+			auto listing = listFolder(folderKey);
+			std::lock_guard<std::mutex> lock(mutex);
+			auto& folderListing = folders[folderKey].listing;
+			folderListing.swap(listing);
+			const auto file = folderListing.find(name);
+			if (file != folderListing.end())
+			{
+				stamp = file->second;
+				return 1;
+			}
+		}
+		//Not listed or created after the listing
+		return statFile(path, stamp);
+	}
+
+	// Entry of the current file, whatever its size and time when stamp is null
+	bool findEntry(const std::string& folderKey, const std::string& name, const FileStamp* stamp, ImageMetadata& metadata)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto folder = folders.find(folderKey);
+		if (folder == folders.end())
+		{
+			return 0;
+		}
+		const auto entry = folder->second.entries.find(name);
+		if (entry == folder->second.entries.end())
+		{
+			return 0;
+		}
+		if (stamp && (entry->second.size != stamp->size || entry->second.modificationTime != stamp->modificationTime))
+		{
+			return 0;
+		}
+		metadata = entry->second;
+		return 1;
+	}
+
+	void storeEntry(const std::string& folderKey, const std::string& name, const ImageMetadata& metadata)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& folder = folders[folderKey];
+		folder.entries[name] = metadata;
+		folder.changed = true;
+	}
+}
+
+bool ImageMetadataCache::build(const std::string& imagesFolder, const std::string& tablePath, unsigned int maxWorkers,
+	const std::vector<std::string>& sourcePaths)
+{
+	Tracer::Span span("Image metadata", "io", imagesFolder);
+	const auto folderKey = getKey(imagesFolder);
+	std::vector<std::pair<std::string, ImageMetadata>> tableEntries;
+	if (Utils::exists(tablePath) && !readTable(tablePath, tableEntries))
+	{
+		wxLogWarning("Could not read the image metadata of %s, it will be read again", tablePath);
+		tableEntries.clear();
+	}
+	const auto listing = listFolder(folderKey);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& folder = folders[folderKey];
+		folder.tablePath = tablePath;
+		//The entries of the session are as recent as the table
+		for (const auto& entry : tableEntries)
+		{
+			folder.entries.emplace(entry.first, entry.second);
+		}
+		folder.listing = listing;
+		folder.listingTime = getTime();
+	}
+	//The ingestion keeps the file names
+	std::unordered_map<std::string, std::string> sourceFolders;
+	for (const auto& sourcePath : sourcePaths)
+	{
+		std::string sourceFolder, name;
+		splitPath(sourcePath, sourceFolder, name);
+		sourceFolders[name] = sourceFolder;
+	}
+	std::vector<std::pair<std::string, FileStamp>> changedImages;
+	for (const auto& file : listing)
+	{
+		const auto extension = Utils::toUpper(Utils::getFileExtension(file.first));
+		if (extension != "JPG" && extension != "JPEG")
+		{
+			continue;
+		}
+		ImageMetadata metadata;
+		if (findEntry(folderKey, file.first, &file.second, metadata))
+		{
+			continue;
+		}
+		const auto sourceFolder = sourceFolders.find(file.first);
+		if (sourceFolder != sourceFolders.end() && findEntry(sourceFolder->second, file.first, &file.second, metadata))
+		{
+			storeEntry(folderKey, file.first, metadata);
+			continue;
+		}
+		changedImages.emplace_back(file.first, file.second);
+	}
+	//Network bound, the workers can be more than the cores
+	const int numThreads = static_cast<int>(std::max(1u, maxWorkers));
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+	for (int i = 0; i < static_cast<int>(changedImages.size()); i++)
+	{
+		ImageMetadata metadata;
+		readImage(folderKey + "/" + changedImages[i].first, metadata);
+		metadata.size = changedImages[i].second.size;
+		metadata.modificationTime = changedImages[i].second.modificationTime;
+		storeEntry(folderKey, changedImages[i].first, metadata);
+	}
+	return save();
+}
+
+bool ImageMetadataCache::get(const std::string& imagePath, ImageMetadata& metadata)
+{
+	FileStamp stamp;
+	if (!getFileStamp(imagePath, stamp))
+	{
+		return 0;
+	}
+	std::string folderKey, name;
+	splitPath(imagePath, folderKey, name);
+	if (findEntry(folderKey, name, &stamp, metadata))
+	{
+		return 1;
+	}
+	metadata = ImageMetadata();
+	readImage(imagePath, metadata);
+	metadata.size = stamp.size;
+	metadata.modificationTime = stamp.modificationTime;
+	storeEntry(folderKey, name, metadata);
+	return 1;
+}
+
+bool ImageMetadataCache::find(const std::string& imagePath, ImageMetadata& metadata)
+{
+	FileStamp stamp;
+	if (!getFileStamp(imagePath, stamp))
+	{
+		return 0;
+	}
+	std::string folderKey, name;
+	splitPath(imagePath, folderKey, name);
+	return findEntry(folderKey, name, &stamp, metadata);
+}
+
+bool ImageMetadataCache::set(const std::string& imagePath, const ImageMetadata& metadata)
+{
+	FileStamp stamp;
+	if (!getFileStamp(imagePath, stamp))
+	{
+		return 0;
+	}
+	std::string folderKey, name;
+	splitPath(imagePath, folderKey, name);
+	ImageMetadata entry = metadata;
+	entry.size = stamp.size;
+	entry.modificationTime = stamp.modificationTime;
+	storeEntry(folderKey, name, entry);
+	return 1;
+}
+
+bool ImageMetadataCache::exists(const std::string& imagePath)
+{
+	FileStamp stamp;
+	return getFileStamp(imagePath, stamp);
+}
+
+bool ImageMetadataCache::save()
+{
+	std::vector<std::pair<std::string, std::vector<std::pair<std::string, ImageMetadata>>>> tables;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& folder : folders)
+		{
+			if (folder.second.tablePath.empty() || !folder.second.changed)
+			{
+				continue;
+			}
+			tables.emplace_back(folder.second.tablePath, std::vector<std::pair<std::string, ImageMetadata>>(
+				folder.second.entries.begin(), folder.second.entries.end()));
+			folder.second.changed = false;
+		}
+	}
+	bool saved = true;
+	for (const auto& table : tables)
+	{
+		if (!writeTable(table.first, table.second))
+		{
+			wxLogError("Could not write the image metadata %s", table.first);
+			saved = false;
+		}
+	}
+	return saved;
+}
+
+bool ImageMetadataCache::readImage(const std::string& imagePath, ImageMetadata& metadata)
+{
+	metadata.hasExif = ExifReader::read(imagePath, metadata.exif);
+	if (!ImageIO::readImageSize(imagePath, metadata.width, metadata.height))
+	{
+		metadata.width = 0;
+		metadata.height = 0;
+		return 0;
+	}
+	return 1;
+}
+
+bool ImageMetadataCache::readTable(const std::string& tablePath, std::vector<std::pair<std::string, ImageMetadata>>& entries)
+{
+	std::ifstream file(tablePath, std::ios::binary);
+	uint32_t magic = 0, version = 0;
+	uint64_t numEntries = 0;
+	if (!readValue(file, magic) || !readValue(file, version) || !readValue(file, numEntries) ||
+		magic != tableMagic || version != tableVersion)
+	{
+		return 0;
+	}
+	entries.clear();
+	for (uint64_t i = 0; i < numEntries; i++)
+	{
+		uint16_t nameLength = 0;
+		if (!readValue(file, nameLength))
+		{
+			return 0;
+		}
+		std::string name(nameLength, '\0');
+		ImageMetadata metadata;
+		uint8_t flags = 0;
+		if (!file.read(&name[0], nameLength) || !readValue(file, metadata.size) || !readValue(file, metadata.modificationTime) ||
+			!readValue(file, metadata.width) || !readValue(file, metadata.height) || !readValue(file, flags) ||
+			!readValue(file, metadata.exif.latitude) || !readValue(file, metadata.exif.longitude) ||
+			!readValue(file, metadata.exif.altitude) || !readValue(file, metadata.exif.captureTime) ||
+			!readValue(file, metadata.analysisWidth) || !readValue(file, metadata.sharpness) ||
+			!readValue(file, metadata.meanLuminance) || !readValue(file, metadata.clippedFraction) || !readValue(file, metadata.hash))
+		{
+			return 0;
+		}
+		metadata.hasExif = (flags & 1) != 0;
+		metadata.exif.hasGPS = (flags & 2) != 0;
+		metadata.exif.hasCaptureTime = (flags & 4) != 0;
+		entries.emplace_back(name, metadata);
+	}
+	return 1;
+}
+
+bool ImageMetadataCache::writeTable(const std::string& tablePath, const std::vector<std::pair<std::string, ImageMetadata>>& entries)
+{
+	//Written aside and replaced, a run interrupted doesn't leave half a table
+	const auto tempPath = tablePath + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary);
+	if (!file.is_open())
+	{
+		return 0;
+	}
+	writeValue(file, tableMagic);
+	writeValue(file, tableVersion);
+	writeValue(file, static_cast<uint64_t>(entries.size()));
+	for (const auto& entry : entries)
+	{
+		const auto& metadata = entry.second;
+		const uint8_t flags = (metadata.hasExif ? 1 : 0) | (metadata.exif.hasGPS ? 2 : 0) | (metadata.exif.hasCaptureTime ? 4 : 0);
+		writeValue(file, static_cast<uint16_t>(entry.first.size()));
+		file.write(entry.first.data(), entry.first.size());
+		writeValue(file, metadata.size);
+		writeValue(file, metadata.modificationTime);
+		writeValue(file, metadata.width);
+		writeValue(file, metadata.height);
+		writeValue(file, flags);
+		writeValue(file, metadata.exif.latitude);
+		writeValue(file, metadata.exif.longitude);
+		writeValue(file, metadata.exif.altitude);
+		writeValue(file, metadata.exif.captureTime);
+		writeValue(file, metadata.analysisWidth);
+		writeValue(file, metadata.sharpness);
+		writeValue(file, metadata.meanLuminance);
+		writeValue(file, metadata.clippedFraction);
+		writeValue(file, metadata.hash);
+	}
+	file.close();
+	if (file.fail())
+	{
+		Utils::RemoveFile(tempPath);
+		return 0;
+	}
+	if (!MoveFileExW(Utils::s2ws(tempPath).c_str(), Utils::s2ws(tablePath).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		Utils::RemoveFile(tempPath);
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "ExifReader.h"
+
+struct ImageMetadata
+{
+	// Identity of the file the metadata was read from, a change of either invalidates it
+	uint64_t size = 0;
+	// Last write time, in 100 ns since 1601
+	int64_t modificationTime = 0;
+	// 0 when the image could not be read
+	unsigned int width = 0;
+	unsigned int height = 0;
+	bool hasExif = false;
+	ExifData exif;
+	// Measures of the pre-screening (see ImagePreScreen), 0 when the image was not analyzed at this width
+	int analysisWidth = 0;
+	double sharpness = 0;
+	double meanLuminance = 0;
+	double clippedFraction = 0;
+	uint64_t hash = 0;
+};
+
+// Size, EXIF and pre-screening measures of the images, so they are read once instead of on every load of a camera
+// file. An entry is valid while the size and the modification time of its file don't change. The table of the images
+// folder of a project is kept in the project, the other folders are cached for the session.
+// The files of a folder built or attached are checked against a listing of the folder, taken again after a few seconds,
+// instead of one request per file.
+class ImageMetadataCache
+{
+public:
+	// Loads the table of imagesFolder from tablePath (if there is one) and reads in parallel the JPEG images of the folder
+	// that are not in it or changed, then saves it. The images ingested from sourcePaths reuse the entries of their
+	// sources when they kept the size and the time (a rename, a hard link or a copy)
+	static bool build(const std::string& imagesFolder, const std::string& tablePath, unsigned int maxWorkers,
+		const std::vector<std::string>& sourcePaths = {});
+
+	// Metadata of an image, read and added when it is not in the cache or changed. False if the image doesn't exist
+	static bool get(const std::string& imagePath, ImageMetadata& metadata);
+	// Only a valid entry, without reading the image
+	static bool find(const std::string& imagePath, ImageMetadata& metadata);
+	// Replaces the entry of an image read elsewhere, the size and the time are the ones of the file now
+	static bool set(const std::string& imagePath, const ImageMetadata& metadata);
+	static bool exists(const std::string& imagePath);
+
+	// Writes the tables of the project folders that changed
+	static bool save();
+
+private:
+	static bool readImage(const std::string& imagePath, ImageMetadata& metadata);
+	static bool readTable(const std::string& tablePath, std::vector<std::pair<std::string, ImageMetadata>>& entries);
+	static bool writeTable(const std::string& tablePath, const std::vector<std::pair<std::string, ImageMetadata>>& entries);
+};
@@ -0,0 +1,264 @@
+#include "ImagePreScreen.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+
+#include <omp.h>
+
+#include <wx/image.h>
+
+#include "ImageMetadataCache.h"
+#include "Utils.h"
+
+std::string PreScreen::Options::print() const
+{
+	std::stringstream s;
+	s << "Min relative sharpness " << minRelativeSharpness << "\n" <<
+		"Max clipped fraction " << maxClippedFraction << "\n" <<
+		"Max duplicate distance " << maxDuplicateDistance << "\n" <<
+		"Analysis width " << analysisWidth << "\n";
+	return s.str();
+}
+
+std::vector<ImagePreScreen::ImageMetrics> ImagePreScreen::run(const std::vector<std::string>& imagePaths, const PreScreen::Options& options,
+	std::vector<std::string>& acceptedPaths, const ProgressCallback& progress, size_t minImages)
+{
+	//Sorted by name, so consecutive frames of a video or a flight are neighbors
+	std::vector<std::string> sortedPaths = imagePaths;
+	std::sort(sortedPaths.begin(), sortedPaths.end());
+	std::vector<ImageMetrics> metrics(sortedPaths.size());
+	std::atomic<unsigned int> analyzedImages(0);
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < static_cast<int>(sortedPaths.size()); i++)
+	{
+		metrics[i].path = sortedPaths[i];
+		//Measured before at the same width, by another run or the reconstruction of the images
+		ImageMetadata metadata;
+		const bool cached = ImageMetadataCache::find(sortedPaths[i], metadata);
+		if (cached && metadata.analysisWidth == options.analysisWidth)
+		{
+			metrics[i].valid = true;
+			metrics[i].width = metadata.width;
+			metrics[i].height = metadata.height;
+			metrics[i].sharpness = metadata.sharpness;
+			metrics[i].meanLuminance = metadata.meanLuminance;
+			metrics[i].clippedFraction = metadata.clippedFraction;
+			metrics[i].hash = metadata.hash;
+		}
+		else
+		{
+			metrics[i].valid = computeMetrics(sortedPaths[i], options.analysisWidth, metrics[i]);
+			if (metrics[i].valid)
+			{
+				//The decoded image gives the size, so the ingestion doesn't open it again
+				if (!cached)
+				{
+					metadata.hasExif = ExifReader::read(sortedPaths[i], metadata.exif);
+					metadata.width = metrics[i].width;
+					metadata.height = metrics[i].height;
+				}
+				metadata.analysisWidth = options.analysisWidth;
+				metadata.sharpness = metrics[i].sharpness;
+				metadata.meanLuminance = metrics[i].meanLuminance;
+				metadata.clippedFraction = metrics[i].clippedFraction;
+				metadata.hash = metrics[i].hash;
+				ImageMetadataCache::set(sortedPaths[i], metadata);
+			}
+		}
+		analyzedImages++;
+		//The master thread is the caller
+		if (progress && omp_get_thread_num() == 0)
+		{
+			progress(analyzedImages);
+		}
+	}
+	//Blur is relative to the set, absolute values depend on the camera and the scene
+	std::vector<double> sharpness;
+	for (const auto& imageMetrics : metrics)
+	{
+		if (imageMetrics.valid)
+		{
+			sharpness.emplace_back(imageMetrics.sharpness);
+		}
+	}
+	double medianSharpness = 0;
+	if (!sharpness.empty())
+	{
+		std::nth_element(sharpness.begin(), sharpness.begin() + sharpness.size() / 2, sharpness.end());
+		medianSharpness = sharpness[sharpness.size() / 2];
+	}
+	long lastAccepted = -1;
+	for (size_t i = 0; i < metrics.size(); i++)
+	{
+		auto& imageMetrics = metrics[i];
+		if (!imageMetrics.valid)
+		{
+			//Could not be analyzed, let the reconstruction decide
+			continue;
+		}
+		if (imageMetrics.sharpness < options.minRelativeSharpness * medianSharpness)
+		{
+			imageMetrics.rejection = "blurred";
+			continue;
+		}
+		if (imageMetrics.clippedFraction > options.maxClippedFraction)
+		{
+			imageMetrics.rejection = "exposure";
+			continue;
+		}
+		//Near duplicate of the last accepted image, keep the sharper one
+		if (lastAccepted >= 0 && hashDistance(imageMetrics.hash, metrics[lastAccepted].hash) <= options.maxDuplicateDistance)
+		{
+			if (imageMetrics.sharpness > metrics[lastAccepted].sharpness)
+			{
+				metrics[lastAccepted].rejection = "duplicate of " + Utils::getFileName(imageMetrics.path);
+				lastAccepted = static_cast<long>(i);
+			}
+			else
+			{
+				imageMetrics.rejection = "duplicate of " + Utils::getFileName(metrics[lastAccepted].path);
+			}
+			continue;
+		}
+		lastAccepted = static_cast<long>(i);
+	}
+	acceptedPaths.clear();
+	for (const auto& imageMetrics : metrics)
+	{
+		if (imageMetrics.rejection.empty())
+		{
+			acceptedPaths.emplace_back(imageMetrics.path);
+		}
+	}
+	if (acceptedPaths.size() < minImages)
+	{
+		for (auto& imageMetrics : metrics)
+		{
+			imageMetrics.rejection.clear();
+		}
+		acceptedPaths = sortedPaths;
+	}
+	return metrics;
+}
+
+bool ImagePreScreen::computeMetrics(const std::string& imagePath, int analysisWidth, ImageMetrics& metrics)
+{
+	wxImage image;
+	if (!image.LoadFile(imagePath, wxBITMAP_TYPE_JPEG) || !image.IsOk())
+	{
+		return 0;
+	}
+	metrics.width = image.GetWidth();
+	metrics.height = image.GetHeight();
+	if (image.GetWidth() > analysisWidth)
+	{
+		const int analysisHeight = std::max(1, image.GetHeight() * analysisWidth / image.GetWidth());
+		image.Rescale(analysisWidth, analysisHeight, wxIMAGE_QUALITY_NORMAL);
+	}
+	const int width = image.GetWidth();
+	const int height = image.GetHeight();
+	if (width < 9 || height < 8)
+	{
+		return 0;
+	}
+	//Luminance and exposure histogram
+	const unsigned char* rgb = image.GetData();
+	std::vector<float> gray(width * height);
+	unsigned int histogram[256] = { 0 };
+	double luminanceSum = 0;
+	for (int i = 0; i < width * height; i++)
+	{
+		const float luminance = 0.299f * rgb[i * 3] + 0.587f * rgb[i * 3 + 1] + 0.114f * rgb[i * 3 + 2];
+		gray[i] = luminance;
+		histogram[std::min(255, static_cast<int>(luminance))]++;
+		luminanceSum += luminance;
+	}
+	const int clippedBins = 5;
+	unsigned int clipped = 0;
+	for (int i = 0; i < clippedBins; i++)
+	{
+		clipped += histogram[i] + histogram[255 - i];
+	}
+	metrics.meanLuminance = luminanceSum / (width * height);
+	metrics.clippedFraction = static_cast<double>(clipped) / (width * height);
+	//Sharpness, variance of the laplacian
+	double sum = 0, squaredSum = 0;
+	for (int y = 1; y < height - 1; y++)
+	{
+		for (int x = 1; x < width - 1; x++)
+		{
+			const int i = y * width + x;
+			const double laplacian = gray[i - 1] + gray[i + 1] + gray[i - width] + gray[i + width] - 4.0 * gray[i];
+			sum += laplacian;
+			squaredSum += laplacian * laplacian;
+		}
+	}
+	const double count = static_cast<double>(width - 2) * (height - 2);
+	metrics.sharpness = squaredSum / count - (sum / count) * (sum / count);
+	//Difference hash over a 9x8 box averaged thumbnail
+	float thumbnail[8][9];
+	for (int ty = 0; ty < 8; ty++)
+	{
+		for (int tx = 0; tx < 9; tx++)
+		{
+			const int x0 = tx * width / 9, x1 = std::max(x0 + 1, (tx + 1) * width / 9);
+			const int y0 = ty * height / 8, y1 = std::max(y0 + 1, (ty + 1) * height / 8);
+			double cellSum = 0;
+			for (int y = y0; y < y1; y++)
+			{
+				for (int x = x0; x < x1; x++)
+				{
+					cellSum += gray[y * width + x];
+				}
+			}
+			thumbnail[ty][tx] = static_cast<float>(cellSum / ((x1 - x0) * (y1 - y0)));
+		}
+	}
+	metrics.hash = 0;
+	for (int ty = 0; ty < 8; ty++)
+	{
+		for (int tx = 0; tx < 8; tx++)
+		{
+			metrics.hash = (metrics.hash << 1) | (thumbnail[ty][tx] < thumbnail[ty][tx + 1] ? 1 : 0);
+		}
+	}
+	return 1;
+}
+
+bool ImagePreScreen::writeReport(const std::string& reportPath, const std::vector<ImageMetrics>& metrics, const PreScreen::Options& options)
+{
+	std::ofstream report(reportPath);
+	if (!report.is_open())
+	{
+		return 0;
+	}
+	size_t rejected = 0;
+	for (const auto& imageMetrics : metrics)
+	{
+		rejected += imageMetrics.rejection.empty() ? 0 : 1;
+	}
+	report << "Pre-screen\n" << options.print();
+	report << "Images " << metrics.size() << " accepted " << metrics.size() - rejected << " rejected " << rejected << "\n";
+	report << "image sharpness mean_luminance clipped_fraction hash result\n";
+	for (const auto& imageMetrics : metrics)
+	{
+		report << Utils::getFileName(imageMetrics.path) << " ";
+		if (!imageMetrics.valid)
+		{
+			report << "- - - - not analyzed\n";
+			continue;
+		}
+		report << imageMetrics.sharpness << " " << imageMetrics.meanLuminance << " " << imageMetrics.clippedFraction << " " <<
+			std::hex << imageMetrics.hash << std::dec << " " <<
+			(imageMetrics.rejection.empty() ? "accepted" : "rejected, " + imageMetrics.rejection) << "\n";
+	}
+	return 1;
+}
+
+unsigned int ImagePreScreen::hashDistance(uint64_t hashA, uint64_t hashB)
+{
+	return static_cast<unsigned int>(std::bitset<64>(hashA ^ hashB).count());
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+namespace PreScreen
+{
+	struct Options
+	{
+		Options() {};
+		Options(double minRelativeSharpness, double maxClippedFraction, unsigned int maxDuplicateDistance, int analysisWidth) :
+			minRelativeSharpness(minRelativeSharpness), maxClippedFraction(maxClippedFraction),
+			maxDuplicateDistance(maxDuplicateDistance), analysisWidth(analysisWidth) {};
+		// Images with sharpness below this fraction of the median sharpness are blurred
+		double minRelativeSharpness = 0.3;
+		// Images with more than this fraction of black or saturated pixels are badly exposed
+		double maxClippedFraction = 0.5;
+		// Consecutive images whose hashes differ in up to this number of bits are near duplicates
+		unsigned int maxDuplicateDistance = 4;
+		// Width of the downscaled image used by the metrics
+		int analysisWidth = 512;
+
+		std::string print() const;
+	};
+}
+
+class ImagePreScreen
+{
+public:
+	struct ImageMetrics
+	{
+		std::string path;
+		bool valid = false;
+		// Of the original image
+		unsigned int width = 0;
+		unsigned int height = 0;
+		// Variance of the laplacian
+		double sharpness = 0;
+		double meanLuminance = 0;
+		double clippedFraction = 0;
+		// 64 bits difference hash
+		uint64_t hash = 0;
+		// Empty when the image is accepted
+		std::string rejection;
+	};
+
+	// Called from the thread that called run, with the number of analyzed images
+	typedef std::function<void(unsigned int)> ProgressCallback;
+
+	// Analyze the images in parallel and split them in accepted and rejected.
+	// The measures are kept in the ImageMetadataCache, the images analyzed before at the same width are not opened again.
+	// Nothing is rejected when less than minImages would be left.
+	static std::vector<ImageMetrics> run(const std::vector<std::string>& imagePaths, const PreScreen::Options& options,
+		std::vector<std::string>& acceptedPaths, const ProgressCallback& progress = nullptr, size_t minImages = 4);
+
+	static bool computeMetrics(const std::string& imagePath, int analysisWidth, ImageMetrics& metrics);
+
+	static bool writeReport(const std::string& reportPath, const std::vector<ImageMetrics>& metrics, const PreScreen::Options& options);
+
+	static unsigned int hashDistance(uint64_t hashA, uint64_t hashB);
+};
@@ -0,0 +1,328 @@
+#include "JobQueue.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <list>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+#include <windows.h>
+
+#include <wx/log.h>
+#include <wx/dir.h>
+#include <wx/filename.h>
+#include <wx/stdpaths.h>
+
+#include "StageBudget.h"
+#include "ReconstructionLog.h"
+#include "Cancellation.h"
+#include "Utils.h"
+#include "json.hpp"
+
+namespace
+{
+	const char* states[] = { "pending", "running", "done", "failed" };
+	const wchar_t* runnerMutexName = L"SAEScan3D_QueueRunner";
+
+	std::string getJobPath(const std::string& directory, const std::string& state, const std::string& id)
+	{
+		return directory + "\\" + state + "\\" + id + ".json";
+	}
+
+	// Units of the budget held by the job of a project, see StageBudget
+	std::string getHeldPath(const std::string& projectFolder)
+	{
+		return projectFolder + "\\budget.json";
+	}
+
+	bool readJob(const std::string& path, nlohmann::json& job)
+	{
+		std::ifstream jobFile(path);
+		if (!jobFile.is_open())
+		{
+			return 0;
+		}
+		try
+		{
+			job = nlohmann::json::parse(jobFile);
+		}
+		catch (const std::exception&)
+		{
+			return 0;
+		}
+		return job.is_object() && job.contains("projectFolder") && job["projectFolder"].is_string();
+	}
+
+	// Written beside the target and renamed, so a runner never reads half a job
+	bool writeJob(const std::string& path, const nlohmann::json& job)
+	{
+		const auto temporaryPath = path + ".tmp";
+		{
+			std::ofstream jobFile(temporaryPath);
+			if (!jobFile.is_open())
+			{
+				return 0;
+			}
+			jobFile << job.dump(2);
+		}
+		return wxRenameFile(temporaryPath, path, true);
+	}
+
+	// Ids of the jobs in a state, the oldest first
+	std::vector<std::string> getJobIds(const std::string& directory, const std::string& state)
+	{
+		std::vector<std::string> ids;
+		const auto stateDirectory = directory + "\\" + state;
+		if (!wxDirExists(stateDirectory))
+		{
+			return ids;
+		}
+		wxArrayString files;
+		wxDir::GetAllFiles(stateDirectory, &files, "*.json", wxDIR_FILES);
+		for (const auto& file : files)
+		{
+			ids.emplace_back(Utils::getFileName(file.ToStdString(), false));
+		}
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	}
+
+	// Moves a job to another state and updates it, a null job keeps the file as it is. False if it was not there anymore
+	bool moveJob(const std::string& directory, const std::string& id, const std::string& from, const std::string& to, const nlohmann::json& job)
+	{
+		const auto targetPath = getJobPath(directory, to, id);
+		if (!wxRenameFile(getJobPath(directory, from, id), targetPath, false))
+		{
+			return 0;
+		}
+		return job.is_null() || writeJob(targetPath, job);
+	}
+
+	// Submission time in milliseconds, so the names sort in the order of the queue
+	std::string createJobId()
+	{
+		static std::atomic<int> counter(0);
+		const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		std::stringstream id;
+		id << std::setfill('0') << std::setw(14) << milliseconds << "_" << GetCurrentProcessId() << "_" << counter++;
+		return id.str();
+	}
+}
+
+std::string Queue::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Directory " << directory << "\n" <<
+		"Max jobs " << maxJobs << "\n" <<
+		"CPU threads " << cpuThreads << "\n" <<
+		"Memory budget " << memoryBudget << "\n" <<
+		"GPUs " << gpus << "\n";
+	return parameters.str();
+}
+
+bool JobQueue::submit(const Queue::Options& options, const std::string& projectFolder, bool generateTexture)
+{
+	const auto directory = getDirectory(options);
+	if (!Utils::CreateDir(directory) || !Utils::CreateDir(directory + "\\pending"))
+	{
+		wxLogError(wxString("Could not create the queue " + directory));
+		return 0;
+	}
+	nlohmann::json job;
+	job["projectFolder"] = projectFolder;
+	job["generateTexture"] = generateTexture;
+	job["submitted"] = ReconstructionLog::getCurrentDateTime();
+	if (!writeJob(getJobPath(directory, "pending", createJobId()), job))
+	{
+		wxLogError(wxString("Could not add " + projectFolder + " to the queue"));
+		return 0;
+	}
+	return 1;
+}
+
+std::vector<Queue::Job> JobQueue::list(const Queue::Options& options)
+{
+	const auto directory = getDirectory(options);
+	std::vector<Queue::Job> jobs;
+	for (const auto state : states)
+	{
+		for (const auto& id : getJobIds(directory, state))
+		{
+			nlohmann::json json;
+			if (!readJob(getJobPath(directory, state, id), json))
+			{
+				continue;
+			}
+			Queue::Job job;
+			job.id = id;
+			job.projectFolder = json["projectFolder"].get<std::string>();
+			job.generateTexture = json.value("generateTexture", false);
+			job.state = state;
+			jobs.emplace_back(job);
+		}
+	}
+	return jobs;
+}
+
+bool JobQueue::run(const Queue::Options& options)
+{
+	HANDLE runnerMutex = CreateMutexW(NULL, TRUE, runnerMutexName);
+	if (runnerMutex == NULL || GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		wxLogError("Another queue runner is active");
+		if (runnerMutex != NULL)
+		{
+			CloseHandle(runnerMutex);
+		}
+		return 0;
+	}
+	const auto directory = getDirectory(options);
+	for (const auto state : states)
+	{
+		if (!Utils::CreateDir(directory + "\\" + state))
+		{
+			wxLogError(wxString("Could not create the queue " + directory));
+			CloseHandle(runnerMutex);
+			return 0;
+		}
+	}
+	//The semaphores live while the runner holds them, between the jobs too
+	if (!StageBudget::enable(options, ""))
+	{
+		CloseHandle(runnerMutex);
+		return 0;
+	}
+	wxLogMessage(wxString("Budget " + StageBudget::getTotal(options).print()));
+	Cancellation::reset();
+	//Jobs of a runner that stopped
+	for (const auto& id : getJobIds(directory, "running"))
+	{
+		nlohmann::json job;
+		if (!readJob(getJobPath(directory, "running", id), job))
+		{
+			moveJob(directory, id, "running", "failed", nlohmann::json());
+			continue;
+		}
+		StageBudget::releaseLeftover(getHeldPath(job["projectFolder"].get<std::string>()));
+		moveJob(directory, id, "running", "pending", job);
+	}
+	const auto executable = wxStandardPaths::Get().GetExecutablePath().ToStdString();
+	struct RunningJob
+	{
+		std::string id;
+		nlohmann::json job;
+		std::future<unsigned long> exitCode;
+	};
+	std::list<RunningJob> runningJobs;
+	while (true)
+	{
+		for (auto it = runningJobs.begin(); it != runningJobs.end();)
+		{
+			if (it->exitCode.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++it;
+				continue;
+			}
+			const auto exitCode = it->exitCode.get();
+			const auto projectFolder = it->job["projectFolder"].get<std::string>();
+			StageBudget::releaseLeftover(getHeldPath(projectFolder));
+			//Terminated by the cancellation, it runs again from its files with the next runner
+			if (exitCode != 0 && Cancellation::isCancelled())
+			{
+				it->job.erase("started");
+				moveJob(directory, it->id, "running", "pending", it->job);
+				wxLogMessage(wxString("Requeued " + projectFolder));
+				it = runningJobs.erase(it);
+				continue;
+			}
+			it->job["finished"] = ReconstructionLog::getCurrentDateTime();
+			it->job["exitCode"] = exitCode;
+			moveJob(directory, it->id, "running", exitCode == 0 ? "done" : "failed", it->job);
+			wxLogMessage(wxString((exitCode == 0 ? "Finished " : "Failed ") + projectFolder));
+			it = runningJobs.erase(it);
+		}
+		//Cancelled, no job starts and the runner exits once the running ones are terminated
+		const bool cancelled = Cancellation::isCancelled();
+		const auto pendingIds = cancelled ? std::vector<std::string>() : getJobIds(directory, "pending");
+		for (size_t i = 0; i < pendingIds.size() && runningJobs.size() < static_cast<size_t>(std::max(options.maxJobs, 1)); i++)
+		{
+			RunningJob runningJob;
+			runningJob.id = pendingIds[i];
+			if (!readJob(getJobPath(directory, "pending", runningJob.id), runningJob.job))
+			{
+				wxLogWarning(wxString("Invalid job " + runningJob.id));
+				moveJob(directory, runningJob.id, "pending", "failed", nlohmann::json());
+				continue;
+			}
+			runningJob.job["started"] = ReconstructionLog::getCurrentDateTime();
+			if (!moveJob(directory, runningJob.id, "pending", "running", runningJob.job))
+			{
+				continue;
+			}
+			const auto projectFolder = runningJob.job["projectFolder"].get<std::string>();
+			const auto command = "\"" + executable + "\" --reconstruct \"" + projectFolder + "\"" +
+				(runningJob.job.value("generateTexture", false) ? " --texture" : "") + " --budget";
+			runningJob.exitCode = std::async(std::launch::async, [command]()
+			{
+				unsigned long exitCode = 1;
+				if (!Utils::startProcess(command, "", exitCode))
+				{
+					return 1UL;
+				}
+				return exitCode;
+			});
+			wxLogMessage(wxString("Started " + projectFolder));
+			runningJobs.emplace_back(std::move(runningJob));
+		}
+		if (runningJobs.empty() && pendingIds.empty())
+		{
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+	ReleaseMutex(runnerMutex);
+	CloseHandle(runnerMutex);
+	return 1;
+}
+
+bool JobQueue::isRunnerActive()
+{
+	HANDLE runnerMutex = OpenMutexW(SYNCHRONIZE, FALSE, runnerMutexName);
+	if (runnerMutex == NULL)
+	{
+		return 0;
+	}
+	CloseHandle(runnerMutex);
+	return 1;
+}
+
+bool JobQueue::startRunner()
+{
+	std::wstring command = Utils::s2ws("\"" + wxStandardPaths::Get().GetExecutablePath().ToStdString() + "\" --run-queue");
+	STARTUPINFO si;
+	PROCESS_INFORMATION pi;
+	ZeroMemory(&si, sizeof(si));
+	si.cb = sizeof(si);
+	ZeroMemory(&pi, sizeof(pi));
+	if (!CreateProcess(NULL, &command[0], NULL, NULL, FALSE, CREATE_NEW_CONSOLE, NULL, NULL, &si, &pi))
+	{
+		wxLogError("CreateProcess failed (%d).\n", GetLastError());
+		return 0;
+	}
+	CloseHandle(pi.hProcess);
+	CloseHandle(pi.hThread);
+	return 1;
+}
+
+std::string JobQueue::getDirectory(const Queue::Options& options)
+{
+	if (!options.directory.empty())
+	{
+		return options.directory;
+	}
+	return Utils::getExecutionPath() + "\\queue";
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Queue
+{
+	struct Options
+	{
+		Options() {};
+		Options(const std::string& directory, int maxJobs, int cpuThreads, double memoryBudget, int gpus) :
+			directory(directory), maxJobs(maxJobs), cpuThreads(cpuThreads), memoryBudget(memoryBudget), gpus(gpus) {};
+		// Folder of the job files, empty uses the queue folder next to the executable
+		std::string directory;
+		// Jobs reconstructed at the same time, their stages wait for the budgets below
+		int maxJobs = 2;
+		// Budgets shared by the stages of every job in the machine, 0 uses all the threads and 75% of the physical memory (GB)
+		int cpuThreads = 0;
+		double memoryBudget = 0;
+		int gpus = 1;
+
+		std::string print() const;
+	};
+
+	struct Job
+	{
+		std::string id;
+		std::string projectFolder;
+		bool generateTexture = false;
+		// pending, running, done or failed
+		std::string state;
+	};
+}
+
+// Reconstruction of many projects from a folder of job files, one json file per job moved between the pending,
+// running, done and failed subfolders, so the queue survives the application. The runner starts each job as a child
+// process (--reconstruct <project> --budget) and the stages of the jobs share the machine through StageBudget, so
+// the light stages of a job run beside the heavy stages of another. Only one runner works in a machine.
+class JobQueue
+{
+public:
+	static bool submit(const Queue::Options& options, const std::string& projectFolder, bool generateTexture);
+	static std::vector<Queue::Job> list(const Queue::Options& options);
+
+	// Runs the pending jobs, and those submitted meanwhile, until the queue is empty. The jobs left running by a
+	// stopped runner are pending again
+	static bool run(const Queue::Options& options);
+	static bool isRunnerActive();
+	// Starts the runner in its own process and console
+	static bool startRunner();
+
+	static std::string getDirectory(const Queue::Options& options);
+};
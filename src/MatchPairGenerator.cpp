@@ -0,0 +1,186 @@
+#include "MatchPairGenerator.h"
+
+#include <fstream>
+#include <set>
+#include <algorithm>
+#include <numeric>
+
+#include <wx/dir.h>
+
+#include "ImageMetadataCache.h"
+#include "SpatialIndex.h"
+#include "Utils.h"
+
+namespace
+{
+	void addPair(std::set<MatchPairGenerator::Pair>& pairs, size_t a, size_t b)
+	{
+		if (a != b)
+		{
+			pairs.insert(std::make_pair(std::min(a, b), std::max(a, b)));
+		}
+	}
+
+	void addOrderedNeighbors(std::set<MatchPairGenerator::Pair>& pairs, const std::vector<size_t>& order, size_t neighbors)
+	{
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			for (size_t j = i + 1; j < std::min(order.size(), i + 1 + neighbors); j++)
+			{
+				addPair(pairs, order[i], order[j]);
+			}
+		}
+	}
+}
+
+std::vector<MatchPairGenerator::ImageInfo> MatchPairGenerator::readImages(const std::string& imagesPath)
+{
+	wxArrayString files;
+	wxDir::GetAllFiles(imagesPath, &files, wxEmptyString, wxDIR_FILES);
+	std::vector<ImageInfo> images;
+	for (const auto& file : files)
+	{
+		const auto extension = Utils::toUpper(Utils::getFileExtension(file.ToStdString()));
+		if (extension == "JPG" || extension == "JPEG")
+		{
+			ImageInfo image;
+			image.name = Utils::getFileName(file.ToStdString());
+			images.emplace_back(image);
+		}
+	}
+	std::sort(images.begin(), images.end(), [](const ImageInfo& a, const ImageInfo& b) { return a.name < b.name; });
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < static_cast<int>(images.size()); i++)
+	{
+		ImageMetadata metadata;
+		images[i].hasExif = ImageMetadataCache::get(imagesPath + "/" + images[i].name, metadata) && metadata.hasExif;
+		images[i].exif = metadata.exif;
+	}
+	return images;
+}
+
+double MatchPairGenerator::getGPSFraction(const std::vector<ImageInfo>& images)
+{
+	if (images.empty())
+	{
+		return 0;
+	}
+	const auto withGPS = std::count_if(images.begin(), images.end(), [](const ImageInfo& image) { return image.exif.hasGPS; });
+	return static_cast<double>(withGPS) / images.size();
+}
+
+double MatchPairGenerator::getCaptureTimeFraction(const std::vector<ImageInfo>& images)
+{
+	if (images.empty())
+	{
+		return 0;
+	}
+	const auto withTime = std::count_if(images.begin(), images.end(), [](const ImageInfo& image) { return image.exif.hasCaptureTime; });
+	return static_cast<double>(withTime) / images.size();
+}
+
+std::vector<MatchPairGenerator::Pair> MatchPairGenerator::spatialPairs(const std::vector<ImageInfo>& images, size_t neighbors, size_t timeNeighbors)
+{
+	std::set<Pair> pairs;
+	//Position neighbors, in a local metric frame
+	std::vector<size_t> gpsImages;
+	double referenceLatitude = 0, referenceLongitude = 0;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		if (images[i].exif.hasGPS)
+		{
+			if (gpsImages.empty())
+			{
+				referenceLatitude = images[i].exif.latitude;
+				referenceLongitude = images[i].exif.longitude;
+			}
+			gpsImages.emplace_back(i);
+		}
+	}
+	std::vector<Eigen::Vector3d> positions(gpsImages.size());
+	for (size_t i = 0; i < gpsImages.size(); i++)
+	{
+		ExifReader::toLocalMeters(images[gpsImages[i]].exif, referenceLatitude, referenceLongitude, positions[i].data());
+	}
+	const SpatialIndex index(positions);
+	std::vector<std::vector<size_t>> nearest(gpsImages.size());
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < static_cast<int>(gpsImages.size()); i++)
+	{
+		nearest[i] = index.knn(positions[i], neighbors, i);
+	}
+	for (size_t i = 0; i < gpsImages.size(); i++)
+	{
+		for (const auto neighbor : nearest[i])
+		{
+			addPair(pairs, gpsImages[i], gpsImages[neighbor]);
+		}
+	}
+	//Time neighbors, they cover GPS noise between consecutive shots
+	std::vector<size_t> timeOrder;
+	std::vector<size_t> withoutMetadata;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		if (images[i].exif.hasCaptureTime)
+		{
+			timeOrder.emplace_back(i);
+		}
+		else if (!images[i].exif.hasGPS)
+		{
+			withoutMetadata.emplace_back(i);
+		}
+	}
+	std::stable_sort(timeOrder.begin(), timeOrder.end(), [&](size_t a, size_t b)
+	{
+		return images[a].exif.captureTime < images[b].exif.captureTime;
+	});
+	addOrderedNeighbors(pairs, timeOrder, timeNeighbors);
+	//Name neighbors for the images without any metadata, among each other and among all the images (sorted by name),
+	//so they connect to the images with metadata and register into the same model
+	addOrderedNeighbors(pairs, withoutMetadata, timeNeighbors);
+	for (const auto image : withoutMetadata)
+	{
+		for (size_t offset = 1; offset <= timeNeighbors; offset++)
+		{
+			if (image >= offset)
+			{
+				addPair(pairs, image, image - offset);
+			}
+			if (image + offset < images.size())
+			{
+				addPair(pairs, image, image + offset);
+			}
+		}
+	}
+	return std::vector<Pair>(pairs.begin(), pairs.end());
+}
+
+std::vector<MatchPairGenerator::Pair> MatchPairGenerator::sequentialPairs(const std::vector<ImageInfo>& images, size_t overlap)
+{
+	std::vector<size_t> order(images.size());
+	std::iota(order.begin(), order.end(), 0);
+	if (getCaptureTimeFraction(images) == 1.0)
+	{
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+		{
+			return images[a].exif.captureTime < images[b].exif.captureTime;
+		});
+	}
+	std::set<Pair> pairs;
+	addOrderedNeighbors(pairs, order, overlap);
+	return std::vector<Pair>(pairs.begin(), pairs.end());
+}
+
+bool MatchPairGenerator::writePairs(const std::string& pairsPath, const std::vector<ImageInfo>& images, const std::vector<Pair>& pairs)
+{
+	std::ofstream pairsFile(pairsPath);
+	if (!pairsFile.is_open())
+	{
+		return 0;
+	}
+	for (const auto& pair : pairs)
+	{
+		pairsFile << images[pair.first].name << " " << images[pair.second].name << "\n";
+	}
+	return pairsFile.good();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "ExifReader.h"
+
+// Image pairs to be matched by COLMAP matches_importer, instead of matching every pair
+class MatchPairGenerator
+{
+public:
+	struct ImageInfo
+	{
+		// Relative to the images directory
+		std::string name;
+		bool hasExif = false;
+		ExifData exif;
+	};
+	typedef std::pair<size_t, size_t> Pair;
+
+	// JPG images of a directory sorted by name, with the EXIF read in parallel
+	static std::vector<ImageInfo> readImages(const std::string& imagesPath);
+
+	static double getGPSFraction(const std::vector<ImageInfo>& images);
+	static double getCaptureTimeFraction(const std::vector<ImageInfo>& images);
+
+	// The k nearest images by GPS position plus the timeNeighbors next images by capture time.
+	// Images without GPS and capture time are paired with the timeNeighbors images before and after them by name.
+	static std::vector<Pair> spatialPairs(const std::vector<ImageInfo>& images, size_t neighbors, size_t timeNeighbors);
+
+	// Each image with the next overlap images, ordered by capture time when every image has it, otherwise by name
+	static std::vector<Pair> sequentialPairs(const std::vector<ImageInfo>& images, size_t overlap);
+
+	// One "name1 name2" line per pair
+	static bool writePairs(const std::string& pairsPath, const std::vector<ImageInfo>& images, const std::vector<Pair>& pairs);
+};
@@ -0,0 +1,101 @@
+#include "MatchingPlanner.h"
+
+#include <sstream>
+#include <algorithm>
+
+#include "Utils.h"
+
+std::string Matching::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Neighbors " << neighbors << "\n" <<
+		"Time neighbors " << timeNeighbors << "\n" <<
+		"Sequential overlap " << sequentialOverlap << "\n" <<
+		"Vocabulary tree neighbors " << vocabTreeNeighbors << "\n" <<
+		"Time budget " << timeBudget << " s\n" <<
+		"Pairs per second " << pairsPerSecond << "\n";
+	return parameters.str();
+}
+
+std::string Matching::Plan::getStrategyName() const
+{
+	switch (strategy)
+	{
+	case Exhaustive:
+		return "exhaustive";
+	case Sequential:
+		return "sequential";
+	case Spatial:
+		return "spatial";
+	case VocabTree:
+		return "vocabulary tree";
+	default:
+		return "exhaustive";
+	}
+}
+
+std::string Matching::Plan::print() const
+{
+	std::stringstream plan;
+	plan << "Matching strategy " << getStrategyName() << " (" << reason << ")\n" <<
+		"Images " << numImages << ", " << static_cast<int>(100 * gpsFraction) << "% with GPS, " <<
+		static_cast<int>(100 * captureTimeFraction) << "% with capture time\n" <<
+		"Pairs " << numPairs << ", estimated time " << static_cast<int>(estimatedSeconds) << " s";
+	if (measuredSeconds > 0)
+	{
+		plan << ", measured time " << static_cast<int>(measuredSeconds) << " s (" <<
+			static_cast<int>(numPairs / measuredSeconds) << " pairs per second)";
+	}
+	return plan.str();
+}
+
+Matching::Plan MatchingPlanner::plan(const std::vector<MatchPairGenerator::ImageInfo>& images, const Matching::Options& options,
+	const std::string& vocabTreePath)
+{
+	Matching::Plan plan;
+	plan.numImages = images.size();
+	plan.gpsFraction = MatchPairGenerator::getGPSFraction(images);
+	plan.captureTimeFraction = MatchPairGenerator::getCaptureTimeFraction(images);
+	const double pairsPerSecond = std::max(options.pairsPerSecond, 1.0);
+	const size_t exhaustivePairs = images.size() * (images.size() > 0 ? images.size() - 1 : 0) / 2;
+	if (exhaustivePairs / pairsPerSecond <= options.timeBudget)
+	{
+		plan.strategy = Matching::Exhaustive;
+		plan.numPairs = exhaustivePairs;
+		plan.reason = "fits the time budget";
+	}
+	//Cheaper strategies, from the most to the least informed
+	else if (plan.gpsFraction >= 0.5)
+	{
+		plan.strategy = Matching::Spatial;
+		plan.pairs = MatchPairGenerator::spatialPairs(images, std::max(options.neighbors, 1), std::max(options.timeNeighbors, 0));
+		plan.numPairs = plan.pairs.size();
+		plan.reason = "GPS available";
+	}
+	else if (plan.captureTimeFraction == 1.0)
+	{
+		plan.strategy = Matching::Sequential;
+		plan.pairs = MatchPairGenerator::sequentialPairs(images, std::max(options.sequentialOverlap, 1));
+		plan.numPairs = plan.pairs.size();
+		plan.reason = "ordered by capture time";
+	}
+	else if (!vocabTreePath.empty() && Utils::exists(vocabTreePath))
+	{
+		plan.strategy = Matching::VocabTree;
+		plan.numPairs = images.size() * std::min(static_cast<size_t>(std::max(options.vocabTreeNeighbors, 1)), images.size() - 1);
+		plan.reason = "no GPS or capture time";
+	}
+	else
+	{
+		plan.strategy = Matching::Sequential;
+		plan.pairs = MatchPairGenerator::sequentialPairs(images, std::max(options.sequentialOverlap, 1));
+		plan.numPairs = plan.pairs.size();
+		plan.reason = "ordered by filename, no GPS, capture time or vocabulary tree";
+	}
+	plan.estimatedSeconds = plan.numPairs / pairsPerSecond;
+	if (plan.estimatedSeconds > options.timeBudget)
+	{
+		plan.reason += ", over the time budget";
+	}
+	return plan;
+}
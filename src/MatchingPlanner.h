@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MatchPairGenerator.h"
+
+namespace Matching
+{
+	struct Options
+	{
+		Options() {};
+		Options(int neighbors, int timeNeighbors, int sequentialOverlap, int vocabTreeNeighbors, double timeBudget, double pairsPerSecond) :
+			neighbors(neighbors), timeNeighbors(timeNeighbors), sequentialOverlap(sequentialOverlap),
+			vocabTreeNeighbors(vocabTreeNeighbors), timeBudget(timeBudget), pairsPerSecond(pairsPerSecond) {};
+		// Nearest images by GPS position matched with each image
+		int neighbors = 20;
+		// Next images by capture time matched with each image in the spatial matching
+		int timeNeighbors = 5;
+		// Next images matched with each image in the sequential matching
+		int sequentialOverlap = 10;
+		// Most similar images retrieved for each image in the vocabulary tree matching
+		int vocabTreeNeighbors = 50;
+		// Seconds the matching may take before a cheaper strategy is chosen
+		double timeBudget = 1800;
+		// Matching throughput used to estimate the cost, tune it with the measured value in the log
+		double pairsPerSecond = 100;
+
+		std::string print() const;
+	};
+
+	enum Strategy
+	{
+		Exhaustive,
+		Sequential,
+		Spatial,
+		VocabTree
+	};
+
+	struct Plan
+	{
+		Strategy strategy = Exhaustive;
+		size_t numImages = 0;
+		double gpsFraction = 0;
+		double captureTimeFraction = 0;
+		// Pairs of the chosen strategy, estimated for the vocabulary tree
+		size_t numPairs = 0;
+		double estimatedSeconds = 0;
+		// Filled after the matching
+		double measuredSeconds = 0;
+		std::string reason;
+		// Pairs to be imported for the sequential and spatial strategies
+		std::vector<MatchPairGenerator::Pair> pairs;
+
+		std::string getStrategyName() const;
+		std::string print() const;
+	};
+}
+
+// Chooses how the sparse stage matches the images, based on the image count, the EXIF available and the time budget
+class MatchingPlanner
+{
+public:
+	// vocabTreePath empty or missing disables the vocabulary tree matching
+	static Matching::Plan plan(const std::vector<MatchPairGenerator::ImageInfo>& images, const Matching::Options& options,
+		const std::string& vocabTreePath);
+};
@@ -0,0 +1,791 @@
+#include "MockToolRunner.h"
+
+#include <fstream>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include <omp.h>
+
+#include <Eigen/Dense>
+
+#include <wx/log.h>
+#include <wx/dir.h>
+#include <wx/filename.h>
+#include <wx/image.h>
+
+#include "ColmapModel.h"
+#include "DenseMap.h"
+#include "PlyIO.h"
+#include "ImageIO.h"
+#include "Camera.h"
+#include "ProgressModel.h"
+#include "Cancellation.h"
+#include "Tracer.h"
+#include "Utils.h"
+
+namespace
+{
+	const double pi = 3.14159265358979323846;
+	// The scene: a sphere at the origin and the cameras on a circle around it, looking at its center
+	const double sceneRadius = 3;
+	const double orbitRadius = 10;
+	const double orbitHeight = 2;
+	// A sparse point is searched in the images of the orbit around the one in front of it
+	const int trackSearch = 8;
+	const size_t maxTrackLength = 6;
+	// Size of the cameras when the images can't be read
+	const unsigned int defaultWidth = 1600;
+	const unsigned int defaultHeight = 1200;
+	// Delays are slept in slices, so a cancellation stops a stand-in like it terminates a tool
+	const int sleepSlice = 50;
+
+	// Arguments without their quotes, "--name=value" stays a single argument
+	std::vector<std::string> splitArguments(const std::string& arguments)
+	{
+		std::vector<std::string> tokens;
+		std::string token;
+		bool quoted = false, hasToken = false;
+		for (const char c : arguments)
+		{
+			if (c == '"')
+			{
+				quoted = !quoted;
+				hasToken = true;
+			}
+			else if ((c == ' ' || c == '\t') && !quoted)
+			{
+				if (hasToken)
+				{
+					tokens.emplace_back(token);
+				}
+				token.clear();
+				hasToken = false;
+			}
+			else
+			{
+				token += c;
+				hasToken = true;
+			}
+		}
+		if (hasToken)
+		{
+			tokens.emplace_back(token);
+		}
+		return tokens;
+	}
+
+	// Value of "--name=value" or "--name value", empty if it isn't there
+	std::string getArgument(const std::vector<std::string>& tokens, const std::string& name)
+	{
+		for (size_t i = 0; i < tokens.size(); i++)
+		{
+			if (tokens[i].compare(0, name.size() + 1, name + "=") == 0)
+			{
+				return tokens[i].substr(name.size() + 1);
+			}
+			if (tokens[i] == name && i + 1 < tokens.size())
+			{
+				return tokens[i + 1];
+			}
+		}
+		return "";
+	}
+
+	bool sleepCancellable(int milliseconds)
+	{
+		for (int slept = 0; slept < milliseconds; slept += sleepSlice)
+		{
+			if (Cancellation::isCancelled())
+			{
+				return 0;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(std::min(sleepSlice, milliseconds - slept)));
+		}
+		return !Cancellation::isCancelled();
+	}
+
+	// Names of the images of a folder, in the name order
+	std::vector<std::string> listImages(const std::string& imagesPath)
+	{
+		std::vector<std::string> names;
+		wxArrayString files;
+		if (wxDirExists(imagesPath))
+		{
+			wxDir::GetAllFiles(imagesPath, &files, wxEmptyString, wxDIR_FILES);
+		}
+		for (const auto& file : files)
+		{
+			const auto extension = Utils::toUpper(Utils::getFileExtension(file.ToStdString()));
+			if (extension == "JPG" || extension == "JPEG" || extension == "PNG" || extension == "TIF" || extension == "TIFF")
+			{
+				names.emplace_back(Utils::getFileName(file.ToStdString()));
+			}
+		}
+		std::sort(names.begin(), names.end());
+		return names;
+	}
+
+	// World to camera [R|t] of the image index of the orbit
+	Eigen::Matrix4d getOrbitPose(size_t index, size_t numImages)
+	{
+		const double angle = 2 * pi * index / std::max<size_t>(numImages, 1);
+		const Eigen::Vector3d center(orbitRadius * std::cos(angle), orbitRadius * std::sin(angle), orbitHeight);
+		const Eigen::Vector3d z = (-center).normalized();
+		const Eigen::Vector3d x = z.cross(Eigen::Vector3d::UnitZ()).normalized();
+		const Eigen::Vector3d y = z.cross(x);
+		Eigen::Matrix3d rotation;
+		rotation.row(0) = x;
+		rotation.row(1) = y;
+		rotation.row(2) = z;
+		Eigen::Matrix4d matrixRt = Eigen::Matrix4d::Identity();
+		matrixRt.block<3, 3>(0, 0) = rotation;
+		matrixRt.block<3, 1>(0, 3) = -rotation * center;
+		return matrixRt;
+	}
+
+	// Distance along direction from origin to the sphere of the scene, false if the ray misses it
+	bool intersectScene(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& distance)
+	{
+		const double a = direction.squaredNorm();
+		const double b = 2 * origin.dot(direction);
+		const double c = origin.squaredNorm() - sceneRadius * sceneRadius;
+		const double discriminant = b * b - 4 * a * c;
+		if (discriminant < 0)
+		{
+			return 0;
+		}
+		distance = (-b - std::sqrt(discriminant)) / (2 * a);
+		return distance > 0;
+	}
+
+	Eigen::Vector3d samplePoint(std::mt19937& random)
+	{
+		std::normal_distribution<double> normal(0, 1);
+		Eigen::Vector3d point(normal(random), normal(random), normal(random));
+		if (point.squaredNorm() == 0)
+		{
+			point = Eigen::Vector3d::UnitZ();
+		}
+		return sceneRadius * point.normalized();
+	}
+
+	// The color of a point follows its normal, so the views of the scene differ
+	void getColor(const Eigen::Vector3d& point, unsigned char rgb[3])
+	{
+		const Eigen::Vector3d normal = point.normalized();
+		for (int i = 0; i < 3; i++)
+		{
+			rgb[i] = static_cast<unsigned char>(127.5 * (normal[i] + 1));
+		}
+	}
+
+	// Center and mean radius of the points of a PLY
+	bool getBoundingSphere(const std::string& plyPath, Eigen::Vector3d& center, double& radius, size_t& numPoints)
+	{
+		std::vector<float> positions, normals;
+		std::vector<unsigned char> colors;
+		if (!PlyIO::readPoints(plyPath, positions, normals, colors) || positions.empty())
+		{
+			return 0;
+		}
+		numPoints = positions.size() / 3;
+		center.setZero();
+		for (size_t i = 0; i < numPoints; i++)
+		{
+			center += Eigen::Vector3d(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+		}
+		center /= static_cast<double>(numPoints);
+		radius = 0;
+		for (size_t i = 0; i < numPoints; i++)
+		{
+			radius += (Eigen::Vector3d(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]) - center).norm();
+		}
+		radius /= static_cast<double>(numPoints);
+		return 1;
+	}
+
+	// Sphere of about numFaces triangles facing out, the poles and rings of twice as many segments
+	void createSphere(const Eigen::Vector3d& center, double radius, int numFaces, std::vector<float>& positions, std::vector<uint32_t>& triangles)
+	{
+		const uint32_t rings = static_cast<uint32_t>(std::max(2.0, std::round(std::sqrt(std::max(numFaces, 16) / 4.0))));
+		const uint32_t segments = 2 * rings;
+		positions.clear();
+		triangles.clear();
+		positions.reserve(3 * (2 + static_cast<size_t>(rings - 1) * segments));
+		triangles.reserve(6 * static_cast<size_t>(segments) * (rings - 1));
+		auto addVertex = [&](double theta, double phi)
+		{
+			positions.emplace_back(static_cast<float>(center.x() + radius * std::sin(theta) * std::cos(phi)));
+			positions.emplace_back(static_cast<float>(center.y() + radius * std::sin(theta) * std::sin(phi)));
+			positions.emplace_back(static_cast<float>(center.z() + radius * std::cos(theta)));
+		};
+		addVertex(0, 0);
+		for (uint32_t i = 1; i < rings; i++)
+		{
+			for (uint32_t j = 0; j < segments; j++)
+			{
+				addVertex(pi * i / rings, 2 * pi * j / segments);
+			}
+		}
+		addVertex(pi, 0);
+		const uint32_t top = 0;
+		const uint32_t bottom = 1 + (rings - 1) * segments;
+		auto ring = [&](uint32_t i, uint32_t j) { return 1 + (i - 1) * segments + j % segments; };
+		auto addTriangle = [&](uint32_t a, uint32_t b, uint32_t c)
+		{
+			triangles.emplace_back(a);
+			triangles.emplace_back(b);
+			triangles.emplace_back(c);
+		};
+		for (uint32_t j = 0; j < segments; j++)
+		{
+			addTriangle(top, ring(1, j), ring(1, j + 1));
+			for (uint32_t i = 1; i + 1 < rings; i++)
+			{
+				addTriangle(ring(i, j), ring(i + 1, j), ring(i + 1, j + 1));
+				addTriangle(ring(i, j), ring(i + 1, j + 1), ring(i, j + 1));
+			}
+			addTriangle(bottom, ring(rings - 1, j + 1), ring(rings - 1, j));
+		}
+	}
+}
+
+bool MockToolRunner::run(const std::string& tool, const std::string& arguments, const std::string& workingDirectory)
+{
+	if (Cancellation::isCancelled())
+	{
+		return 0;
+	}
+	const auto tokens = splitArguments(arguments);
+	const auto name = Utils::toUpper(Utils::getFileName(tool, false));
+	//Named like the real processes, for the progress model and the trace
+	const std::string processName = Utils::getFileName(tool) + (name == "COLMAP" && !tokens.empty() ? " " + tokens[0] : "");
+	Tracer::Span span(processName, "process", "mock" + arguments);
+	if (name == "COLMAP" && !tokens.empty())
+	{
+		const auto& command = tokens[0];
+		if (command == "feature_extractor")
+		{
+			return featureExtractor(processName, tokens);
+		}
+		if (command == "exhaustive_matcher" || command == "vocab_tree_matcher" || command == "sequential_matcher" ||
+			command == "spatial_matcher" || command == "matches_importer")
+		{
+			return matcher(processName, tokens);
+		}
+		if (command == "mapper")
+		{
+			return mapper(processName, tokens);
+		}
+		if (command == "model_converter")
+		{
+			return modelConverter(processName, tokens);
+		}
+		if (command == "image_undistorter")
+		{
+			return imageUndistorter(processName, tokens);
+		}
+		if (command == "patch_match_stereo")
+		{
+			return patchMatchStereo(processName, tokens);
+		}
+		if (command == "stereo_fusion")
+		{
+			return stereoFusion(processName, tokens);
+		}
+	}
+	else if (name == "SSDRECON")
+	{
+		return ssdRecon(processName, tokens);
+	}
+	else if (name == "TEXRECON")
+	{
+		return texRecon(processName, tokens);
+	}
+	//The surface of the stand-in has nothing to trim and the scene is already in meters
+	else if (name == "SURFACETRIMMER" || name == "SCALE_PTCS")
+	{
+		return simulate(processName, 0);
+	}
+	wxLogError(wxString("No stand-in for " + tool + arguments));
+	return 0;
+}
+
+bool MockToolRunner::simulate(const std::string& processName, size_t numImages) const
+{
+	ProgressModel::processStarted(processName);
+	bool completed = true;
+	for (size_t i = 0; i < numImages && completed; i++)
+	{
+		completed = sleepCancellable(options.delayPerImageMs);
+		ProgressModel::processOutput(processName, "Processed file [" + std::to_string(i + 1) + "/" + std::to_string(numImages) + "]");
+	}
+	completed = completed && sleepCancellable(options.delayMs);
+	ProgressModel::processFinished(processName);
+	if (!completed)
+	{
+		wxLogError("%s terminated: %s", processName, Cancellation::getReason());
+	}
+	return completed;
+}
+
+bool MockToolRunner::featureExtractor(const std::string& processName, const std::vector<std::string>& arguments) const
+{
+	const auto names = listImages(getArgument(arguments, "--image_path"));
+	if (!simulate(processName, names.size()))
+	{
+		return 0;
+	}
+	//Only the matcher of the stand-in reads it, for the number of images
+	std::ofstream database(getArgument(arguments, "--database_path"));
+	if (!database.is_open())
+	{
+		wxLogError("Could not write the database of the stand-in");
+		return 0;
+	}
+	database << "mock_database " << names.size() << "\n";
+	return 1;
+}
+
+bool MockToolRunner::matcher(const std::string& processName, const std::vector<std::string>& arguments) const
+{
+	std::ifstream database(getArgument(arguments, "--database_path"));
+	std::string header;
+	size_t numImages = 0;
+	if (!(database >> header >> numImages) || header != "mock_database")
+	{
+		wxLogError("No database of the stand-in feature extractor");
+		return 0;
+	}
+	return simulate(processName, numImages);
+}
+
+bool MockToolRunner::mapper(const std::string& processName, const std::vector<std::string>& arguments) const
+{
+	const auto imagesPath = getArgument(arguments, "--image_path");
+	const auto outputPath = getArgument(arguments, "--output_path");
+	const auto imageListPath = getArgument(arguments, "--image_list_path");
+	//The pose of an image comes from its place among every image, so the clusters of the partitioned mapper agree
+	const auto allNames = listImages(imagesPath);
+	std::vector<std::string> names;
+	if (imageListPath.empty())
+	{
+		names = allNames;
+	}
+	else
+	{
+		std::ifstream imageList(imageListPath);
+		std::string line;
+		while (std::getline(imageList, line))
+		{
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.pop_back();
+			}
+			if (!line.empty())
+			{
+				names.emplace_back(line);
+			}
+		}
+	}
+	if (names.empty())
+	{
+		wxLogError(wxString("No images for the stand-in mapper in " + imagesPath));
+		return 0;
+	}
+	if (!simulate(processName, names.size()))
+	{
+		return 0;
+	}
+	unsigned int width = defaultWidth, height = defaultHeight;
+	if (!ImageIO::getImageSize(imagesPath + "/" + names[0], width, height) || width == 0 || height == 0)
+	{
+		width = defaultWidth;
+		height = defaultHeight;
+	}
+	ColmapModel model;
+	ColmapModel::Intrinsics intrinsics;
+	intrinsics.cameraId = 1;
+	intrinsics.modelId = 1;
+	intrinsics.width = width;
+	intrinsics.height = height;
+	const double focal = width;
+	intrinsics.params = { focal, focal, width / 2.0, height / 2.0 };
+	model.cameras[1] = intrinsics;
+	const int numOrbit = static_cast<int>(allNames.size());
+	std::vector<uint32_t> orbitImageIds(allNames.size(), 0);
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		const auto orbitIndex = std::lower_bound(allNames.begin(), allNames.end(), names[i]);
+		if (orbitIndex == allNames.end() || *orbitIndex != names[i])
+		{
+			continue;
+		}
+		ColmapModel::Image image;
+		image.imageId = static_cast<uint32_t>(i + 1);
+		image.cameraId = 1;
+		image.name = names[i];
+		ColmapModel::setMatrixRt(image, getOrbitPose(orbitIndex - allNames.begin(), allNames.size()));
+		orbitImageIds[orbitIndex - allNames.begin()] = image.imageId;
+		model.images[image.imageId] = image;
+	}
+	//Points on the sphere with the images around the one in front of them that see them
+	std::mt19937 random(options.seed);
+	const size_t numPoints = static_cast<size_t>(std::max(options.sparsePointsPerImage, 0)) * model.images.size();
+	const int search = std::min(trackSearch, (numOrbit - 1) / 2);
+	uint64_t nextPointId = 1;
+	for (size_t p = 0; p < numPoints && numOrbit > 0; p++)
+	{
+		const Eigen::Vector3d point = samplePoint(random);
+		const double angle = std::atan2(point.y(), point.x());
+		const int front = static_cast<int>(std::round((angle < 0 ? angle + 2 * pi : angle) / (2 * pi) * numOrbit)) % numOrbit;
+		std::vector<std::pair<uint32_t, ColmapModel::Point2D>> observations;
+		for (int offset = -search; offset <= search && observations.size() < maxTrackLength; offset++)
+		{
+			const uint32_t imageId = orbitImageIds[(front + offset + numOrbit) % numOrbit];
+			if (imageId == 0)
+			{
+				continue;
+			}
+			const auto& image = model.images[imageId];
+			const Eigen::Matrix4d matrixRt = ColmapModel::getMatrixRt(image);
+			const Eigen::Vector3d cameraPoint = matrixRt.block<3, 3>(0, 0) * point + matrixRt.block<3, 1>(0, 3);
+			if (cameraPoint.z() <= 0 || (ColmapModel::getCameraCenter(image) - point).dot(point) <= 0)
+			{
+				continue;
+			}
+			ColmapModel::Point2D observation;
+			observation.x = focal * cameraPoint.x() / cameraPoint.z() + width / 2.0;
+			observation.y = focal * cameraPoint.y() / cameraPoint.z() + height / 2.0;
+			if (observation.x < 0 || observation.y < 0 || observation.x >= width || observation.y >= height)
+			{
+				continue;
+			}
+			observation.point3DId = static_cast<int64_t>(nextPointId);
+			observations.emplace_back(imageId, observation);
+		}
+		if (observations.size() < 2)
+		{
+			continue;
+		}
+		ColmapModel::Point3D point3D;
+		for (int i = 0; i < 3; i++)
+		{
+			point3D.xyz[i] = point[i];
+		}
+		getColor(point, point3D.rgb);
+		point3D.error = 0.5;
+		for (const auto& observation : observations)
+		{
+			auto& points2D = model.images[observation.first].points2D;
+			points2D.emplace_back(observation.second);
+			point3D.track.push_back({ observation.first, static_cast<uint32_t>(points2D.size() - 1) });
+		}
+		model.points3D[nextPointId++] = point3D;
+	}
+	const std::string modelPath = outputPath + "/0";
+	if (!wxFileName::Mkdir(modelPath, 0777, wxPATH_MKDIR_FULL) || !model.write(modelPath))
+	{
+		wxLogError(wxString("Could not write the model of the stand-in mapper to " + modelPath));
+		return 0;
+	}
+	return 1;
+}
+
+bool MockToolRunner::modelConverter(const std::string& processName, const std::vector<std::string>& arguments) const
+{
+	const auto inputPath = getArgument(arguments, "--input_path");
+	const auto outputPath = getArgument(arguments, "--output_path");
+	const auto outputType = Utils::toUpper(getArgument(arguments, "--output_type"));
+	ColmapModel model;
+	if (!model.read(inputPath))
+	{
+		wxLogError(wxString("Could not read the model " + inputPath));
+		return 0;
+	}
+	if (!simulate(processName, model.images.size()))
+	{
+		return 0;
+	}
+	if (outputType == "BIN")
+	{
+		return wxFileName::Mkdir(outputPath, 0777, wxPATH_MKDIR_FULL) && model.write(outputPath);
+	}
+	if (outputType != "NVM")
+	{
+		wxLogError(wxString("The stand-in model converter only writes NVM and BIN, not " + outputType));
+		return 0;
+	}
+	std::vector<Camera*> cameras;
+	const bool converted = ImageIO::loadCOLMAPModel(inputPath, "", cameras) && ImageIO::saveCameras(outputPath, cameras);
+	for (auto camera : cameras)
+	{
+		delete camera;
+	}
+	return converted;
+}
+
+bool MockToolRunner::imageUndistorter(const std::string& processName, const std::vector<std::string>& arguments) const
+{
+	const auto imagesPath = getArgument(arguments, "--image_path");
+	const auto inputPath = getArgument(arguments, "--input_path");
+	const auto outputPath = getArgument(arguments, "--output_path");
+	ColmapModel model;
+	if (!model.read(inputPath))
+	{
+		wxLogError(wxString("Could not read the model " + inputPath));
+		return 0;
+	}
+	if (!simulate(processName, model.images.size()))
+	{
+		return 0;
+	}
+	//The cameras of the stand-in have no distortion, the images are copied as they are
+	for (const auto& directory : { "/images", "/sparse", "/stereo/depth_maps", "/stereo/normal_maps" })
+	{
+		if (!wxFileName::Mkdir(outputPath + directory, 0777, wxPATH_MKDIR_FULL))
+		{
+			wxLogError(wxString("Could not create " + outputPath + directory));
+			return 0;
+		}
+	}
+	for (const auto& image : model.images)
+	{
+		if (!wxCopyFile(imagesPath + "/" + image.second.name, outputPath + "/images/" + image.second.name))
+		{
+			wxLogError(wxString("Could not copy the image " + image.second.name));
+			return 0;
+		}
+	}
+	return model.write(outputPath + "/sparse");
+}
+
+bool MockToolRunner::patchMatchStereo(const std::string& processName, const std::vector<std::string>& arguments) const
+{
+	const auto workspacePath = getArgument(arguments, "--workspace_path");
+	const auto maxImageSizeArgument = getArgument(arguments, "--PatchMatchStereo.max_image_size");
+	const int maxImageSize = maxImageSizeArgument.empty() ? -1 : std::atoi(maxImageSizeArgument.c_str());
+	const bool geometric = getArgument(arguments, "--PatchMatchStereo.geom_consistency") == "1";
+	ColmapModel model;
+	if (!model.read(workspacePath + "/sparse", false))
+	{
+		wxLogError(wxString("Could not read the model of " + workspacePath));
+		return 0;
+	}
+	if (!simulate(processName, model.images.size()))
+	{
+		return 0;
+	}
+	//The depth and normal of the sphere at each pixel
+	for (const auto& entry : model.images)
+	{
+		const auto& image = entry.second;
+		const auto intrinsics = model.cameras.find(image.cameraId);
+		if (intrinsics == model.cameras.end())
+		{
+			return 0;
+		}
+		double focal[2], principalPoint[2];
+		ColmapModel::getFocalAndPrincipalPoint(intrinsics->second, focal, principalPoint);
+		const double maxSide = static_cast<double>(std::max(intrinsics->second.width, intrinsics->second.height));
+		const double scale = maxImageSize > 0 && maxSide > maxImageSize ? maxImageSize / maxSide : 1;
+		const int width = std::max(1, static_cast<int>(std::round(intrinsics->second.width * scale)));
+		const int height = std::max(1, static_cast<int>(std::round(intrinsics->second.height * scale)));
+		const Eigen::Matrix4d matrixRt = ColmapModel::getMatrixRt(image);
+		const Eigen::Matrix3d rotation = matrixRt.block<3, 3>(0, 0);
+		const Eigen::Vector3d center = ColmapModel::getCameraCenter(image);
+		DenseMap depthMap(width, height, 1), normalMap(width, height, 3);
+#pragma omp parallel for schedule(static)
+		for (int row = 0; row < height; row++)
+		{
+			for (int col = 0; col < width; col++)
+			{
+				const Eigen::Vector3d ray((col + 0.5 - principalPoint[0] * scale) / (focal[0] * scale),
+					(row + 0.5 - principalPoint[1] * scale) / (focal[1] * scale), 1);
+				double depth;
+				if (!intersectScene(center, rotation.transpose() * ray, depth))
+				{
+					continue;
+				}
+				const Eigen::Vector3d normal = rotation * (center + depth * rotation.transpose() * ray).normalized();
+				depthMap.at(row, col) = static_cast<float>(depth);
+				for (int c = 0; c < 3; c++)
+				{
+					normalMap.at(row, col, c) = static_cast<float>(normal[c]);
+				}
+			}
+		}
+		std::vector<std::string> types = { "photometric" };
+		if (geometric)
+		{
+			types.emplace_back("geometric");
+		}
+		for (const auto& type : types)
+		{
+			const std::string fileName = image.name + "." + type + ".bin";
+			if (!depthMap.write(workspacePath + "/stereo/depth_maps/" + fileName) || !normalMap.write(workspacePath + "/stereo/normal_maps/" + fileName))
+			{
+				wxLogError(wxString("Could not write the maps of " + image.name));
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+bool MockToolRunner::stereoFusion(const std::string& processName, const std::vector<std::string>& arguments) const
+{
+	const auto workspacePath = getArgument(arguments, "--workspace_path");
+	const auto outputPath = getArgument(arguments, "--output_path");
+	ColmapModel model;
+	if (!model.read(workspacePath + "/sparse", false))
+	{
+		wxLogError(wxString("Could not read the model of " + workspacePath));
+		return 0;
+	}
+	if (!simulate(processName, model.images.size()))
+	{
+		return 0;
+	}
+	std::mt19937 random(options.seed + 1);
+	const size_t numPoints = static_cast<size_t>(std::max(options.densePointsPerImage, 0)) * model.images.size();
+	std::vector<float> positions(3 * numPoints), normals(3 * numPoints);
+	std::vector<unsigned char> colors(3 * numPoints);
+	for (size_t i = 0; i < numPoints; i++)
+	{
+		const Eigen::Vector3d point = samplePoint(random);
+		const Eigen::Vector3d normal = point.normalized();
+		for (int c = 0; c < 3; c++)
+		{
+			positions[3 * i + c] = static_cast<float>(point[c]);
+			normals[3 * i + c] = static_cast<float>(normal[c]);
+		}
+		getColor(point, &colors[3 * i]);
+	}
+	return PlyIO::write(outputPath, positions, normals, colors, {});
+}
+
+bool MockToolRunner::ssdRecon(const std::string& processName, const std::vector<std::string>& arguments) const
+{
+	const auto inputPath = getArgument(arguments, "--in");
+	const auto outputPath = getArgument(arguments, "--out");
+	Eigen::Vector3d center;
+	double radius;
+	size_t numPoints;
+	if (!getBoundingSphere(inputPath, center, radius, numPoints))
+	{
+		wxLogError(wxString("Could not read the point cloud " + inputPath));
+		return 0;
+	}
+	//Delayed as the images of the point cloud
+	if (!simulate(processName, numPoints / std::max<size_t>(options.densePointsPerImage, 1)))
+	{
+		return 0;
+	}
+	std::vector<float> positions;
+	std::vector<uint32_t> triangles;
+	createSphere(center, radius, options.meshFaces, positions, triangles);
+	return PlyIO::write(outputPath, positions, {}, {}, triangles);
+}
+
+bool MockToolRunner::texRecon(const std::string& processName, const std::vector<std::string>& arguments) const
+{
+	//texrecon [options] cameras mesh output_prefix
+	std::vector<std::string> positional;
+	for (const auto& argument : arguments)
+	{
+		if (argument.compare(0, 2, "--") != 0)
+		{
+			positional.emplace_back(argument);
+		}
+	}
+	if (positional.size() < 3)
+	{
+		wxLogError("The stand-in TexRecon needs the cameras, the mesh and the output prefix");
+		return 0;
+	}
+	const auto& camerasPath = positional[positional.size() - 3];
+	const auto& meshPath = positional[positional.size() - 2];
+	const auto& outputPrefix = positional[positional.size() - 1];
+	std::ifstream camerasFile(camerasPath);
+	size_t numCameras = 0;
+	if (!(camerasFile >> numCameras))
+	{
+		wxLogError(wxString("Could not read the cameras " + camerasPath));
+		return 0;
+	}
+	Eigen::Vector3d center;
+	double radius;
+	size_t numPoints;
+	if (!getBoundingSphere(meshPath, center, radius, numPoints))
+	{
+		wxLogError(wxString("Could not read the mesh " + meshPath));
+		return 0;
+	}
+	if (!simulate(processName, numCameras))
+	{
+		return 0;
+	}
+	std::vector<float> positions;
+	std::vector<uint32_t> triangles;
+	createSphere(center, radius, options.meshFaces, positions, triangles);
+	//Named like the files of TexRecon
+	const std::string name = Utils::getFileName(outputPrefix);
+	const std::string textureName = name + "_material0000_map_Kd.png";
+	const int textureSize = std::max(options.textureSize, 8);
+	wxImage texture(textureSize, textureSize);
+	unsigned char* pixels = texture.GetData();
+	for (int row = 0; row < textureSize; row++)
+	{
+		for (int col = 0; col < textureSize; col++)
+		{
+			const bool light = ((row * 16 / textureSize) + (col * 16 / textureSize)) % 2 == 0;
+			unsigned char* pixel = pixels + 3 * (static_cast<size_t>(row) * textureSize + col);
+			pixel[0] = static_cast<unsigned char>(255 * col / textureSize);
+			pixel[1] = static_cast<unsigned char>(255 * row / textureSize);
+			pixel[2] = light ? 200 : 60;
+		}
+	}
+	if (!texture.SaveFile(Utils::getPath(outputPrefix) + textureName, wxBITMAP_TYPE_PNG))
+	{
+		wxLogError(wxString("Could not write the texture " + textureName));
+		return 0;
+	}
+	std::ofstream material(outputPrefix + ".mtl");
+	material << "newmtl material0000\nKa 1.000000 1.000000 1.000000\nKd 1.000000 1.000000 1.000000\n" <<
+		"Ks 0.000000 0.000000 0.000000\nTr 0.000000\nillum 1\nNs 1.000000\nmap_Kd " << textureName << "\n";
+	const size_t bufferSize = 1 << 20;
+	std::vector<char> buffer(bufferSize);
+	std::ofstream obj(outputPrefix + ".obj");
+	if (!material.good() || !obj.is_open())
+	{
+		wxLogError(wxString("Could not write the textured mesh " + outputPrefix));
+		return 0;
+	}
+	//After the open, MSVC ignores the buffer of a stream without a file
+	obj.rdbuf()->pubsetbuf(buffer.data(), bufferSize);
+	//Spherical texture coordinates around the center of the mesh
+	obj << "mtllib " << name << ".mtl\n";
+	const size_t numVertices = positions.size() / 3;
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		obj << "v " << positions[3 * i] << " " << positions[3 * i + 1] << " " << positions[3 * i + 2] << "\n";
+	}
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		const Eigen::Vector3d direction = (Eigen::Vector3d(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]) - center).normalized();
+		obj << "vt " << std::atan2(direction.y(), direction.x()) / (2 * pi) + 0.5 << " " <<
+			1 - std::acos(std::max(-1.0, std::min(1.0, direction.z()))) / pi << "\n";
+	}
+	obj << "usemtl material0000\n";
+	for (size_t i = 0; i < triangles.size(); i += 3)
+	{
+		obj << "f " << triangles[i] + 1 << "/" << triangles[i] + 1 << " " << triangles[i + 1] + 1 << "/" << triangles[i + 1] + 1 <<
+			" " << triangles[i + 2] + 1 << "/" << triangles[i + 2] + 1 << "\n";
+	}
+	return obj.good();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "StageRunner.h"
+
+// Stand-ins of the external tools for benchmarks of the scheduling, caching and I/O of the pipeline on machines
+// without COLMAP or a GPU. They take the arguments of the real tools and write valid outputs of a synthetic scene,
+// a sphere seen by cameras orbiting it: a COLMAP model with its tracks, NVM, depth and normal maps, point clouds,
+// meshes and a textured OBJ. Their delays and the sizes of the outputs come from the options, and the same seed
+// and inputs give the same outputs. Their output goes to the progress model like the one of the real tools.
+class MockToolRunner : public StageRunner
+{
+public:
+	explicit MockToolRunner(const Runner::Options& options) : options(options) {};
+
+	bool run(const std::string& tool, const std::string& arguments, const std::string& workingDirectory = "") override;
+
+private:
+	Runner::Options options;
+
+	// Waits the delay of the call, reporting the images as they are done. False if the run was cancelled
+	bool simulate(const std::string& processName, size_t numImages) const;
+
+	// COLMAP
+	bool featureExtractor(const std::string& processName, const std::vector<std::string>& arguments) const;
+	bool matcher(const std::string& processName, const std::vector<std::string>& arguments) const;
+	bool mapper(const std::string& processName, const std::vector<std::string>& arguments) const;
+	bool modelConverter(const std::string& processName, const std::vector<std::string>& arguments) const;
+	bool imageUndistorter(const std::string& processName, const std::vector<std::string>& arguments) const;
+	bool patchMatchStereo(const std::string& processName, const std::vector<std::string>& arguments) const;
+	bool stereoFusion(const std::string& processName, const std::vector<std::string>& arguments) const;
+	// SSDRecon and TexRecon, SurfaceTrimmer and scale_ptcs leave their inputs as they are
+	bool ssdRecon(const std::string& processName, const std::vector<std::string>& arguments) const;
+	bool texRecon(const std::string& processName, const std::vector<std::string>& arguments) const;
+};
@@ -0,0 +1,434 @@
+#include "PlaneSweepStereo.h"
+
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <omp.h>
+
+#include <Eigen/Dense>
+
+#include <wx/image.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+
+#include "ColmapModel.h"
+#include "DenseMap.h"
+#include "Tracer.h"
+#include "ProgressModel.h"
+#include "Cancellation.h"
+
+namespace
+{
+	struct GrayImage
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<float> data;
+
+		float at(int row, int col) const
+		{
+			return data[static_cast<size_t>(row) * width + col];
+		}
+	};
+
+	bool loadGrayImage(const std::string& imagePath, int maxImageSize, GrayImage& gray)
+	{
+		wxImage image;
+		if (!image.LoadFile(imagePath) || !image.IsOk())
+		{
+			return 0;
+		}
+		const int longestSide = std::max(image.GetWidth(), image.GetHeight());
+		if (maxImageSize > 0 && longestSide > maxImageSize)
+		{
+			image.Rescale(std::max(1, image.GetWidth() * maxImageSize / longestSide), std::max(1, image.GetHeight() * maxImageSize / longestSide),
+				wxIMAGE_QUALITY_BOX_AVERAGE);
+		}
+		gray.width = image.GetWidth();
+		gray.height = image.GetHeight();
+		gray.data.resize(static_cast<size_t>(gray.width) * gray.height);
+		const unsigned char* rgb = image.GetData();
+		for (size_t i = 0; i < gray.data.size(); i++)
+		{
+			gray.data[i] = 0.299f * rgb[i * 3] + 0.587f * rgb[i * 3 + 1] + 0.114f * rgb[i * 3 + 2];
+		}
+		return 1;
+	}
+
+	// Pinhole camera of an undistorted image, with the intrinsics scaled to its gray image
+	struct View
+	{
+		uint32_t imageId;
+		GrayImage image;
+		Eigen::Matrix3f rotation;
+		Eigen::Vector3f translation;
+		float fx, fy, cx, cy;
+	};
+
+	bool loadView(const ColmapModel& model, uint32_t imageId, const std::string& imagesPath, int maxImageSize, View& view)
+	{
+		const auto& image = model.images.at(imageId);
+		const auto camera = model.cameras.find(image.cameraId);
+		if (camera == model.cameras.end() || !loadGrayImage(imagesPath + "/" + image.name, maxImageSize, view.image))
+		{
+			return 0;
+		}
+		view.imageId = imageId;
+		const Eigen::Matrix4d matrixRt = ColmapModel::getMatrixRt(image);
+		view.rotation = matrixRt.block<3, 3>(0, 0).cast<float>();
+		view.translation = matrixRt.block<3, 1>(0, 3).cast<float>();
+		double focal[2], principalPoint[2];
+		ColmapModel::getFocalAndPrincipalPoint(camera->second, focal, principalPoint);
+		const double scaleX = static_cast<double>(view.image.width) / camera->second.width;
+		const double scaleY = static_cast<double>(view.image.height) / camera->second.height;
+		view.fx = static_cast<float>(focal[0] * scaleX);
+		view.fy = static_cast<float>(focal[1] * scaleY);
+		view.cx = static_cast<float>(principalPoint[0] * scaleX);
+		view.cy = static_cast<float>(principalPoint[1] * scaleY);
+		return 1;
+	}
+
+	// Depths of the sparse points seen by the image, without the 1% at each end
+	bool getDepthRange(const ColmapModel& model, const View& view, float& minDepth, float& maxDepth)
+	{
+		std::vector<float> depths;
+		for (const auto& point2D : model.images.at(view.imageId).points2D)
+		{
+			const auto point = model.points3D.find(static_cast<uint64_t>(point2D.point3DId));
+			if (point2D.point3DId < 0 || point == model.points3D.end())
+			{
+				continue;
+			}
+			const Eigen::Vector3f xyz(static_cast<float>(point->second.xyz[0]), static_cast<float>(point->second.xyz[1]),
+				static_cast<float>(point->second.xyz[2]));
+			const float depth = (view.rotation * xyz + view.translation).z();
+			if (depth > 0)
+			{
+				depths.emplace_back(depth);
+			}
+		}
+		if (depths.size() < 10)
+		{
+			return 0;
+		}
+		std::sort(depths.begin(), depths.end());
+		minDepth = 0.8f * depths[depths.size() / 100];
+		maxDepth = 1.2f * depths[depths.size() - 1 - depths.size() / 100];
+		return 1;
+	}
+
+	// Summed area table of a rows x cols block, (rows + 1) x (cols + 1) with a zero first row and column
+	void integrate(const std::vector<double>& values, int rows, int cols, std::vector<double>& table)
+	{
+		table.assign(static_cast<size_t>(rows + 1) * (cols + 1), 0.0);
+		for (int row = 0; row < rows; row++)
+		{
+			double rowSum = 0;
+			for (int col = 0; col < cols; col++)
+			{
+				rowSum += values[static_cast<size_t>(row) * cols + col];
+				table[static_cast<size_t>(row + 1) * (cols + 1) + col + 1] = table[static_cast<size_t>(row) * (cols + 1) + col + 1] + rowSum;
+			}
+		}
+	}
+
+	double boxSum(const std::vector<double>& table, int cols, int top, int left, int bottom, int right)
+	{
+		const size_t stride = cols + 1;
+		return table[bottom * stride + right] - table[top * stride + right] - table[bottom * stride + left] + table[top * stride + left];
+	}
+
+	// Best cost of each pixel over the swept depths, with the costs of the depths before and after it for the sub-depth refinement
+	struct BestCost
+	{
+		float cost = 2.f;
+		float previousCost = 2.f;
+		float nextCost = 2.f;
+		int index = -1;
+	};
+}
+
+std::string Stereo::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Mode " << mode << "\n" <<
+		"Max image size " << maxImageSize << "\n" <<
+		"Num source images " << numSourceImages << "\n" <<
+		"Num depths " << numDepths << "\n" <<
+		"Window radius " << windowRadius << "\n" <<
+		"Min NCC " << minNCC << "\n" <<
+		"Num threads " << numThreads << "\n" <<
+		"Tile rows " << tileRows << "\n";
+	return parameters.str();
+}
+
+std::string Stereo::Options::printOutputParameters() const
+{
+	std::stringstream parameters;
+	parameters << "Max image size " << maxImageSize << "\n" <<
+		"Num source images " << numSourceImages << "\n" <<
+		"Num depths " << numDepths << "\n" <<
+		"Window radius " << windowRadius << "\n" <<
+		"Min NCC " << minNCC << "\n";
+	return parameters.str();
+}
+
+bool PlaneSweepStereo::run(const std::string& workspacePath, const Stereo::Options& options)
+{
+	Tracer::Span span("Plane sweep", "native", workspacePath);
+	const auto startTime = std::chrono::steady_clock::now();
+	ColmapModel model;
+	if (!model.read(workspacePath + "/sparse"))
+	{
+		wxLogError("Error reading the sparse model of the dense workspace");
+		return 0;
+	}
+	const std::string stereoPath = workspacePath + "/stereo";
+	if (!wxFileName::Mkdir(stereoPath + "/depth_maps", 0777, wxPATH_MKDIR_FULL) || !wxFileName::Mkdir(stereoPath + "/normal_maps", 0777, wxPATH_MKDIR_FULL))
+	{
+		wxLogError("Error creating the stereo directories");
+		return 0;
+	}
+	const int numThreads = options.numThreads > 0 ? options.numThreads : omp_get_max_threads();
+	const int radius = std::max(options.windowRadius, 1);
+	const int numDepths = std::max(options.numDepths, 2);
+	const int tileRows = std::max(options.tileRows, 1);
+	const float maxCost = static_cast<float>(1 - options.minNCC);
+	const auto covisibleImages = model.getCovisibleImages(static_cast<size_t>(std::max(options.numSourceImages, 1)));
+	std::vector<std::string> processedNames;
+	size_t numStarted = 0;
+	for (const auto& image : model.images)
+	{
+		//The depth maps already written are kept
+		if (Cancellation::isCancelled())
+		{
+			wxLogError("Plane sweep stopped: %s", Cancellation::getReason());
+			return 0;
+		}
+		View reference;
+		Tracer::Span imageSpan("Plane sweep image", "native", image.second.name);
+		ProgressModel::reportStep("plane_sweep", numStarted++, model.images.size());
+		float minDepth, maxDepth;
+		if (!loadView(model, image.first, workspacePath + "/images", options.maxImageSize, reference) ||
+			!getDepthRange(model, reference, minDepth, maxDepth))
+		{
+			wxLogWarning("No depth map for %s, missing image or sparse points", image.second.name);
+			continue;
+		}
+		std::vector<View> sources;
+		for (const auto sourceId : covisibleImages.at(image.first))
+		{
+			View source;
+			if (loadView(model, sourceId, workspacePath + "/images", options.maxImageSize, source))
+			{
+				sources.emplace_back(std::move(source));
+			}
+		}
+		const int width = reference.image.width, height = reference.image.height;
+		//Pose of each source relative to the reference, X_source = R * X_reference + t
+		std::vector<Eigen::Matrix3f> relativeRotations;
+		std::vector<Eigen::Vector3f> relativeTranslations;
+		for (const auto& source : sources)
+		{
+			relativeRotations.emplace_back(source.rotation * reference.rotation.transpose());
+			relativeTranslations.emplace_back(source.translation - relativeRotations.back() * reference.translation);
+		}
+		const float nearInverse = 1 / minDepth, farInverse = 1 / maxDepth;
+		auto getInverseDepth = [&](float index) { return nearInverse + index * (farInverse - nearInverse) / (numDepths - 1); };
+		DenseMap depthMap(width, height, 1);
+		const int numTiles = (height + tileRows - 1) / tileRows;
+#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+		for (int t = 0; t < numTiles; t++)
+		{
+			const int firstRow = t * tileRows, lastRow = std::min(height, firstRow + tileRows);
+			//The windows of the tile rows read the rows around them
+			const int top = std::max(0, firstRow - radius), bottom = std::min(height, lastRow + radius);
+			const int blockRows = bottom - top;
+			const size_t blockSize = static_cast<size_t>(blockRows) * width;
+			std::vector<double> referenceValues(blockSize), referenceSquared(blockSize);
+			for (int row = top; row < bottom; row++)
+			{
+				for (int col = 0; col < width; col++)
+				{
+					const double value = reference.image.at(row, col);
+					referenceValues[static_cast<size_t>(row - top) * width + col] = value;
+					referenceSquared[static_cast<size_t>(row - top) * width + col] = value * value;
+				}
+			}
+			std::vector<double> referenceTable, referenceSquaredTable;
+			integrate(referenceValues, blockRows, width, referenceTable);
+			integrate(referenceSquared, blockRows, width, referenceSquaredTable);
+			std::vector<double> warped(blockSize), warpedSquared(blockSize), product(blockSize), valid(blockSize);
+			std::vector<double> warpedTable, warpedSquaredTable, productTable, validTable;
+			std::vector<float> costSum(static_cast<size_t>(lastRow - firstRow) * width);
+			std::vector<int> costCount(costSum.size());
+			std::vector<float> previousCost(costSum.size(), 2.f);
+			std::vector<BestCost> best(costSum.size());
+			for (int k = 0; k < numDepths; k++)
+			{
+				const float depth = 1 / getInverseDepth(static_cast<float>(k));
+				std::fill(costSum.begin(), costSum.end(), 0.f);
+				std::fill(costCount.begin(), costCount.end(), 0);
+				for (size_t s = 0; s < sources.size(); s++)
+				{
+					const View& source = sources[s];
+					//Source image warped to the reference by the plane
+					for (int row = top; row < bottom; row++)
+					{
+						for (int col = 0; col < width; col++)
+						{
+							const size_t i = static_cast<size_t>(row - top) * width + col;
+							const Eigen::Vector3f ray((col - reference.cx) / reference.fx, (row - reference.cy) / reference.fy, 1.f);
+							const Eigen::Vector3f point = depth * (relativeRotations[s] * ray) + relativeTranslations[s];
+							const float x = point.z() > 0 ? source.fx * point.x() / point.z() + source.cx : -1.f;
+							const float y = point.z() > 0 ? source.fy * point.y() / point.z() + source.cy : -1.f;
+							if (x < 0 || y < 0 || x > source.image.width - 1 || y > source.image.height - 1)
+							{
+								warped[i] = warpedSquared[i] = product[i] = valid[i] = 0;
+								continue;
+							}
+							//Bilinear
+							const int x0 = std::min(static_cast<int>(x), source.image.width - 2), y0 = std::min(static_cast<int>(y), source.image.height - 2);
+							const float ax = x - x0, ay = y - y0;
+							const double value = (1 - ay) * ((1 - ax) * source.image.at(y0, x0) + ax * source.image.at(y0, x0 + 1)) +
+								ay * ((1 - ax) * source.image.at(y0 + 1, x0) + ax * source.image.at(y0 + 1, x0 + 1));
+							warped[i] = value;
+							warpedSquared[i] = value * value;
+							product[i] = value * referenceValues[i];
+							valid[i] = 1;
+						}
+					}
+					integrate(warped, blockRows, width, warpedTable);
+					integrate(warpedSquared, blockRows, width, warpedSquaredTable);
+					integrate(product, blockRows, width, productTable);
+					integrate(valid, blockRows, width, validTable);
+					//NCC of the windows fully inside the source
+					for (int row = firstRow; row < lastRow; row++)
+					{
+						const int windowTop = std::max(top, row - radius) - top, windowBottom = std::min(bottom, row + radius + 1) - top;
+						for (int col = 0; col < width; col++)
+						{
+							const int windowLeft = std::max(0, col - radius), windowRight = std::min(width, col + radius + 1);
+							const double n = static_cast<double>(windowBottom - windowTop) * (windowRight - windowLeft);
+							if (boxSum(validTable, width, windowTop, windowLeft, windowBottom, windowRight) < n)
+							{
+								continue;
+							}
+							const double sumReference = boxSum(referenceTable, width, windowTop, windowLeft, windowBottom, windowRight);
+							const double sumWarped = boxSum(warpedTable, width, windowTop, windowLeft, windowBottom, windowRight);
+							const double varianceReference = boxSum(referenceSquaredTable, width, windowTop, windowLeft, windowBottom, windowRight) -
+								sumReference * sumReference / n;
+							const double varianceWarped = boxSum(warpedSquaredTable, width, windowTop, windowLeft, windowBottom, windowRight) -
+								sumWarped * sumWarped / n;
+							//Textureless windows don't constrain the depth
+							if (varianceReference < n || varianceWarped < n)
+							{
+								continue;
+							}
+							const double covariance = boxSum(productTable, width, windowTop, windowLeft, windowBottom, windowRight) -
+								sumReference * sumWarped / n;
+							const size_t i = static_cast<size_t>(row - firstRow) * width + col;
+							costSum[i] += static_cast<float>(1 - covariance / std::sqrt(varianceReference * varianceWarped));
+							costCount[i]++;
+						}
+					}
+				}
+				for (size_t i = 0; i < costSum.size(); i++)
+				{
+					const float cost = costCount[i] > 0 ? costSum[i] / costCount[i] : 2.f;
+					if (best[i].index == k - 1)
+					{
+						best[i].nextCost = cost;
+					}
+					if (cost < best[i].cost)
+					{
+						best[i].cost = cost;
+						best[i].previousCost = previousCost[i];
+						best[i].index = k;
+					}
+					previousCost[i] = cost;
+				}
+			}
+			//Depth of the best plane, refined by a parabola through its neighbor planes
+			for (int row = firstRow; row < lastRow; row++)
+			{
+				for (int col = 0; col < width; col++)
+				{
+					const BestCost& pixelBest = best[static_cast<size_t>(row - firstRow) * width + col];
+					if (pixelBest.index < 0 || pixelBest.cost > maxCost)
+					{
+						continue;
+					}
+					float offset = 0;
+					if (pixelBest.index > 0 && pixelBest.index < numDepths - 1)
+					{
+						const float curvature = pixelBest.previousCost - 2 * pixelBest.cost + pixelBest.nextCost;
+						if (curvature > 0)
+						{
+							offset = std::min(0.5f, std::max(-0.5f, 0.5f * (pixelBest.previousCost - pixelBest.nextCost) / curvature));
+						}
+					}
+					depthMap.at(row, col) = 1 / getInverseDepth(pixelBest.index + offset);
+				}
+			}
+		}
+		//Normals from the depth map, pointing to the camera
+		DenseMap normalMap(width, height, 3);
+#pragma omp parallel for schedule(static) num_threads(numThreads)
+		for (int row = 0; row < height; row++)
+		{
+			for (int col = 0; col < width; col++)
+			{
+				const float depth = depthMap.at(row, col);
+				if (depth <= 0)
+				{
+					continue;
+				}
+				auto getPoint = [&](int pointRow, int pointCol)
+				{
+					const float pointDepth = depthMap.at(pointRow, pointCol);
+					return Eigen::Vector3f((pointCol - reference.cx) / reference.fx * pointDepth, (pointRow - reference.cy) / reference.fy * pointDepth, pointDepth);
+				};
+				const Eigen::Vector3f point = getPoint(row, col);
+				Eigen::Vector3f normal = -point.normalized();
+				const int left = col > 0 && depthMap.at(row, col - 1) > 0 ? col - 1 : col;
+				const int right = col < width - 1 && depthMap.at(row, col + 1) > 0 ? col + 1 : col;
+				const int up = row > 0 && depthMap.at(row - 1, col) > 0 ? row - 1 : row;
+				const int down = row < height - 1 && depthMap.at(row + 1, col) > 0 ? row + 1 : row;
+				if (left != right && up != down)
+				{
+					const Eigen::Vector3f cross = (getPoint(row, right) - getPoint(row, left)).cross(getPoint(down, col) - getPoint(up, col));
+					if (cross.norm() > 0)
+					{
+						normal = cross.dot(point) > 0 ? -cross.normalized() : cross.normalized();
+					}
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					normalMap.at(row, col, c) = normal[c];
+				}
+			}
+		}
+		const std::string fileName = image.second.name + ".photometric.bin";
+		if (!depthMap.write(stereoPath + "/depth_maps/" + fileName) || !normalMap.write(stereoPath + "/normal_maps/" + fileName))
+		{
+			wxLogError("Error writing the depth and normal maps of %s", image.second.name);
+			return 0;
+		}
+		processedNames.emplace_back(image.second.name);
+	}
+	//Images with maps, read by COLMAP stereo_fusion
+	std::ofstream fusionConfig(stereoPath + "/fusion.cfg");
+	for (const auto& name : processedNames)
+	{
+		fusionConfig << name << "\n";
+	}
+	fusionConfig.close();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	wxLogInfo(wxString("Plane sweep stereo: " + std::to_string(processedNames.size()) + " of " + std::to_string(model.images.size()) +
+		" images in " + std::to_string(static_cast<int>(seconds)) + " s with " + std::to_string(numThreads) + " threads"));
+	return !processedNames.empty();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+
+namespace Stereo
+{
+	enum Mode
+	{
+		// COLMAP patch match when COLMAP.useGPU is set, plane sweep otherwise
+		Auto,
+		// COLMAP patch_match_stereo, needs CUDA
+		PatchMatch,
+		// PlaneSweepStereo, CPU only
+		PlaneSweep
+	};
+
+	struct Options
+	{
+		Options() {};
+		Options(int mode, int maxImageSize, int numSourceImages, int numDepths, int windowRadius, double minNCC, int numThreads, int tileRows) :
+			mode(mode), maxImageSize(maxImageSize), numSourceImages(numSourceImages), numDepths(numDepths), windowRadius(windowRadius),
+			minNCC(minNCC), numThreads(numThreads), tileRows(tileRows) {};
+		int mode = Auto;
+		// Longest side of the depth maps, the images are downscaled to it
+		int maxImageSize = 1000;
+		// Most covisible images compared with each reference image
+		int numSourceImages = 4;
+		// Fronto-parallel planes swept between the nearest and farthest sparse points, uniform in inverse depth
+		int numDepths = 96;
+		// The matching window has (2 * windowRadius + 1)^2 pixels
+		int windowRadius = 3;
+		// Pixels whose best mean NCC is below it get no depth
+		double minNCC = 0.5;
+		// 0 uses all the cores
+		int numThreads = 0;
+		// Rows of a tile, the unit of work of a thread, its buffers have (tileRows + 2 * windowRadius) * width values
+		int tileRows = 32;
+
+		std::string print() const;
+		// Only the options that change the depth maps, part of the workspace keys
+		std::string printOutputParameters() const;
+	};
+}
+
+// Multi-threaded CPU stereo for machines without CUDA. Each image of the COLMAP dense workspace is matched with its
+// most covisible images by a plane sweep with NCC cost, the rows of the image are split in tiles processed in parallel.
+// The maps are written as COLMAP photometric depth and normal maps, so both fusions can read them.
+class PlaneSweepStereo
+{
+public:
+	static bool run(const std::string& workspacePath, const Stereo::Options& options);
+};
@@ -0,0 +1,417 @@
+#include "PlyIO.h"
+
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
+#include <windows.h>
+
+#include <wx/log.h>
+
+#include "Utils.h"
+#include "tinyply.h"
+#include "Tracer.h"
+
+namespace
+{
+	// pwrite like write, the handle is synchronous so the offset of the OVERLAPPED is used and the call blocks
+	bool writeAt(HANDLE file, const char* data, size_t size, uint64_t offset)
+	{
+		while (size > 0)
+		{
+			const DWORD toWrite = static_cast<DWORD>(std::min<size_t>(size, 1 << 30));
+			OVERLAPPED overlapped = { 0 };
+			overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+			DWORD written = 0;
+			if (!WriteFile(file, data, toWrite, &written, &overlapped) || written != toWrite)
+			{
+				return 0;
+			}
+			data += written;
+			size -= written;
+			offset += written;
+		}
+		return 1;
+	}
+
+	struct WriteTask
+	{
+		bool isFace;
+		size_t begin;
+		size_t end;
+	};
+}
+
+bool PlyIO::write(const std::string& filePath, const std::vector<float>& positions, const std::vector<float>& normals,
+	const std::vector<unsigned char>& colors, const std::vector<uint32_t>& triangles, const WriteOptions& options)
+{
+	Tracer::Span span("PLY write", "io", filePath);
+	const size_t numVertices = positions.size() / 3;
+	const size_t numFaces = triangles.size() / 3;
+	const bool hasNormals = normals.size() == positions.size() && !normals.empty();
+	const bool hasColors = colors.size() == positions.size() && !colors.empty();
+	//Quantization parameters
+	float scale[3] = { 1.f, 1.f, 1.f };
+	float offset[3] = { 0.f, 0.f, 0.f };
+	if (options.quantizePositions && numVertices > 0)
+	{
+		float minimum[3] = { positions[0], positions[1], positions[2] };
+		float maximum[3] = { positions[0], positions[1], positions[2] };
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				minimum[j] = std::min(minimum[j], positions[i * 3 + j]);
+				maximum[j] = std::max(maximum[j], positions[i * 3 + j]);
+			}
+		}
+		for (int j = 0; j < 3; j++)
+		{
+			offset[j] = minimum[j];
+			scale[j] = maximum[j] > minimum[j] ? (maximum[j] - minimum[j]) / 65535.f : 1.f;
+		}
+	}
+	const std::string header = createHeader(numVertices, numFaces, hasNormals, hasColors,
+		options.quantizePositions ? scale : nullptr, options.quantizePositions ? offset : nullptr);
+	const size_t vertexSize = (options.quantizePositions ? 3 * sizeof(uint16_t) : 3 * sizeof(float)) +
+		(hasNormals ? 3 * sizeof(float) : 0) + (hasColors ? 3 : 0);
+	// uchar count + 3 uint indices
+	const size_t faceSize = 1 + 3 * sizeof(uint32_t);
+	const uint64_t facesOffset = header.size() + static_cast<uint64_t>(numVertices) * vertexSize;
+	const uint64_t fileSize = facesOffset + static_cast<uint64_t>(numFaces) * faceSize;
+
+	//Preallocate the file and write the header
+	const std::wstring wideFilePath = Utils::s2ws(filePath);
+	HANDLE file = CreateFileW(wideFilePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		wxLogError(wxString("Could not open " + filePath + " to write"));
+		return 0;
+	}
+	LARGE_INTEGER size;
+	size.QuadPart = static_cast<LONGLONG>(fileSize);
+	if (!SetFilePointerEx(file, size, NULL, FILE_BEGIN) || !SetEndOfFile(file) ||
+		!writeAt(file, header.data(), header.size(), 0))
+	{
+		CloseHandle(file);
+		wxLogError(wxString("Could not allocate " + filePath));
+		return 0;
+	}
+	CloseHandle(file);
+
+	//Split the elements in chunks
+	const size_t chunkSize = std::max<size_t>(options.chunkSize, 1);
+	std::vector<WriteTask> tasks;
+	tasks.reserve((numVertices + numFaces) / chunkSize + 2);
+	for (size_t begin = 0; begin < numVertices; begin += chunkSize)
+	{
+		tasks.push_back({ false, begin, std::min(begin + chunkSize, numVertices) });
+	}
+	for (size_t begin = 0; begin < numFaces; begin += chunkSize)
+	{
+		tasks.push_back({ true, begin, std::min(begin + chunkSize, numFaces) });
+	}
+
+	std::atomic<bool> failed(false);
+#pragma omp parallel
+	{
+		//Each thread has its own handle, so the writes of different regions do not wait for each other
+		HANDLE threadFile = CreateFileW(wideFilePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (threadFile == INVALID_HANDLE_VALUE)
+		{
+			failed = true;
+		}
+		std::vector<char> buffer;
+#pragma omp for schedule(dynamic, 1)
+		for (int t = 0; t < static_cast<int>(tasks.size()); t++)
+		{
+			if (failed)
+			{
+				continue;
+			}
+			const WriteTask& task = tasks[t];
+			const size_t count = task.end - task.begin;
+			if (task.isFace)
+			{
+				buffer.resize(count * faceSize);
+				char* out = buffer.data();
+				for (size_t i = task.begin; i < task.end; i++)
+				{
+					*out++ = 3;
+					std::memcpy(out, &triangles[i * 3], 3 * sizeof(uint32_t));
+					out += 3 * sizeof(uint32_t);
+				}
+				if (!writeAt(threadFile, buffer.data(), buffer.size(), facesOffset + static_cast<uint64_t>(task.begin) * faceSize))
+				{
+					failed = true;
+				}
+			}
+			else
+			{
+				buffer.resize(count * vertexSize);
+				char* out = buffer.data();
+				for (size_t i = task.begin; i < task.end; i++)
+				{
+					if (options.quantizePositions)
+					{
+						uint16_t quantized[3];
+						for (int j = 0; j < 3; j++)
+						{
+							const float value = (positions[i * 3 + j] - offset[j]) / scale[j] + 0.5f;
+							quantized[j] = static_cast<uint16_t>(std::min(std::max(value, 0.f), 65535.f));
+						}
+						std::memcpy(out, quantized, sizeof(quantized));
+						out += sizeof(quantized);
+					}
+					else
+					{
+						std::memcpy(out, &positions[i * 3], 3 * sizeof(float));
+						out += 3 * sizeof(float);
+					}
+					if (hasNormals)
+					{
+						std::memcpy(out, &normals[i * 3], 3 * sizeof(float));
+						out += 3 * sizeof(float);
+					}
+					if (hasColors)
+					{
+						std::memcpy(out, &colors[i * 3], 3);
+						out += 3;
+					}
+				}
+				if (!writeAt(threadFile, buffer.data(), buffer.size(), header.size() + static_cast<uint64_t>(task.begin) * vertexSize))
+				{
+					failed = true;
+				}
+			}
+		}
+		if (threadFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(threadFile);
+		}
+	}
+	if (failed)
+	{
+		wxLogError(wxString("Error writing " + filePath));
+		return 0;
+	}
+	return 1;
+}
+
+PlyIO::StreamWriter::~StreamWriter()
+{
+	if (file.is_open())
+	{
+		close();
+	}
+}
+
+bool PlyIO::StreamWriter::open(const std::string& filePath, bool hasNormals, bool hasColors)
+{
+	this->filePath = filePath;
+	this->hasNormals = hasNormals;
+	this->hasColors = hasColors;
+	numVertices = 0;
+	file.open(filePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		wxLogError(wxString("Could not open " + filePath + " to write"));
+		return 0;
+	}
+	//The count is padded with zeros, so the final one fits in its place
+	std::string header = createHeader(0, 0, hasNormals, hasColors, nullptr, nullptr);
+	const std::string countLine = "element vertex ";
+	const size_t countPosition = header.find(countLine + "0\n") + countLine.size();
+	header.replace(countPosition, 1, std::string(20, '0'));
+	countOffset = static_cast<std::streamoff>(countPosition);
+	file.write(header.data(), header.size());
+	return file.good();
+}
+
+bool PlyIO::StreamWriter::append(const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<unsigned char>& colors)
+{
+	const size_t count = positions.size() / 3;
+	if (count == 0)
+	{
+		return 1;
+	}
+	if ((hasNormals && normals.size() != positions.size()) || (hasColors && colors.size() != positions.size()))
+	{
+		wxLogError(wxString("Missing normals or colors writing " + filePath));
+		return 0;
+	}
+	//Serialized before taking the lock
+	const size_t vertexSize = 3 * sizeof(float) + (hasNormals ? 3 * sizeof(float) : 0) + (hasColors ? 3 : 0);
+	std::vector<char> buffer(count * vertexSize);
+	char* out = buffer.data();
+	for (size_t i = 0; i < count; i++)
+	{
+		std::memcpy(out, &positions[i * 3], 3 * sizeof(float));
+		out += 3 * sizeof(float);
+		if (hasNormals)
+		{
+			std::memcpy(out, &normals[i * 3], 3 * sizeof(float));
+			out += 3 * sizeof(float);
+		}
+		if (hasColors)
+		{
+			std::memcpy(out, &colors[i * 3], 3);
+			out += 3;
+		}
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	file.write(buffer.data(), buffer.size());
+	numVertices += count;
+	return file.good();
+}
+
+bool PlyIO::StreamWriter::close()
+{
+	std::stringstream count;
+	count << std::setw(20) << std::setfill('0') << numVertices;
+	file.seekp(countOffset);
+	file.write(count.str().data(), 20);
+	const bool succeeded = file.good();
+	file.close();
+	if (!succeeded)
+	{
+		wxLogError(wxString("Error writing " + filePath));
+	}
+	return succeeded;
+}
+
+bool PlyIO::readPoints(const std::string& filePath, std::vector<float>& positions, std::vector<float>& normals,
+	std::vector<unsigned char>& colors)
+{
+	Tracer::Span span("PLY read", "io", filePath);
+	std::ifstream fileStream(filePath, std::ios::binary);
+	if (!fileStream.is_open())
+	{
+		return 0;
+	}
+	std::shared_ptr<tinyply::PlyData> vertices, vertexNormals, vertexColors;
+	try
+	{
+		tinyply::PlyFile file;
+		file.parse_header(fileStream);
+		vertices = file.request_properties_from_element("vertex", { "x", "y", "z" });
+		//Optional properties
+		try { vertexNormals = file.request_properties_from_element("vertex", { "nx", "ny", "nz" }); }
+		catch (const std::exception&) {}
+		try { vertexColors = file.request_properties_from_element("vertex", { "red", "green", "blue" }); }
+		catch (const std::exception&) {}
+		file.read(fileStream);
+	}
+	catch (const std::exception&)
+	{
+		wxLogError("Caught tinyply exception");
+		return 0;
+	}
+	if (!vertices || vertices->t != tinyply::Type::FLOAT32)
+	{
+		return 0;
+	}
+	positions.resize(vertices->count * 3);
+	std::memcpy(positions.data(), vertices->buffer.get(), vertices->buffer.size_bytes());
+	normals.clear();
+	if (vertexNormals && vertexNormals->t == tinyply::Type::FLOAT32)
+	{
+		normals.resize(vertexNormals->count * 3);
+		std::memcpy(normals.data(), vertexNormals->buffer.get(), vertexNormals->buffer.size_bytes());
+	}
+	colors.clear();
+	if (vertexColors && vertexColors->t == tinyply::Type::UINT8)
+	{
+		colors.resize(vertexColors->count * 3);
+		std::memcpy(colors.data(), vertexColors->buffer.get(), vertexColors->buffer.size_bytes());
+	}
+	return 1;
+}
+
+bool PlyIO::readPointsHeader(const std::string& filePath, size_t& numVertices, bool& hasNormals, bool& hasColors)
+{
+	std::ifstream fileStream(filePath, std::ios::binary);
+	if (!fileStream.is_open())
+	{
+		return 0;
+	}
+	std::vector<tinyply::PlyElement> elements;
+	try
+	{
+		tinyply::PlyFile file;
+		file.parse_header(fileStream);
+		elements = file.get_elements();
+	}
+	catch (const std::exception&)
+	{
+		wxLogError("Caught tinyply exception");
+		return 0;
+	}
+	for (const auto& element : elements)
+	{
+		if (element.name != "vertex")
+		{
+			continue;
+		}
+		//Same types as readPoints
+		auto hasProperty = [&](const std::string& name, tinyply::Type type)
+		{
+			return std::any_of(element.properties.begin(), element.properties.end(), [&](const tinyply::PlyProperty& property)
+			{
+				return property.name == name && property.propertyType == type && !property.isList;
+			});
+		};
+		numVertices = element.size;
+		hasNormals = hasProperty("nx", tinyply::Type::FLOAT32) && hasProperty("ny", tinyply::Type::FLOAT32) &&
+			hasProperty("nz", tinyply::Type::FLOAT32);
+		hasColors = hasProperty("red", tinyply::Type::UINT8) && hasProperty("green", tinyply::Type::UINT8) &&
+			hasProperty("blue", tinyply::Type::UINT8);
+		return 1;
+	}
+	return 0;
+}
+
+std::string PlyIO::getHeader(size_t numVertices, size_t numFaces, bool hasNormals, bool hasColors)
+{
+	return createHeader(numVertices, numFaces, hasNormals, hasColors, nullptr, nullptr);
+}
+
+std::string PlyIO::createHeader(size_t numVertices, size_t numFaces, bool hasNormals, bool hasColors,
+	const float* quantizationScale, const float* quantizationOffset)
+{
+	std::stringstream header;
+	header.precision(9);
+	header << "ply\nformat binary_little_endian 1.0\n";
+	if (quantizationScale && quantizationOffset)
+	{
+		header << "comment quantization_scale " << quantizationScale[0] << " " << quantizationScale[1] << " " << quantizationScale[2] << "\n";
+		header << "comment quantization_offset " << quantizationOffset[0] << " " << quantizationOffset[1] << " " << quantizationOffset[2] << "\n";
+	}
+	header << "element vertex " << numVertices << "\n";
+	const std::string positionType = (quantizationScale && quantizationOffset) ? "ushort" : "float";
+	header << "property " << positionType << " x\n";
+	header << "property " << positionType << " y\n";
+	header << "property " << positionType << " z\n";
+	if (hasNormals)
+	{
+		header << "property float nx\nproperty float ny\nproperty float nz\n";
+	}
+	if (hasColors)
+	{
+		header << "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+	}
+	if (numFaces > 0)
+	{
+		header << "element face " << numFaces << "\n";
+		header << "property list uchar uint vertex_indices\n";
+	}
+	header << "end_header\n";
+	return header.str();
+}
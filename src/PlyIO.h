@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+
+class PlyIO
+{
+public:
+	struct WriteOptions
+	{
+		WriteOptions() {};
+		// Store x, y, z as 16 bits integers, position = offset + value * scale (per axis, written as a header comment)
+		bool quantizePositions = false;
+		// Number of vertices or faces serialized by each task
+		size_t chunkSize = 1 << 18;
+	};
+
+	// Write a binary little endian PLY.
+	// positions and normals are xyz interleaved, colors are rgb interleaved and triangles are 3 indices per face.
+	// Empty normals, colors or triangles are not written.
+	// The file is preallocated and the chunks are serialized and written in parallel, each one in its own region.
+	static bool write(const std::string& filePath, const std::vector<float>& positions, const std::vector<float>& normals,
+		const std::vector<unsigned char>& colors, const std::vector<uint32_t>& triangles, const WriteOptions& options = WriteOptions());
+
+	// Binary little endian PLY of float vertices appended while they are created, the vertex count is written on close,
+	// so a point cloud is written without holding it in memory
+	class StreamWriter
+	{
+	public:
+		StreamWriter() {};
+		~StreamWriter();
+
+		bool open(const std::string& filePath, bool hasNormals, bool hasColors);
+		// Thread safe, positions and normals are xyz interleaved and colors are rgb interleaved
+		bool append(const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<unsigned char>& colors);
+		// Write the vertex count and close the file
+		bool close();
+		size_t getNumVertices() const { return numVertices; };
+
+	private:
+		std::ofstream file;
+		std::mutex mutex;
+		std::string filePath;
+		bool hasNormals = false;
+		bool hasColors = false;
+		size_t numVertices = 0;
+		// Position of the fixed width vertex count in the header
+		std::streamoff countOffset = 0;
+	};
+
+	// Read the float positions of a point cloud, normals and colors are left empty when the file doesn't have them
+	static bool readPoints(const std::string& filePath, std::vector<float>& positions, std::vector<float>& normals,
+		std::vector<unsigned char>& colors);
+
+	// Vertex count and optional properties of a point cloud from its header, without reading the points
+	static bool readPointsHeader(const std::string& filePath, size_t& numVertices, bool& hasNormals, bool& hasColors);
+
+	// Header of the files written here, for writers that stream their own vertices and faces (uchar count and uint indices)
+	static std::string getHeader(size_t numVertices, size_t numFaces, bool hasNormals, bool hasColors);
+
+private:
+	static std::string createHeader(size_t numVertices, size_t numFaces, bool hasNormals, bool hasColors,
+		const float* quantizationScale, const float* quantizationOffset);
+};
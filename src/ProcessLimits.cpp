@@ -0,0 +1,88 @@
+#include "ProcessLimits.h"
+
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#include <windows.h>
+
+#include <wx/log.h>
+
+#include "StageBudget.h"
+#include "ConfigurationDialog.h"
+
+std::string Limits::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Priority " << priority << "\n" <<
+		"Memory factor " << memoryFactor << "\n" <<
+		"CPU hard cap " << cpuHardCap << "\n";
+	return parameters.str();
+}
+
+std::string Limits::Plan::print() const
+{
+	std::stringstream text;
+	text << "priority class 0x" << std::hex << priorityClass << ", processors 0x" << affinityMask << std::dec <<
+		", memory " << memoryBytes / (1024 * 1024) << " MB, CPU rate " << cpuRate / 100.0 << "%";
+	return text.str();
+}
+
+Limits::Plan ProcessLimits::plan(const Limits::Options& options, const Budget::Cost& held, uint64_t heldProcessors, int numProcessors)
+{
+	Limits::Plan plan;
+	plan.priorityClass = options.priority >= 2 ? IDLE_PRIORITY_CLASS : options.priority == 1 ? BELOW_NORMAL_PRIORITY_CLASS : NORMAL_PRIORITY_CLASS;
+	plan.affinityMask = heldProcessors;
+	if (options.memoryFactor > 0 && held.memory > 0)
+	{
+		plan.memoryBytes = static_cast<uint64_t>(options.memoryFactor * held.memory * 1024 * 1024 * 1024);
+	}
+	if (options.cpuHardCap && held.cpuThreads > 0 && numProcessors > held.cpuThreads)
+	{
+		plan.cpuRate = std::max(10000 * held.cpuThreads / numProcessors, 1);
+	}
+	return plan;
+}
+
+Limits::Plan ProcessLimits::getCurrentPlan()
+{
+	return plan(ConfigurationDialog::getLimitsOptions(), StageBudget::getHeld(), StageBudget::getHeldProcessors(),
+		std::max(static_cast<int>(std::thread::hardware_concurrency()), 1));
+}
+
+bool ProcessLimits::apply(void* job, const Limits::Plan& plan)
+{
+	JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits;
+	ZeroMemory(&limits, sizeof(limits));
+	limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_PRIORITY_CLASS;
+	limits.BasicLimitInformation.PriorityClass = plan.priorityClass;
+	if (plan.affinityMask != 0)
+	{
+		limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_AFFINITY;
+		limits.BasicLimitInformation.Affinity = static_cast<ULONG_PTR>(plan.affinityMask);
+	}
+	if (plan.memoryBytes > 0)
+	{
+		limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_JOB_MEMORY;
+		limits.JobMemoryLimit = static_cast<SIZE_T>(plan.memoryBytes);
+	}
+	bool applied = true;
+	if (!SetInformationJobObject(job, JobObjectExtendedLimitInformation, &limits, sizeof(limits)))
+	{
+		wxLogWarning("Could not limit the process (%d)", GetLastError());
+		applied = false;
+	}
+	if (plan.cpuRate > 0)
+	{
+		JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate;
+		ZeroMemory(&rate, sizeof(rate));
+		rate.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+		rate.CpuRate = plan.cpuRate;
+		if (!SetInformationJobObject(job, JobObjectCpuRateControlInformation, &rate, sizeof(rate)))
+		{
+			wxLogWarning("Could not cap the CPU of the process (%d)", GetLastError());
+			applied = false;
+		}
+	}
+	return applied;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace Budget
+{
+	struct Cost;
+}
+
+namespace Limits
+{
+	struct Options
+	{
+		Options() {};
+		Options(int priority, double memoryFactor, bool cpuHardCap) : priority(priority), memoryFactor(memoryFactor), cpuHardCap(cpuHardCap) {};
+		// Priority of the external tools, 0 normal, 1 below normal, 2 idle
+		int priority = 1;
+		// Memory limit of a tool as a multiple of the GB its stage holds in the queue budget, 0 for none. A tool over it fails
+		double memoryFactor = 1.5;
+		// Caps the CPU time of a tool to the threads its stage holds, besides keeping it on their processors
+		bool cpuHardCap = false;
+
+		std::string print() const;
+	};
+
+	struct Plan
+	{
+		unsigned long priorityClass = 0;
+		// Processors of the tool, 0 for all
+		uint64_t affinityMask = 0;
+		// 0 for none
+		uint64_t memoryBytes = 0;
+		// In 1/100 of a percent of the machine, 0 for none
+		int cpuRate = 0;
+
+		std::string print() const;
+	};
+}
+
+// Limits of the job object each external tool runs in, the Windows counterpart of a cgroup: priority class,
+// processors, memory and CPU rate. Outside the queue only the priority applies, in a queued job the rest follows
+// the share of the machine held by the running stage (StageBudget), so concurrent tools don't thrash each other.
+class ProcessLimits
+{
+public:
+	static Limits::Plan plan(const Limits::Options& options, const Budget::Cost& held, uint64_t heldProcessors, int numProcessors);
+	// Limits of the tools started now, from the configuration and the budget of the running stage
+	static Limits::Plan getCurrentPlan();
+	static bool apply(void* job, const Limits::Plan& plan);
+};
@@ -0,0 +1,416 @@
+#include "ProgressModel.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <chrono>
+#include <algorithm>
+
+#include "json.hpp"
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// Steps of each stage by a substring of the tool or native step name, the alternatives of a step share its group
+	struct StepWeight
+	{
+		const char* stage;
+		const char* name;
+		const char* group;
+		double weight;
+	};
+	const StepWeight stepWeights[] =
+	{
+		{ "SFM", "feature_extractor", "features", 0.15 },
+		{ "SFM", "matcher", "matching", 0.35 },
+		{ "SFM", "matches_importer", "matching", 0.35 },
+		{ "SFM", "mapper", "mapping", 0.5 },
+		{ "Dense", "image_undistorter", "undistortion", 0.05 },
+		{ "Dense", "patch_match_stereo", "stereo", 0.75 },
+		{ "Dense", "plane_sweep", "stereo", 0.75 },
+		{ "Dense", "stereo_fusion", "fusion", 0.2 },
+		{ "Dense", "fusion", "fusion", 0.2 },
+		{ "Meshing", "SSDRecon", "meshing", 0.9 },
+		{ "Meshing", "SurfaceTrimmer", "trimming", 0.1 },
+		{ "Texturization", "texrecon", "texturing", 1 },
+		{ "Scale", "scale_ptcs", "scale", 1 }
+	};
+
+	// Seconds per image megapixel of a stage before it has a history, rough values replaced after the first run
+	double getDefaultRate(const std::string& stage)
+	{
+		if (stage == "SFM") return 0.5;
+		if (stage == "Dense") return 2;
+		if (stage == "Meshing") return 0.3;
+		if (stage == "Texturization") return 0.3;
+		return 0.02;
+	}
+
+	// The steps TexRecon prints in order
+	const char* texReconSteps[] =
+	{
+		"Load and prepare mesh", "Generating texture views", "Building adjacency graph", "View selection",
+		"Generating texture patches", "Running global seam leveling", "Running local seam leveling",
+		"Generating texture atlases", "Building objmodel", "Saving"
+	};
+	// Weight given to the history in the average of the rates
+	const double historyWeight = 0.7;
+
+	std::mutex progressMutex;
+	bool running = false;
+	std::vector<Progress::Stage> stages;
+	std::vector<double> stageSeconds;
+	size_t numImages = 0;
+	int currentStage = -1;
+	Clock::time_point runStart, stageStart;
+	std::map<std::string, double> groupFractions;
+	std::string currentStep, lastLine;
+	std::string historyPath;
+	nlohmann::json history;
+	std::ofstream toolLog;
+
+	const StepWeight* findStep(const std::string& stage, const std::string& name)
+	{
+		for (const auto& step : stepWeights)
+		{
+			if (stage == step.stage && name.find(step.name) != std::string::npos)
+			{
+				return &step;
+			}
+		}
+		return nullptr;
+	}
+
+	//Needs progressMutex
+	double getRate(const Progress::Stage& stage)
+	{
+		const auto it = history.find(stage.historyKey);
+		if (it != history.end() && it->is_object() && it->value("secondsPerWork", 0.0) > 0)
+		{
+			return it->value("secondsPerWork", 0.0);
+		}
+		return getDefaultRate(stage.name);
+	}
+
+	//Needs progressMutex
+	double getStageFraction()
+	{
+		if (currentStage < 0)
+		{
+			return 0;
+		}
+		std::map<std::string, double> groupWeights;
+		for (const auto& step : stepWeights)
+		{
+			if (stages[currentStage].name == step.stage)
+			{
+				groupWeights[step.group] = step.weight;
+			}
+		}
+		double done = 0, total = 0;
+		for (const auto& group : groupWeights)
+		{
+			const auto it = groupFractions.find(group.first);
+			done += group.second * (it != groupFractions.end() ? it->second : 0);
+			total += group.second;
+		}
+		return total > 0 ? done / total : 0;
+	}
+
+	//Needs progressMutex, fractions of a step only grow during a stage
+	void setStepFraction(const std::string& name, double fraction)
+	{
+		if (currentStage < 0)
+		{
+			return;
+		}
+		const auto step = findStep(stages[currentStage].name, name);
+		if (step)
+		{
+			auto& groupFraction = groupFractions[step->group];
+			groupFraction = std::max(groupFraction, std::min(std::max(fraction, 0.0), 1.0));
+		}
+	}
+
+	std::string formatSeconds(double seconds)
+	{
+		const long long total = static_cast<long long>(seconds + 0.5);
+		std::stringstream text;
+		text << std::setfill('0') << std::setw(2) << total / 3600 << ":" << std::setw(2) << (total / 60) % 60 << ":" << std::setw(2) << total % 60;
+		return text.str();
+	}
+}
+
+std::string Progress::Status::print() const
+{
+	std::stringstream text;
+	if (stageIndex > 0)
+	{
+		text << "Etapa " << stageIndex << "/" << numStages << " " << stage;
+		if (!step.empty())
+		{
+			text << " - " << step;
+		}
+		text << " " << static_cast<int>(100 * stageFraction) << "% - ";
+	}
+	text << "total " << static_cast<int>(100 * fraction) << "% - decorrido " << formatSeconds(elapsedSeconds);
+	if (remainingSeconds >= 0)
+	{
+		text << " - restante ~" << formatSeconds(remainingSeconds);
+	}
+	return text.str();
+}
+
+void ProgressModel::start(const std::vector<Progress::Stage>& runStages, size_t runNumImages, const std::string& runHistoryPath,
+	const std::string& toolLogPath)
+{
+	std::lock_guard<std::mutex> lock(progressMutex);
+	stages = runStages;
+	stageSeconds.assign(stages.size(), 0);
+	numImages = runNumImages;
+	currentStage = -1;
+	groupFractions.clear();
+	currentStep.clear();
+	lastLine.clear();
+	historyPath = runHistoryPath;
+	history = nlohmann::json::object();
+	std::ifstream historyFile(historyPath);
+	if (historyFile.is_open())
+	{
+		try
+		{
+			history = nlohmann::json::parse(historyFile);
+		}
+		catch (const std::exception&)
+		{
+			//A corrupted history only means the default rates are used
+			history = nlohmann::json::object();
+		}
+	}
+	if (!history.is_object())
+	{
+		history = nlohmann::json::object();
+	}
+	if (toolLog.is_open())
+	{
+		toolLog.close();
+	}
+	toolLog.open(toolLogPath, std::ofstream::out | std::ofstream::app);
+	runStart = Clock::now();
+	running = true;
+}
+
+void ProgressModel::finish()
+{
+	std::lock_guard<std::mutex> lock(progressMutex);
+	running = false;
+	currentStage = -1;
+	if (toolLog.is_open())
+	{
+		toolLog.close();
+	}
+}
+
+void ProgressModel::startStage(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(progressMutex);
+	currentStage = -1;
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		if (stages[i].name == name)
+		{
+			currentStage = static_cast<int>(i);
+		}
+	}
+	groupFractions.clear();
+	currentStep.clear();
+	lastLine.clear();
+	stageStart = Clock::now();
+}
+
+void ProgressModel::finishStage(bool succeeded)
+{
+	std::lock_guard<std::mutex> lock(progressMutex);
+	if (currentStage < 0)
+	{
+		return;
+	}
+	const double seconds = std::chrono::duration<double>(Clock::now() - stageStart).count();
+	stageSeconds[currentStage] = seconds;
+	const auto& stage = stages[currentStage];
+	currentStage = -1;
+	if (!succeeded || stage.work <= 0 || historyPath.empty())
+	{
+		return;
+	}
+	auto& entry = history[stage.historyKey];
+	const double rate = seconds / stage.work;
+	const int runs = entry.is_object() ? entry.value("runs", 0) : 0;
+	const double previousRate = entry.is_object() ? entry.value("secondsPerWork", 0.0) : 0.0;
+	entry["secondsPerWork"] = runs > 0 && previousRate > 0 ? historyWeight * previousRate + (1 - historyWeight) * rate : rate;
+	entry["runs"] = runs + 1;
+	std::ofstream historyFile(historyPath);
+	if (historyFile.is_open())
+	{
+		historyFile << history.dump(2);
+	}
+}
+
+void ProgressModel::processStarted(const std::string& processName)
+{
+	std::lock_guard<std::mutex> lock(progressMutex);
+	currentStep = processName;
+	lastLine.clear();
+}
+
+void ProgressModel::processOutput(const std::string& processName, const std::string& line)
+{
+	double fraction;
+	const bool hasFraction = parseLine(processName, line, numImages, fraction);
+	std::lock_guard<std::mutex> lock(progressMutex);
+	if (toolLog.is_open())
+	{
+		toolLog << "[" << processName << "] " << line << "\n";
+	}
+	currentStep = processName;
+	lastLine = line;
+	if (hasFraction)
+	{
+		setStepFraction(processName, fraction);
+	}
+}
+
+void ProgressModel::processFinished(const std::string& processName)
+{
+	std::lock_guard<std::mutex> lock(progressMutex);
+	setStepFraction(processName, 1);
+	if (toolLog.is_open())
+	{
+		toolLog.flush();
+	}
+}
+
+void ProgressModel::reportStep(const std::string& step, size_t done, size_t total)
+{
+	std::lock_guard<std::mutex> lock(progressMutex);
+	currentStep = step;
+	if (total > 0)
+	{
+		setStepFraction(step, static_cast<double>(done) / total);
+	}
+}
+
+Progress::Status ProgressModel::getStatus()
+{
+	std::lock_guard<std::mutex> lock(progressMutex);
+	Progress::Status status;
+	status.running = running;
+	status.numStages = static_cast<int>(stages.size());
+	if (!running)
+	{
+		return status;
+	}
+	const auto now = Clock::now();
+	status.elapsedSeconds = std::chrono::duration<double>(now - runStart).count();
+	status.step = currentStep;
+	status.lastLine = lastLine;
+	double remaining = 0;
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		const double predicted = getRate(stages[i]) * stages[i].work;
+		if (static_cast<int>(i) == currentStage)
+		{
+			//The observed progress is trusted more as the stage advances
+			const double stageElapsed = std::chrono::duration<double>(now - stageStart).count();
+			const double fraction = getStageFraction();
+			double estimated = predicted;
+			if (fraction > 0.02)
+			{
+				const double observed = stageElapsed / fraction;
+				estimated = fraction * observed + (1 - fraction) * predicted;
+			}
+			remaining += std::max(estimated - stageElapsed, 0.0);
+			status.stage = stages[i].name;
+			status.stageIndex = static_cast<int>(i) + 1;
+			status.stageFraction = fraction;
+		}
+		else if (stageSeconds[i] == 0 && (currentStage < 0 || static_cast<int>(i) > currentStage))
+		{
+			remaining += predicted;
+		}
+	}
+	status.remainingSeconds = remaining;
+	status.fraction = status.elapsedSeconds + remaining > 0 ? status.elapsedSeconds / (status.elapsedSeconds + remaining) : 0;
+	return status;
+}
+
+double ProgressModel::getPredictedSeconds(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(progressMutex);
+	for (const auto& stage : stages)
+	{
+		if (stage.name == name)
+		{
+			return getRate(stage) * stage.work;
+		}
+	}
+	return -1;
+}
+
+bool ProgressModel::parseLine(const std::string& processName, const std::string& line, size_t numImages, double& fraction)
+{
+	std::smatch match;
+	//Exhaustive matcher, "Matching block [i/n, j/n]"
+	static const std::regex blockRegex("block \\[(\\d+)/(\\d+), (\\d+)/(\\d+)\\]");
+	if (std::regex_search(line, match, blockRegex))
+	{
+		const double i = std::stod(match[1]), n = std::stod(match[2]), j = std::stod(match[3]), m = std::stod(match[4]);
+		if (n > 0 && m > 0)
+		{
+			fraction = ((i - 1) * m + j) / (n * m);
+			return 1;
+		}
+	}
+	//Mapper, "Registering image #id (registered)"
+	static const std::regex registerRegex("Registering image #\\d+ \\((\\d+)\\)");
+	if (std::regex_search(line, match, registerRegex))
+	{
+		if (numImages == 0)
+		{
+			return 0;
+		}
+		fraction = std::stod(match[1]) / numImages;
+		return 1;
+	}
+	//TexRecon steps, the percentages it prints are of the current step only
+	if (processName.find("texrecon") != std::string::npos)
+	{
+		const int numSteps = sizeof(texReconSteps) / sizeof(texReconSteps[0]);
+		for (int s = numSteps - 1; s >= 0; s--)
+		{
+			if (line.find(texReconSteps[s]) != std::string::npos)
+			{
+				fraction = static_cast<double>(s) / numSteps;
+				return 1;
+			}
+		}
+		return 0;
+	}
+	//"[x/y]", "x / y" of the COLMAP counters and the SSDRecon depths, not inside paths or words
+	static const std::regex counterRegex("(^|[^\\w/.])(\\d+)\\s*/\\s*(\\d+)(?![\\w/.])");
+	bool found = false;
+	for (auto it = std::sregex_iterator(line.begin(), line.end(), counterRegex); it != std::sregex_iterator(); ++it)
+	{
+		const double done = std::stod((*it)[2]), total = std::stod((*it)[3]);
+		if (total > 0 && done <= total)
+		{
+			fraction = done / total;
+			found = true;
+		}
+	}
+	return found;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace Progress
+{
+	// A stage of the run, work is what its time grows with (images x megapixels processed)
+	struct Stage
+	{
+		Stage() {};
+		Stage(const std::string& name, const std::string& historyKey, double work) : name(name), historyKey(historyKey), work(work) {};
+		std::string name;
+		// Stages with the same key share their history, e.g. the dense stage of one quality and stereo
+		std::string historyKey;
+		double work = 0;
+	};
+
+	struct Status
+	{
+		bool running = false;
+		std::string stage;
+		// 1 based, 0 before the first stage
+		int stageIndex = 0;
+		int numStages = 0;
+		// Tool or native step running and its last output line
+		std::string step;
+		std::string lastLine;
+		// Of the running stage and of the whole run, 0 to 1
+		double stageFraction = 0;
+		double fraction = 0;
+		double elapsedSeconds = 0;
+		// Negative while unknown
+		double remainingSeconds = -1;
+
+		// One line for the progress dialog and the command line
+		std::string print() const;
+	};
+}
+
+// Progress of a reconstruction. The output of the external tools is parsed line by line (COLMAP "[x/y]" counters,
+// registered images of the mapper, SSDRecon depths, TexRecon steps) and the native steps report their counts,
+// each stage is split in weighted steps and the remaining time is predicted from the seconds per unit of work of
+// the previous runs, corrected by the progress observed in the running stage. Every call is thread safe.
+class ProgressModel
+{
+public:
+	// historyPath keeps the rates of the previous runs, the tools output is appended to toolLogPath
+	static void start(const std::vector<Progress::Stage>& stages, size_t numImages, const std::string& historyPath,
+		const std::string& toolLogPath);
+	static void finish();
+
+	static void startStage(const std::string& name);
+	// The rate of a succeeded stage is added to the history
+	static void finishStage(bool succeeded);
+
+	// Called by Utils::startProcess
+	static void processStarted(const std::string& processName);
+	static void processOutput(const std::string& processName, const std::string& line);
+	static void processFinished(const std::string& processName);
+
+	// Progress of a native step, done out of total
+	static void reportStep(const std::string& step, size_t done, size_t total);
+
+	static Progress::Status getStatus();
+	// Seconds the stage should take from the rates of the previous runs, -1 if it isn't in the run
+	static double getPredictedSeconds(const std::string& name);
+
+	// Fraction of the step in a line of its output, false if the line has none
+	static bool parseLine(const std::string& processName, const std::string& line, size_t numImages, double& fraction);
+};
@@ -54,6 +54,10 @@ ProjectImagesWizardPage::ProjectImagesWizardPage(wxWizard * parent, wxWizardPage
 
 	bSizer->Add(ckMoveImages, 0, wxALIGN_LEFT, 5);
 
+	ckPreScreenImages = new wxCheckBox(this, wxID_ANY, "Descartar imagens borradas, mal expostas ou repetidas");
+
+	bSizer->Add(ckPreScreenImages, 0, wxALIGN_LEFT, 5);
+
 	this->SetSizer(bSizer);
 
 	btAddImages->Connect(wxEVT_COMMAND_BUTTON_CLICKED, wxCommandEventHandler(ProjectImagesWizardPage::OnBtAddImages), nullptr, this);
@@ -81,6 +85,11 @@ bool ProjectImagesWizardPage::GetMoveImagesToProjectDir()
 	return ckMoveImages->IsChecked();
 }
 
+bool ProjectImagesWizardPage::GetPreScreenImages()
+{
+	return ckPreScreenImages->IsChecked();
+}
+
 void ProjectImagesWizardPage::OnBtAddImages(wxCommandEvent & event)
 {
 	wxFileDialog imagesDialog(this, "Selecione as imagens", "", "",
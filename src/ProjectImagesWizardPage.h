@@ -13,11 +13,13 @@ public:
 
 	wxArrayString GetImagesPath();
 	bool GetMoveImagesToProjectDir();
+	bool GetPreScreenImages();
 
 private:
 	wxStaticText* selectedImagesStatText;
 	wxListCtrl* selectedImagesList;
 	wxCheckBox* ckMoveImages;
+	wxCheckBox* ckPreScreenImages;
 	
 	void OnBtAddImages(wxCommandEvent& event);
 	void OnBtAddDirectory(wxCommandEvent& event);
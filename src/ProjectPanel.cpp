@@ -2,6 +2,9 @@
 
 #include <fstream>
 #include <string>
+#include <future>
+#include <algorithm>
+#include <chrono>
 
 #include <wx/wx.h>
 #include <wx/log.h>
@@ -12,6 +15,13 @@
 #include "ProjectTemplateWizardPage.h"
 #include "Utils.h"
 #include "Reconstruction.h"
+#include "ImageIngestion.h"
+#include "ImagePreScreen.h"
+#include "ImageMetadataCache.h"
+#include "ConfigurationDialog.h"
+#include "ProgressModel.h"
+#include "Cancellation.h"
+#include "JobQueue.h"
 #include "ProjectPanel.h"
 
 BEGIN_EVENT_TABLE(ProjectPanel, wxPanel)
@@ -26,6 +36,10 @@ ProjectPanel::ProjectPanel(wxFrame* parent) : wxPanel(parent)
 	
 	auto btCreateProject = new wxButton(this, wxID_ANY, "Criar projeto...", wxPoint(430, 430), wxSize(120, 50));
 	btCreateProject->Bind(wxEVT_BUTTON, &ProjectPanel::OnBtCreateProject, this);
+	auto btReprocessProject = new wxButton(this, wxID_ANY, "Reprocessar projeto...", wxPoint(430, 490), wxSize(120, 50));
+	btReprocessProject->Bind(wxEVT_BUTTON, &ProjectPanel::OnBtReprocessProject, this);
+	auto btEnqueueProjects = new wxButton(this, wxID_ANY, "Enfileirar projetos...", wxPoint(560, 490), wxSize(120, 50));
+	btEnqueueProjects->Bind(wxEVT_BUTTON, &ProjectPanel::OnBtEnqueueProjects, this);
 
 	versionText << "Verso 0.0.1 ";
 	
@@ -81,43 +95,145 @@ void ProjectPanel::OnBtCreateProject(wxCommandEvent & event)
 		wxLogError("No foi possvel criar o diretrio das imagens");
 		return;
 	}
+	std::vector<std::string> sourcePaths;
+	sourcePaths.reserve(imagesPaths.size());
+	for (const auto& path : imagesPaths)
+	{
+		sourcePaths.emplace_back(path.ToStdString());
+	}
+	//Discard blurred, badly exposed and repeated images before they reach the reconstruction
+	if (imagesPage->GetPreScreenImages())
+	{
+		wxProgressDialog preScreenDialog("Analisando imagens", "Analisando imagens", sourcePaths.size());
+		const auto preScreenOptions = ConfigurationDialog::getPreScreenOptions();
+		std::vector<std::string> acceptedPaths;
+		const auto metrics = ImagePreScreen::run(sourcePaths, preScreenOptions, acceptedPaths,
+			[&](unsigned int imageCount) { preScreenDialog.Update(imageCount); });
+		ImagePreScreen::writeReport(projectFolder + "\\prescreen.txt", metrics, preScreenOptions);
+		sourcePaths = acceptedPaths;
+	}
 	wxProgressDialog* progressDialog;
 	if (imagesPage->GetMoveImagesToProjectDir())
 	{
-		progressDialog = new wxProgressDialog("Movendo imagens", "Movendo imagens", imagesPaths.size());
+		progressDialog = new wxProgressDialog("Movendo imagens", "Movendo imagens", sourcePaths.size());
 	}
 	else
 	{
-		progressDialog = new wxProgressDialog("Copiando imagens", "Copiando imagens", imagesPaths.size());
+		progressDialog = new wxProgressDialog("Copiando imagens", "Copiando imagens", sourcePaths.size());
 	}
-	unsigned int imageCount = 0;
-	for (const auto& path : imagesPaths)
+	ImageIngestion::Statistics ingestionStatistics;
+	ImageIngestion::ingest(sourcePaths, imagesFolder, imagesPage->GetMoveImagesToProjectDir(), 8,
+		[&](unsigned int imageCount) { progressDialog->Update(imageCount); }, ingestionStatistics);
+	delete progressDialog;
+	for (const auto& path : ingestionStatistics.failedPaths)
 	{
-		const auto newPath = imagesFolder + "\\" + Utils::getFileName(path.ToStdString());
-		if (!wxCopyFile(path, newPath))
-		{
-			wxLogError("Erro copiando o arquivo " + path);
-		}
-		else if (imagesPage->GetMoveImagesToProjectDir())
-		{
-			if (!wxRemoveFile(path))
-			{
-				wxLogError("Erro removendo o arquivo " + path);
-			}
-		}
-		progressDialog->Update(imageCount);
-		imageCount++;
+		wxLogError(wxString("Erro copiando o arquivo " + path));
 	}
-	delete progressDialog;
+	for (const auto& path : ingestionStatistics.keptSourcePaths)
+	{
+		wxLogWarning(wxString("Nao foi possivel remover o arquivo de origem " + path));
+	}
+	wxLogInfo(wxString("Imagens: " + ingestionStatistics.print()));
+	//Metadata of the images in parallel, reusing the one of the pre-screening
+	ImageMetadataCache::build(imagesFolder, projectFolder + "\\images_metadata.bin", 8, sourcePaths);
 	//Project options
 	const auto generateTexture = dynamic_cast<ProjectTemplateWizardPage*>(wizardPages[2])->GetGenerateTexture();
 	//Start processing
-	if (Reconstruction::Reconstruct(projectFolder, generateTexture))
+	if (runReconstruction(projectFolder, generateTexture))
 	{
 		wxLogInfo("Projecto criado com sucesso!");
 	}
 }
 
+void ProjectPanel::OnBtReprocessProject(wxCommandEvent & event)
+{
+	wxDirDialog dirDialog(nullptr, "Selecione o diretorio do projeto", wxEmptyString, wxDD_DEFAULT_STYLE | wxDD_DIR_MUST_EXIST);
+	if (dirDialog.ShowModal() != wxID_OK)
+	{
+		return;
+	}
+	const auto projectFolder = dirDialog.GetPath().ToStdString();
+	if (!wxDirExists(projectFolder + "\\images"))
+	{
+		wxLogError("O diretorio selecionado nao tem as imagens de um projeto");
+		return;
+	}
+	const auto generateTexture = wxMessageBox("Gerar textura?", "SAEScan3D", wxYES_NO | wxICON_QUESTION) == wxYES;
+	if (runReconstruction(projectFolder, generateTexture))
+	{
+		wxLogInfo("Projeto reprocessado com sucesso!");
+	}
+}
+
+void ProjectPanel::OnBtEnqueueProjects(wxCommandEvent & event)
+{
+	wxDirDialog dirDialog(nullptr, "Selecione os diretorios dos projetos", wxEmptyString, wxDD_DEFAULT_STYLE | wxDD_DIR_MUST_EXIST | wxDD_MULTIPLE);
+	if (dirDialog.ShowModal() != wxID_OK)
+	{
+		return;
+	}
+	wxArrayString projectFolders;
+	dirDialog.GetPaths(projectFolders);
+	const auto generateTexture = wxMessageBox("Gerar textura?", "SAEScan3D", wxYES_NO | wxICON_QUESTION) == wxYES;
+	const auto queueOptions = ConfigurationDialog::getQueueOptions();
+	int numSubmitted = 0;
+	for (const auto& projectFolder : projectFolders)
+	{
+		if (!wxDirExists(projectFolder + "\\images"))
+		{
+			wxLogError(wxString("O diretorio " + projectFolder + " nao tem as imagens de um projeto"));
+			continue;
+		}
+		if (JobQueue::submit(queueOptions, projectFolder.ToStdString(), generateTexture))
+		{
+			numSubmitted++;
+		}
+	}
+	if (numSubmitted == 0)
+	{
+		return;
+	}
+	//The runner takes the new jobs while it is active
+	if (JobQueue::isRunnerActive())
+	{
+		wxLogInfo(wxString::Format("%d projetos adicionados a fila em processamento", numSubmitted));
+	}
+	else if (wxMessageBox(wxString::Format("%d projetos adicionados a fila. Processar a fila agora?", numSubmitted), "SAEScan3D",
+		wxYES_NO | wxICON_QUESTION) == wxYES)
+	{
+		JobQueue::startRunner();
+	}
+}
+
+bool ProjectPanel::runReconstruction(const std::string& projectFolder, bool generateTexture)
+{
+	//The reconstruction runs in a worker thread so the dialog can show its progress
+	auto reconstruction = std::async(std::launch::async, [&]() { return Reconstruction::Reconstruct(projectFolder, generateTexture); });
+	const int range = 1000;
+	wxProgressDialog progressDialog("Reconstruindo", "Iniciando a reconstrucao", range, this, wxPD_APP_MODAL | wxPD_ELAPSED_TIME | wxPD_CAN_ABORT);
+	bool aborted = false;
+	while (reconstruction.wait_for(std::chrono::milliseconds(200)) != std::future_status::ready)
+	{
+		//Until the reconstruction returns, it may not have started when the user aborted
+		if (aborted)
+		{
+			Cancellation::cancel();
+			progressDialog.Pulse("Cancelando a reconstrucao, os arquivos gerados sao mantidos");
+			continue;
+		}
+		const auto status = ProgressModel::getStatus();
+		if (!status.running)
+		{
+			aborted = !progressDialog.Pulse();
+			continue;
+		}
+		//Below the range, the dialog closes itself when it reaches it
+		const int value = std::min(static_cast<int>(status.fraction * range), range - 1);
+		aborted = !progressDialog.Update(value, wxString(status.print() + "\n" + status.lastLine.substr(0, 100)));
+	}
+	return reconstruction.get();
+}
+
 /*
  * Called by the system of by wxWidgets when the panel needs
  * to be redrawn. You can also trigger this call by
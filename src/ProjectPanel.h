@@ -2,6 +2,8 @@
 #include <wx/panel.h>
 #include <wx/bitmap.h>
 
+#include <string>
+
 class ProjectPanel : public wxPanel
 {
 	wxBitmap image;
@@ -12,6 +14,12 @@ public:
 
 private:
 	void OnBtCreateProject(wxCommandEvent & event);
+	//Runs the reconstruction again on an existing project, reusing its workspace when retained
+	void OnBtReprocessProject(wxCommandEvent & event);
+	//Adds projects to the job queue and starts its runner if none is active
+	void OnBtEnqueueProjects(wxCommandEvent & event);
+	//Reconstruct with a progress dialog, from the output of the tools and the history of the previous runs
+	bool runReconstruction(const std::string& projectFolder, bool generateTexture);
 	void paintEvent(wxPaintEvent & evt);
 	void paintNow();
 
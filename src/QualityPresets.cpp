@@ -0,0 +1,146 @@
+#include "QualityPresets.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <wx/log.h>
+
+#include "json.hpp"
+#include "Utils.h"
+
+namespace
+{
+	nlohmann::json projectOverrides;
+
+	// Group of the overrides, empty if the file doesn't have it. Throws std::invalid_argument with the name of a group
+	// that is not an object
+	nlohmann::json getGroup(const nlohmann::json& overrides, const std::string& name)
+	{
+		const auto it = overrides.find(name);
+		if (it == overrides.end())
+		{
+			return nlohmann::json::object();
+		}
+		if (!it->is_object())
+		{
+			throw std::invalid_argument(name);
+		}
+		return *it;
+	}
+
+	// Throws std::invalid_argument with group.key when the value has another type
+	template <typename T>
+	void applyOverride(const nlohmann::json& group, const std::string& groupName, const char* key, T& value)
+	{
+		const auto it = group.find(key);
+		if (it == group.end())
+		{
+			return;
+		}
+		try
+		{
+			value = it->get<T>();
+		}
+		catch (const nlohmann::json::exception&)
+		{
+			throw std::invalid_argument(groupName + "." + key);
+		}
+	}
+
+	void applyOverrides(const nlohmann::json& overrides, Quality::Preset& preset)
+	{
+		const auto sparse = getGroup(overrides, "sparse");
+		applyOverride(sparse, "sparse", "maxImageSize", preset.sparse.maxImageSize);
+		applyOverride(sparse, "sparse", "maxNumFeatures", preset.sparse.maxNumFeatures);
+		const auto dense = getGroup(overrides, "dense");
+		applyOverride(dense, "dense", "maxImageSize", preset.dense.maxImageSize);
+		applyOverride(dense, "dense", "windowRadius", preset.dense.windowRadius);
+		applyOverride(dense, "dense", "windowStep", preset.dense.windowStep);
+		applyOverride(dense, "dense", "numSamples", preset.dense.numSamples);
+		applyOverride(dense, "dense", "numIterations", preset.dense.numIterations);
+		applyOverride(dense, "dense", "geomConsistency", preset.dense.geomConsistency);
+		applyOverride(dense, "dense", "checkNumImages", preset.dense.checkNumImages);
+		const auto meshing = getGroup(overrides, "meshing");
+		applyOverride(meshing, "meshing", "depth", preset.meshing.depth);
+		applyOverride(meshing, "meshing", "samplesPerNode", preset.meshing.samplesPerNode);
+		applyOverride(meshing, "meshing", "trim", preset.meshing.trim);
+		const auto texturing = getGroup(overrides, "texturing");
+		applyOverride(texturing, "texturing", "geometricVisibilityTest", preset.texturing.geometricVisibilityTest);
+		applyOverride(texturing, "texturing", "globalSeamLeveling", preset.texturing.globalSeamLeveling);
+	}
+}
+
+std::string Quality::Preset::print() const
+{
+	std::stringstream parameters;
+	parameters << "Sparse max image size " << sparse.maxImageSize << ", max num features " << sparse.maxNumFeatures << "\n" <<
+		"Dense max image size " << dense.maxImageSize << ", window radius " << dense.windowRadius << ", window step " << dense.windowStep <<
+		", num samples " << dense.numSamples << ", num iterations " << dense.numIterations << ", geom consistency " << dense.geomConsistency <<
+		", check num images " << dense.checkNumImages << "\n" <<
+		"Meshing depth " << meshing.depth << ", samples per node " << meshing.samplesPerNode << ", trim " << meshing.trim << "\n" <<
+		"Texturing geometric visibility test " << texturing.geometricVisibilityTest << ", global seam leveling " << texturing.globalSeamLeveling << "\n";
+	return parameters.str();
+}
+
+Quality::Preset QualityPresets::get(Quality::Level level)
+{
+	if (level < Quality::Low || level > Quality::Extreme)
+	{
+		level = Quality::High;
+	}
+	auto preset = Quality::presets[level];
+	//The types were checked when the file was loaded
+	if (projectOverrides.is_object())
+	{
+		applyOverrides(projectOverrides, preset);
+	}
+	return preset;
+}
+
+bool QualityPresets::loadProjectOverrides(const std::string& path)
+{
+	projectOverrides = nlohmann::json();
+	if (!Utils::exists(path))
+	{
+		return 1;
+	}
+	try
+	{
+		std::ifstream overridesFile(path);
+		projectOverrides = nlohmann::json::parse(overridesFile);
+	}
+	catch (const std::exception&)
+	{
+		projectOverrides = nlohmann::json();
+		wxLogError("Erro lendo as configuracoes de qualidade do projeto");
+		return 0;
+	}
+	if (!projectOverrides.is_object())
+	{
+		projectOverrides = nlohmann::json();
+		wxLogError("Configuracoes de qualidade do projeto invalidas");
+		return 0;
+	}
+	//Applied once to every level, so a wrong type is reported here instead of when a stage reads its preset
+	try
+	{
+		for (const auto& preset : Quality::presets)
+		{
+			auto overridden = preset;
+			applyOverrides(projectOverrides, overridden);
+		}
+	}
+	catch (const std::invalid_argument& exception)
+	{
+		projectOverrides = nlohmann::json();
+		wxLogError(wxString("Tipo invalido de " + std::string(exception.what()) + " nas configuracoes de qualidade do projeto"));
+		return 0;
+	}
+	return 1;
+}
+
+bool QualityPresets::hasProjectOverrides()
+{
+	return projectOverrides.is_object();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+
+namespace Quality
+{
+	// Same order as the quality choices of the configuration and the project wizard
+	enum Level
+	{
+		Low,
+		Medium,
+		High,
+		Extreme
+	};
+
+	// COLMAP feature extraction
+	struct Sparse
+	{
+		// Longest side of the images read by SIFT, -1 keeps the image size
+		int maxImageSize;
+		int maxNumFeatures;
+	};
+
+	// COLMAP patch match and fusion
+	struct Dense
+	{
+		// Upper bound of the resource plan, -1 keeps the image size
+		int maxImageSize;
+		int windowRadius;
+		int windowStep;
+		int numSamples;
+		int numIterations;
+		// Without the geometric consistency pass the fusion reads the photometric maps
+		bool geomConsistency;
+		int checkNumImages;
+	};
+
+	// SSDRecon and SurfaceTrimmer
+	struct Meshing
+	{
+		int depth;
+		int samplesPerNode;
+		int trim;
+	};
+
+	// Costly TexRecon steps allowed by the level, a step runs only if it is also enabled in the configuration
+	struct Texturing
+	{
+		bool geometricVisibilityTest;
+		bool globalSeamLeveling;
+	};
+
+	struct Preset
+	{
+		Sparse sparse;
+		Dense dense;
+		Meshing meshing;
+		Texturing texturing;
+
+		std::string print() const;
+	};
+
+	// The levels of automatic_reconstructor for sparse and dense, geom_consistency is only made from high up.
+	// Low meshes at a smaller octree depth and skips the visibility test, its point clouds are too sparse for more.
+	constexpr Preset presets[] =
+	{
+		// Low
+		{ { 1000, 2048 }, { 1000, 4, 2, 7, 3, false, 25 }, { 10, 12, 5 }, { false, true } },
+		// Medium
+		{ { 1600, 4096 }, { 1600, 4, 2, 10, 5, false, 33 }, { 12, 12, 5 }, { true, true } },
+		// High
+		{ { 2400, 8192 }, { 2400, 5, 1, 15, 5, true, 50 }, { 12, 12, 5 }, { true, true } },
+		// Extreme
+		{ { -1, 8192 }, { -1, 5, 1, 15, 5, true, 50 }, { 12, 12, 5 }, { true, true } }
+	};
+	static_assert(sizeof(presets) / sizeof(presets[0]) == Extreme + 1, "One preset per quality level");
+}
+
+// The quality levels turned into the parameters of every stage, so the speed and quality trade-offs are tuned here only.
+// A project may replace single fields of its levels with a quality.json in its folder, e.g.
+// { "dense": { "numSamples": 12 }, "meshing": { "depth": 11 } }
+class QualityPresets
+{
+public:
+	// Preset of the level with the overrides of the project
+	static Quality::Preset get(Quality::Level level);
+
+	// Reads the overrides of a project, a missing file clears them. False without overrides when the file can't be
+	// parsed or a value has the wrong type, which is logged with its group and key
+	static bool loadProjectOverrides(const std::string& path);
+	static bool hasProjectOverrides();
+};
@@ -1,18 +1,108 @@
 #include "Reconstruction.h"
 
+#include <algorithm>
+
 #include <wx/filename.h>
 #include <wx/log.h>
+#include <wx/dir.h>
 
 #include "HelperCOLMAP.h"
+#include "MatchingPlanner.h"
 #include "HelperSSDRecon.h"
 #include "HelperTexRecon.h"
 #include "HelperScalePtcs.h"
 #include "ReconstructionLog.h"
+#include "ArtifactTracker.h"
 #include "ConfigurationDialog.h"
+#include "QualityPresets.h"
+#include "PlaneSweepStereo.h"
+#include "Tracer.h"
+#include "ProgressModel.h"
+#include "Cancellation.h"
+#include "ImageIO.h"
+#include "ImageMetadataCache.h"
 #include "Utils.h"
 
+namespace
+{
+	// Writes the trace when Reconstruct returns, after the log has closed its stage
+	struct TraceGuard
+	{
+		~TraceGuard() { Tracer::stop(); }
+	};
+
+	struct ProgressGuard
+	{
+		~ProgressGuard() { ProgressModel::finish(); }
+	};
+
+	// A cancelled run keeps its intermediate files, the next run resumes from them
+	struct CancellationGuard
+	{
+		ArtifactTracker& artifacts;
+		~CancellationGuard()
+		{
+			if (Cancellation::isCancelled())
+			{
+				artifacts.keepAll();
+			}
+		}
+	};
+
+	// Megapixels of an image once resized to maxImageSize (-1 keeps the original size)
+	double getMegapixels(unsigned int width, unsigned int height, int maxImageSize)
+	{
+		double scale = 1;
+		const unsigned int maxSide = std::max(width, height);
+		if (maxImageSize > 0 && maxSide > static_cast<unsigned int>(maxImageSize))
+		{
+			scale = static_cast<double>(maxImageSize) / maxSide;
+		}
+		return width * scale * height * scale / 1e6;
+	}
+
+	// Stages of the run with their work in images x megapixels processed, the history is kept per quality
+	// and, for the dense stage, per stereo
+	std::vector<Progress::Stage> getProgressStages(const std::string& imagesFolder, bool generateTexture, size_t& numImages)
+	{
+		wxArrayString files;
+		wxDir::GetAllFiles(imagesFolder, &files, wxEmptyString, wxDIR_FILES);
+		numImages = 0;
+		unsigned int width = 0, height = 0;
+		for (const auto& file : files)
+		{
+			const auto extension = Utils::toUpper(Utils::getFileExtension(file.ToStdString()));
+			if (extension == "JPG" || extension == "JPEG")
+			{
+				if (numImages == 0)
+				{
+					ImageIO::getImageSize(file.ToStdString(), width, height);
+				}
+				numImages++;
+			}
+		}
+		const auto preset = ConfigurationDialog::getQualityPreset();
+		const double sparseWork = numImages * getMegapixels(width, height, preset.sparse.maxImageSize);
+		const double denseWork = numImages * getMegapixels(width, height, preset.dense.maxImageSize);
+		const auto stereoOptions = ConfigurationDialog::getStereoOptions();
+		const bool planeSweep = stereoOptions.mode == Stereo::PlaneSweep || (stereoOptions.mode == Stereo::Auto && ConfigurationDialog::getUseGPU() == "0");
+		const auto denseQuality = ConfigurationDialog::getDenseQuality();
+		std::vector<Progress::Stage> stages;
+		stages.emplace_back("SFM", "SFM " + ConfigurationDialog::getSparseQuality(), sparseWork);
+		stages.emplace_back("Dense", "Dense " + denseQuality + (planeSweep ? " cpu" : " gpu"), denseWork);
+		stages.emplace_back("Meshing", "Meshing " + denseQuality, denseWork);
+		if (generateTexture)
+		{
+			stages.emplace_back("Texturization", "Texturization " + denseQuality, denseWork);
+		}
+		stages.emplace_back("Scale", "Scale", static_cast<double>(numImages));
+		return stages;
+	}
+}
+
 bool Reconstruction::Reconstruct(const std::string &projectFolder, bool generateTexture)
 {
+	Cancellation::reset();
 	const auto imagesFolder = projectFolder + "\\images";
 	// Creating directories
 	const auto tempDir = projectFolder + "\\temp";
@@ -25,15 +115,60 @@ bool Reconstruction::Reconstruct(const std::string &projectFolder, bool generate
 	const auto pointCloudPath = reconstructionDir + "\\PointCloud.ply";
 	const auto surfacePath = tempDir + "\\Surface.ply";
 	// Start processing
+	// Quality parameters replaced by the project, before the log records them
+	if (!QualityPresets::loadProjectOverrides(projectFolder + "\\quality.json"))
+	{
+		return 0;
+	}
+	// Timeline of the run for chrome://tracing
+	Tracer::start(projectFolder + "\\trace.json", ConfigurationDialog::getTraceOptions());
+	TraceGuard traceGuard;
+	// Size and EXIF of the images, read once and kept in the project for the stages and the next runs.
+	// Not needed to go on, the images are read when not in it
+	ImageMetadataCache::build(imagesFolder, projectFolder + "\\images_metadata.bin", 8);
+	// Progress and remaining time for the GUI and the command line, the output of the tools is kept in the project
+	size_t numImages = 0;
+	const auto progressStages = getProgressStages(imagesFolder, generateTexture, numImages);
+	ProgressModel::start(progressStages, numImages, Utils::getExecutionPath() + "/progress_history.json", projectFolder + "\\tools_output.txt");
+	ProgressGuard progressGuard;
 	// Log
-	ReconstructionLog log(projectFolder + "\\log.txt");
+	ReconstructionLog log(projectFolder + "\\log.txt", projectFolder + "\\telemetry.jsonl");
 	auto bool2String = [](bool flag)
 	{ if (flag) { return "Yes"; } return "No"; };
 	log.write("Generate mesh - Yes");
 	log.write("Generate texture - " + ((std::string)bool2String(generateTexture)));
 	log.addSeparator();
+	// COLMAP workspace, retained in the project folder for reruns if configured
+	const bool retainWorkspace = ConfigurationDialog::getRetainWorkspace();
+	const auto workspaceDir = retainWorkspace ? projectFolder + "\\workspace" : tempDir;
+	if (!Utils::CreateDir(workspaceDir))
+	{
+		return 0;
+	}
+	// Intermediate files, removed after the last stage that reads them (or on failure)
+	ArtifactTracker artifacts;
+	CancellationGuard cancellationGuard{ artifacts };
+	auto reclaim = [&](const std::string& stage)
+	{
+		const auto freedBytes = artifacts.stageCompleted(stage);
+		if (freedBytes > 0)
+		{
+			log.write("Freed " + std::to_string(freedBytes / (1024 * 1024)) + " MB of intermediate files of " + stage);
+		}
+	};
+	if (!retainWorkspace)
+	{
+		artifacts.add(workspaceDir + "\\database.db", "SFM");
+		artifacts.add(workspaceDir + "\\sparse_parts", "SFM");
+		artifacts.add(workspaceDir + "\\cameras.nvm", "SFM");
+		artifacts.add(workspaceDir + "\\cameras.scb", generateTexture ? "Texturization" : "SFM");
+		artifacts.add(workspaceDir + "\\sparse", "Dense");
+		artifacts.add(workspaceDir + "\\dense", "Dense");
+	}
+	artifacts.add(surfacePath, generateTexture ? "Texturization" : "Meshing");
+	artifacts.add(tempDir, "Scale");
 	// SFM
-	std::string nvmPath = tempDir + "\\cameras.nvm";
+	std::string nvmPath = workspaceDir + "\\cameras.nvm";
 	if (!SFM(imagesFolder, nvmPath, log))
 	{
 		wxLogError("Erro durante o SFM");
@@ -46,24 +181,27 @@ bool Reconstruction::Reconstruct(const std::string &projectFolder, bool generate
 		wxLogError("Erro movendo os arquivos de c�mera");
 		return 0;
 	}
+	reclaim("SFM");
 	// Dense
 	// Create dense dir
-	if (!Utils::CreateDir(tempDir + "/dense"))
+	if (!Utils::CreateDir(workspaceDir + "/dense"))
 	{
 		wxLogError("Erro criando o diret�rio dense");
 		return 0;
 	}
-	if (!Dense(imagesFolder, tempDir, pointCloudPath, log))
+	if (!Dense(imagesFolder, workspaceDir, pointCloudPath, retainWorkspace, log))
 	{
 		wxLogError("Erro durante o Dense");
 		return 0;
 	}
+	reclaim("Dense");
 	// Meshing
 	if (!Meshing(pointCloudPath, surfacePath, log))
 	{
 		wxLogError("Erro durante o meshing");
 		return 0;
 	}
+	reclaim("Meshing");
 	// Texturization
 	std::string texturedSurfaceToScalePath = "";
 	if (generateTexture)
@@ -74,45 +212,69 @@ bool Reconstruction::Reconstruct(const std::string &projectFolder, bool generate
 			return 0;
 		}
 		const auto texturedSurfacePath = texturizationDir + "\\TexturedSurface.obj";
-		if (!Reconstruction::Texturization(surfacePath, nvmPath, texturedSurfacePath, log))
+		if (!Reconstruction::Texturization(surfacePath, workspaceDir + "\\cameras.scb", texturedSurfacePath, log))
 		{
 			wxLogError("Erro durante a texturizacao");
 			return 0;
 		}
 		texturedSurfaceToScalePath = texturedSurfacePath;
+		reclaim("Texturization");
 	}
 	// Scale the point cloud
+	log.startStage("Scale", { projectNvmPath, pointCloudPath, texturedSurfaceToScalePath });
 	if (!HelperScalePtcs::executeScalePtcs(projectNvmPath, imagesFolder, pointCloudPath, texturedSurfaceToScalePath))
 	{
+		log.finishStage(false, {});
 		wxLogError("Erro durante a aplicacao de escala real sobre a reconstrucao");
 		return 0;
 	}
+	log.finishStage(true, { pointCloudPath, texturedSurfaceToScalePath });
 	// Remove the temp dir
-	wxFileName::Rmdir(tempDir, wxPATH_RMDIR_RECURSIVE);
+	reclaim("Scale");
 	return 1;
 }
 
 bool Reconstruction::SFM(const std::string &imagesPath, const std::string &nvmPath, ReconstructionLog &log)
 {
 	log.write("Started SFM", true, true);
-	if (!HelperCOLMAP::executeSparse(imagesPath, nvmPath))
+	log.startStage("SFM", { imagesPath });
+	Matching::Plan matchingPlan;
+	if (!HelperCOLMAP::executeSparse(imagesPath, nvmPath, matchingPlan))
 	{
+		if (matchingPlan.numImages > 0)
+		{
+			log.write(matchingPlan.print());
+		}
+		log.finishStage(false, {});
 		log.write("Error during SFM", true, true);
 		return 0;
 	}
+	log.finishStage(true, { nvmPath, Utils::getPath(nvmPath, false) + "/sparse" });
+	if (matchingPlan.numImages > 0)
+	{
+		log.write(matchingPlan.print());
+	}
+	else
+	{
+		log.write("Reused the sparse model of the workspace");
+	}
 	log.write("Finished SFM", true, true);
 	log.addSeparator();
 	return 1;
 }
 
-bool Reconstruction::Dense(const std::string &imagesPath, const std::string &tempDir, const std::string &pointCloudOutputPath, ReconstructionLog &log)
+bool Reconstruction::Dense(const std::string &imagesPath, const std::string &workspaceDir, const std::string &pointCloudOutputPath,
+	bool retainWorkspace, ReconstructionLog &log)
 {
 	log.write("Started COLMAP dense reconstruction", true, true);
-	if (!HelperCOLMAP::executeDense(imagesPath, tempDir, pointCloudOutputPath))
+	log.startStage("Dense", { imagesPath, workspaceDir + "/sparse/0" });
+	if (!HelperCOLMAP::executeDense(imagesPath, workspaceDir + "/sparse/0", workspaceDir + "/dense", pointCloudOutputPath, retainWorkspace))
 	{
+		log.finishStage(false, {});
 		log.write("Error during COLMAP dense reconstruction", true, true);
 		return 0;
 	}
+	log.finishStage(true, { pointCloudOutputPath });
 	log.write("Finished COLMAP dense reconstruction", true, true);
 	log.addSeparator();
 	return 1;
@@ -121,11 +283,14 @@ bool Reconstruction::Dense(const std::string &imagesPath, const std::string &tem
 bool Reconstruction::Meshing(const std::string &pointCloudInputPath, const std::string &meshOutputPath, ReconstructionLog &log)
 {
 	log.write("Started SSD meshing", true, true);
-	if (!HelperSSDRecon::executeMeshing(pointCloudInputPath, meshOutputPath))
+	log.startStage("Meshing", { pointCloudInputPath });
+	if (!HelperSSDRecon::executeMeshing(pointCloudInputPath, meshOutputPath, ConfigurationDialog::getQualityPreset().meshing))
 	{
+		log.finishStage(false, {});
 		log.write("Error during SSD meshing", true, true);
 		return 0;
 	}
+	log.finishStage(true, { meshOutputPath });
 	log.write("Finished SSD meshing", true, true);
 	log.addSeparator();
 	return 1;
@@ -133,13 +298,20 @@ bool Reconstruction::Meshing(const std::string &pointCloudInputPath, const std::
 
 bool Reconstruction::Texturization(const std::string &meshPath, const std::string &camerasPath, const std::string &outputPath, ReconstructionLog &log)
 {
-	// TexRecon
+	// TexRecon, the costly steps run only when the quality allows them
+	auto options = ConfigurationDialog::getTexReconOptions();
+	const auto quality = ConfigurationDialog::getQualityPreset().texturing;
+	options.geometricVisibilityTest = options.geometricVisibilityTest && quality.geometricVisibilityTest;
+	options.globalSeamLeveling = options.globalSeamLeveling && quality.globalSeamLeveling;
 	log.write("Started TexRecon", true, true);
-	if (!HelperTexRecon::executeTexRecon(camerasPath, meshPath, outputPath, ConfigurationDialog::getTexReconOptions()))
+	log.startStage("Texturization", { meshPath, camerasPath });
+	if (!HelperTexRecon::executeTexRecon(camerasPath, meshPath, outputPath, options))
 	{
+		log.finishStage(false, {});
 		log.write("Error during TexRecon", true, true);
 		return 0;
 	}
+	log.finishStage(true, { Utils::getPath(outputPath, false) });
 	log.write("Finished TexRecon", true, true);
 	log.addSeparator();
 	return 1;
@@ -15,7 +15,8 @@ public:
 	//SFM
 	static bool SFM(const std::string& imagesPath, const std::string& nvmPath, ReconstructionLog & log);
 	//Dense
-	static bool Dense(const std::string& imagesPath, const std::string & tempDir, const std::string& pointCloudOutputPath, ReconstructionLog & log);
+	static bool Dense(const std::string& imagesPath, const std::string & workspaceDir, const std::string& pointCloudOutputPath,
+		bool retainWorkspace, ReconstructionLog & log);
 	//Meshing
 	static bool Meshing(const std::string & pointCloudInputPath, const std::string& meshOutputPath, ReconstructionLog & log);
 	//Texturization
@@ -1,23 +1,40 @@
 #include "ReconstructionLog.h"
 
 #include <sstream>
+#include <algorithm>
 
 #include "ConfigurationDialog.h"
+#include "StageTelemetry.h"
+#include "Tracer.h"
+#include "ProgressModel.h"
+#include "StageBudget.h"
+#include "ProcessLimits.h"
+#include "Cancellation.h"
 
-ReconstructionLog::ReconstructionLog(std::string pathToLogFile)
+ReconstructionLog::ReconstructionLog(std::string pathToLogFile, std::string pathToTelemetryFile)
 {
 	logFile = std::ofstream(pathToLogFile, std::ofstream::out | std::ofstream::app);
+	if (!pathToTelemetryFile.empty())
+	{
+		telemetryFile = std::ofstream(pathToTelemetryFile, std::ofstream::out | std::ofstream::app);
+	}
+	runId = getCurrentDateTime();
 	write("Started log file", true);
 	logFile << "Parameters:\n";
 	logFile << ConfigurationDialog::getParameters();
-	initialTimer = std::clock();
+	initialTimer = std::chrono::steady_clock::now();
 }
 
 ReconstructionLog::~ReconstructionLog()
 {
+	//A stage left running has failed
+	if (stage)
+	{
+		finishStage(false, {});
+	}
 	if (logFile.is_open())
 	{
-		logFile << "Total elapsed time: " << formatTime(initialTimer, std::clock());
+		logFile << "Total elapsed time: " << formatTime(std::chrono::steady_clock::now() - initialTimer);
 		logFile.close();
 	}
 }
@@ -36,14 +53,15 @@ void ReconstructionLog::write(std::string var, bool addTime, bool computeTime)
 	if (computeTime)
 	{
 		// start timer
-		if (timer == -1)
+		if (!timerRunning)
 		{
-			timer = std::clock();
+			timer = std::chrono::steady_clock::now();
+			timerRunning = true;
 		}
 		else
 		{
-			logFile << " elapsed time: " << formatTime(timer, std::clock());
-			timer = -1;
+			logFile << " elapsed time: " << formatTime(std::chrono::steady_clock::now() - timer);
+			timerRunning = false;
 		}
 	}
 	logFile << "\n";
@@ -54,6 +72,55 @@ void ReconstructionLog::addSeparator()
 	logFile << "------------------------------------------------------\n";
 }
 
+void ReconstructionLog::startStage(const std::string& stageName, const std::vector<std::string>& inputPaths)
+{
+	if (stage)
+	{
+		finishStage(false, {});
+	}
+	//Queued jobs wait for the share of the machine of the stage, out of its telemetry
+	if (StageBudget::isEnabled())
+	{
+		write("Waiting for the budget of " + stageName, true);
+		StageBudget::acquire(stageName);
+		write("Budget " + StageBudget::getHeld().print() + ", tools " + ProcessLimits::getCurrentPlan().print(), true);
+	}
+	stage.reset(new StageTelemetry(stageName, inputPaths));
+	stageTraceStart = Tracer::now();
+	ProgressModel::startStage(stageName);
+	//The timeout grows with the predicted time of the stage, so a large project isn't cut short
+	const auto timeouts = ConfigurationDialog::getTimeoutsOptions();
+	if (timeouts.enabled)
+	{
+		const double seconds = std::max(timeouts.factor * ProgressModel::getPredictedSeconds(stageName), static_cast<double>(timeouts.minSeconds));
+		Cancellation::setDeadline(stageName, seconds);
+		write(stageName + " timeout " + formatTime(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds))), true);
+	}
+}
+
+void ReconstructionLog::finishStage(bool succeeded, const std::vector<std::string>& outputPaths)
+{
+	if (!stage)
+	{
+		return;
+	}
+	Tracer::addSpan(stage->getStage(), "stage", stageTraceStart, Tracer::now(), succeeded ? "succeeded" : "failed");
+	ProgressModel::finishStage(succeeded);
+	StageBudget::release();
+	Cancellation::clearDeadline();
+	if (!succeeded && Cancellation::isCancelled())
+	{
+		write(stage->getStage() + " cancelled: " + Cancellation::getReason(), true);
+	}
+	const auto event = stage->finish(succeeded, outputPaths, runId);
+	stage.reset();
+	if (telemetryFile.is_open())
+	{
+		telemetryFile << event << "\n";
+		telemetryFile.flush();
+	}
+}
+
 std::string ReconstructionLog::getCurrentDateTime()
 {
 	time_t now = time(0);
@@ -73,17 +140,17 @@ std::string ReconstructionLog::addZerosToTheLeft(int amount, int value)
 	return "";
 }
 
-std::string ReconstructionLog::formatTime(std::clock_t startTime, std::clock_t endTime)
+std::string ReconstructionLog::formatTime(std::chrono::steady_clock::duration time)
 {
-	std::clock_t time = endTime - startTime;
-	int seconds = (int)(time / 1000) % 60;
-	int milisseconds = time - (seconds * 1000);
-	int minutes = (int)((time / (1000 * 60)) % 60);
-	int hours = (int)((time / (1000 * 60 * 60)) % 24);
+	const long long totalMilisseconds = std::chrono::duration_cast<std::chrono::milliseconds>(time).count();
+	int milisseconds = (int)(totalMilisseconds % 1000);
+	int seconds = (int)((totalMilisseconds / 1000) % 60);
+	int minutes = (int)((totalMilisseconds / (1000 * 60)) % 60);
+	int hours = (int)(totalMilisseconds / (1000 * 60 * 60));
 	std::stringstream result;
 	result << addZerosToTheLeft(10, hours) << hours << ":" <<
 		addZerosToTheLeft(10, minutes) << minutes << ":" <<
 		addZerosToTheLeft(10, seconds) << seconds << "." <<
-		addZerosToTheLeft(1000, milisseconds) << milisseconds;
+		addZerosToTheLeft(100, milisseconds) << milisseconds;
 	return result.str();
 }
@@ -1,12 +1,18 @@
 #pragma once
 #include <fstream>
 #include <ctime>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdint>
 
+class StageTelemetry;
 
 class ReconstructionLog
 {
 public:
-	ReconstructionLog(std::string pathToLogFile);
+	// The stages are also written as JSON lines to pathToTelemetryFile, if it isn't empty
+	ReconstructionLog(std::string pathToLogFile, std::string pathToTelemetryFile = "");
 	~ReconstructionLog();
 
 	// var will be written in the log file, if addTime is true the dataTime will be added in the txt line
@@ -14,13 +20,25 @@ public:
 	void write(std::string var, bool addTime = false, bool computeTime = false);
 	void addSeparator();
 
+	// Starts the telemetry of a stage, the sizes of the inputs are measured now
+	void startStage(const std::string& stage, const std::vector<std::string>& inputPaths);
+	// Writes the telemetry of the running stage with the sizes of its outputs
+	void finishStage(bool succeeded, const std::vector<std::string>& outputPaths);
+
 	// Get current date/time, format is YYYY-MM-DD.HH:mm:ss
 	static std::string getCurrentDateTime();
 	static std::string addZerosToTheLeft(int amount, int value);
-	static std::string formatTime(std::clock_t startTime, std::clock_t endTime);
+	// HH:mm:ss.mmm, hours beyond a day are kept
+	static std::string formatTime(std::chrono::steady_clock::duration time);
 
 private:
 	std::ofstream logFile;
-	std::clock_t timer = -1;
-	std::clock_t initialTimer = -1;
+	std::ofstream telemetryFile;
+	// Wall time, std::clock is the CPU time of this process only on some platforms
+	bool timerRunning = false;
+	std::chrono::steady_clock::time_point timer;
+	std::chrono::steady_clock::time_point initialTimer;
+	std::string runId;
+	std::unique_ptr<StageTelemetry> stage;
+	int64_t stageTraceStart = -1;
 };
\ No newline at end of file
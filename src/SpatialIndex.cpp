@@ -0,0 +1,160 @@
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialIndex::SpatialIndex(const std::vector<Eigen::Vector3d>& points, double cellSize)
+{
+	build(points, cellSize);
+}
+
+void SpatialIndex::build(const std::vector<Eigen::Vector3d>& points, double cellSize)
+{
+	this->points = points;
+	cells.clear();
+	if (points.empty())
+	{
+		return;
+	}
+	Eigen::Vector3d minimum = points[0], maximum = points[0];
+	for (const auto& point : points)
+	{
+		minimum = minimum.cwiseMin(point);
+		maximum = maximum.cwiseMax(point);
+	}
+	Eigen::Vector3d extent = maximum - minimum;
+	std::sort(extent.data(), extent.data() + 3);
+	if (cellSize <= 0)
+	{
+		if (extent[1] > extent[2] * 1e-3)
+		{
+			//Captures are mostly flat, so the size comes from the area of the two largest axes
+			cellSize = 2.0 * std::sqrt(extent[1] * extent[2] / points.size());
+		}
+		else
+		{
+			//Collinear, e.g. a corridor flown at a constant altitude
+			cellSize = 2.0 * extent[2] / points.size();
+		}
+	}
+	//Bounded cells per axis, so the cells fit in the keys and the shells of a query are few
+	this->cellSize = std::max({ cellSize, extent[2] / maxCellsPerAxis, 1e-6 });
+	origin = minimum;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		cells[getKey(getCell(points[i]))].emplace_back(i);
+	}
+	minCell = getCell(minimum);
+	maxCell = getCell(maximum);
+}
+
+std::vector<size_t> SpatialIndex::knn(const Eigen::Vector3d& query, size_t k, long long excludeIndex) const
+{
+	std::vector<std::pair<double, size_t>> candidates;
+	if (points.empty() || k == 0)
+	{
+		return {};
+	}
+	const Eigen::Vector3i center = getCell(query);
+	//Shells before the one reaching the cells of the points are empty
+	const int minRing = std::max({ 0, minCell[0] - center[0], center[0] - maxCell[0], minCell[1] - center[1], center[1] - maxCell[1],
+		minCell[2] - center[2], center[2] - maxCell[2] });
+	const int maxRing = std::max({ std::abs(center[0] - minCell[0]), std::abs(center[0] - maxCell[0]),
+		std::abs(center[1] - minCell[1]), std::abs(center[1] - maxCell[1]),
+		std::abs(center[2] - minCell[2]), std::abs(center[2] - maxCell[2]) });
+	//Visit shells of cells around the query until the k-th distance is inside the visited shells
+	for (int ring = minRing; ring <= maxRing; ring++)
+	{
+		for (int x = std::max(center[0] - ring, minCell[0]); x <= std::min(center[0] + ring, maxCell[0]); x++)
+		{
+			for (int y = std::max(center[1] - ring, minCell[1]); y <= std::min(center[1] + ring, maxCell[1]); y++)
+			{
+				for (int z = std::max(center[2] - ring, minCell[2]); z <= std::min(center[2] + ring, maxCell[2]); z++)
+				{
+					if (std::max({ std::abs(x - center[0]), std::abs(y - center[1]), std::abs(z - center[2]) }) != ring)
+					{
+						continue;
+					}
+					const auto cell = cells.find(getKey(Eigen::Vector3i(x, y, z)));
+					if (cell == cells.end())
+					{
+						continue;
+					}
+					for (const auto index : cell->second)
+					{
+						if (static_cast<long long>(index) != excludeIndex)
+						{
+							candidates.emplace_back((points[index] - query).squaredNorm(), index);
+						}
+					}
+				}
+			}
+		}
+		if (candidates.size() >= k)
+		{
+			std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end());
+			const double searched = ring * cellSize;
+			if (candidates[k - 1].first <= searched * searched)
+			{
+				break;
+			}
+		}
+	}
+	const size_t count = std::min(k, candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+	std::vector<size_t> result(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		result[i] = candidates[i].second;
+	}
+	return result;
+}
+
+std::vector<size_t> SpatialIndex::radius(const Eigen::Vector3d& query, double radius) const
+{
+	std::vector<size_t> result;
+	const Eigen::Vector3i minimum = getCell(query - Eigen::Vector3d::Constant(radius));
+	const Eigen::Vector3i maximum = getCell(query + Eigen::Vector3d::Constant(radius));
+	const double squaredRadius = radius * radius;
+	for (int x = std::max(minimum[0], minCell[0]); x <= std::min(maximum[0], maxCell[0]); x++)
+	{
+		for (int y = std::max(minimum[1], minCell[1]); y <= std::min(maximum[1], maxCell[1]); y++)
+		{
+			for (int z = std::max(minimum[2], minCell[2]); z <= std::min(maximum[2], maxCell[2]); z++)
+			{
+				const auto cell = cells.find(getKey(Eigen::Vector3i(x, y, z)));
+				if (cell == cells.end())
+				{
+					continue;
+				}
+				for (const auto index : cell->second)
+				{
+					if ((points[index] - query).squaredNorm() <= squaredRadius)
+					{
+						result.emplace_back(index);
+					}
+				}
+			}
+		}
+	}
+	return result;
+}
+
+Eigen::Vector3i SpatialIndex::getCell(const Eigen::Vector3d& point) const
+{
+	//Relative to the minimum, so far coordinates (e.g. UTM) don't overflow. Queries far outside are clamped
+	const double limit = 4.0 * maxCellsPerAxis;
+	Eigen::Vector3i cell;
+	for (int i = 0; i < 3; i++)
+	{
+		cell[i] = static_cast<int>(std::max(-limit, std::min(limit, std::floor((point[i] - origin[i]) / cellSize))));
+	}
+	return cell;
+}
+
+int64_t SpatialIndex::getKey(const Eigen::Vector3i& cell)
+{
+	//21 bits per axis
+	const int64_t mask = (1 << 21) - 1;
+	return ((static_cast<int64_t>(cell[0]) & mask) << 42) | ((static_cast<int64_t>(cell[1]) & mask) << 21) | (static_cast<int64_t>(cell[2]) & mask);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+// Uniform grid over 3D points for nearest neighbor and radius queries
+class SpatialIndex
+{
+public:
+	SpatialIndex() {};
+	// cellSize <= 0 chooses a size with a few points per cell, also for collinear points
+	SpatialIndex(const std::vector<Eigen::Vector3d>& points, double cellSize = 0);
+
+	void build(const std::vector<Eigen::Vector3d>& points, double cellSize = 0);
+
+	// Indices of the k nearest points sorted by distance, excludeIndex is skipped (e.g. the query itself)
+	std::vector<size_t> knn(const Eigen::Vector3d& query, size_t k, long long excludeIndex = -1) const;
+
+	// Indices of the points inside the radius
+	std::vector<size_t> radius(const Eigen::Vector3d& query, double radius) const;
+
+	size_t size() const { return points.size(); };
+	double getCellSize() const { return cellSize; };
+
+private:
+	std::vector<Eigen::Vector3d> points;
+	std::unordered_map<int64_t, std::vector<size_t>> cells;
+	// Cells of the largest axis at most, below the 21 bits per axis of the keys
+	static const int maxCellsPerAxis = 1 << 19;
+	double cellSize = 1;
+	Eigen::Vector3d origin = Eigen::Vector3d::Zero();
+	Eigen::Vector3i minCell = Eigen::Vector3i::Zero();
+	Eigen::Vector3i maxCell = Eigen::Vector3i::Zero();
+
+	Eigen::Vector3i getCell(const Eigen::Vector3d& point) const;
+	static int64_t getKey(const Eigen::Vector3i& cell);
+};
@@ -0,0 +1,112 @@
+#include "SpatialPartition.h"
+
+#include <sstream>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+std::string Partition::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Max images " << maxImages << "\n" <<
+		"Overlap " << overlap << "\n" <<
+		"Max workers " << maxWorkers << "\n" <<
+		"Max dropped fraction " << maxDroppedFraction << "\n" <<
+		"Dense max images " << denseMaxImages << "\n" <<
+		"Dense max workers " << denseMaxWorkers << "\n";
+	return parameters.str();
+}
+
+bool SpatialPartition::Cluster::contains(const Eigen::Vector3d& point) const
+{
+	return (point.array() >= minimum.array()).all() && (point.array() < maximum.array()).all();
+}
+
+std::vector<SpatialPartition::Cluster> SpatialPartition::partition(const std::vector<Eigen::Vector3d>& points, size_t maxSize, double overlap)
+{
+	std::vector<Cluster> clusters;
+	if (points.empty())
+	{
+		return clusters;
+	}
+	std::vector<size_t> indices(points.size());
+	std::iota(indices.begin(), indices.end(), 0);
+	Eigen::Vector3d minimum = points[0], maximum = points[0];
+	for (const auto& point : points)
+	{
+		minimum = minimum.cwiseMin(point);
+		maximum = maximum.cwiseMax(point);
+	}
+	int verticalAxis;
+	(maximum - minimum).minCoeff(&verticalAxis);
+	const int horizontalAxes[2] = { (verticalAxis + 1) % 3, (verticalAxis + 2) % 3 };
+	//The outer cells are unbounded so every point is inside one cell
+	const double infinity = std::numeric_limits<double>::infinity();
+	split(points, indices, Eigen::Vector3d::Constant(-infinity), Eigen::Vector3d::Constant(infinity), std::max(maxSize, static_cast<size_t>(1)),
+		verticalAxis, clusters);
+	//Grow each cluster with the points around its core, only in the horizontal axes
+	for (auto& cluster : clusters)
+	{
+		Eigen::Vector3d coreMinimum = points[cluster.core[0]], coreMaximum = points[cluster.core[0]];
+		for (const auto index : cluster.core)
+		{
+			coreMinimum = coreMinimum.cwiseMin(points[index]);
+			coreMaximum = coreMaximum.cwiseMax(points[index]);
+		}
+		const Eigen::Vector3d margin = overlap * (coreMaximum - coreMinimum);
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			const auto& point = points[i];
+			const int a = horizontalAxes[0], b = horizontalAxes[1];
+			if (point[a] >= coreMinimum[a] - margin[a] && point[a] <= coreMaximum[a] + margin[a] &&
+				point[b] >= coreMinimum[b] - margin[b] && point[b] <= coreMaximum[b] + margin[b])
+			{
+				cluster.indices.emplace_back(i);
+			}
+		}
+		//The core is always part of the cluster, even when it is not in the box (e.g. zero overlap on a boundary)
+		cluster.indices.insert(cluster.indices.end(), cluster.core.begin(), cluster.core.end());
+		std::sort(cluster.indices.begin(), cluster.indices.end());
+		cluster.indices.erase(std::unique(cluster.indices.begin(), cluster.indices.end()), cluster.indices.end());
+	}
+	return clusters;
+}
+
+void SpatialPartition::split(const std::vector<Eigen::Vector3d>& points, std::vector<size_t>& indices,
+	const Eigen::Vector3d& minimum, const Eigen::Vector3d& maximum, size_t maxSize, int verticalAxis, std::vector<Cluster>& clusters)
+{
+	if (indices.size() > maxSize)
+	{
+		Eigen::Vector3d pointsMinimum = points[indices[0]], pointsMaximum = points[indices[0]];
+		for (const auto index : indices)
+		{
+			pointsMinimum = pointsMinimum.cwiseMin(points[index]);
+			pointsMaximum = pointsMaximum.cwiseMax(points[index]);
+		}
+		Eigen::Vector3d extent = pointsMaximum - pointsMinimum;
+		extent[verticalAxis] = -1;
+		int axis;
+		extent.maxCoeff(&axis);
+		std::sort(indices.begin(), indices.end(), [&](size_t a, size_t b) { return points[a][axis] < points[b][axis]; });
+		const size_t median = indices.size() / 2;
+		const double splitValue = 0.5 * (points[indices[median - 1]][axis] + points[indices[median]][axis]);
+		const auto middle = std::partition_point(indices.begin(), indices.end(), [&](size_t index) { return points[index][axis] < splitValue; });
+		//Only split when both sides get points, repeated positions can make it impossible
+		if (middle != indices.begin() && middle != indices.end())
+		{
+			std::vector<size_t> lower(indices.begin(), middle), upper(middle, indices.end());
+			Eigen::Vector3d lowerMaximum = maximum, upperMinimum = minimum;
+			lowerMaximum[axis] = splitValue;
+			upperMinimum[axis] = splitValue;
+			split(points, lower, minimum, lowerMaximum, maxSize, verticalAxis, clusters);
+			split(points, upper, upperMinimum, maximum, maxSize, verticalAxis, clusters);
+			return;
+		}
+	}
+	Cluster cluster;
+	cluster.minimum = minimum;
+	cluster.maximum = maximum;
+	cluster.core = indices;
+	std::sort(cluster.core.begin(), cluster.core.end());
+	clusters.emplace_back(cluster);
+}
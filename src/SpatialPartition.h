@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+namespace Partition
+{
+	struct Options
+	{
+		Options() {};
+		Options(int maxImages, double overlap, int maxWorkers, double maxDroppedFraction, int denseMaxImages, int denseMaxWorkers) :
+			maxImages(maxImages), overlap(overlap), maxWorkers(maxWorkers), maxDroppedFraction(maxDroppedFraction),
+			denseMaxImages(denseMaxImages), denseMaxWorkers(denseMaxWorkers) {};
+		// Captures with more images than this are split in clusters of up to this size
+		int maxImages = 500;
+		// Fraction of the cluster extent added around it, the images in it are shared with the neighbor clusters
+		double overlap = 0.2;
+		// Clusters processed at the same time
+		int maxWorkers = 2;
+		// Fraction of the images registered by the clusters that may be left out of the merged model, above it the
+		// sparse stage fails
+		double maxDroppedFraction = 0.1;
+		// Same for the dense stage, where the memory and temp disk grow with the images of a cluster
+		int denseMaxImages = 150;
+		int denseMaxWorkers = 2;
+
+		std::string print() const;
+	};
+}
+
+// Splits points in clusters by recursive bisection of their two widest axes, the thinnest one is taken as
+// the vertical of the capture (e.g. the altitude of GPS positions or of the cameras of a sparse model)
+class SpatialPartition
+{
+public:
+	struct Cluster
+	{
+		// Cell of the bisection, the cells of all clusters cover the space without overlapping
+		Eigen::Vector3d minimum;
+		Eigen::Vector3d maximum;
+		// Points inside the cell
+		std::vector<size_t> core;
+		// Core points plus the points in the overlap around the cell
+		std::vector<size_t> indices;
+
+		// Inside the cell, the lower faces are inclusive and the upper ones exclusive unless they bound the space
+		bool contains(const Eigen::Vector3d& point) const;
+	};
+
+	// Cells are split along their longest horizontal axis at the median until they have at most maxSize points
+	static std::vector<Cluster> partition(const std::vector<Eigen::Vector3d>& points, size_t maxSize, double overlap);
+
+private:
+	static void split(const std::vector<Eigen::Vector3d>& points, std::vector<size_t>& indices,
+		const Eigen::Vector3d& minimum, const Eigen::Vector3d& maximum, size_t maxSize, int verticalAxis, std::vector<Cluster>& clusters);
+};
@@ -0,0 +1,362 @@
+#include "StageBudget.h"
+
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+
+#include <windows.h>
+#include <omp.h>
+
+#include <wx/log.h>
+#include <wx/filename.h>
+
+#include "JobQueue.h"
+#include "ConfigurationDialog.h"
+#include "PlaneSweepStereo.h"
+#include "json.hpp"
+
+namespace
+{
+	// Share of the budget each stage takes, a stage with the GPU takes one whole GPU
+	struct StageShare
+	{
+		const char* stage;
+		double cpuThreads;
+		double memory;
+		bool gpu;
+	};
+	const StageShare stageShares[] =
+	{
+		{ "SFM", 0.75, 0.25, true },
+		{ "Dense", 0.25, 0.5, true },
+		{ "Meshing", 0.75, 0.5, false },
+		{ "Texturization", 0.5, 0.25, false },
+		{ "Scale", 0.125, 0.125, false }
+	};
+
+	const wchar_t* semaphoreNames[] = { L"SAEScan3D_Budget_CPU", L"SAEScan3D_Budget_Memory", L"SAEScan3D_Budget_GPU" };
+	// One process acquires at a time, so two stages never wait holding part of what the other needs
+	const wchar_t* acquireMutexName = L"SAEScan3D_Budget_Acquire";
+
+	// Processors in use by the stages of every job, a bit each. Its lock is not the acquire mutex, which is held while waiting
+	const wchar_t* processorsMappingName = L"SAEScan3D_Budget_Processors";
+	const wchar_t* processorsMutexName = L"SAEScan3D_Budget_ProcessorsLock";
+
+	std::mutex budgetMutex;
+	bool enabled = false;
+	std::string heldPath;
+	HANDLE semaphores[3] = { NULL, NULL, NULL };
+	HANDLE acquireMutex = NULL;
+	HANDLE processorsMapping = NULL;
+	HANDLE processorsMutex = NULL;
+	volatile uint64_t* busyProcessors = nullptr;
+	Budget::Cost budgetTotal;
+	int held[3] = { 0, 0, 0 };
+	uint64_t heldProcessors = 0;
+
+	// Takes count free processors, in a block when possible so the threads of a stage share caches. 0 if there are
+	// not enough, as when the CPU budget is above the processors of the machine
+	uint64_t takeProcessors(int count)
+	{
+		if (busyProcessors == nullptr || count <= 0 || WaitForSingleObject(processorsMutex, INFINITE) == WAIT_FAILED)
+		{
+			return 0;
+		}
+		DWORD_PTR processMask = 0, systemMask = 0;
+		GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+		const uint64_t freeProcessors = static_cast<uint64_t>(systemMask) & ~*busyProcessors;
+		uint64_t taken = 0;
+		for (int first = 0; first + count <= 64 && taken == 0; first++)
+		{
+			const uint64_t block = (count == 64 ? ~0ULL : ((1ULL << count) - 1)) << first;
+			if ((freeProcessors & block) == block)
+			{
+				taken = block;
+			}
+		}
+		//The free processors are scattered, the first ones
+		if (taken == 0)
+		{
+			int numTaken = 0;
+			for (int p = 0; p < 64 && numTaken < count; p++)
+			{
+				if (freeProcessors & (1ULL << p))
+				{
+					taken |= 1ULL << p;
+					numTaken++;
+				}
+			}
+			if (numTaken < count)
+			{
+				taken = 0;
+			}
+		}
+		*busyProcessors |= taken;
+		ReleaseMutex(processorsMutex);
+		return taken;
+	}
+
+	void giveBackProcessors(uint64_t processors)
+	{
+		if (busyProcessors == nullptr || processors == 0 || WaitForSingleObject(processorsMutex, INFINITE) == WAIT_FAILED)
+		{
+			return;
+		}
+		*busyProcessors &= ~processors;
+		ReleaseMutex(processorsMutex);
+	}
+
+	int* getUnits(Budget::Cost& cost, int resource)
+	{
+		return resource == 0 ? &cost.cpuThreads : resource == 1 ? &cost.memory : &cost.gpus;
+	}
+
+	//Needs budgetMutex
+	void writeHeld()
+	{
+		if (heldPath.empty())
+		{
+			return;
+		}
+		nlohmann::json json;
+		json["cpuThreads"] = held[0];
+		json["memory"] = held[1];
+		json["gpus"] = held[2];
+		json["processors"] = heldProcessors;
+		std::ofstream heldFile(heldPath);
+		heldFile << json.dump();
+	}
+
+	//Needs budgetMutex. The processors go back first, so there are always as many free as CPU units
+	void releaseHeld()
+	{
+		if (heldProcessors != 0)
+		{
+			giveBackProcessors(heldProcessors);
+			heldProcessors = 0;
+			DWORD_PTR processMask = 0, systemMask = 0;
+			if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+			{
+				SetProcessAffinityMask(GetCurrentProcess(), systemMask);
+			}
+			omp_set_num_threads(omp_get_num_procs());
+		}
+		for (int r = 0; r < 3; r++)
+		{
+			if (held[r] > 0 && semaphores[r] != NULL)
+			{
+				ReleaseSemaphore(semaphores[r], held[r], NULL);
+			}
+			held[r] = 0;
+		}
+		if (!heldPath.empty())
+		{
+			wxRemoveFile(heldPath);
+		}
+	}
+}
+
+std::string Budget::Cost::print() const
+{
+	std::stringstream text;
+	text << cpuThreads << " threads, " << memory << " GB, " << gpus << " GPU";
+	return text.str();
+}
+
+bool StageBudget::enable(const Queue::Options& options, const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(budgetMutex);
+	if (enabled)
+	{
+		return 1;
+	}
+	//The process that creates the semaphores sets the totals, the others share them
+	budgetTotal = getTotal(options);
+	for (int r = 0; r < 3; r++)
+	{
+		const long units = *getUnits(budgetTotal, r);
+		semaphores[r] = CreateSemaphoreW(NULL, units, std::max(units, 1L), semaphoreNames[r]);
+		if (semaphores[r] == NULL)
+		{
+			wxLogError("Could not create the budget semaphores (%d)", GetLastError());
+			return 0;
+		}
+	}
+	acquireMutex = CreateMutexW(NULL, FALSE, acquireMutexName);
+	processorsMutex = CreateMutexW(NULL, FALSE, processorsMutexName);
+	if (acquireMutex == NULL || processorsMutex == NULL)
+	{
+		wxLogError("Could not create the budget mutex (%d)", GetLastError());
+		return 0;
+	}
+	//Zeroed when created
+	processorsMapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(uint64_t), processorsMappingName);
+	if (processorsMapping != NULL)
+	{
+		busyProcessors = static_cast<volatile uint64_t*>(MapViewOfFile(processorsMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(uint64_t)));
+	}
+	if (busyProcessors == nullptr)
+	{
+		wxLogWarning("Could not share the processors of the budget (%d), the stages will not have their own", GetLastError());
+	}
+	heldPath = path;
+	enabled = true;
+	return 1;
+}
+
+bool StageBudget::isEnabled()
+{
+	std::lock_guard<std::mutex> lock(budgetMutex);
+	return enabled;
+}
+
+bool StageBudget::acquire(const std::string& stage)
+{
+	std::lock_guard<std::mutex> lock(budgetMutex);
+	if (!enabled)
+	{
+		return 1;
+	}
+	releaseHeld();
+	auto cost = getStageCost(stage, budgetTotal);
+	//WAIT_ABANDONED leaves the mutex to this process when the owner died
+	const DWORD waitResult = WaitForSingleObject(acquireMutex, INFINITE);
+	if (waitResult != WAIT_OBJECT_0 && waitResult != WAIT_ABANDONED)
+	{
+		wxLogError("Could not wait for the budget (%d)", GetLastError());
+		return 0;
+	}
+	bool acquired = true;
+	for (int r = 0; r < 3 && acquired; r++)
+	{
+		for (int unit = 0; unit < *getUnits(cost, r); unit++)
+		{
+			if (WaitForSingleObject(semaphores[r], INFINITE) != WAIT_OBJECT_0)
+			{
+				acquired = false;
+				break;
+			}
+			held[r]++;
+			writeHeld();
+		}
+	}
+	ReleaseMutex(acquireMutex);
+	if (!acquired)
+	{
+		wxLogError("Could not acquire the budget of %s", stage);
+		releaseHeld();
+		return 0;
+	}
+	//The native steps and the tools started by the stage (they inherit the affinity) stay on its processors
+	heldProcessors = takeProcessors(held[0]);
+	writeHeld();
+	if (heldProcessors != 0)
+	{
+		SetProcessAffinityMask(GetCurrentProcess(), static_cast<DWORD_PTR>(heldProcessors));
+		omp_set_num_threads(held[0]);
+	}
+	return 1;
+}
+
+void StageBudget::release()
+{
+	std::lock_guard<std::mutex> lock(budgetMutex);
+	releaseHeld();
+}
+
+Budget::Cost StageBudget::getHeld()
+{
+	std::lock_guard<std::mutex> lock(budgetMutex);
+	return Budget::Cost(held[0], held[1], held[2]);
+}
+
+uint64_t StageBudget::getHeldProcessors()
+{
+	std::lock_guard<std::mutex> lock(budgetMutex);
+	return heldProcessors;
+}
+
+Budget::Cost StageBudget::getTotal(const Queue::Options& options)
+{
+	Budget::Cost total;
+	total.cpuThreads = options.cpuThreads > 0 ? options.cpuThreads : std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+	if (options.memoryBudget > 0)
+	{
+		total.memory = std::max(static_cast<int>(options.memoryBudget), 1);
+	}
+	else
+	{
+		MEMORYSTATUSEX memoryStatus;
+		memoryStatus.dwLength = sizeof(memoryStatus);
+		const double physicalGB = GlobalMemoryStatusEx(&memoryStatus) ? memoryStatus.ullTotalPhys / (1024.0 * 1024 * 1024) : 0;
+		total.memory = std::max(static_cast<int>(physicalGB * 0.75), 1);
+	}
+	total.gpus = std::max(options.gpus, 0);
+	return total;
+}
+
+Budget::Cost StageBudget::getStageCost(const std::string& stage, const Budget::Cost& budget)
+{
+	//The stereo of machines without CUDA is the CPU plane sweep
+	const bool useGPU = ConfigurationDialog::getUseGPU() == "1";
+	const auto stereoOptions = ConfigurationDialog::getStereoOptions();
+	const bool planeSweep = stereoOptions.mode == Stereo::PlaneSweep || (stereoOptions.mode == Stereo::Auto && !useGPU);
+	StageShare share = { "", 0.125, 0.125, false };
+	for (const auto& stageShare : stageShares)
+	{
+		if (stage == stageShare.stage)
+		{
+			share = stageShare;
+		}
+	}
+	if (stage == "Dense" && planeSweep)
+	{
+		share.cpuThreads = 1;
+		share.gpu = false;
+	}
+	auto toUnits = [](double fraction, int totalUnits)
+	{
+		return std::min(std::max(static_cast<int>(std::ceil(fraction * totalUnits)), 1), totalUnits);
+	};
+	Budget::Cost cost;
+	cost.cpuThreads = toUnits(share.cpuThreads, budget.cpuThreads);
+	cost.memory = toUnits(share.memory, budget.memory);
+	cost.gpus = share.gpu && useGPU ? std::min(budget.gpus, 1) : 0;
+	return cost;
+}
+
+void StageBudget::releaseLeftover(const std::string& path)
+{
+	std::ifstream heldFile(path);
+	if (!heldFile.is_open())
+	{
+		return;
+	}
+	Budget::Cost leftover;
+	uint64_t leftoverProcessors = 0;
+	try
+	{
+		const auto json = nlohmann::json::parse(heldFile);
+		leftover = Budget::Cost(json.value("cpuThreads", 0), json.value("memory", 0), json.value("gpus", 0));
+		leftoverProcessors = json.value("processors", static_cast<uint64_t>(0));
+	}
+	catch (const std::exception&)
+	{
+		wxLogWarning(wxString("Invalid budget file " + path));
+	}
+	heldFile.close();
+	std::lock_guard<std::mutex> lock(budgetMutex);
+	giveBackProcessors(leftoverProcessors);
+	for (int r = 0; r < 3; r++)
+	{
+		const int units = *getUnits(leftover, r);
+		if (units > 0 && semaphores[r] != NULL)
+		{
+			ReleaseSemaphore(semaphores[r], units, NULL);
+		}
+	}
+	wxRemoveFile(path);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace Queue
+{
+	struct Options;
+}
+
+namespace Budget
+{
+	// Units of the budget: CPU threads, GB of memory and GPUs
+	struct Cost
+	{
+		Cost() {};
+		Cost(int cpuThreads, int memory, int gpus) : cpuThreads(cpuThreads), memory(memory), gpus(gpus) {};
+		int cpuThreads = 0;
+		int memory = 0;
+		int gpus = 0;
+
+		std::string print() const;
+	};
+}
+
+// Machine wide budget shared by the stages of the queued jobs, kept in named semaphores with a unit per thread,
+// GB and GPU. Each stage takes a share of the budget (the dense stage most of the GPU and memory, the meshing most of
+// the CPU) and waits until it is free. A stage also gets processors of its own, one per thread, that the process and
+// its tools are kept on. The units held are written to a file so the runner can give back those of a job that
+// crashed. Disabled, as in the GUI, acquire returns at once.
+class StageBudget
+{
+public:
+	// heldPath is where the units held are recorded, empty for the runner that only keeps the semaphores alive
+	static bool enable(const Queue::Options& options, const std::string& heldPath);
+	static bool isEnabled();
+
+	// Waits for the units of the stage, releasing those of the previous one
+	static bool acquire(const std::string& stage);
+	static void release();
+	// Units of the running stage
+	static Budget::Cost getHeld();
+	// Processors of the running stage, a bit each, 0 when it has none of its own
+	static uint64_t getHeldProcessors();
+
+	static Budget::Cost getTotal(const Queue::Options& options);
+	static Budget::Cost getStageCost(const std::string& stage, const Budget::Cost& total);
+	// Gives back the units recorded in heldPath by a job that exited without releasing them
+	static void releaseLeftover(const std::string& heldPath);
+};
@@ -0,0 +1,57 @@
+#include "StageRunner.h"
+
+#include <sstream>
+#include <mutex>
+
+#include "MockToolRunner.h"
+#include "ConfigurationDialog.h"
+#include "Utils.h"
+
+namespace
+{
+	std::mutex runnerMutex;
+	std::shared_ptr<StageRunner> runner;
+}
+
+std::string Runner::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Mock " << mock << "\n" <<
+		"Delay ms " << delayMs << "\n" <<
+		"Delay per image ms " << delayPerImageMs << "\n" <<
+		"Sparse points per image " << sparsePointsPerImage << "\n" <<
+		"Dense points per image " << densePointsPerImage << "\n" <<
+		"Mesh faces " << meshFaces << "\n" <<
+		"Texture size " << textureSize << "\n" <<
+		"Seed " << seed << "\n";
+	return parameters.str();
+}
+
+std::shared_ptr<StageRunner> StageRunner::get()
+{
+	{
+		std::lock_guard<std::mutex> lock(runnerMutex);
+		if (runner)
+		{
+			return runner;
+		}
+	}
+	//Made on each call, the configuration may have been reloaded
+	const auto options = ConfigurationDialog::getRunnerOptions();
+	if (options.mock)
+	{
+		return std::make_shared<MockToolRunner>(options);
+	}
+	return std::make_shared<ExternalToolRunner>();
+}
+
+void StageRunner::set(const std::shared_ptr<StageRunner>& newRunner)
+{
+	std::lock_guard<std::mutex> lock(runnerMutex);
+	runner = newRunner;
+}
+
+bool ExternalToolRunner::run(const std::string& tool, const std::string& arguments, const std::string& workingDirectory)
+{
+	return Utils::startProcess(Utils::preparePath(Utils::getExecutionPath() + "/" + tool) + arguments, workingDirectory);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+namespace Runner
+{
+	struct Options
+	{
+		Options() {};
+		Options(bool mock, int delayMs, int delayPerImageMs, int sparsePointsPerImage, int densePointsPerImage, int meshFaces,
+			int textureSize, unsigned int seed) : mock(mock), delayMs(delayMs), delayPerImageMs(delayPerImageMs),
+			sparsePointsPerImage(sparsePointsPerImage), densePointsPerImage(densePointsPerImage), meshFaces(meshFaces),
+			textureSize(textureSize), seed(seed) {};
+		// Runs the stand-ins of the external tools instead of them, to benchmark the pipeline without COLMAP or a GPU
+		bool mock = false;
+		// Time a stand-in takes per call and per image it processes
+		int delayMs = 0;
+		int delayPerImageMs = 0;
+		// Sizes of the outputs of the stand-ins
+		int sparsePointsPerImage = 300;
+		int densePointsPerImage = 5000;
+		int meshFaces = 200000;
+		int textureSize = 1024;
+		// The same seed and inputs give the same outputs
+		unsigned int seed = 1;
+
+		std::string print() const;
+	};
+}
+
+// Runs the external tools of the helpers. The tool is given relative to the execution path (e.g. "COLMAP/COLMAP.bat")
+// with its arguments as they follow it on the command line, so a runner can start the executable or stand in for it.
+class StageRunner
+{
+public:
+	virtual ~StageRunner() {};
+	virtual bool run(const std::string& tool, const std::string& arguments, const std::string& workingDirectory = "") = 0;
+
+	// Runner of the helpers: the one set, or the configured one
+	static std::shared_ptr<StageRunner> get();
+	// Replaces the configured runner, e.g. a benchmark with its own options. nullptr goes back to the configured one
+	static void set(const std::shared_ptr<StageRunner>& runner);
+};
+
+// Starts the executables in the execution path, in their job object (see Utils::startProcess)
+class ExternalToolRunner : public StageRunner
+{
+public:
+	bool run(const std::string& tool, const std::string& arguments, const std::string& workingDirectory = "") override;
+};
@@ -0,0 +1,174 @@
+#include "StageTelemetry.h"
+
+#include <mutex>
+#include <algorithm>
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+
+#include "ReconstructionLog.h"
+#include "json.hpp"
+
+namespace
+{
+	std::mutex childrenMutex;
+	Telemetry::Usage childrenUsage;
+
+	//FILETIME and the job times count 100 ns
+	double toSeconds(uint64_t ticks)
+	{
+		return ticks / 1e7;
+	}
+
+	double toSeconds(const FILETIME& time)
+	{
+		return toSeconds((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime);
+	}
+
+	nlohmann::json toJson(const Telemetry::Usage& usage)
+	{
+		nlohmann::json json;
+		json["userSeconds"] = usage.userSeconds;
+		json["systemSeconds"] = usage.systemSeconds;
+		json["peakMemory"] = usage.peakMemory;
+		json["bytesRead"] = usage.bytesRead;
+		json["bytesWritten"] = usage.bytesWritten;
+		return json;
+	}
+}
+
+StageTelemetry::StageTelemetry(const std::string& stage, const std::vector<std::string>& inputPaths) : stage(stage)
+{
+	for (const auto& path : inputPaths)
+	{
+		inputBytes += getDiskSize(path);
+	}
+	startTime = ReconstructionLog::getCurrentDateTime();
+	startChildren = getChildrenUsage(true);
+	startProcess = getProcessUsage(startMemory);
+	startClock = std::chrono::steady_clock::now();
+}
+
+std::string StageTelemetry::finish(bool succeeded, const std::vector<std::string>& outputPaths, const std::string& runId)
+{
+	const std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - startClock;
+	const auto endChildren = getChildrenUsage(false);
+	uint64_t endMemory = 0;
+	const auto endProcess = getProcessUsage(endMemory);
+	Telemetry::Usage children;
+	children.userSeconds = endChildren.userSeconds - startChildren.userSeconds;
+	children.systemSeconds = endChildren.systemSeconds - startChildren.systemSeconds;
+	children.peakMemory = endChildren.peakMemory;
+	children.bytesRead = endChildren.bytesRead - startChildren.bytesRead;
+	children.bytesWritten = endChildren.bytesWritten - startChildren.bytesWritten;
+	children.numProcesses = endChildren.numProcesses - startChildren.numProcesses;
+	Telemetry::Usage process;
+	process.userSeconds = endProcess.userSeconds - startProcess.userSeconds;
+	process.systemSeconds = endProcess.systemSeconds - startProcess.systemSeconds;
+	//The peak of the process life is only known to belong to the stage if it grew during it
+	process.peakMemory = endProcess.peakMemory > startProcess.peakMemory ? endProcess.peakMemory : std::max(startMemory, endMemory);
+	process.bytesRead = endProcess.bytesRead - startProcess.bytesRead;
+	process.bytesWritten = endProcess.bytesWritten - startProcess.bytesWritten;
+	uint64_t outputBytes = 0;
+	for (const auto& path : outputPaths)
+	{
+		outputBytes += getDiskSize(path);
+	}
+	nlohmann::json event;
+	event["run"] = runId;
+	event["stage"] = stage;
+	event["succeeded"] = succeeded;
+	event["startTime"] = startTime;
+	event["wallSeconds"] = wallTime.count();
+	event["process"] = toJson(process);
+	event["children"] = toJson(children);
+	event["children"]["numProcesses"] = children.numProcesses;
+	event["inputBytes"] = inputBytes;
+	event["outputBytes"] = outputBytes;
+	return event.dump();
+}
+
+void StageTelemetry::addChildUsage(const Telemetry::Usage& usage)
+{
+	std::lock_guard<std::mutex> lock(childrenMutex);
+	childrenUsage.userSeconds += usage.userSeconds;
+	childrenUsage.systemSeconds += usage.systemSeconds;
+	childrenUsage.peakMemory = std::max(childrenUsage.peakMemory, usage.peakMemory);
+	childrenUsage.bytesRead += usage.bytesRead;
+	childrenUsage.bytesWritten += usage.bytesWritten;
+	childrenUsage.numProcesses += usage.numProcesses;
+}
+
+Telemetry::Usage StageTelemetry::getJobUsage(void* job)
+{
+	Telemetry::Usage usage;
+	JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION accounting;
+	if (QueryInformationJobObject(job, JobObjectBasicAndIoAccountingInformation, &accounting, sizeof(accounting), NULL))
+	{
+		usage.userSeconds = toSeconds(accounting.BasicInfo.TotalUserTime.QuadPart);
+		usage.systemSeconds = toSeconds(accounting.BasicInfo.TotalKernelTime.QuadPart);
+		usage.bytesRead = accounting.IoInfo.ReadTransferCount;
+		usage.bytesWritten = accounting.IoInfo.WriteTransferCount;
+		usage.numProcesses = accounting.BasicInfo.TotalProcesses;
+	}
+	JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits;
+	if (QueryInformationJobObject(job, JobObjectExtendedLimitInformation, &limits, sizeof(limits), NULL))
+	{
+		usage.peakMemory = limits.PeakJobMemoryUsed;
+	}
+	return usage;
+}
+
+uint64_t StageTelemetry::getDiskSize(const std::string& path)
+{
+	if (wxDirExists(path))
+	{
+		return wxDir::GetTotalSize(path).GetValue();
+	}
+	if (wxFileExists(path))
+	{
+		return wxFileName::GetSize(path).GetValue();
+	}
+	return 0;
+}
+
+Telemetry::Usage StageTelemetry::getChildrenUsage(bool resetPeak)
+{
+	std::lock_guard<std::mutex> lock(childrenMutex);
+	const auto usage = childrenUsage;
+	if (resetPeak)
+	{
+		childrenUsage.peakMemory = 0;
+	}
+	return usage;
+}
+
+Telemetry::Usage StageTelemetry::getProcessUsage(uint64_t& currentMemory)
+{
+	Telemetry::Usage usage;
+	const HANDLE process = GetCurrentProcess();
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (GetProcessTimes(process, &creationTime, &exitTime, &kernelTime, &userTime))
+	{
+		usage.userSeconds = toSeconds(userTime);
+		usage.systemSeconds = toSeconds(kernelTime);
+	}
+	IO_COUNTERS ioCounters;
+	if (GetProcessIoCounters(process, &ioCounters))
+	{
+		usage.bytesRead = ioCounters.ReadTransferCount;
+		usage.bytesWritten = ioCounters.WriteTransferCount;
+	}
+	PROCESS_MEMORY_COUNTERS memoryCounters;
+	currentMemory = 0;
+	if (GetProcessMemoryInfo(process, &memoryCounters, sizeof(memoryCounters)))
+	{
+		usage.peakMemory = memoryCounters.PeakPagefileUsage;
+		currentMemory = memoryCounters.PagefileUsage;
+	}
+	usage.numProcesses = 1;
+	return usage;
+}
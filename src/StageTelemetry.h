@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+namespace Telemetry
+{
+	// Resources used by this process and the external tools it started
+	struct Usage
+	{
+		double userSeconds = 0;
+		double systemSeconds = 0;
+		// Peak committed bytes of a process tree, Windows doesn't keep the peak working set of a job
+		uint64_t peakMemory = 0;
+		uint64_t bytesRead = 0;
+		uint64_t bytesWritten = 0;
+		int numProcesses = 0;
+	};
+}
+
+// Measures one stage of the reconstruction: monotonic wall time, CPU, I/O and peak memory of this process and of the
+// children started by Utils::startProcess in the meantime, and the size of the stage inputs and outputs.
+// Every child runs in its own job object, so the tools started by the .bat files are accounted too.
+class StageTelemetry
+{
+public:
+	// The inputs are measured now, the counters are read as the start of the stage
+	StageTelemetry(const std::string& stage, const std::vector<std::string>& inputPaths);
+
+	// One JSON object in a line, runId tells the runs of a project apart
+	std::string finish(bool succeeded, const std::vector<std::string>& outputPaths, const std::string& runId);
+
+	const std::string& getStage() const { return stage; };
+
+	// Called with the totals of the job of each finished child
+	static void addChildUsage(const Telemetry::Usage& usage);
+	// Totals of a job object, given as a HANDLE
+	static Telemetry::Usage getJobUsage(void* job);
+
+	// Bytes of a file or of a directory tree, 0 if it doesn't exist
+	static uint64_t getDiskSize(const std::string& path);
+
+private:
+	// Children finished so far, the peak is the largest job since the last reset
+	static Telemetry::Usage getChildrenUsage(bool resetPeak);
+	// This process, the peak is the largest commit of its life and currentMemory the commit now
+	static Telemetry::Usage getProcessUsage(uint64_t& currentMemory);
+
+	std::string stage;
+	std::string startTime;
+	std::chrono::steady_clock::time_point startClock;
+	Telemetry::Usage startChildren;
+	Telemetry::Usage startProcess;
+	uint64_t startMemory = 0;
+	uint64_t inputBytes = 0;
+};
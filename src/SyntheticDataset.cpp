@@ -0,0 +1,857 @@
+#include "SyntheticDataset.h"
+
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include <omp.h>
+
+#include <wx/log.h>
+#include <wx/filename.h>
+#include <wx/image.h>
+
+#include "json.hpp"
+#include "SpatialIndex.h"
+#include "PlyIO.h"
+#include "ImageIO.h"
+#include "Camera.h"
+#include "Tracer.h"
+#include "Utils.h"
+
+namespace
+{
+	const double pi = 3.14159265358979323846;
+	// Orbit: a sphere at the origin and the cameras on a circle around it
+	const double sphereRadius = 3;
+	const double orbitRadius = 10;
+	const double orbitHeight = 2;
+	// Nadir grid: a rolling terrain flown over at a constant altitude
+	const double altitude = 50;
+	const double forwardOverlap = 0.8;
+	const double sideOverlap = 0.6;
+	const double terrainAmplitude = 2;
+	// Corridor: a box of 4 x 3 m walked along its axis at the height of the eyes, 14 m around
+	const double corridorHalfWidth = 2;
+	const double corridorHeight = 3;
+	const double eyeHeight = 1.5;
+	const double stepLength = 0.5;
+	const double corridorAhead = 20;
+	const double corridorPerimeter = 4 * corridorHalfWidth + 2 * corridorHeight;
+	// A sparse point is searched in the nearest cameras, its track has the ones that see it
+	const size_t trackCandidates = 32;
+	const size_t maxTrackLength = 8;
+	// Dense points are created in chunks of their own random stream, so the threads give the same points
+	const size_t chunkSize = 1 << 20;
+	// Side of the squares of the color pattern, in meters
+	const double patternSize = 1;
+
+	double getTerrainHeight(double x, double y)
+	{
+		return terrainAmplitude * std::sin(x / 15) * std::cos(y / 20);
+	}
+
+	Eigen::Vector3d getTerrainNormal(double x, double y)
+	{
+		const double dx = terrainAmplitude / 15 * std::cos(x / 15) * std::cos(y / 20);
+		const double dy = -terrainAmplitude / 20 * std::sin(x / 15) * std::sin(y / 20);
+		return Eigen::Vector3d(-dx, -dy, 1).normalized();
+	}
+
+	// Point of the section of the corridor at the distance s around it (floor, right wall, ceiling, left wall)
+	// and its normal toward the inside
+	void getCorridorSection(double s, double& y, double& z, Eigen::Vector3d& normal)
+	{
+		const double width = 2 * corridorHalfWidth;
+		s = std::fmod(s, corridorPerimeter);
+		if (s < 0)
+		{
+			s += corridorPerimeter;
+		}
+		if (s < width)
+		{
+			y = -corridorHalfWidth + s;
+			z = 0;
+			normal = Eigen::Vector3d::UnitZ();
+		}
+		else if (s < width + corridorHeight)
+		{
+			y = corridorHalfWidth;
+			z = s - width;
+			normal = -Eigen::Vector3d::UnitY();
+		}
+		else if (s < 2 * width + corridorHeight)
+		{
+			y = corridorHalfWidth - (s - width - corridorHeight);
+			z = corridorHeight;
+			normal = -Eigen::Vector3d::UnitZ();
+		}
+		else
+		{
+			y = -corridorHalfWidth;
+			z = corridorHeight - (s - 2 * width - corridorHeight);
+			normal = Eigen::Vector3d::UnitY();
+		}
+	}
+
+	// Rows of the world to camera rotation of a camera looking along forward
+	Eigen::Matrix3d lookAt(const Eigen::Vector3d& forward, const Eigen::Vector3d& up)
+	{
+		const Eigen::Vector3d z = forward.normalized();
+		const Eigen::Vector3d x = z.cross(up).normalized();
+		const Eigen::Vector3d y = z.cross(x);
+		Eigen::Matrix3d rotation;
+		rotation.row(0) = x;
+		rotation.row(1) = y;
+		rotation.row(2) = z;
+		return rotation;
+	}
+
+	// Grid of the mesh, rows x cols vertices, the last column joins the first one when it wraps
+	struct Grid
+	{
+		size_t rows = 2;
+		size_t cols = 2;
+		bool wrap = false;
+		// The cells are split the other way, so the faces look at the cameras
+		bool reversed = false;
+
+		size_t getNumVertices() const { return rows * cols; };
+		size_t getNumFaces() const { return 2 * (rows - 1) * (wrap ? cols : cols - 1); };
+	};
+
+	// Surface of a rig and the poses of its cameras, in meters
+	class Scene
+	{
+	public:
+		explicit Scene(const Synthetic::Options& options);
+
+		size_t getNumImages() const { return centers.size(); };
+		const Eigen::Vector3d& getCenter(size_t index) const { return centers[index]; };
+		Eigen::Matrix4d getPose(size_t index) const;
+		// Cell of the index of the camera centers, the default one of SpatialIndex degenerates on the line of the corridor
+		double getCameraCellSize() const { return cameraCellSize; };
+
+		// Uniform point of the surface and its normal toward the cameras
+		void sample(std::mt19937& random, Eigen::Vector3d& point, Eigen::Vector3d& normal) const;
+		void getBounds(Eigen::Vector3d& min, Eigen::Vector3d& max) const;
+
+		Grid getGrid(size_t numFaces) const;
+		Eigen::Vector3d getGridVertex(const Grid& grid, size_t row, size_t col) const;
+
+	private:
+		Synthetic::Rig rig;
+		std::vector<Eigen::Vector3d> centers;
+		std::vector<Eigen::Matrix3d> rotations;
+		// Extent of the terrain in x and y, of the corridor in x
+		Eigen::Vector2d extentMin = Eigen::Vector2d::Zero();
+		Eigen::Vector2d extentMax = Eigen::Vector2d::Zero();
+		double cameraCellSize = 1;
+	};
+
+	Scene::Scene(const Synthetic::Options& options) : rig(options.rig)
+	{
+		const size_t numImages = static_cast<size_t>(std::max(options.numImages, 1));
+		centers.reserve(numImages);
+		rotations.reserve(numImages);
+		if (rig == Synthetic::Orbit)
+		{
+			for (size_t i = 0; i < numImages; i++)
+			{
+				const double angle = 2 * pi * i / numImages;
+				centers.emplace_back(orbitRadius * std::cos(angle), orbitRadius * std::sin(angle), orbitHeight);
+				rotations.emplace_back(lookAt(-centers.back(), Eigen::Vector3d::UnitZ()));
+			}
+			//A few cameras per cell, the surface a few cells away
+			cameraCellSize = std::max(4 * 2 * pi * orbitRadius / numImages, (orbitRadius - sphereRadius) / 2);
+		}
+		else if (rig == Synthetic::NadirGrid)
+		{
+			//Footprint of an image on the ground, the focal is the width of the image
+			const double footprintWidth = altitude;
+			const double footprintHeight = altitude * options.height / std::max(options.width, 1u);
+			const double sideStep = (1 - sideOverlap) * footprintWidth;
+			const double forwardStep = (1 - forwardOverlap) * footprintHeight;
+			const size_t numLines = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(numImages))));
+			const size_t perLine = (numImages + numLines - 1) / numLines;
+			//Lawnmower: the lines go along y, one way and then back
+			for (size_t i = 0; i < numImages; i++)
+			{
+				const size_t line = i / perLine;
+				const size_t step = (line % 2 == 0) ? i % perLine : perLine - 1 - i % perLine;
+				const double x = line * sideStep;
+				const double y = step * forwardStep;
+				centers.emplace_back(x, y, altitude);
+				rotations.emplace_back(lookAt(-Eigen::Vector3d::UnitZ(), Eigen::Vector3d::UnitY()));
+			}
+			extentMin = Eigen::Vector2d(-footprintWidth / 2, -footprintHeight / 2);
+			extentMax = Eigen::Vector2d((numLines - 1) * sideStep + footprintWidth / 2, (perLine - 1) * forwardStep + footprintHeight / 2);
+			cameraCellSize = std::max(4 * forwardStep, altitude / 4);
+		}
+		else
+		{
+			for (size_t i = 0; i < numImages; i++)
+			{
+				centers.emplace_back(i * stepLength, 0, eyeHeight);
+				rotations.emplace_back(lookAt(Eigen::Vector3d::UnitX(), Eigen::Vector3d::UnitZ()));
+			}
+			extentMin = Eigen::Vector2d(-corridorHalfWidth, 0);
+			extentMax = Eigen::Vector2d((numImages - 1) * stepLength + corridorAhead, 0);
+			cameraCellSize = std::max(4 * stepLength, corridorHalfWidth / 4);
+		}
+	}
+
+	Eigen::Matrix4d Scene::getPose(size_t index) const
+	{
+		Eigen::Matrix4d matrixRt = Eigen::Matrix4d::Identity();
+		matrixRt.block<3, 3>(0, 0) = rotations[index];
+		matrixRt.block<3, 1>(0, 3) = -rotations[index] * centers[index];
+		return matrixRt;
+	}
+
+	void Scene::sample(std::mt19937& random, Eigen::Vector3d& point, Eigen::Vector3d& normal) const
+	{
+		if (rig == Synthetic::Orbit)
+		{
+			std::normal_distribution<double> gaussian(0, 1);
+			normal = Eigen::Vector3d(gaussian(random), gaussian(random), gaussian(random));
+			if (normal.squaredNorm() == 0)
+			{
+				normal = Eigen::Vector3d::UnitZ();
+			}
+			normal.normalize();
+			point = sphereRadius * normal;
+		}
+		else if (rig == Synthetic::NadirGrid)
+		{
+			std::uniform_real_distribution<double> uniformX(extentMin.x(), extentMax.x());
+			std::uniform_real_distribution<double> uniformY(extentMin.y(), extentMax.y());
+			const double x = uniformX(random);
+			const double y = uniformY(random);
+			point = Eigen::Vector3d(x, y, getTerrainHeight(x, y));
+			normal = getTerrainNormal(x, y);
+		}
+		else
+		{
+			std::uniform_real_distribution<double> uniformX(extentMin.x(), extentMax.x());
+			std::uniform_real_distribution<double> uniformS(0, corridorPerimeter);
+			double y, z;
+			const double x = uniformX(random);
+			getCorridorSection(uniformS(random), y, z, normal);
+			point = Eigen::Vector3d(x, y, z);
+		}
+	}
+
+	void Scene::getBounds(Eigen::Vector3d& min, Eigen::Vector3d& max) const
+	{
+		if (rig == Synthetic::Orbit)
+		{
+			min = Eigen::Vector3d::Constant(-sphereRadius);
+			max = Eigen::Vector3d::Constant(sphereRadius);
+		}
+		else if (rig == Synthetic::NadirGrid)
+		{
+			min = Eigen::Vector3d(extentMin.x(), extentMin.y(), -terrainAmplitude);
+			max = Eigen::Vector3d(extentMax.x(), extentMax.y(), terrainAmplitude);
+		}
+		else
+		{
+			min = Eigen::Vector3d(extentMin.x(), -corridorHalfWidth, 0);
+			max = Eigen::Vector3d(extentMax.x(), corridorHalfWidth, corridorHeight);
+		}
+	}
+
+	Grid Scene::getGrid(size_t numFaces) const
+	{
+		Grid grid;
+		const double faces = static_cast<double>(std::max<size_t>(numFaces, 8));
+		if (rig == Synthetic::Orbit)
+		{
+			//Rings of twice as many segments, the poles are left open
+			grid.wrap = true;
+			grid.rows = std::max<size_t>(2, static_cast<size_t>(std::round(std::sqrt(faces / 4))) + 1);
+			grid.cols = 2 * (grid.rows - 1);
+		}
+		else if (rig == Synthetic::NadirGrid)
+		{
+			const Eigen::Vector2d size = extentMax - extentMin;
+			const double aspect = size.x() / std::max(size.y(), 1e-9);
+			grid.rows = std::max<size_t>(2, static_cast<size_t>(std::round(std::sqrt(faces / (2 * aspect)))) + 1);
+			grid.cols = std::max<size_t>(2, static_cast<size_t>(std::round(faces / (2 * (grid.rows - 1)))) + 1);
+			grid.reversed = true;
+		}
+		else
+		{
+			//Rows along the corridor, the columns around it hit its corners at multiples of 14
+			grid.wrap = true;
+			const double length = extentMax.x() - extentMin.x();
+			const double aspect = corridorPerimeter / length;
+			const size_t cols = static_cast<size_t>(std::round(std::sqrt(faces * aspect / 2)));
+			grid.cols = std::max<size_t>(1, (cols + 7) / 14) * 14;
+			grid.rows = std::max<size_t>(2, static_cast<size_t>(std::round(faces / (2 * grid.cols))) + 1);
+		}
+		return grid;
+	}
+
+	Eigen::Vector3d Scene::getGridVertex(const Grid& grid, size_t row, size_t col) const
+	{
+		if (rig == Synthetic::Orbit)
+		{
+			const double theta = pi * (row + 0.5) / grid.rows;
+			const double phi = 2 * pi * col / grid.cols;
+			return sphereRadius * Eigen::Vector3d(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+		}
+		if (rig == Synthetic::NadirGrid)
+		{
+			const double x = extentMin.x() + (extentMax.x() - extentMin.x()) * col / (grid.cols - 1);
+			const double y = extentMin.y() + (extentMax.y() - extentMin.y()) * row / (grid.rows - 1);
+			return Eigen::Vector3d(x, y, getTerrainHeight(x, y));
+		}
+		double y, z;
+		Eigen::Vector3d normal;
+		getCorridorSection(corridorPerimeter * col / grid.cols, y, z, normal);
+		return Eigen::Vector3d(extentMin.x() + (extentMax.x() - extentMin.x()) * row / (grid.rows - 1), y, z);
+	}
+
+	// Triangles of the cells between the row and the next one
+	void getRowTriangles(const Grid& grid, size_t row, std::vector<uint32_t>& triangles)
+	{
+		triangles.clear();
+		const size_t numCells = grid.wrap ? grid.cols : grid.cols - 1;
+		for (size_t col = 0; col < numCells; col++)
+		{
+			const uint32_t a = static_cast<uint32_t>(row * grid.cols + col);
+			const uint32_t b = static_cast<uint32_t>(row * grid.cols + (col + 1) % grid.cols);
+			const uint32_t c = static_cast<uint32_t>((row + 1) * grid.cols + col);
+			const uint32_t d = static_cast<uint32_t>((row + 1) * grid.cols + (col + 1) % grid.cols);
+			if (grid.reversed)
+			{
+				triangles.insert(triangles.end(), { a, d, c, a, b, d });
+			}
+			else
+			{
+				triangles.insert(triangles.end(), { a, c, d, a, d, b });
+			}
+		}
+	}
+
+	// The color follows the normal in squares of two shades, so the views of the scene differ
+	void getColor(const Eigen::Vector3d& point, const Eigen::Vector3d& normal, unsigned char rgb[3])
+	{
+		const long long square = static_cast<long long>(std::floor(point.x() / patternSize)) +
+			static_cast<long long>(std::floor(point.y() / patternSize)) + static_cast<long long>(std::floor(point.z() / patternSize));
+		const double shade = (square % 2 == 0) ? 1 : 0.6;
+		for (int i = 0; i < 3; i++)
+		{
+			rgb[i] = static_cast<unsigned char>(shade * 127.5 * (std::max(-1.0, std::min(1.0, normal[i])) + 1));
+		}
+	}
+
+	std::string getImageName(size_t index)
+	{
+		std::stringstream name;
+		name << "image_";
+		name.width(6);
+		name.fill('0');
+		name << index + 1 << ".jpg";
+		return name.str();
+	}
+
+	const char* getRigName(Synthetic::Rig rig)
+	{
+		switch (rig)
+		{
+		case Synthetic::NadirGrid:
+			return "nadir";
+		case Synthetic::Corridor:
+			return "corridor";
+		default:
+			return "orbit";
+		}
+	}
+
+	// Placeholder image of a camera: a gradient with its index, so each file differs
+	bool writeImage(const Synthetic::Options& options, size_t index, const std::string& path)
+	{
+		wxImage image(options.width, options.height);
+		unsigned char* data = image.GetData();
+		const unsigned char shade = static_cast<unsigned char>(index * 37 % 256);
+		for (unsigned int y = 0; y < options.height; y++)
+		{
+			for (unsigned int x = 0; x < options.width; x++)
+			{
+				unsigned char* pixel = data + 3 * (static_cast<size_t>(y) * options.width + x);
+				pixel[0] = static_cast<unsigned char>(255 * x / options.width);
+				pixel[1] = static_cast<unsigned char>(255 * y / options.height);
+				pixel[2] = shade;
+			}
+		}
+		return image.SaveFile(path, wxBITMAP_TYPE_JPEG);
+	}
+}
+
+std::string Synthetic::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Rig " << getRigName(rig) << "\n" <<
+		"Images " << numImages << "\n" <<
+		"Size " << width << "x" << height << "\n" <<
+		"Sparse points per image " << sparsePointsPerImage << "\n" <<
+		"Dense points " << densePoints << "\n" <<
+		"Noise " << noise << "\n" <<
+		"Outlier ratio " << outlierRatio << "\n" <<
+		"Mesh faces " << meshFaces << "\n" <<
+		"Write images " << writeImages << "\n" <<
+		"Transform " << transform << "\n" <<
+		"Seed " << seed << "\n";
+	return parameters.str();
+}
+
+bool SyntheticDataset::generate(const Synthetic::Options& options, const std::string& directory)
+{
+	Tracer::Span span("Synthetic dataset", "native", directory);
+	const std::string sparsePath = directory + "/sparse";
+	const std::string imagesPath = directory + "/images";
+	if (!wxFileName::Mkdir(sparsePath, 0777, wxPATH_MKDIR_FULL) || !wxFileName::Mkdir(imagesPath, 0777, wxPATH_MKDIR_FULL))
+	{
+		wxLogError(wxString("Could not create the folders of the synthetic dataset in " + directory));
+		return 0;
+	}
+	ColmapModel model = createModel(options);
+	const Synthetic::Similarity similarity = createSimilarity(options);
+	nlohmann::json groundTruth;
+	groundTruth["rig"] = getRigName(options.rig);
+	groundTruth["seed"] = options.seed;
+	groundTruth["transform"]["description"] = "reconstruction = scale * rotation * scene + translation, the scene in meters";
+	groundTruth["transform"]["scale"] = similarity.scale;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			groundTruth["transform"]["rotation"].push_back(similarity.rotation(i, j));
+		}
+		groundTruth["transform"]["translation"].push_back(similarity.translation[i]);
+	}
+	for (const auto& image : model.images)
+	{
+		const Eigen::Vector3d center = ColmapModel::getCameraCenter(image.second);
+		groundTruth["images"].push_back({ { "name", image.second.name }, { "center", { center.x(), center.y(), center.z() } } });
+	}
+	groundTruth["sparsePoints"] = model.points3D.size();
+	model.transform(similarity.scale, similarity.rotation, similarity.translation);
+	if (!model.write(sparsePath))
+	{
+		wxLogError(wxString("Could not write the synthetic model to " + sparsePath));
+		return 0;
+	}
+	if (options.writeImages)
+	{
+		for (const auto& image : model.images)
+		{
+			if (!writeImage(options, image.first - 1, imagesPath + "/" + image.second.name))
+			{
+				wxLogError(wxString("Could not write the synthetic image " + image.second.name));
+				return 0;
+			}
+		}
+	}
+	std::vector<Camera*> cameras;
+	if (!ImageIO::loadCOLMAPModel(sparsePath, imagesPath, cameras))
+	{
+		wxLogError(wxString("Could not read the synthetic model of " + sparsePath));
+		return 0;
+	}
+	const bool camerasSaved = ImageIO::saveCameras(directory + "/cameras.nvm", cameras) &&
+		ImageIO::saveCameras(directory + "/cameras.sfm", cameras) &&
+		ImageIO::saveCameraBundle(directory + "/cameras.scb", cameras);
+	for (auto camera : cameras)
+	{
+		delete camera;
+	}
+	if (!camerasSaved)
+	{
+		wxLogError(wxString("Could not write the synthetic cameras to " + directory));
+		return 0;
+	}
+	if (!writePointCloud(options, similarity, directory + "/dense.ply") || !writeMesh(options, similarity, directory + "/mesh.ply"))
+	{
+		return 0;
+	}
+	groundTruth["densePoints"] = options.densePoints;
+	groundTruth["meshFaces"] = Scene(options).getGrid(options.meshFaces).getNumFaces();
+	std::ofstream groundTruthFile(directory + "/ground_truth.json");
+	if (!groundTruthFile.is_open())
+	{
+		wxLogError(wxString("Could not write " + directory + "/ground_truth.json"));
+		return 0;
+	}
+	groundTruthFile << groundTruth.dump(1, '\t');
+	wxLogMessage(wxString("Synthetic dataset of " + std::to_string(model.images.size()) + " images, " +
+		std::to_string(model.points3D.size()) + " sparse points and " + std::to_string(options.densePoints) +
+		" dense points written to " + directory));
+	return 1;
+}
+
+bool SyntheticDataset::parseArguments(const std::vector<std::string>& arguments, Synthetic::Options& options)
+{
+	for (size_t i = 0; i < arguments.size(); i++)
+	{
+		const std::string& name = arguments[i];
+		//Flags
+		if (name == "--write-images")
+		{
+			options.writeImages = true;
+			continue;
+		}
+		if (name == "--no-transform")
+		{
+			options.transform = false;
+			continue;
+		}
+		if (i + 1 >= arguments.size())
+		{
+			wxLogError(wxString("Missing the value of the synthetic dataset option " + name));
+			return 0;
+		}
+		const std::string& value = arguments[++i];
+		try
+		{
+			if (name == "--rig")
+			{
+				const auto rig = Utils::toUpper(value);
+				if (rig == "ORBIT")
+				{
+					options.rig = Synthetic::Orbit;
+				}
+				else if (rig == "NADIR")
+				{
+					options.rig = Synthetic::NadirGrid;
+				}
+				else if (rig == "CORRIDOR")
+				{
+					options.rig = Synthetic::Corridor;
+				}
+				else
+				{
+					wxLogError(wxString("Unknown synthetic rig " + value + ", use orbit, nadir or corridor"));
+					return 0;
+				}
+			}
+			else if (name == "--images")
+			{
+				options.numImages = std::stoi(value);
+			}
+			else if (name == "--size")
+			{
+				const size_t separator = Utils::toUpper(value).find('X');
+				if (separator == std::string::npos)
+				{
+					wxLogError(wxString("Invalid synthetic image size " + value + ", use WxH"));
+					return 0;
+				}
+				options.width = static_cast<unsigned int>(std::stoul(value.substr(0, separator)));
+				options.height = static_cast<unsigned int>(std::stoul(value.substr(separator + 1)));
+			}
+			else if (name == "--sparse-points")
+			{
+				options.sparsePointsPerImage = std::stoi(value);
+			}
+			else if (name == "--dense-points")
+			{
+				options.densePoints = static_cast<size_t>(std::stoull(value));
+			}
+			else if (name == "--noise")
+			{
+				options.noise = std::stod(value);
+			}
+			else if (name == "--outliers")
+			{
+				options.outlierRatio = std::stod(value);
+			}
+			else if (name == "--mesh-faces")
+			{
+				options.meshFaces = static_cast<size_t>(std::stoull(value));
+			}
+			else if (name == "--seed")
+			{
+				options.seed = static_cast<unsigned int>(std::stoul(value));
+			}
+			else
+			{
+				wxLogError(wxString("Unknown synthetic dataset option " + name));
+				return 0;
+			}
+		}
+		catch (const std::exception&)
+		{
+			wxLogError(wxString("Invalid value " + value + " of the synthetic dataset option " + name));
+			return 0;
+		}
+	}
+	if (options.numImages < 2 || options.width == 0 || options.height == 0 || options.noise < 0 ||
+		options.outlierRatio < 0 || options.outlierRatio > 1)
+	{
+		wxLogError("The synthetic dataset needs at least 2 images, a valid size, a positive noise and an outlier ratio in [0, 1]");
+		return 0;
+	}
+	return 1;
+}
+
+Synthetic::Similarity SyntheticDataset::createSimilarity(const Synthetic::Options& options)
+{
+	Synthetic::Similarity similarity;
+	if (!options.transform)
+	{
+		return similarity;
+	}
+	//Its own stream, so the other options don't change it
+	std::mt19937 random(options.seed ^ 0x5eed5eedu);
+	std::uniform_real_distribution<double> logScale(std::log(0.1), std::log(10.0));
+	std::normal_distribution<double> gaussian(0, 1);
+	similarity.scale = std::exp(logScale(random));
+	Eigen::Quaterniond rotation(gaussian(random), gaussian(random), gaussian(random), gaussian(random));
+	rotation.normalize();
+	similarity.rotation = rotation.toRotationMatrix();
+	similarity.translation = 100 * Eigen::Vector3d(gaussian(random), gaussian(random), gaussian(random));
+	return similarity;
+}
+
+ColmapModel SyntheticDataset::createModel(const Synthetic::Options& options)
+{
+	const Scene scene(options);
+	const size_t numImages = scene.getNumImages();
+	ColmapModel model;
+	ColmapModel::Intrinsics intrinsics;
+	intrinsics.cameraId = 1;
+	intrinsics.modelId = 1;
+	intrinsics.width = options.width;
+	intrinsics.height = options.height;
+	const double focal = options.width;
+	intrinsics.params = { focal, focal, options.width / 2.0, options.height / 2.0 };
+	model.cameras[1] = intrinsics;
+	std::vector<Eigen::Vector3d> centers(numImages);
+	std::vector<Eigen::Matrix4d> poses(numImages);
+	for (size_t i = 0; i < numImages; i++)
+	{
+		ColmapModel::Image image;
+		image.imageId = static_cast<uint32_t>(i + 1);
+		image.cameraId = 1;
+		image.name = getImageName(i);
+		poses[i] = scene.getPose(i);
+		centers[i] = scene.getCenter(i);
+		ColmapModel::setMatrixRt(image, poses[i]);
+		model.images[image.imageId] = image;
+	}
+	//Points of the surface with the nearest cameras in front of them that see them
+	const SpatialIndex cameraIndex(centers, scene.getCameraCellSize());
+	std::mt19937 random(options.seed);
+	const size_t numPoints = static_cast<size_t>(std::max(options.sparsePointsPerImage, 0)) * numImages;
+	uint64_t nextPointId = 1;
+	for (size_t p = 0; p < numPoints; p++)
+	{
+		Eigen::Vector3d point, normal;
+		scene.sample(random, point, normal);
+		std::vector<std::pair<uint32_t, ColmapModel::Point2D>> observations;
+		for (const size_t index : cameraIndex.knn(point, std::min(trackCandidates, numImages)))
+		{
+			const Eigen::Vector3d cameraPoint = poses[index].block<3, 3>(0, 0) * point + poses[index].block<3, 1>(0, 3);
+			if (cameraPoint.z() <= 0 || (centers[index] - point).dot(normal) <= 0)
+			{
+				continue;
+			}
+			ColmapModel::Point2D observation;
+			observation.x = focal * cameraPoint.x() / cameraPoint.z() + options.width / 2.0;
+			observation.y = focal * cameraPoint.y() / cameraPoint.z() + options.height / 2.0;
+			if (observation.x < 0 || observation.y < 0 || observation.x >= options.width || observation.y >= options.height)
+			{
+				continue;
+			}
+			observation.point3DId = static_cast<int64_t>(nextPointId);
+			observations.emplace_back(static_cast<uint32_t>(index + 1), observation);
+			if (observations.size() == maxTrackLength)
+			{
+				break;
+			}
+		}
+		if (observations.size() < 2)
+		{
+			continue;
+		}
+		ColmapModel::Point3D point3D;
+		for (int i = 0; i < 3; i++)
+		{
+			point3D.xyz[i] = point[i];
+		}
+		getColor(point, normal, point3D.rgb);
+		point3D.error = 0.5;
+		for (const auto& observation : observations)
+		{
+			auto& points2D = model.images[observation.first].points2D;
+			points2D.emplace_back(observation.second);
+			point3D.track.push_back({ observation.first, static_cast<uint32_t>(points2D.size() - 1) });
+		}
+		model.points3D[nextPointId++] = point3D;
+	}
+	return model;
+}
+
+void SyntheticDataset::createPoints(const Synthetic::Options& options, size_t count, uint64_t stream, std::vector<float>& positions,
+	std::vector<float>& normals, std::vector<unsigned char>& colors)
+{
+	const Scene scene(options);
+	Eigen::Vector3d min, max;
+	scene.getBounds(min, max);
+	std::seed_seq seeds = { options.seed, static_cast<unsigned int>(stream), static_cast<unsigned int>(stream >> 32) };
+	std::mt19937 random(seeds);
+	std::uniform_real_distribution<double> uniform(0, 1);
+	std::normal_distribution<double> gaussian(0, 1);
+	positions.resize(3 * count);
+	normals.resize(3 * count);
+	colors.resize(3 * count);
+	for (size_t i = 0; i < count; i++)
+	{
+		Eigen::Vector3d point, normal;
+		if (uniform(random) < options.outlierRatio)
+		{
+			point = min + (max - min).cwiseProduct(Eigen::Vector3d(uniform(random), uniform(random), uniform(random)));
+			normal = Eigen::Vector3d(gaussian(random), gaussian(random), gaussian(random));
+			normal = (normal.squaredNorm() > 0) ? normal.normalized() : Eigen::Vector3d::UnitZ();
+		}
+		else
+		{
+			scene.sample(random, point, normal);
+			point += options.noise * gaussian(random) * normal;
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			positions[3 * i + c] = static_cast<float>(point[c]);
+			normals[3 * i + c] = static_cast<float>(normal[c]);
+		}
+		getColor(point, normal, &colors[3 * i]);
+	}
+}
+
+void SyntheticDataset::createMesh(const Synthetic::Options& options, std::vector<float>& positions, std::vector<uint32_t>& triangles)
+{
+	const Scene scene(options);
+	const Grid grid = scene.getGrid(options.meshFaces);
+	positions.clear();
+	triangles.clear();
+	positions.reserve(3 * grid.getNumVertices());
+	triangles.reserve(3 * grid.getNumFaces());
+	for (size_t row = 0; row < grid.rows; row++)
+	{
+		for (size_t col = 0; col < grid.cols; col++)
+		{
+			const Eigen::Vector3d vertex = scene.getGridVertex(grid, row, col);
+			positions.insert(positions.end(), { static_cast<float>(vertex.x()), static_cast<float>(vertex.y()), static_cast<float>(vertex.z()) });
+		}
+	}
+	std::vector<uint32_t> rowTriangles;
+	for (size_t row = 0; row + 1 < grid.rows; row++)
+	{
+		getRowTriangles(grid, row, rowTriangles);
+		triangles.insert(triangles.end(), rowTriangles.begin(), rowTriangles.end());
+	}
+}
+
+bool SyntheticDataset::writePointCloud(const Synthetic::Options& options, const Synthetic::Similarity& similarity, const std::string& path)
+{
+	Tracer::Span span("Synthetic point cloud", "native", path);
+	PlyIO::StreamWriter writer;
+	if (!writer.open(path, true, true))
+	{
+		return 0;
+	}
+	const Eigen::Matrix3f rotation = similarity.rotation.cast<float>();
+	const Eigen::Matrix3f scaledRotation = static_cast<float>(similarity.scale) * rotation;
+	const Eigen::Vector3f translation = similarity.translation.cast<float>();
+	const size_t numChunks = (options.densePoints + chunkSize - 1) / chunkSize;
+	//A batch of chunks is created in parallel and appended in order, so the file doesn't depend on the threads
+	const size_t batchSize = static_cast<size_t>(std::max(omp_get_max_threads(), 1));
+	for (size_t batchStart = 0; batchStart < numChunks; batchStart += batchSize)
+	{
+		const int batchCount = static_cast<int>(std::min(batchSize, numChunks - batchStart));
+		std::vector<std::vector<float>> positions(batchCount), normals(batchCount);
+		std::vector<std::vector<unsigned char>> colors(batchCount);
+#pragma omp parallel for
+		for (int b = 0; b < batchCount; b++)
+		{
+			const size_t chunk = batchStart + b;
+			const size_t count = std::min(chunkSize, options.densePoints - chunk * chunkSize);
+			createPoints(options, count, chunk, positions[b], normals[b], colors[b]);
+			for (size_t i = 0; i < count; i++)
+			{
+				Eigen::Map<Eigen::Vector3f> position(&positions[b][3 * i]);
+				Eigen::Map<Eigen::Vector3f> normal(&normals[b][3 * i]);
+				position = scaledRotation * position + translation;
+				normal = rotation * normal;
+			}
+		}
+		for (int b = 0; b < batchCount; b++)
+		{
+			if (!writer.append(positions[b], normals[b], colors[b]))
+			{
+				return 0;
+			}
+		}
+	}
+	return writer.close();
+}
+
+bool SyntheticDataset::writeMesh(const Synthetic::Options& options, const Synthetic::Similarity& similarity, const std::string& path)
+{
+	Tracer::Span span("Synthetic mesh", "native", path);
+	const Scene scene(options);
+	const Grid grid = scene.getGrid(options.meshFaces);
+	if (grid.getNumVertices() > std::numeric_limits<uint32_t>::max())
+	{
+		wxLogError(wxString("The synthetic mesh of " + std::to_string(options.meshFaces) + " faces has too many vertices for 32 bits indices"));
+		return 0;
+	}
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		wxLogError(wxString("Could not write " + path));
+		return 0;
+	}
+	//Rows of vertices and then of faces, the sizes are known from the grid
+	file << PlyIO::getHeader(grid.getNumVertices(), grid.getNumFaces(), false, false);
+	std::vector<float> rowVertices(3 * grid.cols);
+	for (size_t row = 0; row < grid.rows; row++)
+	{
+		for (size_t col = 0; col < grid.cols; col++)
+		{
+			const Eigen::Vector3d vertex = similarity.apply(scene.getGridVertex(grid, row, col));
+			for (int c = 0; c < 3; c++)
+			{
+				rowVertices[3 * col + c] = static_cast<float>(vertex[c]);
+			}
+		}
+		file.write(reinterpret_cast<const char*>(rowVertices.data()), rowVertices.size() * sizeof(float));
+	}
+	const size_t faceSize = sizeof(unsigned char) + 3 * sizeof(uint32_t);
+	std::vector<uint32_t> rowTriangles;
+	std::vector<char> rowFaces;
+	for (size_t row = 0; row + 1 < grid.rows; row++)
+	{
+		getRowTriangles(grid, row, rowTriangles);
+		const size_t numFaces = rowTriangles.size() / 3;
+		rowFaces.resize(numFaces * faceSize);
+		for (size_t f = 0; f < numFaces; f++)
+		{
+			char* face = &rowFaces[f * faceSize];
+			face[0] = 3;
+			std::copy(reinterpret_cast<const char*>(&rowTriangles[3 * f]), reinterpret_cast<const char*>(&rowTriangles[3 * f + 3]), face + 1);
+		}
+		file.write(rowFaces.data(), rowFaces.size());
+	}
+	if (!file.good())
+	{
+		wxLogError(wxString("Could not write " + path));
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+#include "ColmapModel.h"
+
+namespace Synthetic
+{
+	enum Rig
+	{
+		// Cameras on a circle around a sphere, looking at its center
+		Orbit,
+		// Cameras looking down on a terrain in a lawnmower grid of 80% forward and 60% side overlap
+		NadirGrid,
+		// Cameras walking along a corridor and looking ahead, the walls, floor and ceiling around them
+		Corridor
+	};
+
+	struct Options
+	{
+		Options() {};
+		Rig rig = Orbit;
+		int numImages = 100;
+		unsigned int width = 1600;
+		unsigned int height = 1200;
+		int sparsePointsPerImage = 500;
+		size_t densePoints = 2000000;
+		// Standard deviation along the normal of the dense points, in meters of the scene
+		double noise = 0.01;
+		// Fraction of the dense points spread over the bounding box of the scene
+		double outlierRatio = 0;
+		size_t meshFaces = 2000000;
+		// Placeholder images, so the dataset is also a project folder
+		bool writeImages = false;
+		// Moves the outputs from the scene, in meters, by a random similarity like the arbitrary frame of a
+		// reconstruction. The ground truth keeps the similarity and the cameras in meters
+		bool transform = true;
+		unsigned int seed = 1;
+
+		std::string print() const;
+	};
+
+	// reconstruction = scale * rotation * scene + translation
+	struct Similarity
+	{
+		double scale = 1;
+		Eigen::Matrix3d rotation = Eigen::Matrix3d::Identity();
+		Eigen::Vector3d translation = Eigen::Vector3d::Zero();
+
+		Eigen::Vector3d apply(const Eigen::Vector3d& point) const { return scale * rotation * point + translation; };
+	};
+}
+
+// Synthetic inputs for the correctness tests and benchmarks of the native components, at any scale. A dataset has
+// the cameras of a rig as a COLMAP binary model (sparse/) with the points seen by them and their tracks, the same
+// cameras as NVM, SFM and camera bundle, a dense point cloud with noise and outliers, a mesh of the scene and
+// ground_truth.json with the similarity from the scene and the camera centers in meters. The point cloud and the
+// mesh are streamed to the disk, so they can have hundreds of millions of elements. The same options give the
+// same files.
+class SyntheticDataset
+{
+public:
+	static bool generate(const Synthetic::Options& options, const std::string& directory);
+	// Options of the command line (--rig orbit|nadir|corridor, --images, --size WxH, --sparse-points, --dense-points,
+	// --noise, --outliers, --mesh-faces, --write-images, --no-transform, --seed), false on an unknown or invalid one
+	static bool parseArguments(const std::vector<std::string>& arguments, Synthetic::Options& options);
+
+	// Parts of a dataset in memory, for the tests and benchmarks that don't need the files
+	static Synthetic::Similarity createSimilarity(const Synthetic::Options& options);
+	// Cameras of the rig and the sparse points with their tracks, in the frame of the scene
+	static ColmapModel createModel(const Synthetic::Options& options);
+	// count points of the scene, xyz interleaved, with the noise and outliers of the options
+	static void createPoints(const Synthetic::Options& options, size_t count, uint64_t stream, std::vector<float>& positions,
+		std::vector<float>& normals, std::vector<unsigned char>& colors);
+	static void createMesh(const Synthetic::Options& options, std::vector<float>& positions, std::vector<uint32_t>& triangles);
+
+	static bool writePointCloud(const Synthetic::Options& options, const Synthetic::Similarity& similarity, const std::string& path);
+	static bool writeMesh(const Synthetic::Options& options, const Synthetic::Similarity& similarity, const std::string& path);
+};
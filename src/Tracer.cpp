@@ -0,0 +1,218 @@
+#include "Tracer.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <algorithm>
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <wx/log.h>
+
+#include "json.hpp"
+
+namespace
+{
+	std::mutex traceMutex;
+	bool running = false;
+	std::string path;
+	std::chrono::steady_clock::time_point origin;
+	std::vector<nlohmann::json> events;
+	std::map<std::thread::id, int> threadIds;
+
+	std::thread sampler;
+	std::condition_variable samplerWakeUp;
+	bool samplerStop = false;
+
+	uint64_t toTicks(const FILETIME& time)
+	{
+		return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	}
+
+	//Small ids in the order the threads are seen, 1 is the thread that started the trace. Needs traceMutex
+	int getThreadId()
+	{
+		const auto id = std::this_thread::get_id();
+		const auto it = threadIds.find(id);
+		if (it != threadIds.end())
+		{
+			return it->second;
+		}
+		const int threadId = static_cast<int>(threadIds.size()) + 1;
+		threadIds[id] = threadId;
+		return threadId;
+	}
+
+	int64_t getMicroseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+	}
+
+	//Memory in MB and CPU in percent of the machine, of this process and of the whole system (the external tools included)
+	void sample(int interval)
+	{
+		uint64_t lastProcess = 0, lastBusy = 0, lastTotal = 0;
+		std::unique_lock<std::mutex> lock(traceMutex);
+		while (!samplerStop)
+		{
+			lock.unlock();
+			nlohmann::json memory, cpu;
+			PROCESS_MEMORY_COUNTERS memoryCounters;
+			if (GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters)))
+			{
+				memory["processWorkingSet"] = memoryCounters.WorkingSetSize / (1024 * 1024);
+			}
+			MEMORYSTATUSEX memoryStatus;
+			memoryStatus.dwLength = sizeof(memoryStatus);
+			if (GlobalMemoryStatusEx(&memoryStatus))
+			{
+				memory["systemUsed"] = (memoryStatus.ullTotalPhys - memoryStatus.ullAvailPhys) / (1024 * 1024);
+			}
+			FILETIME idleTime, kernelTime, userTime, creationTime, exitTime, processKernelTime, processUserTime;
+			if (GetSystemTimes(&idleTime, &kernelTime, &userTime) &&
+				GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &processKernelTime, &processUserTime))
+			{
+				//The system kernel time includes the idle time
+				const uint64_t total = toTicks(kernelTime) + toTicks(userTime);
+				const uint64_t busy = total - toTicks(idleTime);
+				const uint64_t process = toTicks(processKernelTime) + toTicks(processUserTime);
+				if (lastTotal > 0 && total > lastTotal)
+				{
+					cpu["process"] = 100.0 * (process - lastProcess) / (total - lastTotal);
+					cpu["system"] = 100.0 * (busy - lastBusy) / (total - lastTotal);
+				}
+				lastProcess = process;
+				lastBusy = busy;
+				lastTotal = total;
+			}
+			lock.lock();
+			const auto timestamp = getMicroseconds();
+			if (!memory.empty())
+			{
+				events.push_back({ { "ph", "C" }, { "name", "Memory (MB)" }, { "pid", 1 }, { "ts", timestamp }, { "args", memory } });
+			}
+			if (!cpu.empty())
+			{
+				events.push_back({ { "ph", "C" }, { "name", "CPU (%)" }, { "pid", 1 }, { "ts", timestamp }, { "args", cpu } });
+			}
+			samplerWakeUp.wait_for(lock, std::chrono::milliseconds(interval), []() { return samplerStop; });
+		}
+	}
+}
+
+std::string Trace::Options::print() const
+{
+	std::stringstream parameters;
+	parameters << "Enabled " << enabled << "\n" <<
+		"Counter interval " << counterInterval << "\n";
+	return parameters.str();
+}
+
+Tracer::Span::Span(const std::string& name, const std::string& category, const std::string& detail) :
+	name(name), category(category), detail(detail), start(Tracer::now())
+{
+}
+
+Tracer::Span::~Span()
+{
+	if (start >= 0)
+	{
+		Tracer::addSpan(name, category, start, Tracer::now(), detail);
+	}
+}
+
+bool Tracer::start(const std::string& tracePath, const Trace::Options& options)
+{
+	stop();
+	if (!options.enabled)
+	{
+		return 1;
+	}
+	std::lock_guard<std::mutex> lock(traceMutex);
+	path = tracePath;
+	origin = std::chrono::steady_clock::now();
+	events.clear();
+	threadIds.clear();
+	getThreadId();
+	running = true;
+	samplerStop = false;
+	sampler = std::thread(sample, std::max(options.counterInterval, 10));
+	return 1;
+}
+
+bool Tracer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(traceMutex);
+		if (!running)
+		{
+			return 1;
+		}
+		running = false;
+		samplerStop = true;
+	}
+	samplerWakeUp.notify_all();
+	sampler.join();
+	std::lock_guard<std::mutex> lock(traceMutex);
+	nlohmann::json trace;
+	trace["displayTimeUnit"] = "ms";
+	trace["traceEvents"] = nlohmann::json::array();
+	trace["traceEvents"].push_back({ { "ph", "M" }, { "name", "process_name" }, { "pid", 1 }, { "args", { { "name", "SaeScan3D" } } } });
+	for (const auto& thread : threadIds)
+	{
+		const std::string threadName = thread.second == 1 ? "Main" : "Thread " + std::to_string(thread.second);
+		trace["traceEvents"].push_back({ { "ph", "M" }, { "name", "thread_name" }, { "pid", 1 }, { "tid", thread.second },
+			{ "args", { { "name", threadName } } } });
+	}
+	for (auto& event : events)
+	{
+		trace["traceEvents"].push_back(std::move(event));
+	}
+	events.clear();
+	std::ofstream traceFile(path);
+	if (!traceFile.is_open())
+	{
+		wxLogWarning(wxString("Could not write the trace " + path));
+		return 0;
+	}
+	traceFile << trace.dump();
+	return 1;
+}
+
+bool Tracer::isRunning()
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+	return running;
+}
+
+int64_t Tracer::now()
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+	if (!running)
+	{
+		return -1;
+	}
+	return getMicroseconds();
+}
+
+void Tracer::addSpan(const std::string& name, const std::string& category, int64_t start, int64_t end, const std::string& detail)
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+	if (!running || start < 0)
+	{
+		return;
+	}
+	nlohmann::json event = { { "ph", "X" }, { "name", name }, { "cat", category }, { "pid", 1 }, { "tid", getThreadId() },
+		{ "ts", start }, { "dur", std::max<int64_t>(end - start, 0) } };
+	if (!detail.empty())
+	{
+		event["args"] = { { "detail", detail } };
+	}
+	events.push_back(std::move(event));
+}
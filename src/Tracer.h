@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace Trace
+{
+	struct Options
+	{
+		Options() {};
+		Options(bool enabled, int counterInterval) : enabled(enabled), counterInterval(counterInterval) {};
+		// Write trace.json in the project folder
+		bool enabled = true;
+		// Milliseconds between the memory and CPU samples
+		int counterInterval = 500;
+
+		std::string print() const;
+	};
+}
+
+// Timeline of a reconstruction in the trace event format of chrome://tracing and Perfetto: spans of the stages,
+// external processes and native steps in the thread that ran them, and counters of memory and CPU sampled by a thread.
+// The events are kept in memory and written by stop(). Every call is thread safe and does nothing while stopped.
+class Tracer
+{
+public:
+	// Span from the construction to the destruction, in the calling thread
+	class Span
+	{
+	public:
+		Span(const std::string& name, const std::string& category, const std::string& detail = "");
+		~Span();
+
+	private:
+		std::string name;
+		std::string category;
+		std::string detail;
+		int64_t start;
+	};
+
+	static bool start(const std::string& tracePath, const Trace::Options& options);
+	// Stops the sampling and writes the trace, the spans still open are lost
+	static bool stop();
+	static bool isRunning();
+
+	// Microseconds since start
+	static int64_t now();
+	static void addSpan(const std::string& name, const std::string& category, int64_t start, int64_t end, const std::string& detail = "");
+};
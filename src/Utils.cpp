@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <sstream>
+#include <mutex>
+#include <thread>
 //#include <Windows.h>
 
 #include <wx/log.h>
@@ -10,6 +12,174 @@
 #include <wx/msgdlg.h>
 #include <wx/filedlg.h>
 
+#include "StageTelemetry.h"
+#include "Tracer.h"
+#include "ProgressModel.h"
+#include "ProcessLimits.h"
+#include "Cancellation.h"
+
+namespace
+{
+	std::mutex createProcessMutex;
+
+	// Executable of a command line, with the first argument for the .bat wrappers (e.g. COLMAP.bat feature_extractor)
+	std::string getProcessName(const std::string& command)
+	{
+		std::stringstream stream(command);
+		std::string executable, argument;
+		if (!command.empty() && command[0] == '"')
+		{
+			stream.get();
+			std::getline(stream, executable, '"');
+		}
+		else
+		{
+			stream >> executable;
+		}
+		std::string name = Utils::getFileName(executable);
+		if (Utils::toUpper(Utils::getFileExtension(name)) == "BAT" && stream >> argument)
+		{
+			name += " " + argument;
+		}
+		return name;
+	}
+
+	// Passes the output of a child to the progress model line by line until every process holding the pipe exits,
+	// the progress bars of the tools rewrite their line with \r so it also ends a line
+	void readOutput(HANDLE output, const std::string& processName)
+	{
+		std::string line;
+		char buffer[4096];
+		DWORD numRead = 0;
+		while (ReadFile(output, buffer, sizeof(buffer), &numRead, NULL) && numRead > 0)
+		{
+			for (DWORD i = 0; i < numRead; i++)
+			{
+				if (buffer[i] != '\n' && buffer[i] != '\r')
+				{
+					line += buffer[i];
+				}
+				else if (!line.empty())
+				{
+					ProgressModel::processOutput(processName, line);
+					line.clear();
+				}
+			}
+		}
+		if (!line.empty())
+		{
+			ProgressModel::processOutput(processName, line);
+		}
+	}
+
+	// Runs a child created suspended in its own job object, so the processes it starts are accounted and limited
+	// with it, and adds the CPU, I/O and memory of the job to the stage telemetry once it exits. The job goes with
+	// every process in it when the reconstruction is cancelled, false then
+	bool waitAccounted(PROCESS_INFORMATION& pi, const std::string& command, HANDLE output, DWORD* exitCode)
+	{
+		const std::string processName = getProcessName(command);
+		Tracer::Span span(processName, "process", command);
+		HANDLE job = CreateJobObject(NULL, NULL);
+		if (job != NULL && !AssignProcessToJobObject(job, pi.hProcess))
+		{
+			CloseHandle(job);
+			job = NULL;
+		}
+		//Priority, and the processors and memory of the stage in a queued job, before the child runs
+		if (job != NULL)
+		{
+			ProcessLimits::apply(job, ProcessLimits::getCurrentPlan());
+		}
+		ProgressModel::processStarted(processName);
+		ResumeThread(pi.hThread);
+		std::thread reader(readOutput, output, processName);
+
+		// Wait until child process exits.
+		const bool completed = Cancellation::wait(pi.hProcess, job);
+		reader.join();
+		CloseHandle(output);
+		ProgressModel::processFinished(processName);
+		if (!completed)
+		{
+			wxLogError("%s terminated: %s", processName, Cancellation::getReason());
+		}
+		if (exitCode != NULL && !GetExitCodeProcess(pi.hProcess, exitCode))
+		{
+			*exitCode = 1;
+		}
+
+		if (job != NULL)
+		{
+			StageTelemetry::addChildUsage(StageTelemetry::getJobUsage(job));
+			CloseHandle(job);
+		}
+		// Close process and thread handles. 
+		CloseHandle(pi.hProcess);
+		CloseHandle(pi.hThread);
+		return completed;
+	}
+
+	// Creates the child suspended with its stdout and stderr in a pipe. The write end is only inheritable while the
+	// child is created, so the children of other threads do not keep the pipe open
+	int createProcess(const std::string& command, const std::string& workingDirectory, DWORD* exitCode)
+	{
+		if (Cancellation::isCancelled())
+		{
+			return 0;
+		}
+		std::wstring stemp = Utils::s2ws(command);
+		LPWSTR path_command = const_cast<LPWSTR>(stemp.c_str());
+		std::wstring stemp2 = Utils::s2ws(workingDirectory);
+		LPCWSTR working_dir = workingDirectory.empty() ? NULL : stemp2.c_str();
+
+		STARTUPINFO si;
+		PROCESS_INFORMATION pi;
+
+		ZeroMemory(&si, sizeof(si));
+		si.cb = sizeof(si);
+		ZeroMemory(&pi, sizeof(pi));
+
+		SECURITY_ATTRIBUTES security;
+		security.nLength = sizeof(security);
+		security.lpSecurityDescriptor = NULL;
+		security.bInheritHandle = FALSE;
+		HANDLE outputRead = NULL, outputWrite = NULL;
+		{
+			std::lock_guard<std::mutex> lock(createProcessMutex);
+			if (!CreatePipe(&outputRead, &outputWrite, &security, 0))
+			{
+				wxLogError("CreatePipe failed (%d).\n", GetLastError());
+				return 0;
+			}
+			SetHandleInformation(outputWrite, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
+			si.dwFlags = STARTF_USESTDHANDLES;
+			si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+			si.hStdOutput = outputWrite;
+			si.hStdError = outputWrite;
+
+			// Start the child process. 
+			const BOOL created = CreateProcess(NULL,   // No module name (use command line)
+				path_command,        // Command line
+				NULL,           // Process handle not inheritable
+				NULL,           // Thread handle not inheritable
+				TRUE,           // Inherits the output pipe
+				CREATE_SUSPENDED | CREATE_NO_WINDOW, // Resumed once in its job object, the output goes to the pipe
+				NULL,           // Use parent's environment block
+				working_dir,    // NULL uses the parent's starting directory
+				&si,            // Pointer to STARTUPINFO structure
+				&pi);           // Pointer to PROCESS_INFORMATION structure
+			CloseHandle(outputWrite);
+			if (!created)
+			{
+				wxLogError("CreateProcess failed (%d).\n", GetLastError());
+				CloseHandle(outputRead);
+				return 0;
+			}
+		}
+
+		return waitAccounted(pi, command, outputRead, exitCode);
+	}
+}
 
 Utils::Utils()
 {
@@ -33,80 +203,22 @@ std::wstring Utils::s2ws(const std::string & s)
 
 int Utils::startProcess(const std::string& path_with_command)
 {
-	std::wstring stemp = s2ws(path_with_command);
-	LPWSTR path_command = const_cast<LPWSTR>(stemp.c_str());
-
-	STARTUPINFO si;
-	PROCESS_INFORMATION pi;
-
-	ZeroMemory(&si, sizeof(si));
-	si.cb = sizeof(si);
-	ZeroMemory(&pi, sizeof(pi));
-
-	// Start the child process. 
-	if (!CreateProcess(NULL,   // No module name (use command line)
-		path_command,        // Command line
-		NULL,           // Process handle not inheritable
-		NULL,           // Thread handle not inheritable
-		FALSE,          // Set handle inheritance to FALSE
-		0,              // No creation flags
-		NULL,           // Use parent's environment block
-		NULL,           // Use parent's starting directory 
-		&si,            // Pointer to STARTUPINFO structure
-		&pi)           // Pointer to PROCESS_INFORMATION structure
-		)
-	{
-		wxLogError("CreateProcess failed (%d).\n", GetLastError());
-		return 0;
-	}
-
-	// Wait until child process exits.
-	WaitForSingleObject(pi.hProcess, INFINITE);
-
-	// Close process and thread handles. 
-	CloseHandle(pi.hProcess);
-	CloseHandle(pi.hThread);
-	return 1;
+	return createProcess(path_with_command, "", NULL);
 }
 
 int Utils::startProcess(const std::string& path_with_command, const std::string& workingDirectory)
 {
-	std::wstring stemp = s2ws(path_with_command);
-	LPWSTR path_command = const_cast<LPWSTR>(stemp.c_str());
-
-	std::wstring stemp2 = s2ws(workingDirectory);
-	LPCWSTR working_dir = stemp2.c_str();
+	return createProcess(path_with_command, workingDirectory, NULL);
+}
 
-	STARTUPINFO si;
-	PROCESS_INFORMATION pi;
-
-	ZeroMemory(&si, sizeof(si));
-	si.cb = sizeof(si);
-	ZeroMemory(&pi, sizeof(pi));
-
-	// Start the child process. 
-	if (!CreateProcess(NULL,   // No module name (use command line)
-		path_command,        // Command line
-		NULL,           // Process handle not inheritable
-		NULL,           // Thread handle not inheritable
-		FALSE,          // Set handle inheritance to FALSE
-		0,              // No creation flags
-		NULL,           // Use parent's environment block
-		working_dir,           // Use parent's starting directory 
-		&si,            // Pointer to STARTUPINFO structure
-		&pi)           // Pointer to PROCESS_INFORMATION structure
-		)
+int Utils::startProcess(const std::string& path_with_command, const std::string& workingDirectory, unsigned long& exitCode)
+{
+	DWORD code = 0;
+	if (!createProcess(path_with_command, workingDirectory, &code))
 	{
-		wxLogError("CreateProcess failed (%d).\n", GetLastError());
 		return 0;
 	}
-
-	// Wait until child process exits.
-	WaitForSingleObject(pi.hProcess, INFINITE);
-
-	// Close process and thread handles. 
-	CloseHandle(pi.hProcess);
-	CloseHandle(pi.hThread);
+	exitCode = code;
 	return 1;
 }
 
@@ -226,6 +338,11 @@ std::string Utils::toUpper(const std::string & str)
 
 bool Utils::CreateDir(const std::string & dirName)
 {
+	//Existing directories are kept, so a project can be processed again
+	if (wxDirExists(dirName))
+	{
+		return 1;
+	}
 	if (!wxMkdir(dirName))
 	{
 		wxLogError(wxString("Error creating the directory " + dirName));
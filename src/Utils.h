@@ -12,6 +12,8 @@ public:
 
 	static int startProcess(const std::string& path_with_command);
 	static int startProcess(const std::string& path_with_command, const std::string& workingDirectory);
+	//startProcess with the exit code of the child
+	static int startProcess(const std::string& path_with_command, const std::string& workingDirectory, unsigned long& exitCode);
 	//startProcess and ask for admin permission
 	static int startProcess(const std::string& path_exec, const std::string& parameters, const std::string& workingDirectory);
 
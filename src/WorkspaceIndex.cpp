@@ -0,0 +1,140 @@
+#include "WorkspaceIndex.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+
+#include <wx/dir.h>
+
+#include "Utils.h"
+#include "Tracer.h"
+
+namespace
+{
+	//FNV-1a 64 bits
+	class Hasher
+	{
+	public:
+		void add(const char* data, size_t size)
+		{
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= static_cast<unsigned char>(data[i]);
+				hash *= 1099511628211ULL;
+			}
+		}
+		void add(const std::string& text)
+		{
+			add(text.c_str(), text.size() + 1);
+		}
+		std::string get() const
+		{
+			std::stringstream result;
+			result << std::hex << std::setw(16) << std::setfill('0') << hash;
+			return result.str();
+		}
+
+	private:
+		uint64_t hash = 14695981039346656037ULL;
+	};
+}
+
+WorkspaceIndex::WorkspaceIndex(const std::string& indexPath) : indexPath(indexPath)
+{
+	std::ifstream indexFile(indexPath);
+	if (!indexFile.is_open())
+	{
+		return;
+	}
+	try
+	{
+		index = nlohmann::json::parse(indexFile);
+	}
+	catch (const std::exception&)
+	{
+		//A corrupted index only means nothing is reused
+		index = nlohmann::json();
+	}
+}
+
+bool WorkspaceIndex::isValid(const std::string& stage, const std::string& key) const
+{
+	if (!index.is_object() || !index.contains(stage) || !index[stage].is_string())
+	{
+		return 0;
+	}
+	return index[stage].get<std::string>() == key;
+}
+
+bool WorkspaceIndex::setValid(const std::string& stage, const std::string& key)
+{
+	index[stage] = key;
+	return save();
+}
+
+bool WorkspaceIndex::invalidate(const std::string& stage)
+{
+	if (!index.is_object() || !index.contains(stage))
+	{
+		return 1;
+	}
+	index.erase(stage);
+	return save();
+}
+
+std::string WorkspaceIndex::fingerprintFiles(const std::vector<std::string>& filePaths)
+{
+	Tracer::Span span("Fingerprint files", "io");
+	Hasher hasher;
+	std::vector<char> buffer(1 << 20);
+	for (const auto& filePath : filePaths)
+	{
+		hasher.add(Utils::getFileName(filePath));
+		std::ifstream file(filePath, std::ios::binary);
+		if (!file.is_open())
+		{
+			hasher.add("missing");
+			continue;
+		}
+		while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+		{
+			hasher.add(buffer.data(), static_cast<size_t>(file.gcount()));
+		}
+	}
+	return hasher.get();
+}
+
+std::string WorkspaceIndex::fingerprintDirectory(const std::string& dirPath)
+{
+	Tracer::Span span("Fingerprint directory", "io", dirPath);
+	wxArrayString files;
+	wxDir::GetAllFiles(dirPath, &files, wxEmptyString, wxDIR_FILES);
+	std::vector<std::string> sortedFiles;
+	for (const auto& file : files)
+	{
+		sortedFiles.emplace_back(file.ToStdString());
+	}
+	std::sort(sortedFiles.begin(), sortedFiles.end());
+	Hasher hasher;
+	for (const auto& file : sortedFiles)
+	{
+		wxStructStat fileStat;
+		wxStat(file, &fileStat);
+		hasher.add(Utils::getFileName(file));
+		hasher.add(std::to_string(fileStat.st_size) + " " + std::to_string(fileStat.st_mtime));
+	}
+	return hasher.get();
+}
+
+bool WorkspaceIndex::save() const
+{
+	std::ofstream indexFile(indexPath);
+	if (!indexFile.is_open())
+	{
+		return 0;
+	}
+	indexFile << index.dump(2);
+	return indexFile.good();
+}
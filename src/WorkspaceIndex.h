@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+// Index of the stages whose outputs in a workspace are valid, each one with the key
+// (parameters and input fingerprints) used to create them. Saved on every change.
+class WorkspaceIndex
+{
+public:
+	explicit WorkspaceIndex(const std::string& indexPath);
+
+	bool isValid(const std::string& stage, const std::string& key) const;
+	bool setValid(const std::string& stage, const std::string& key);
+	// Called before a stage rewrites its outputs, so an interrupted run isn't reused
+	bool invalidate(const std::string& stage);
+
+	// Hash of the contents of the files, missing files are part of it
+	static std::string fingerprintFiles(const std::vector<std::string>& filePaths);
+	// Hash of the names, sizes and modification times of the files of a directory (not recursive)
+	static std::string fingerprintDirectory(const std::string& dirPath);
+
+private:
+	std::string indexPath;
+	nlohmann::json index;
+
+	bool save() const;
+};